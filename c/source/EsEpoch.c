@@ -0,0 +1,227 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsEpoch.c
+ *  @brief Epoch-Based Reclamation Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+
+#include "plibsys.h"
+
+#include "EsEpoch.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Reader epoch value when outside of a critical section
+ */
+#define ES_EPOCH_INACTIVE       0
+
+/**
+ * @brief Size of a reader record so each one has its own cache line
+ */
+#define ES_EPOCH_CACHE_LINE     64
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Per-thread reader record
+ *
+ * Only the owning thread writes the active epoch.
+ * Records are registered with the domain so writers can scan them.
+ */
+typedef union _EsEpochReader EsEpochReader;
+union _EsEpochReader {
+    struct {
+        volatile I_32 active;
+        EsEpoch *epoch;
+        EsEpochReader *prevReader;
+        EsEpochReader *nextReader;
+    } r;
+    U_8 pad[ES_EPOCH_CACHE_LINE];
+};
+
+/**
+ * @brief Hidden implementation for EsEpoch
+ *
+ * Each reader thread gets its own record (thread-local) on first use.
+ * The record registry is guarded by the lock.
+ * The global epoch only changes in EsEpoch_synchronize().
+ *
+ * Freeing a thread-local key does not remove the thread exit hooks
+ * on every platform (plibsys POSIX keeps the pthread key), so a record
+ * is only ever freed by the exit hook of its thread. The domain stays
+ * allocated until it was freed and its last record is retired.
+ */
+struct _EsEpoch {
+    volatile I_32 global;
+    PUThreadKey *readerKey;
+    PMutex *lock;
+    EsEpochReader *readers;
+    BOOLEAN freed;
+};
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Release the memory of the domain
+ * @param epoch
+ */
+static void destroyEpoch(EsEpoch *epoch) {
+    if (epoch->lock != NULL) {
+        p_mutex_free(epoch->lock);
+    }
+    free(epoch);
+}
+
+/**
+ * @brief Thread exit hook that unregisters the reader record
+ * @note Destroys the domain if it was freed and this was its last record
+ * @param arg EsEpochReader
+ */
+static void retireReader(void *arg) {
+    EsEpochReader *reader = (EsEpochReader *) arg;
+    EsEpoch *epoch;
+    BOOLEAN lastReference;
+
+    if (reader == NULL) {
+        return;
+    }
+
+    epoch = reader->r.epoch;
+    p_mutex_lock(epoch->lock);
+    if (reader->r.prevReader != NULL) {
+        reader->r.prevReader->r.nextReader = reader->r.nextReader;
+    } else {
+        epoch->readers = reader->r.nextReader;
+    }
+    if (reader->r.nextReader != NULL) {
+        reader->r.nextReader->r.prevReader = reader->r.prevReader;
+    }
+    lastReference = (BOOLEAN) (epoch->freed && epoch->readers == NULL);
+    p_mutex_unlock(epoch->lock);
+    free(reader);
+    if (lastReference) {
+        destroyEpoch(epoch);
+    }
+}
+
+/**
+ * @brief Answer the calling thread's reader record, creating it on first use
+ * @param epoch
+ * @return reader or NULL if out of memory
+ */
+static EsEpochReader *getReader(EsEpoch *epoch) {
+    EsEpochReader *reader;
+
+    reader = (EsEpochReader *) p_uthread_get_local(epoch->readerKey);
+    if (reader == NULL) {
+        reader = (EsEpochReader *) calloc(1, sizeof(EsEpochReader));
+        if (reader != NULL) {
+            reader->r.epoch = epoch;
+            p_mutex_lock(epoch->lock);
+            reader->r.nextReader = epoch->readers;
+            if (epoch->readers != NULL) {
+                epoch->readers->r.prevReader = reader;
+            }
+            epoch->readers = reader;
+            p_mutex_unlock(epoch->lock);
+            p_uthread_set_local(epoch->readerKey, reader);
+        }
+    }
+    return reader;
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+EsEpoch *EsEpoch_new() {
+    EsEpoch *epoch;
+
+    epoch = (EsEpoch *) calloc(1, sizeof(EsEpoch));
+    if (epoch != NULL) {
+        epoch->global = 1;
+        epoch->lock = p_mutex_new();
+        epoch->readerKey = p_uthread_local_new(retireReader);
+        if (epoch->lock == NULL || epoch->readerKey == NULL) {
+            if (epoch->readerKey != NULL) {
+                p_uthread_local_free(epoch->readerKey);
+            }
+            destroyEpoch(epoch);
+            epoch = NULL;
+        }
+    }
+    return epoch;
+}
+
+void EsEpoch_free(EsEpoch *epoch) {
+    BOOLEAN lastReference;
+
+    if (epoch == NULL) {
+        return;
+    }
+
+    p_uthread_local_free(epoch->readerKey);
+    epoch->readerKey = NULL;
+
+    /* Live records are retired (and the domain destroyed) by their thread exit hooks */
+    p_mutex_lock(epoch->lock);
+    epoch->freed = TRUE;
+    lastReference = (BOOLEAN) (epoch->readers == NULL);
+    p_mutex_unlock(epoch->lock);
+    if (lastReference) {
+        destroyEpoch(epoch);
+    }
+}
+
+BOOLEAN EsEpoch_enter(EsEpoch *epoch) {
+    EsEpochReader *reader;
+
+    reader = getReader(epoch);
+    if (reader == NULL) {
+        return FALSE;
+    }
+    /* Announce the epoch before reading any shared pointer */
+    p_atomic_int_set(&reader->r.active, p_atomic_int_get(&epoch->global));
+    return TRUE;
+}
+
+void EsEpoch_exit(EsEpoch *epoch) {
+    EsEpochReader *reader;
+
+    reader = (EsEpochReader *) p_uthread_get_local(epoch->readerKey);
+    if (reader != NULL) {
+        p_atomic_int_set(&reader->r.active, ES_EPOCH_INACTIVE);
+    }
+}
+
+void EsEpoch_synchronize(EsEpoch *epoch) {
+    EsEpochReader *reader;
+    I_32 target;
+    I_32 active;
+
+    /* Readers that enter from now on can only see the new data */
+    target = p_atomic_int_add(&epoch->global, 1) + 1;
+    if (target == ES_EPOCH_INACTIVE) {
+        target = p_atomic_int_add(&epoch->global, 1) + 1;
+    }
+
+    /* Wait for the readers that announced an older epoch */
+    p_mutex_lock(epoch->lock);
+    for (reader = epoch->readers; reader != NULL; reader = reader->r.nextReader) {
+        while ((active = p_atomic_int_get(&reader->r.active)) != ES_EPOCH_INACTIVE && active != target) {
+            p_uthread_yield();
+        }
+    }
+    p_mutex_unlock(epoch->lock);
+}
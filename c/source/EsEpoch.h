@@ -0,0 +1,95 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsEpoch.h
+ *  @brief Epoch-Based Reclamation Interface
+ *  @author Seth Berman
+ *
+ *  Epochs allow readers to use shared data that is published with an
+ *  atomic pointer, without taking a lock. A writer publishes a new version
+ *  of the data, waits until no reader can still be using the old version,
+ *  and only then frees the old version.
+ *
+ *  Readers only write to their own (thread-local) epoch record, so
+ *  concurrent readers do not share any written cache line.
+ *  Writers are expected to be rare and must be serialized by the caller.
+ *
+ *  Reader:
+ *  EsEpoch_enter(epoch);
+ *  data = p_atomic_pointer_get(&shared);
+ *  ...read data...
+ *  EsEpoch_exit(epoch);
+ *
+ *  Writer:
+ *  old = shared;
+ *  p_atomic_pointer_set(&shared, new);
+ *  EsEpoch_synchronize(epoch);
+ *  free(old);
+ *******************************************************************************/
+#ifndef ES_EPOCH_H
+#define ES_EPOCH_H
+
+#include "EsMqtt.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Epoch domain that readers and writers share
+ * @note This is an opaque datatype
+ */
+typedef struct _EsEpoch EsEpoch;
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer a new epoch domain
+ * @return epoch or NULL if out of memory
+ */
+EsEpoch *EsEpoch_new();
+
+/**
+ * @brief Destroy the epoch domain
+ * @note There must be no readers inside the domain.
+ * The record of a thread that has read is reclaimed when that thread exits,
+ * together with the rest of the domain if it was the last one.
+ * @param epoch
+ */
+void EsEpoch_free(EsEpoch *epoch);
+
+/*********************/
+/*   R E A D E R S   */
+/*********************/
+
+/**
+ * @brief Enter a read-side critical section
+ * @note Sections do not nest, and must be short since writers wait for them
+ * @param epoch
+ * @return TRUE if entered, FALSE if out of memory (the caller must not read)
+ */
+BOOLEAN EsEpoch_enter(EsEpoch *epoch);
+
+/**
+ * @brief Exit the read-side critical section
+ * @param epoch
+ */
+void EsEpoch_exit(EsEpoch *epoch);
+
+/*********************/
+/*   W R I T E R S   */
+/*********************/
+
+/**
+ * @brief Wait until every reader that may have seen data unpublished
+ * before this call has exited its critical section
+ * @note Must not be called from inside a read-side critical section
+ * @param epoch
+ */
+void EsEpoch_synchronize(EsEpoch *epoch);
+
+#endif //ES_EPOCH_H
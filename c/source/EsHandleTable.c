@@ -0,0 +1,229 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsHandleTable.c
+ *  @brief Generation-Tagged Handle Table Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+
+#include "plibsys.h"
+
+#include "EsHandleTable.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Handle bit fields
+ */
+#define ES_HANDLE_INDEX_BITS        18u
+#define ES_HANDLE_INDEX_MASK        ((1u << ES_HANDLE_INDEX_BITS) - 1u)
+#define ES_HANDLE_GENERATION_MASK   0xFFFu
+
+/**
+ * @brief Compose a handle from a slot generation and index
+ */
+#define ES_HANDLE_MAKE(_gen, _index)    (((_gen) << ES_HANDLE_INDEX_BITS) | (_index))
+
+/**
+ * @brief End of the free slot list
+ */
+#define ES_HANDLE_NO_SLOT           ((U_32) -1)
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Handle slot
+ *
+ * ptr: Pointer of the live handle, or NULL if the slot is free
+ * generation: Tag of the current (or next) handle of the slot, never 0
+ * nextFree: Index of the next free slot while the slot is free
+ * tag: Caller's tag of the live handle
+ */
+typedef struct _EsHandleSlot EsHandleSlot;
+struct _EsHandleSlot {
+    void *ptr;
+    U_32 generation;
+    union {
+        U_32 nextFree;
+        U_32 tag;
+    } u;
+};
+
+/**
+ * @brief Hidden implementation for EsHandleTable
+ *
+ * Free slots are linked through their nextFree index.
+ * All state is guarded by the lock.
+ */
+struct _EsHandleTable {
+    PMutex *lock;
+    EsHandleSlot *slots;
+    U_32 capacity;
+    U_32 size;
+    U_32 freeSlot;
+};
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Answer the live slot of the handle
+ * @note lock must be held
+ * @param table
+ * @param handle
+ * @return slot or NULL if the handle is not live
+ */
+static EsHandleSlot *liveSlot(EsHandleTable *table, U_32 handle) {
+    U_32 index = handle & ES_HANDLE_INDEX_MASK;
+    EsHandleSlot *slot;
+
+    if (index >= table->capacity) {
+        return NULL;
+    }
+    slot = &table->slots[index];
+    if (slot->ptr == NULL || ES_HANDLE_MAKE(slot->generation, index) != handle) {
+        return NULL;
+    }
+    return slot;
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+EsHandleTable *EsHandleTable_new(U_32 capacity) {
+    EsHandleTable *table;
+    U_32 i;
+
+    if (capacity == 0 || capacity > ES_HANDLE_TABLE_MAX_CAPACITY) {
+        return NULL;
+    }
+
+    table = (EsHandleTable *) calloc(1, sizeof(EsHandleTable));
+    if (table != NULL) {
+        table->slots = (EsHandleSlot *) malloc(sizeof(EsHandleSlot) * capacity);
+        table->lock = p_mutex_new();
+        if (table->slots == NULL || table->lock == NULL) {
+            EsHandleTable_free(table);
+            return NULL;
+        }
+        for (i = 0; i < capacity; i++) {
+            table->slots[i].ptr = NULL;
+            table->slots[i].generation = 1;
+            table->slots[i].u.nextFree = (i + 1 < capacity) ? i + 1 : ES_HANDLE_NO_SLOT;
+        }
+        table->capacity = capacity;
+        table->freeSlot = 0;
+    }
+    return table;
+}
+
+void EsHandleTable_free(EsHandleTable *table) {
+    if (table != NULL) {
+        if (table->lock != NULL) {
+            p_mutex_free(table->lock);
+        }
+        free(table->slots);
+        free(table);
+    }
+}
+
+U_32 EsHandleTable_add(EsHandleTable *table, void *ptr) {
+    return EsHandleTable_addTagged(table, ptr, 0);
+}
+
+U_32 EsHandleTable_addTagged(EsHandleTable *table, void *ptr, U_32 tag) {
+    EsHandleSlot *slot;
+    U_32 index;
+    U_32 handle = ES_HANDLE_NONE;
+
+    if (table == NULL || ptr == NULL) {
+        return ES_HANDLE_NONE;
+    }
+
+    p_mutex_lock(table->lock);
+    index = table->freeSlot;
+    if (index != ES_HANDLE_NO_SLOT) {
+        slot = &table->slots[index];
+        table->freeSlot = slot->u.nextFree;
+        slot->ptr = ptr;
+        slot->u.tag = tag;
+        table->size++;
+        handle = ES_HANDLE_MAKE(slot->generation, index);
+    }
+    p_mutex_unlock(table->lock);
+    return handle;
+}
+
+void *EsHandleTable_at(EsHandleTable *table, U_32 handle) {
+    return EsHandleTable_atTagged(table, handle, NULL);
+}
+
+void *EsHandleTable_atTagged(EsHandleTable *table, U_32 handle, U_32 *tag) {
+    EsHandleSlot *slot;
+    void *ptr = NULL;
+
+    if (table == NULL) {
+        return NULL;
+    }
+
+    p_mutex_lock(table->lock);
+    slot = liveSlot(table, handle);
+    if (slot != NULL) {
+        ptr = slot->ptr;
+        if (tag != NULL) {
+            *tag = slot->u.tag;
+        }
+    }
+    p_mutex_unlock(table->lock);
+    return ptr;
+}
+
+void *EsHandleTable_remove(EsHandleTable *table, U_32 handle) {
+    return EsHandleTable_removeTagged(table, handle, NULL);
+}
+
+void *EsHandleTable_removeTagged(EsHandleTable *table, U_32 handle, U_32 *tag) {
+    EsHandleSlot *slot;
+    void *ptr = NULL;
+
+    if (table == NULL) {
+        return NULL;
+    }
+
+    p_mutex_lock(table->lock);
+    slot = liveSlot(table, handle);
+    if (slot != NULL) {
+        ptr = slot->ptr;
+        if (tag != NULL) {
+            *tag = slot->u.tag;
+        }
+        slot->ptr = NULL;
+        /* New tag so this handle is stale (0 is skipped) */
+        slot->generation = (slot->generation == ES_HANDLE_GENERATION_MASK) ? 1 : slot->generation + 1;
+        slot->u.nextFree = table->freeSlot;
+        table->freeSlot = (U_32) (slot - table->slots);
+        table->size--;
+    }
+    p_mutex_unlock(table->lock);
+    return ptr;
+}
+
+U_32 EsHandleTable_getSize(EsHandleTable *table) {
+    U_32 size = 0;
+
+    if (table != NULL) {
+        p_mutex_lock(table->lock);
+        size = table->size;
+        p_mutex_unlock(table->lock);
+    }
+    return size;
+}
@@ -0,0 +1,148 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsHandleTable.h
+ *  @brief Generation-Tagged Handle Table Interface
+ *  @author Seth Berman
+ *
+ *  A handle table maps small integer handles to pointers.
+ *  Handles are used instead of addresses for data that is passed to Smalltalk
+ *  in async messages. A handle always fits in a positive SmallInteger, so one
+ *  arg is enough where an address needed to be split into high/low parts.
+ *
+ *  A handle is the index of a slot in a preallocated array, tagged with the
+ *  generation of the slot. The generation changes each time the slot is freed,
+ *  so a stale handle (already removed) is detected instead of answering the
+ *  pointer that now occupies the slot. Lookups are O(1).
+ *
+ *  Handle layout (30 bits):
+ *  [generation: 12 bits][index: 18 bits]
+ *  The generation is never 0, so 0 is never a valid handle (ES_HANDLE_NONE).
+ *
+ *  EsHandleTable *table = EsHandleTable_new(1024);
+ *  U_32 handle = EsHandleTable_add(table, ptr);
+ *  ptr = EsHandleTable_at(table, handle);
+ *  ptr = EsHandleTable_remove(table, handle);    <-- handle is stale now
+ *  EsHandleTable_free(table);
+ *
+ *  A handle can carry a small caller-defined tag (i.e. who owns the pointer),
+ *  which is kept natively and answered with the pointer by the *Tagged functions.
+ *******************************************************************************/
+#ifndef ES_HANDLE_TABLE_H
+#define ES_HANDLE_TABLE_H
+
+#include "EsMqtt.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Handle that never refers to a pointer (i.e. for NULL)
+ */
+#define ES_HANDLE_NONE                  0
+
+/**
+ * @brief Max number of slots in a table
+ */
+#define ES_HANDLE_TABLE_MAX_CAPACITY    (1u << 18u)
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Table of generation-tagged handles
+ * @note This is an opaque datatype
+ */
+typedef struct _EsHandleTable EsHandleTable;
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer a new table with all slots preallocated
+ * @param capacity max number of live handles (up to ES_HANDLE_TABLE_MAX_CAPACITY)
+ * @return table or NULL if invalid capacity or out of memory
+ */
+EsHandleTable *EsHandleTable_new(U_32 capacity);
+
+/**
+ * @brief Destroy the table
+ * @note The pointers of live handles are not freed
+ * @param table
+ */
+void EsHandleTable_free(EsHandleTable *table);
+
+/*********************/
+/*   H A N D L E S   */
+/*********************/
+
+/**
+ * @brief Answer a new handle for the pointer
+ * @note thread-safe
+ * @param table
+ * @param ptr must not be NULL
+ * @return handle or ES_HANDLE_NONE if the table is full
+ */
+U_32 EsHandleTable_add(EsHandleTable *table, void *ptr);
+
+/**
+ * @brief Answer a new handle for the pointer, tagged with tag
+ * @note thread-safe
+ * @param table
+ * @param ptr must not be NULL
+ * @param tag caller-defined tag of the handle
+ * @return handle or ES_HANDLE_NONE if the table is full
+ */
+U_32 EsHandleTable_addTagged(EsHandleTable *table, void *ptr, U_32 tag);
+
+/**
+ * @brief Answer the pointer of the handle
+ * @note thread-safe
+ * @param table
+ * @param handle
+ * @return pointer or NULL if the handle is not live (stale or invalid)
+ */
+void *EsHandleTable_at(EsHandleTable *table, U_32 handle);
+
+/**
+ * @brief Answer the pointer and tag of the handle
+ * @note thread-safe
+ * @param table
+ * @param handle
+ * @param tag[out] tag of the handle (untouched if not live), may be NULL
+ * @return pointer or NULL if the handle is not live (stale or invalid)
+ */
+void *EsHandleTable_atTagged(EsHandleTable *table, U_32 handle, U_32 *tag);
+
+/**
+ * @brief Remove the handle and answer its pointer
+ * @note thread-safe
+ * @param table
+ * @param handle
+ * @return pointer or NULL if the handle is not live (stale or invalid)
+ */
+void *EsHandleTable_remove(EsHandleTable *table, U_32 handle);
+
+/**
+ * @brief Remove the handle and answer its pointer and tag
+ * @note thread-safe
+ * @param table
+ * @param handle
+ * @param tag[out] tag of the handle (untouched if not live), may be NULL
+ * @return pointer or NULL if the handle is not live (stale or invalid)
+ */
+void *EsHandleTable_removeTagged(EsHandleTable *table, U_32 handle, U_32 *tag);
+
+/**
+ * @brief Answer the number of live handles
+ * @param table
+ * @return number of live handles
+ */
+U_32 EsHandleTable_getSize(EsHandleTable *table);
+
+#endif //ES_HANDLE_TABLE_H
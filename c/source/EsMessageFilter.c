@@ -0,0 +1,205 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsMessageFilter.c
+ *  @brief Message Filter Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+
+#include "plibsys.h"
+
+#include "EsMessageFilter.h"
+#include "EsTopicTable.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief FNV-1a 64-bit hash parameters of the payload hash
+ */
+#define ESMF_FNV_OFFSET_BASIS   0xCBF29CE484222325ULL
+#define ESMF_FNV_PRIME          0x00000100000001B3ULL
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Filter state of one topic name
+ *
+ * count: Messages seen since the last sample (sample)
+ * lastUs: Time of the last accepted message (rate limit, dedupe)
+ * lastHash: Payload hash of the last accepted message (dedupe)
+ */
+typedef struct _EsFilterState EsFilterState;
+struct _EsFilterState {
+    U_64 lastUs;
+    U_64 lastHash;
+    U_32 count;
+    BOOLEAN hasLast;
+};
+
+/**
+ * @brief Hidden implementation for EsMessageFilter
+ *
+ * The lock guards the topic table and its states, the statistics are atomic.
+ */
+struct _EsMessageFilter {
+    enum EsMessageFilterTypes type;
+    U_32 param;
+    PMutex *lock;
+    PTimeProfiler *clock;
+    EsTopicTable *topics;
+    volatile I_32 numAccepted;
+    volatile I_32 numDropped;
+};
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Answer the FNV-1a hash of the payload
+ * @param payload may be NULL if payloadLen is 0
+ * @param payloadLen
+ * @return hash
+ */
+static U_64 hashPayload(const void *payload, U_32 payloadLen) {
+    const U_8 *p = (const U_8 *) payload;
+    U_64 hash = ESMF_FNV_OFFSET_BASIS;
+    U_32 i;
+
+    for (i = 0; i < payloadLen; i++) {
+        hash ^= (U_64) p[i];
+        hash *= ESMF_FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Answer if the state lets the message through, and update it if so
+ * @param filter (locked)
+ * @param state
+ * @param payload
+ * @param payloadLen
+ * @return TRUE if accepted, FALSE if dropped
+ */
+static BOOLEAN acceptByState(EsMessageFilter *filter, EsFilterState *state, const void *payload, U_32 payloadLen) {
+    U_64 intervalUs = (U_64) filter->param * 1000;
+    U_64 nowUs;
+    U_64 payloadHash;
+    BOOLEAN accepted;
+
+    switch (filter->type) {
+        case ESMF_TYPE_SAMPLE:
+            accepted = (BOOLEAN) (state->count == 0);
+            state->count = (state->count + 1 < filter->param) ? state->count + 1 : 0;
+            return accepted;
+        case ESMF_TYPE_RATE_LIMIT:
+            nowUs = p_time_profiler_elapsed_usecs(filter->clock);
+            if (state->hasLast && nowUs - state->lastUs < intervalUs) {
+                return FALSE;
+            }
+            state->lastUs = nowUs;
+            state->hasLast = TRUE;
+            return TRUE;
+        case ESMF_TYPE_DEDUPE:
+            nowUs = p_time_profiler_elapsed_usecs(filter->clock);
+            payloadHash = hashPayload(payload, payloadLen);
+            if (state->hasLast && state->lastHash == payloadHash
+                && (intervalUs == 0 || nowUs - state->lastUs < intervalUs)) {
+                return FALSE;
+            }
+            state->lastUs = nowUs;
+            state->lastHash = payloadHash;
+            state->hasLast = TRUE;
+            return TRUE;
+        default:
+            return TRUE;
+    }
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+EsMessageFilter *EsMessageFilter_new(enum EsMessageFilterTypes type, U_32 param) {
+    EsMessageFilter *filter;
+
+    switch (type) {
+        case ESMF_TYPE_SAMPLE:
+        case ESMF_TYPE_RATE_LIMIT:
+            if (param == 0) {
+                return NULL;
+            }
+            break;
+        case ESMF_TYPE_DEDUPE:
+            break;
+        default:
+            return NULL;
+    }
+
+    filter = (EsMessageFilter *) calloc(1, sizeof(EsMessageFilter));
+    if (filter != NULL) {
+        filter->type = type;
+        filter->param = param;
+        filter->lock = p_mutex_new();
+        filter->clock = p_time_profiler_new();
+        filter->topics = EsTopicTable_new(sizeof(EsFilterState), ESMF_MAX_TOPICS);
+        if (filter->lock == NULL || filter->clock == NULL || filter->topics == NULL) {
+            EsMessageFilter_free(filter);
+            filter = NULL;
+        }
+    }
+    return filter;
+}
+
+void EsMessageFilter_free(EsMessageFilter *filter) {
+    if (filter == NULL) {
+        return;
+    }
+
+    EsTopicTable_free(filter->topics);
+    if (filter->clock != NULL) {
+        p_time_profiler_free(filter->clock);
+    }
+    if (filter->lock != NULL) {
+        p_mutex_free(filter->lock);
+    }
+    free(filter);
+}
+
+BOOLEAN EsMessageFilter_accept(EsMessageFilter *filter, const char *topic, U_32 topicLen,
+                               const void *payload, U_32 payloadLen) {
+    EsFilterState *state;
+    BOOLEAN accepted = TRUE;
+
+    if (filter == NULL || topic == NULL) {
+        return TRUE;
+    }
+
+    p_mutex_lock(filter->lock);
+    state = (EsFilterState *) EsTopicTable_atOrAdd(filter->topics, topic, topicLen);
+    if (state != NULL) {
+        accepted = acceptByState(filter, state, payload, payloadLen);
+    }
+    p_mutex_unlock(filter->lock);
+
+    p_atomic_int_inc(accepted ? &filter->numAccepted : &filter->numDropped);
+    return accepted;
+}
+
+void EsMessageFilter_getStats(EsMessageFilter *filter, EsMessageFilterStats *stats) {
+    if (stats == NULL) {
+        return;
+    }
+    p_mutex_lock(filter->lock);
+    stats->numTopics = EsTopicTable_getSize(filter->topics);
+    p_mutex_unlock(filter->lock);
+    stats->numAccepted = (U_32) p_atomic_int_get(&filter->numAccepted);
+    stats->numDropped = (U_32) p_atomic_int_get(&filter->numDropped);
+}
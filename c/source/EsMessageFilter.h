@@ -0,0 +1,119 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsMessageFilter.h
+ *  @brief Message Filter Interface
+ *  @author Seth Berman
+ *
+ *  A message filter decides per topic name if a message is worth
+ *  delivering, so unwanted messages can be dropped before they are posted.
+ *  Each topic name the filter sees gets its own state, so one filter
+ *  (i.e. bound to the topic filter "sensors/+/temp") thins out every
+ *  matching topic separately.
+ *
+ *  Filter Types:
+ *  ESMF_TYPE_SAMPLE: Accept the first and then every Nth message (param is N)
+ *  ESMF_TYPE_RATE_LIMIT: Accept at most one message per interval (param is milliseconds)
+ *  ESMF_TYPE_DEDUPE: Drop payloads equal to the last accepted one
+ *                    (param is milliseconds a duplicate is dropped for, 0 for no limit)
+ *
+ *  Payloads are compared by a 64-bit hash, not byte by byte.
+ *******************************************************************************/
+#ifndef ES_MESSAGE_FILTER_H
+#define ES_MESSAGE_FILTER_H
+
+#include "EsMqtt.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Upper bound of the topic names that get their own state.
+ * Messages of any further topic name are accepted.
+ */
+#define ESMF_MAX_TOPICS     65536
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Message filter
+ * @note This is an opaque datatype
+ */
+typedef struct _EsMessageFilter EsMessageFilter;
+
+/**
+ * @brief Filter Types
+ */
+enum EsMessageFilterTypes {
+    ESMF_TYPE_NONE = 0,
+    ESMF_TYPE_SAMPLE = 1,
+    ESMF_TYPE_RATE_LIMIT = 2,
+    ESMF_TYPE_DEDUPE = 3
+};
+
+/**
+ * @brief Filter statistics
+ *
+ * numTopics: Topic names with their own state
+ * numAccepted: Messages accepted
+ * numDropped: Messages dropped
+ */
+typedef struct _EsMessageFilterStats EsMessageFilterStats;
+struct _EsMessageFilterStats {
+    U_32 numTopics;
+    U_32 numAccepted;
+    U_32 numDropped;
+};
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer a new message filter
+ * @param type filter type (not ESMF_TYPE_NONE)
+ * @param param parameter of the type (must be > 0 for sample and rate limit)
+ * @return filter or NULL if the type/param is invalid or out of memory
+ */
+EsMessageFilter *EsMessageFilter_new(enum EsMessageFilterTypes type, U_32 param);
+
+/**
+ * @brief Destroy the filter
+ * @param filter may be NULL
+ */
+void EsMessageFilter_free(EsMessageFilter *filter);
+
+/*********************/
+/*   F I L T E R S   */
+/*********************/
+
+/**
+ * @brief Answer if the message is accepted, and update the state of the topic name
+ * @note thread-safe
+ * @param filter
+ * @param topic topic name
+ * @param topicLen length of the topic name (0 if null-terminated)
+ * @param payload may be NULL if payloadLen is 0
+ * @param payloadLen
+ * @return TRUE if accepted, FALSE if dropped
+ */
+BOOLEAN EsMessageFilter_accept(EsMessageFilter *filter, const char *topic, U_32 topicLen,
+                               const void *payload, U_32 payloadLen);
+
+/*************************/
+/*   A C C E S S I N G   */
+/*************************/
+
+/**
+ * @brief Get the filter statistics
+ * @param filter
+ * @param stats[output]
+ */
+void EsMessageFilter_getStats(EsMessageFilter *filter, EsMessageFilterStats *stats);
+
+#endif //ES_MESSAGE_FILTER_H
@@ -9,19 +9,213 @@
  *******************************************************************************/
 #include <string.h>
 
+#include "plibsys.h"
 #include "MQTTClient.h"
 
 #include "EsMqttAsyncArguments.h"
+#include "EsRefBuffer.h"
+
+/*******************************************/
+/*   M O D U L E  P R I V A T E  V A R S   */
+/*******************************************/
+
+/**
+ * @brief Paho functions that free pass-through data
+ *
+ * These are only ever replaced by other valid Paho functions, so a message
+ * adopted in pass-through mode can always be freed even if pass-through
+ * is later disabled.
+ */
+static EsMqttFreeMessageFunc _PahoFreeMessage = NULL;
+static EsMqttFreeFunc _PahoFree = NULL;
+
+/**
+ * @brief Non-zero if arrived messages are passed through
+ */
+static volatile I_32 _PassThrough = 0;
 
 /*********************/
 /*   U T I L I T Y   */
 /*********************/
 
-static void copyMessageInto(MQTTClient_message *dest, MQTTClient_message *src) {
-    if (src != NULL && dest != NULL) {
-        memcpy(dest, src, sizeof(MQTTClient_message));
-        memcpy(dest->payload, src->payload, src->payloadlen);
+/**
+ * @brief Answer the number of length-prefixed values the property carries
+ * @note Paho's MQTTProperty_getType() is not used since Paho is not linked
+ * @param identifier
+ * @return 0 for numeric values, 1 for string/binary data, 2 for string pairs
+ */
+static U_32 propertyNumLenStrings(enum MQTTPropertyCodes identifier) {
+    switch (identifier) {
+        case MQTTPROPERTY_CODE_CONTENT_TYPE:
+        case MQTTPROPERTY_CODE_RESPONSE_TOPIC:
+        case MQTTPROPERTY_CODE_CORRELATION_DATA:
+        case MQTTPROPERTY_CODE_ASSIGNED_CLIENT_IDENTIFER:
+        case MQTTPROPERTY_CODE_AUTHENTICATION_METHOD:
+        case MQTTPROPERTY_CODE_AUTHENTICATION_DATA:
+        case MQTTPROPERTY_CODE_RESPONSE_INFORMATION:
+        case MQTTPROPERTY_CODE_SERVER_REFERENCE:
+        case MQTTPROPERTY_CODE_REASON_STRING:
+            return 1;
+        case MQTTPROPERTY_CODE_USER_PROPERTY:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Answer the numeric value of the property
+ * @note Paho's MQTTProperty_getType() is not used since Paho is not linked
+ * @param prop
+ * @return value from the union member of the property's type
+ */
+static U_32 propertyNumericValue(const MQTTProperty *prop) {
+    switch (prop->identifier) {
+        case MQTTPROPERTY_CODE_PAYLOAD_FORMAT_INDICATOR:
+        case MQTTPROPERTY_CODE_REQUEST_PROBLEM_INFORMATION:
+        case MQTTPROPERTY_CODE_REQUEST_RESPONSE_INFORMATION:
+        case MQTTPROPERTY_CODE_MAXIMUM_QOS:
+        case MQTTPROPERTY_CODE_RETAIN_AVAILABLE:
+        case MQTTPROPERTY_CODE_WILDCARD_SUBSCRIPTION_AVAILABLE:
+        case MQTTPROPERTY_CODE_SUBSCRIPTION_IDENTIFIERS_AVAILABLE:
+        case MQTTPROPERTY_CODE_SHARED_SUBSCRIPTION_AVAILABLE:
+            return prop->value.byte;
+        case MQTTPROPERTY_CODE_SERVER_KEEP_ALIVE:
+        case MQTTPROPERTY_CODE_RECEIVE_MAXIMUM:
+        case MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM:
+        case MQTTPROPERTY_CODE_TOPIC_ALIAS:
+            return prop->value.integer2;
+        default:
+            return prop->value.integer4;
+    }
+}
+
+/**
+ * @brief Answer the bytes needed to pack a length-prefixed value
+ * @param lenStr
+ * @return U_SIZE (a multiple of 4)
+ */
+static U_SIZE lenStringPackedSize(const MQTTLenString *lenStr) {
+    U_SIZE len = (lenStr->data != NULL && lenStr->len > 0) ? (U_SIZE) lenStr->len : 0;
+
+    return sizeof(U_32) + ((len + 3) & ~(U_SIZE) 3);
+}
+
+/**
+ * @brief Pack a length-prefixed value and answer the position after it
+ * @param lenStr
+ * @param dest
+ * @return next position
+ */
+static U_8 *packLenString(const MQTTLenString *lenStr, U_8 *dest) {
+    U_32 len = (lenStr->data != NULL && lenStr->len > 0) ? (U_32) lenStr->len : 0;
+    U_SIZE size = lenStringPackedSize(lenStr);
+
+    memcpy(dest, &len, sizeof(U_32));
+    if (len > 0) {
+        memcpy(dest + sizeof(U_32), lenStr->data, len);
+    }
+    memset(dest + sizeof(U_32) + len, 0, size - sizeof(U_32) - len);
+    return dest + size;
+}
+
+/**
+ * @brief Answer the bytes needed to copy a length-prefixed value
+ * @note One extra byte so the copy is always null-terminated
+ * @param lenStr
+ * @return U_SIZE
+ */
+static U_SIZE lenStringCopySize(const MQTTLenString *lenStr) {
+    return (lenStr->data != NULL && lenStr->len > 0) ? (U_SIZE) lenStr->len + 1 : 1;
+}
+
+/**
+ * @brief Copy a length-prefixed value to the arena and answer the arena position after it
+ * @param dest[out] points into the arena
+ * @param src
+ * @param arena
+ * @return next free arena position
+ */
+static char *copyLenStringInto(MQTTLenString *dest, const MQTTLenString *src, char *arena) {
+    U_SIZE len = lenStringCopySize(src) - 1;
+
+    if (len > 0) {
+        memcpy(arena, src->data, len);
+    }
+    arena[len] = '\0';
+    dest->len = (int) len;
+    dest->data = arena;
+    return arena + len + 1;
+}
+
+/**
+ * @brief Answer the bytes needed for the deep copy of the property array and its values
+ * @note Pre-pass for sizing the single block that holds a properties copy
+ * @param props
+ * @return U_SIZE
+ */
+static U_SIZE propertiesDataSize(const MQTTProperties *props) {
+    U_SIZE size;
+    I_32 i;
+
+    if (props->array == NULL || props->count <= 0) {
+        return 0;
     }
+
+    size = sizeof(MQTTProperty) * (U_SIZE) props->count;
+    for (i = 0; i < props->count; i++) {
+        const MQTTProperty *prop = &props->array[i];
+        switch (propertyNumLenStrings(prop->identifier)) {
+            case 2:
+                size += lenStringCopySize(&prop->value.value);
+                /* Fall-Through */
+            case 1:
+                size += lenStringCopySize(&prop->value.data);
+                break;
+            default:
+                break;
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief Deep copy the properties into dest using the arena for the array and values
+ * @note The arena must be at least propertiesDataSize(src) bytes and pointer aligned
+ * @param dest[out]
+ * @param src
+ * @param arena
+ */
+static void copyPropertiesInto(MQTTProperties *dest, const MQTTProperties *src, void *arena) {
+    MQTTProperty *array;
+    char *strings;
+    I_32 i;
+
+    memcpy(dest, src, sizeof(MQTTProperties));
+    if (src->array == NULL || src->count <= 0) {
+        dest->count = 0;
+        dest->max_count = 0;
+        dest->array = NULL;
+        return;
+    }
+
+    array = (MQTTProperty *) arena;
+    strings = (char *) (array + src->count);
+    memcpy(array, src->array, sizeof(MQTTProperty) * (U_SIZE) src->count);
+    for (i = 0; i < src->count; i++) {
+        switch (propertyNumLenStrings(src->array[i].identifier)) {
+            case 2:
+                strings = copyLenStringInto(&array[i].value.value, &src->array[i].value.value, strings);
+                /* Fall-Through */
+            case 1:
+                strings = copyLenStringInto(&array[i].value.data, &src->array[i].value.data, strings);
+                break;
+            default:
+                break;
+        }
+    }
+    dest->max_count = src->count;
+    dest->array = array;
 }
 
 /******************************************************/
@@ -33,7 +227,39 @@ void EsMqttAsyncArguments_ModuleInit(EsGlobalInfo *globalInfo) {
 }
 
 void EsMqttAsyncArguments_ModuleShutdown() {
-    /* No-Op */
+    p_atomic_int_set(&_PassThrough, 0);
+}
+
+void EsMqttAsyncArguments_SetPassThrough(EsMqttFreeMessageFunc freeMessageFunc, EsMqttFreeFunc freeFunc) {
+    if (freeMessageFunc != NULL && freeFunc != NULL) {
+        p_atomic_pointer_set((volatile void *) &_PahoFreeMessage, (void *) freeMessageFunc);
+        p_atomic_pointer_set((volatile void *) &_PahoFree, (void *) freeFunc);
+        p_atomic_int_set(&_PassThrough, 1);
+    } else {
+        p_atomic_int_set(&_PassThrough, 0);
+    }
+}
+
+BOOLEAN EsMqttAsyncArguments_IsPassThrough() {
+    return (BOOLEAN) (p_atomic_int_get(&_PassThrough) != 0);
+}
+
+void EsFreePahoMessage(MQTTClient_message *msg) {
+    EsMqttFreeMessageFunc freeMessage;
+
+    freeMessage = (EsMqttFreeMessageFunc) p_atomic_pointer_get((const volatile void *) &_PahoFreeMessage);
+    if (msg != NULL && freeMessage != NULL) {
+        freeMessage(&msg);
+    }
+}
+
+void EsFreePahoString(char *str) {
+    EsMqttFreeFunc freeFunc;
+
+    freeFunc = (EsMqttFreeFunc) p_atomic_pointer_get((const volatile void *) &_PahoFree);
+    if (str != NULL && freeFunc != NULL) {
+        freeFunc(str);
+    }
 }
 
 MQTTProperties *EsCopyProperties(MQTTProperties *props) {
@@ -43,11 +269,12 @@ MQTTProperties *EsCopyProperties(MQTTProperties *props) {
         return NULL;
     }
 
-    heapCopy = (MQTTProperties *) EsAllocateMemory(sizeof(MQTTProperties));
-    memcpy(heapCopy, props, sizeof(MQTTProperties));
-
-    // TODO: Copy the list of properties
-
+    /* The property array and all its values follow the struct in the same block */
+    heapCopy = (MQTTProperties *) EsAllocateMemory(sizeof(MQTTProperties) + propertiesDataSize(props));
+    if (heapCopy == NULL) {
+        return NULL;
+    }
+    copyPropertiesInto(heapCopy, props, heapCopy + 1);
     return heapCopy;
 }
 
@@ -59,6 +286,9 @@ char *EsCopyString(char *str) {
     }
 
     heapCopy = (char *) EsAllocateMemory(strlen(str) + 1);
+    if (heapCopy == NULL) {
+        return NULL;
+    }
     strcpy(heapCopy, str);
     return heapCopy;
 }
@@ -73,17 +303,109 @@ char *EsCopyTopicString(char *topicStr, I_32 len) {
 
     actualLen = (len == 0) ? strlen(topicStr) : (U_SIZE)len;
     heapCopy = (char *) EsAllocateMemory(actualLen + 1);
-    strncpy(heapCopy, topicStr, actualLen);
+    if (heapCopy == NULL) {
+        return NULL;
+    }
+    memcpy(heapCopy, topicStr, actualLen);
+    heapCopy[actualLen] = '\0';
     return heapCopy;
 }
 
 MQTTClient_message *EsCopyMessage(MQTTClient_message *msg) {
     MQTTClient_message *heapCopy;
+    void *payload = NULL;
+
     if (msg == NULL) {
         return NULL;
     }
 
-    heapCopy = (MQTTClient_message *) EsAllocateMemory(sizeof(MQTTClient_message));
-    copyMessageInto(heapCopy, msg);
+    /* The payload is a shared ref buffer so holders do not need their own copy */
+    if (msg->payload != NULL && msg->payloadlen > 0) {
+        payload = EsRefBuffer_newCopy(msg->payload, (U_SIZE) msg->payloadlen);
+        if (payload == NULL) {
+            return NULL;
+        }
+    }
+
+    /* The v5 properties are deep copied into the same block as the struct */
+    heapCopy = (MQTTClient_message *) EsAllocateMemory(sizeof(MQTTClient_message) +
+                                                       propertiesDataSize(&msg->properties));
+    if (heapCopy == NULL) {
+        EsRefBuffer_release(payload);
+        return NULL;
+    }
+
+    memcpy(heapCopy, msg, sizeof(MQTTClient_message));
+    copyPropertiesInto(&heapCopy->properties, &msg->properties, heapCopy + 1);
+    heapCopy->payload = payload;
+    if (payload == NULL) {
+        heapCopy->payloadlen = 0;
+    }
     return heapCopy;
 }
+
+void EsFreeMessageCopy(MQTTClient_message *msgCopy) {
+    if (msgCopy != NULL) {
+        EsRefBuffer_release(msgCopy->payload);
+        EsFreeMemory(msgCopy);
+    }
+}
+
+U_SIZE EsPackedPropertiesSize(const MQTTProperties *props) {
+    U_SIZE size = 0;
+    I_32 i;
+
+    if (props == NULL || props->array == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < props->count; i++) {
+        const MQTTProperty *prop = &props->array[i];
+        size += sizeof(I_32);
+        switch (propertyNumLenStrings(prop->identifier)) {
+            case 2:
+                size += lenStringPackedSize(&prop->value.data) + lenStringPackedSize(&prop->value.value);
+                break;
+            case 1:
+                size += lenStringPackedSize(&prop->value.data);
+                break;
+            default:
+                size += sizeof(U_32);
+                break;
+        }
+    }
+    return size;
+}
+
+void EsPackProperties(const MQTTProperties *props, void *dest) {
+    U_8 *position = (U_8 *) dest;
+    I_32 identifier;
+    U_32 value;
+    I_32 i;
+
+    if (props == NULL || props->array == NULL) {
+        return;
+    }
+
+    for (i = 0; i < props->count; i++) {
+        const MQTTProperty *prop = &props->array[i];
+        identifier = (I_32) prop->identifier;
+        memcpy(position, &identifier, sizeof(I_32));
+        position += sizeof(I_32);
+        switch (propertyNumLenStrings(prop->identifier)) {
+            case 2:
+                /* Name first, then the value */
+                position = packLenString(&prop->value.data, position);
+                position = packLenString(&prop->value.value, position);
+                break;
+            case 1:
+                position = packLenString(&prop->value.data, position);
+                break;
+            default:
+                value = propertyNumericValue(prop);
+                memcpy(position, &value, sizeof(U_32));
+                position += sizeof(U_32);
+                break;
+        }
+    }
+}
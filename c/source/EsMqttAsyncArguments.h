@@ -17,6 +17,30 @@
  *  it receives, therefore it is not necessary to track the data that we allocate
  *  here.  Smalltalk will deallocate the memory when it is no longer referenced
  *  using EsFreeMemory, which is why we use EsAllocateMemory in this module.
+ *
+ *  Each datum is copied exactly once, on the Paho callback thread, when the
+ *  async message is created. Posting the message hands the copy over to
+ *  Smalltalk as is; a copy that is never posted is freed with the message.
+ *
+ *  The payload of a message copy is a reference counted buffer (@see EsRefBuffer.h)
+ *  so it can be shared by many holders without further copies. The initial
+ *  reference belongs to the message copy and is released exactly once, by
+ *  whoever frees the copy:
+ *  - natively, by EsFreeMessageCopy() (i.e. the EsMqttVastMessageTakePayload
+ *    prim, or a copy that is never posted)
+ *  - by Smalltalk, for a copy it took with EsMqttVastHandleRemove or from a
+ *    batch entry, with EsMqttVastBufferRelease before it frees the copy with
+ *    EsFreeMemory
+ *  Any other holder acquires and releases a reference of its own with the
+ *  EsMqttVastBufferAcquire and EsMqttVastBufferRelease prims.
+ *
+ *  Pass-Through Mode:
+ *  When the arrived-message callback returns 1, Paho hands ownership of the
+ *  MQTTClient_message and the topic string to the application. In pass-through
+ *  mode those are not copied at all. The original Paho pointers are posted and
+ *  Smalltalk must release them with MQTTClient_freeMessage()/MQTTClient_free()
+ *  instead of EsFreeMemory. Pass-through is enabled by supplying those two
+ *  Paho functions, since this library does not link against Paho itself.
  *******************************************************************************/
 #ifndef ES_MQTT_ASYNC_ARGUMENTS_H
 #define ES_MQTT_ASYNC_ARGUMENTS_H
@@ -41,12 +65,63 @@ void EsMqttAsyncArguments_ModuleInit(EsGlobalInfo *globalInfo);
  */
 void EsMqttAsyncArguments_ModuleShutdown();
 
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Paho's MQTTClient_freeMessage() signature
+ */
+typedef void (*EsMqttFreeMessageFunc)(MQTTClient_message **msg);
+
+/**
+ * @brief Paho's MQTTClient_free() signature
+ */
+typedef void (*EsMqttFreeFunc)(void *ptr);
+
+/*******************************/
+/*   P A S S - T H R O U G H   */
+/*******************************/
+
+/**
+ * @brief Enable or disable pass-through of arrived messages
+ * @note Pass-through is enabled if both functions are supplied,
+ * otherwise arrived messages are copied (the default).
+ * @note Messages created before the change keep the mode they were created with
+ * @param freeMessageFunc Paho's MQTTClient_freeMessage() or NULL
+ * @param freeFunc Paho's MQTTClient_free() or NULL
+ */
+void EsMqttAsyncArguments_SetPassThrough(EsMqttFreeMessageFunc freeMessageFunc, EsMqttFreeFunc freeFunc);
+
+/**
+ * @brief Answer if arrived messages are passed through without copying
+ * @return TRUE if pass-through, FALSE if copied
+ */
+BOOLEAN EsMqttAsyncArguments_IsPassThrough();
+
+/**
+ * @brief Free a message whose ownership was passed from Paho
+ * @note Uses the MQTTClient_freeMessage() supplied for pass-through
+ * @param msg may be NULL
+ */
+void EsFreePahoMessage(MQTTClient_message *msg);
+
+/**
+ * @brief Free a string whose ownership was passed from Paho (i.e. a topic)
+ * @note Uses the MQTTClient_free() supplied for pass-through
+ * @param str may be NULL
+ */
+void EsFreePahoString(char *str);
+
 /*************************************/
 /*   M Q T T  D A T A  C O P I E S   */
 /*************************************/
 
 /**
- * @brief Answer a heap-allocated copy of the properties
+ * @brief Answer a heap-allocated deep copy of the properties
+ * @note The property array and all string/binary values are packed into
+ * the same block as the struct, so the copy is released by a single EsFreeMemory().
+ * String and binary values are null-terminated in the copy.
  * @param props
  * @return props copy
  */
@@ -64,16 +139,53 @@ char *EsCopyString(char *str);
  * @note Non-0 len could be due to embedded nulls...so use that if != 0
  * @param topicStr
  * @param len
- * @return topicStr copy
+ * @return topicStr copy (always null-terminated)
  */
 char *EsCopyTopicString(char *topicStr, I_32 len);
 
 /**
- * Answer a heap-allocated copy of the message
+ * @brief Answer a heap-allocated copy of the message
+ * @note The payload is copied into a ref buffer with a count of 1
+ * @note The v5 properties are deep copied into the message block (@see EsCopyProperties)
+ * @see EsFreeMessageCopy
  * @param msg
  * @return msg copy
  */
 MQTTClient_message *EsCopyMessage(MQTTClient_message *msg);
 
+/**
+ * @brief Free a message copy made by EsCopyMessage()
+ * @note Releases the initial reference of the payload buffer, held by the copy
+ * @param msgCopy may be NULL
+ */
+void EsFreeMessageCopy(MQTTClient_message *msgCopy);
+
+/****************************************/
+/*   P A C K E D  P R O P E R T I E S   */
+/****************************************/
+
+/**
+ * @brief Answer the bytes needed to pack the properties
+ * @see EsPackProperties
+ * @param props may be NULL
+ * @return U_SIZE (a multiple of 4)
+ */
+U_SIZE EsPackedPropertiesSize(const MQTTProperties *props);
+
+/**
+ * @brief Pack the properties back-to-back into dest
+ *
+ * Each property starts on a 4-byte boundary and is laid out as
+ * I_32 identifier followed by
+ * - numeric values: U_32 value
+ * - string/binary values: U_32 len, bytes[len] (zero-padded to 4)
+ * - user properties: the name and then the value, each as a string value
+ *
+ * @note This layout is read from the Smalltalk image
+ * @param props may be NULL
+ * @param dest[out] at least EsPackedPropertiesSize(props) bytes, 4-byte aligned
+ */
+void EsPackProperties(const MQTTProperties *props, void *dest);
+
 
 #endif //ES_MQTT_ASYNC_ARGUMENTS_H
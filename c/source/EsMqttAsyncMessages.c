@@ -7,12 +7,21 @@
  *  @brief Asynchronous Queue and Message Targets Implementation
  *  @author Seth Berman
  *******************************************************************************/
+#include <stdlib.h>
+
 #include "plibsys.h"
 #include "MQTTClient.h"
 
 #include "EsMqttAsyncMessages.h"
 #include "EsMqttAsyncArguments.h"
-#include "EsWorkTask.h"
+#include "EsWorkQueue.h"
+#include "EsSlab.h"
+#include "EsEpoch.h"
+#include "EsHandleTable.h"
+#include "EsRefBuffer.h"
+#include "EsTopicTrie.h"
+#include "EsMessageFilter.h"
+#include "EsTopicTable.h"
 
 
 /***************************/
@@ -68,6 +77,41 @@ static BOOLEAN publishedHandler(EsMqttAsyncMessage *message);
  */
 static BOOLEAN checkpointHandler(EsMqttAsyncMessage *message);
 
+/**
+ * Post Async Message for MQTTVAST_CALLBACK_TYPE_MESSAGEBATCH
+ * @param message to post to VAST async queue
+ * @return TRUE if async msg posted, FALSE otherwise
+ */
+static BOOLEAN messageBatchHandler(EsMqttAsyncMessage *message);
+
+/**
+ * Post Async Message for MQTTVAST_CALLBACK_TYPE_ONSUCCESS
+ * @param message to post to VAST async queue
+ * @return TRUE if async msg posted, FALSE otherwise
+ */
+static BOOLEAN onSuccessHandler(EsMqttAsyncMessage *message);
+
+/**
+ * Post Async Message for MQTTVAST_CALLBACK_TYPE_ONCONNECT
+ * @param message to post to VAST async queue
+ * @return TRUE if async msg posted, FALSE otherwise
+ */
+static BOOLEAN onConnectHandler(EsMqttAsyncMessage *message);
+
+/**
+ * Post Async Message for MQTTVAST_CALLBACK_TYPE_ONSUBSCRIBE
+ * @param message to post to VAST async queue
+ * @return TRUE if async msg posted, FALSE otherwise
+ */
+static BOOLEAN onSubscribeHandler(EsMqttAsyncMessage *message);
+
+/**
+ * Post Async Message for MQTTVAST_CALLBACK_TYPE_ONFAILURE
+ * @param message to post to VAST async queue
+ * @return TRUE if async msg posted, FALSE otherwise
+ */
+static BOOLEAN onFailureHandler(EsMqttAsyncMessage *message);
+
 
 /*******************/
 /*   M A C R O S   */
@@ -118,25 +162,243 @@ static BOOLEAN checkpointHandler(EsMqttAsyncMessage *message);
 static ESVMContext _DummyVMContext;
 
 /**
- * @brief Array of EsObject Receiver/Selector Pairs used
+ * @brief Table of EsObject Receiver/Selector Pairs used
  * as the target for a VA Smalltalk Asynchronous message
  *
  * An adjacent even/odd pair is the EsObject class>>selector
  * to activate for an async message
  */
 #define ASYNC_MSG_TARGETS_SIZE      (NUM_MQTT_CALLBACKS * 2)
-static EsObject _AsyncMessageTargets[ASYNC_MSG_TARGETS_SIZE] = {EsNil};
+typedef struct _AsyncMessageTargetTable AsyncMessageTargetTable;
+struct _AsyncMessageTargetTable {
+    EsObject targets[ASYNC_MSG_TARGETS_SIZE];
+};
+
+/**
+ * @brief Published (immutable) snapshot of the target table
+ *
+ * Every delivered callback reads its target, while targets almost
+ * never change after registration. Readers load the snapshot pointer
+ * inside an epoch critical section and take no lock. A writer copies
+ * the snapshot, changes the copy, swaps the pointer and frees the old
+ * snapshot once no reader can still see it (@see EsEpoch.h).
+ * The initial (all nil) snapshot is static and never freed.
+ */
+static AsyncMessageTargetTable _InitialAsyncMessageTargets = {{EsNil}};
+static AsyncMessageTargetTable *volatile _AsyncMessageTargets = &_InitialAsyncMessageTargets;
+
+/**
+ * @brief Epoch domain of the target table readers
+ */
+static EsEpoch *_AsyncMessageTargetsEpoch = NULL;
+
+/**
+ * @brief Lock that serializes the (rare) target table writers
+ */
+static PMutex *_AsyncMessageTargetsWriteLock = NULL;
+
+/**
+ * @brief Receiver/Selector pair that is the target of a topic route
+ */
+typedef struct _AsyncMessageTarget AsyncMessageTarget;
+struct _AsyncMessageTarget {
+    EsObject receiver;
+    EsObject selector;
+};
+
+/**
+ * @brief Topic filter routes of arrived messages
+ *
+ * Maps MQTT topic filters to an AsyncMessageTarget. While there is any
+ * route, an arrived message is posted to the target of the most specific
+ * matching filter, and a message that matches no filter is dropped in C.
+ * Without routes, arrived messages go to the messageArrived target.
+ */
+static EsTopicTrie *_TopicRoutes = NULL;
+
+/**
+ * @brief Topic filters of arrived messages
+ *
+ * Maps MQTT topic filters to an EsMessageFilter. An arrived message is
+ * given to the message filter of the most specific matching topic filter
+ * before it is queued, and is freed right away if the filter drops it.
+ */
+static EsTopicTrie *_TopicFilters = NULL;
+
+/**
+ * @brief Latest-value coalescing of arrived messages (@see EsMqttAsyncMessage_SetTopicCoalescing)
+ *
+ * _CoalescedFilters: Topic filters whose topic names are coalesced
+ * _CoalescedTopics: CoalescedTopic of each topic name, guarded by the lock
+ * MARK: Value of the coalesced topic filters (the trie needs a non-NULL value)
+ * MAX_TOPICS: Upper bound of the coalesced topic names, others are queued as usual
+ */
+#define ASYNC_MSG_COALESCE_MARK         ((void *) 1)
+#define ASYNC_MSG_COALESCE_MAX_TOPICS   65536
+static EsTopicTrie *_CoalescedFilters = NULL;
+static EsTopicTable *_CoalescedTopics = NULL;
+static PMutex *_CoalescedTopicsLock = NULL;
+
+/**
+ * @brief Coalescing slot of one topic name
+ *
+ * pending: Queued arrived message the dispatcher has not taken yet (or NULL)
+ * numCoalesced: Older messages of the topic that were replaced by newer ones
+ */
+typedef struct _CoalescedTopic CoalescedTopic;
+struct _CoalescedTopic {
+    EsMqttAsyncMessage *pending;
+    U_32 numCoalesced;
+};
+
+/**
+ * @brief Handles of the data passed to Smalltalk in async messages
+ *
+ * Messages, topics, strings and properties are passed as one handle
+ * (a SmallInteger) instead of an address split into high/low parts.
+ * Smalltalk removes the handle when it takes the data.
+ */
+#define ASYNC_MSG_HANDLES_CAPACITY      65536
+static EsHandleTable *_AsyncMessageHandles = NULL;
 
 /**
- * @brief Read-Write Lock used for coordinated access to
- * the _AsyncMessageTargets array.
+ * @brief Work queue that posts async messages off of the Paho threads
  *
- * It is expected that write access to the array will be rare
- * because writes would only would happen when the user makes
- * receiver/selector
- * adjustments.
+ * Paho callbacks hand off the message to this queue and return
+ * right away. The consumer thread (dispatcher) does the posting to the
+ * VA Smalltalk async queue. A single consumer is used so that messages
+ * are posted in the same order that Paho delivered them.
  */
-static PRWLock *_AsyncMessageTargetsLock = NULL;
+#define ASYNC_MSG_QUEUE_NUM_THREADS     "1"
+static EsWorkQueue *_AsyncMessageQueue = NULL;
+
+/**
+ * @brief Non-zero if messages are posted by the dispatcher thread (default),
+ * zero if they are posted inline on the Paho thread
+ */
+static volatile I_32 _AsyncMessageDispatcher = 1;
+
+/**
+ * @brief Dispatcher retry policy for failed posts (i.e. vm async queue is full)
+ *
+ * MAX_ATTEMPTS: Number of posts tried before the message is dropped
+ * UNTIL_POSTED: Retry until posted (arrived messages under flow control)
+ * BACKOFF_MS: Sleep before the first retry, doubled for each retry
+ * MAX_BACKOFF_MS: Upper bound of the sleep between retries
+ *
+ * The Paho threads never sleep here, only when flow control holds them back.
+ */
+#define ASYNC_MSG_POST_MAX_ATTEMPTS     8
+#define ASYNC_MSG_POST_UNTIL_POSTED     0
+#define ASYNC_MSG_POST_BACKOFF_MS       1
+#define ASYNC_MSG_POST_MAX_BACKOFF_MS   32
+
+/**
+ * @brief Flow control of arrived messages (@see EsMqttAsyncMessage_SetFlowControl)
+ *
+ * FAILURE_STREAK: Consecutive failed posts that count as a saturated vm async queue
+ * THROTTLE_MS: Sleep of the Paho thread for each message past the throttle mark
+ * PAUSE_MS: Sleep of the Paho thread before it is told to redeliver a message
+ */
+#define ASYNC_MSG_FLOW_FAILURE_STREAK   4
+#define ASYNC_MSG_FLOW_THROTTLE_MS      1
+#define ASYNC_MSG_FLOW_PAUSE_MS         5
+static volatile I_32 _FlowThrottleMark = 0;
+static volatile I_32 _FlowPauseMark = 0;
+
+/**
+ * @brief Post and flow control counters (@see EsMqttFlowStats)
+ */
+static volatile I_32 _NumPosts = 0;
+static volatile I_32 _NumFailedPosts = 0;
+static volatile I_32 _NumThrottled = 0;
+static volatile I_32 _NumRefused = 0;
+static volatile I_32 _NumUnrouted = 0;
+static volatile I_32 _NumFiltered = 0;
+static volatile I_32 _NumCoalesced = 0;
+static volatile I_32 _PostFailureStreak = 0;
+
+/**
+ * @brief Non-zero while the module shuts down, so posts are not retried forever
+ */
+static volatile I_32 _AsyncMessagesShutdown = 0;
+
+/**
+ * @brief Number of messages handed to the dispatcher that it has not finished
+ *
+ * This counts the messages the work queue has accepted, including
+ * any the consumer has already dequeued but not yet run.
+ */
+static volatile I_32 _AsyncMessagesQueued = 0;
+
+/**
+ * @brief Batching limits of arrived messages (@see EsMqttAsyncMessage_SetBatching)
+ *
+ * MAX_COUNT: Upper bound of the messages per batch
+ * MAX_DELAY_US: Upper bound of the time a message may wait in a batch
+ */
+#define ASYNC_MSG_BATCH_MAX_COUNT       65536
+#define ASYNC_MSG_BATCH_MAX_DELAY_US    1000000
+static volatile I_32 _BatchMaxCount = 0;
+static volatile I_32 _BatchMaxBytes = 0;
+static volatile I_32 _BatchMaxDelayUs = 0;
+
+/**
+ * @brief Batch of arrived messages that the dispatcher is filling
+ *
+ * Only the dispatcher thread uses it, so it needs no lock.
+ * batch: Batch to post or NULL if there is none
+ * capacity: Number of entries allocated for the batch
+ * numBytes: Topic and payload bytes of the entries
+ * age: Time since the first entry was added
+ */
+typedef struct _PendingMessageBatch PendingMessageBatch;
+struct _PendingMessageBatch {
+    EsMqttMessageBatch *batch;
+    U_32 capacity;
+    U_32 numBytes;
+    PTimeProfiler *age;
+};
+static PendingMessageBatch _PendingBatch = {NULL, 0, 0, NULL};
+
+/**
+ * @brief Pool of recyclable tasks for the async message queue
+ *
+ * Paho threads acquire a task per message and the queue consumer
+ * releases it, so the allocator is not on the message hot path.
+ */
+static EsWorkTaskPool *_AsyncTaskPool = NULL;
+
+/**
+ * @brief Number of args of the async message for each callback type
+ *
+ * The index is the MqttVastCallbackTypes and value
+ * is the fixed arity of that message
+ */
+static const U_32 _AsyncMessageArity[NUM_MQTT_CALLBACKS] = {
+        2, /* trace */
+        2, /* connectionLost */
+        3, /* disconnected */
+        4, /* messageArrived */
+        2, /* deliveryComplete */
+        5, /* published */
+        1, /* checkpoint */
+        1, /* messageBatch */
+        2, /* onSuccess */
+        5, /* onConnect */
+        3, /* onSubscribe */
+        4  /* onFailure */
+};
+
+/**
+ * @brief Slab of fixed-size message blocks for each callback type
+ *
+ * Messages are recycled through the slab on free, so a Paho
+ * callback does not need a round-trip to the vm allocator.
+ * The index is the MqttVastCallbackTypes.
+ */
+#define ASYNC_MSG_SLAB_BLOCKS_PER_CHUNK     64
+static EsSlab *_AsyncMessageSlabs[NUM_MQTT_CALLBACKS] = {NULL};
 
 /**
  * Handler functions that post async messages to VA Smalltalk's async queue
@@ -156,7 +418,12 @@ static AsyncMessageHandlerFunc _AsyncMessageHandlers[NUM_MQTT_CALLBACKS] = {
         messageArrivedHandler,
         deliveryCompleteHandler,
         publishedHandler,
-        checkpointHandler
+        checkpointHandler,
+        messageBatchHandler,
+        onSuccessHandler,
+        onConnectHandler,
+        onSubscribeHandler,
+        onFailureHandler
 };
 
 /**********************************/
@@ -174,8 +441,39 @@ union _EsMqttAsynMessageArg {
     MQTTClient_deliveryToken token;
 };
 
+/**
+ * @brief Who is responsible for freeing the data the args refer to
+ *
+ * ARGS_COPIED: Copies made with EsAllocateMemory, owned by the message
+ * ARGS_BORROWED: Paho's originals, Paho still owns them (pass-through)
+ * ARGS_ADOPTED: Paho's originals, ownership was passed to the message (pass-through)
+ * ARGS_POSTED: Handed over to Smalltalk by a successful post
+ * ARGS_BATCHED: Moved into the pending batch, which owns them now
+ * ARGS_MOVED: Moved into the pending message of the topic, which owns them now
+ */
+static const I_32 ARGS_COPIED = 0;
+static const I_32 ARGS_BORROWED = 1;
+static const I_32 ARGS_ADOPTED = 2;
+static const I_32 ARGS_POSTED = 3;
+static const I_32 ARGS_BATCHED = 4;
+static const I_32 ARGS_MOVED = 5;
+
+/**
+ * @brief Tags of the handles passed to Smalltalk
+ *
+ * HANDLE_DATA: Any data other than an arrived message
+ * HANDLE_MESSAGE_COPY: Arrived message copy, freed with EsFreeMessageCopy()
+ * HANDLE_PAHO_MESSAGE: Paho's arrived message (pass-through), freed with EsFreePahoMessage()
+ */
+static const U_32 HANDLE_DATA = 0;
+static const U_32 HANDLE_MESSAGE_COPY = 1;
+static const U_32 HANDLE_PAHO_MESSAGE = 2;
+
 struct _EsMqttAsyncMessage {
+    EsSlab *slab;
     enum EsMqttVastCallbackTypes cbType;
+    I_32 argsOwner;
+    BOOLEAN coalesced;
     EsObject receiver;
     EsObject selector;
     EsMqttAsyncMessageArg args[];
@@ -186,39 +484,50 @@ struct _EsMqttAsyncMessage {
 /*********************/
 
 /**
- * @brief Split u64 into high/low i32
+ * @brief Answer a handle, tagged with its kind of data, for a pointer that is passed to Smalltalk
+ * @param ptr may be NULL
+ * @param tag HANDLE_DATA, HANDLE_MESSAGE_COPY or HANDLE_PAHO_MESSAGE
+ * @param handle[output]
+ * @return TRUE if success, FALSE if the handle table is full
+ */
+static BOOLEAN handleFromTaggedPointer(void *ptr, U_32 tag, U_32 *handle) {
+    if (ptr == NULL) {
+        *handle = ES_HANDLE_NONE;
+        return TRUE;
+    }
+    *handle = EsHandleTable_addTagged(_AsyncMessageHandles, ptr, tag);
+    return (BOOLEAN) (*handle != ES_HANDLE_NONE);
+}
+
+/**
+ * @brief Answer a handle for a pointer that is passed to Smalltalk
  *
- * Its possible that the full u64 could not be
- * represented by 2 positive i32s.
+ * Smalltalk resolves (and removes) the handle with a user-prim.
+ * A NULL pointer is passed as ES_HANDLE_NONE.
  *
- * @param u64
- * @param iHigh
- * @param iLow
- * @return TRUE if success, FALSE if overflow
+ * @param ptr may be NULL
+ * @param handle[output]
+ * @return TRUE if success, FALSE if the handle table is full
  */
-static BOOLEAN hiLowFrom64(U_64 u64, I_32 *iHigh, I_32 *iLow) {
-    *iHigh = (I_32) (((u64) & 0x3FFFFFFF80000000UL) >> 31u);
-    *iLow = (I_32) ((u64) & 0x7FFFFFFFUL);
-    return (BOOLEAN) ((u64 & 0xC000000000000000UL) == 0);
+static BOOLEAN handleFromPointer(void *ptr, U_32 *handle) {
+    return handleFromTaggedPointer(ptr, HANDLE_DATA, handle);
 }
 
 /**
- * @brief Split pointer address into high/low i32
- * @see hiLowFrom64 for more details
- * @param ptr
- * @param iHigh
- * @param iLow
- * @return TRUE if success, FALSE if overflow
+ * @brief Remove the handle of a pointer that Smalltalk did not get
+ * @param handle may be ES_HANDLE_NONE
  */
-static BOOLEAN hiLowFromPointer(void *ptr, I_32 *iHigh, I_32 *iLow) {
-    return hiLowFrom64((U_64) (U_PTR) ptr, iHigh, iLow);
+static void removeHandle(U_32 handle) {
+    if (handle != ES_HANDLE_NONE) {
+        EsHandleTable_remove(_AsyncMessageHandles, handle);
+    }
 }
 
 /**
  * @brief Get the receiver/selector target for a callback type
  *
  * Reads the receiver/selector into the output parameters.
- * Access is guarded by read lock
+ * Lock-free: the current snapshot is read in an epoch critical section
  *
  * @param cbType
  * @param receiverPtr[output]
@@ -227,15 +536,21 @@ static BOOLEAN hiLowFromPointer(void *ptr, I_32 *iHigh, I_32 *iLow) {
  */
 static BOOLEAN
 getAsyncMessageTarget(enum EsMqttVastCallbackTypes cbType, EsObject *receiverPtr, EsObject *selectorPtr) {
+    AsyncMessageTargetTable *table;
+
     if ((receiverPtr == NULL) || (selectorPtr == NULL)) {
         return FALSE;
     }
 
-    /* READ LOCK */
-    p_rwlock_reader_lock(_AsyncMessageTargetsLock);
-    *receiverPtr = _AsyncMessageTargets[cbType * 2];
-    *selectorPtr = _AsyncMessageTargets[cbType * 2 + 1];
-    p_rwlock_reader_unlock(_AsyncMessageTargetsLock);
+    if (!EsMqttCallbacks_IsValidCallbackType(cbType) || !EsEpoch_enter(_AsyncMessageTargetsEpoch)) {
+        *receiverPtr = EsNil;
+        *selectorPtr = EsNil;
+        return FALSE;
+    }
+    table = (AsyncMessageTargetTable *) p_atomic_pointer_get(&_AsyncMessageTargets);
+    *receiverPtr = table->targets[cbType * 2];
+    *selectorPtr = table->targets[cbType * 2 + 1];
+    EsEpoch_exit(_AsyncMessageTargetsEpoch);
 
     if (ES_LIKELY(!EsIsNil(*receiverPtr) && !EsIsNil(*selectorPtr))) {
         return TRUE;
@@ -247,24 +562,133 @@ getAsyncMessageTarget(enum EsMqttVastCallbackTypes cbType, EsObject *receiverPtr
 /**
  * @brief Set the receiver/selector target for a callback type
  *
- * Writes the receiver/selector to the async message target array.
- * Access is guarded by write lock
+ * Publishes a new snapshot of the target table with the receiver/selector.
+ * Writers are serialized by the write lock
  *
  * @param cbType
  * @param receiver
  * @param selector
  */
 static BOOLEAN setAsyncMessageTarget(enum EsMqttVastCallbackTypes cbType, EsObject receiver, EsObject selector) {
-    if (EsMqttCallbacks_IsValidCallbackType(cbType)) {
-        /* WRITE LOCK */
-        p_rwlock_writer_lock(_AsyncMessageTargetsLock);
-        _AsyncMessageTargets[cbType * 2] = receiver;
-        _AsyncMessageTargets[cbType * 2 + 1] = selector;
-        p_rwlock_writer_unlock(_AsyncMessageTargetsLock);
-        return TRUE;
-    } else {
+    AsyncMessageTargetTable *oldTable;
+    AsyncMessageTargetTable *newTable;
+
+    if (!EsMqttCallbacks_IsValidCallbackType(cbType)) {
+        return FALSE;
+    }
+
+    newTable = (AsyncMessageTargetTable *) malloc(sizeof(AsyncMessageTargetTable));
+    if (newTable == NULL) {
+        return FALSE;
+    }
+
+    /* WRITE LOCK */
+    p_mutex_lock(_AsyncMessageTargetsWriteLock);
+    oldTable = _AsyncMessageTargets;
+    *newTable = *oldTable;
+    newTable->targets[cbType * 2] = receiver;
+    newTable->targets[cbType * 2 + 1] = selector;
+    p_atomic_pointer_set(&_AsyncMessageTargets, newTable);
+    /* Wait out readers of the old snapshot before freeing it */
+    EsEpoch_synchronize(_AsyncMessageTargetsEpoch);
+    p_mutex_unlock(_AsyncMessageTargetsWriteLock);
+
+    if (oldTable != &_InitialAsyncMessageTargets) {
+        free(oldTable);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Trie match function that copies the target of a topic route
+ * @param value AsyncMessageTarget
+ * @param userData AsyncMessageTarget [output]
+ */
+static void copyTopicRouteTarget(void *value, void *userData) {
+    *(AsyncMessageTarget *) userData = *(AsyncMessageTarget *) value;
+}
+
+/**
+ * @brief Answer if arrived messages are routed by topic
+ * @return TRUE if there is any topic route, FALSE otherwise
+ */
+static BOOLEAN hasTopicRoutes() {
+    return (BOOLEAN) (EsTopicTrie_getSize(_TopicRoutes) > 0);
+}
+
+/**
+ * @brief Get the receiver/selector target of the route that matches the topic
+ * @param topicName
+ * @param topicLen (0 if null-terminated)
+ * @param receiverPtr[output]
+ * @param selectorPtr[output]
+ * @return TRUE if routed, FALSE if no route matches
+ */
+static BOOLEAN getTopicRouteTarget(const char *topicName, I_32 topicLen, EsObject *receiverPtr, EsObject *selectorPtr) {
+    AsyncMessageTarget target = {EsNil, EsNil};
+
+    if (topicName == NULL || topicLen < 0
+        || !EsTopicTrie_match(_TopicRoutes, topicName, (U_32) topicLen, copyTopicRouteTarget, &target)) {
         return FALSE;
     }
+    *receiverPtr = target.receiver;
+    *selectorPtr = target.selector;
+    return TRUE;
+}
+
+/**
+ * @brief Arrived message that is given to a message filter
+ */
+typedef struct _FilteredMessage FilteredMessage;
+struct _FilteredMessage {
+    const char *topicName;
+    U_32 topicLen;
+    MQTTClient_message *message;
+    BOOLEAN accepted;
+};
+
+/**
+ * @brief Trie match function that gives the message to the message filter
+ * @param value EsMessageFilter
+ * @param userData FilteredMessage
+ */
+static void acceptByMessageFilter(void *value, void *userData) {
+    FilteredMessage *filtered = (FilteredMessage *) userData;
+    MQTTClient_message *message = filtered->message;
+
+    filtered->accepted = EsMessageFilter_accept(
+            (EsMessageFilter *) value,
+            filtered->topicName,
+            filtered->topicLen,
+            (message != NULL) ? message->payload : NULL,
+            (message != NULL && message->payloadlen > 0) ? (U_32) message->payloadlen : 0);
+}
+
+/**
+ * @brief Answer if the arrived message passes the filter of its topic (if any)
+ * @param msg arrived message
+ * @return TRUE if accepted (or not filtered), FALSE if dropped
+ */
+static BOOLEAN acceptArrivedMessage(EsMqttAsyncMessage *msg) {
+    FilteredMessage filtered;
+
+    if (EsTopicTrie_getSize(_TopicFilters) == 0 || msg->args[1].str == NULL || msg->args[2].i < 0) {
+        return TRUE;
+    }
+    filtered.topicName = msg->args[1].str;
+    filtered.topicLen = (U_32) msg->args[2].i;
+    filtered.message = msg->args[3].msg;
+    filtered.accepted = TRUE;
+    EsTopicTrie_match(_TopicFilters, filtered.topicName, filtered.topicLen, acceptByMessageFilter, &filtered);
+    return filtered.accepted;
+}
+
+/**
+ * @brief Free function for the values of the topic filter trie
+ * @param filter EsMessageFilter
+ */
+static void freeMessageFilter(void *filter) {
+    EsMessageFilter_free((EsMessageFilter *) filter);
 }
 
 /**
@@ -286,64 +710,157 @@ static BOOLEAN getAsyncMessageHandler(enum EsMqttVastCallbackTypes cbType, Async
     }
 }
 
+/**
+ * @brief Free an arg copy made with EsAllocateMemory
+ * @param copy may be NULL
+ */
+static void freeArgCopy(void *copy) {
+    if (copy != NULL) {
+        EsFreeMemory(copy);
+    }
+}
+
+/**
+ * @brief Free a batch that was never posted, along with its entries
+ * @param batch may be NULL
+ */
+static void freeMessageBatch(EsMqttMessageBatch *batch) {
+    U_32 i;
+
+    if (batch == NULL) {
+        return;
+    }
+    for (i = 0; i < batch->count; i++) {
+        if (batch->passThrough) {
+            EsFreePahoString(batch->entries[i].topicName);
+            EsFreePahoMessage(batch->entries[i].message);
+        } else {
+            freeArgCopy(batch->entries[i].topicName);
+            EsFreeMessageCopy(batch->entries[i].message);
+        }
+    }
+    EsFreeMemory(batch);
+}
+
+/**
+ * @brief Free the arg data that is still owned by the message
+ *
+ * Copies are made once in EsMqttAsyncMessage_newInit() and become
+ * owned by Smalltalk when posted. If the message was never posted
+ * (no target, post failed or the queue rejected it) they are freed here.
+ * Adopted Paho data is given back to Paho's allocator instead.
+ *
+ * @param message
+ */
+static void freeMessageArgs(EsMqttAsyncMessage *message) {
+    if (message->argsOwner == ARGS_ADOPTED) {
+        /* Only arrived messages are passed through */
+        EsFreePahoString(message->args[1].str);
+        EsFreePahoMessage(message->args[3].msg);
+        return;
+    } else if (message->argsOwner != ARGS_COPIED) {
+        return;
+    }
+
+    switch (message->cbType) {
+        case ESMQTT_CB_TYPE_TRACE:
+        case ESMQTT_CB_TYPE_CONNECTIONLOST:
+            freeArgCopy(message->args[1].str);
+            break;
+        case ESMQTT_CB_TYPE_DISCONNECTED:
+            freeArgCopy(message->args[1].props);
+            break;
+        case ESMQTT_CB_TYPE_MESSAGEARRIVED:
+            freeArgCopy(message->args[1].str);
+            EsFreeMessageCopy(message->args[3].msg);
+            break;
+        case ESMQTT_CB_TYPE_PUBLISHED:
+            freeArgCopy(message->args[3].props);
+            break;
+        case ESMQTT_CB_TYPE_MESSAGEBATCH:
+            freeMessageBatch((EsMqttMessageBatch *) message->args[0].ptr);
+            break;
+        case ESMQTT_CB_TYPE_ONCONNECT:
+            freeArgCopy(message->args[4].str);
+            break;
+        case ESMQTT_CB_TYPE_ONFAILURE:
+            freeArgCopy(message->args[3].str);
+            break;
+        default:
+            break;
+    }
+}
+
 /*********************************************/
 /*   A S Y N C  Q U E U E  H A N D L E R S   */
 /*********************************************/
 
 static BOOLEAN traceHandler(EsMqttAsyncMessage *message) {
     I_32 level;
-    I_32 traceStrHigh, traceStrLow;
     char *traceStr;
-    char *traceStrCopy;
+    U_32 traceStrHandle;
+    BOOLEAN posted;
 
     level = message->args[0].i;
     traceStr = message->args[1].str;
 
-    traceStrCopy = EsCopyString(traceStr);
-    hiLowFromPointer(traceStrCopy, &traceStrHigh, &traceStrLow);
-    return EsMqttPostAsyncMessage(
+    if (!handleFromPointer(traceStr, &traceStrHandle)) {
+        return FALSE;
+    }
+    posted = EsMqttPostAsyncMessage(
             message->receiver,
             message->selector,
-            3,
+            2,
             EsI32ToSmallInteger(level),
-            EsI32ToSmallInteger(traceStrHigh),
-            EsI32ToSmallInteger(traceStrLow));
+            EsI32ToSmallInteger((I_32) traceStrHandle));
+    if (!posted) {
+        removeHandle(traceStrHandle);
+    }
+    return posted;
 }
 
 static BOOLEAN connectionLostHandler(EsMqttAsyncMessage *message) {
     void *context = message->args[0].ptr;
     char *cause = message->args[1].str;
+    U_32 causeHandle;
+    BOOLEAN posted;
 
-    char *causeCopy = EsCopyString(cause);
-    I_32 causeHigh, causeLow;
-
-    hiLowFromPointer(causeCopy, &causeHigh, &causeLow);
-    return EsMqttPostAsyncMessage(
+    if (!handleFromPointer(cause, &causeHandle)) {
+        return FALSE;
+    }
+    posted = EsMqttPostAsyncMessage(
             message->receiver,
             message->selector,
-            3,
+            2,
             EsI32ToSmallInteger(context),
-            EsI32ToSmallInteger(causeHigh),
-            EsI32ToSmallInteger(causeLow));
+            EsI32ToSmallInteger((I_32) causeHandle));
+    if (!posted) {
+        removeHandle(causeHandle);
+    }
+    return posted;
 }
 
 static BOOLEAN disconnectedHandler(EsMqttAsyncMessage *message) {
     void *context = message->args[0].ptr;
     MQTTProperties *properties = message->args[1].props;
     enum MQTTReasonCodes reasonCode = message->args[2].reasonCode;
+    U_32 propertiesHandle;
+    BOOLEAN posted;
 
-    MQTTProperties *propertiesCopy = EsCopyProperties(properties);
-    I_32 propertiesHigh, propertiesLow;
-
-    hiLowFromPointer(propertiesCopy, &propertiesHigh, &propertiesLow);
-    return EsMqttPostAsyncMessage(
+    if (!handleFromPointer(properties, &propertiesHandle)) {
+        return FALSE;
+    }
+    posted = EsMqttPostAsyncMessage(
             message->receiver,
             message->selector,
-            4,
+            3,
             EsI32ToSmallInteger(context),
-            EsI32ToSmallInteger(propertiesHigh),
-            EsI32ToSmallInteger(propertiesLow),
+            EsI32ToSmallInteger((I_32) propertiesHandle),
             EsI32ToSmallInteger(reasonCode));
+    if (!posted) {
+        removeHandle(propertiesHandle);
+    }
+    return posted;
 }
 
 static BOOLEAN messageArrivedHandler(EsMqttAsyncMessage *message) {
@@ -351,24 +868,28 @@ static BOOLEAN messageArrivedHandler(EsMqttAsyncMessage *message) {
     char *topicName = message->args[1].str;
     I_32 topicLen = message->args[2].i;
     MQTTClient_message *clientMessage = message->args[3].msg;
-
-    MQTTClient_message *clientMessageCopy = EsCopyMessage(clientMessage);
-    char *topicNameCopy = EsCopyTopicString(topicName, topicLen);
-    I_32 topicNameHigh, topicNameLow;
-    I_32 messageHigh, messageLow;
-
-    hiLowFromPointer(topicNameCopy, &topicNameHigh, &topicNameLow);
-    hiLowFromPointer(clientMessageCopy, &messageHigh, &messageLow);
-    return EsMqttPostAsyncMessage(
-            message->receiver,
-            message->selector,
-            6,
-            EsI32ToSmallInteger(context),
-            EsI32ToSmallInteger(topicNameHigh),
-            EsI32ToSmallInteger(topicNameLow),
-            EsI32ToSmallInteger(topicLen),
-            EsI32ToSmallInteger(messageHigh),
-            EsI32ToSmallInteger(messageLow));
+    U_32 topicNameHandle = ES_HANDLE_NONE;
+    U_32 messageHandle = ES_HANDLE_NONE;
+    /* Borrowed (inline post) or adopted: the message is Paho's either way */
+    U_32 messageTag = (message->argsOwner == ARGS_COPIED) ? HANDLE_MESSAGE_COPY : HANDLE_PAHO_MESSAGE;
+    BOOLEAN posted = FALSE;
+
+    if (handleFromPointer(topicName, &topicNameHandle)
+        && handleFromTaggedPointer(clientMessage, messageTag, &messageHandle)) {
+        posted = EsMqttPostAsyncMessage(
+                message->receiver,
+                message->selector,
+                4,
+                EsI32ToSmallInteger(context),
+                EsI32ToSmallInteger((I_32) topicNameHandle),
+                EsI32ToSmallInteger(topicLen),
+                EsI32ToSmallInteger((I_32) messageHandle));
+    }
+    if (!posted) {
+        removeHandle(topicNameHandle);
+        removeHandle(messageHandle);
+    }
+    return posted;
 }
 
 static BOOLEAN deliveryCompleteHandler(EsMqttAsyncMessage *message) {
@@ -389,21 +910,25 @@ static BOOLEAN publishedHandler(EsMqttAsyncMessage *message) {
     I_32 packet_type = message->args[2].i;
     MQTTProperties *properties = message->args[3].props;
     enum MQTTReasonCodes reasonCode = message->args[4].reasonCode;
+    U_32 propertiesHandle;
+    BOOLEAN posted;
 
-    MQTTProperties *propertiesCopy = EsCopyProperties(properties);
-    I_32 propertiesHigh, propertiesLow;
-
-    hiLowFromPointer(propertiesCopy, &propertiesHigh, &propertiesLow);
-    return EsMqttPostAsyncMessage(
+    if (!handleFromPointer(properties, &propertiesHandle)) {
+        return FALSE;
+    }
+    posted = EsMqttPostAsyncMessage(
             message->receiver,
             message->selector,
-            6,
+            5,
             EsI32ToSmallInteger(context),
             EsI32ToSmallInteger(dt),
             EsI32ToSmallInteger(packet_type),
-            EsI32ToSmallInteger(propertiesHigh),
-            EsI32ToSmallInteger(propertiesLow),
+            EsI32ToSmallInteger((I_32) propertiesHandle),
             EsI32ToSmallInteger(reasonCode));
+    if (!posted) {
+        removeHandle(propertiesHandle);
+    }
+    return posted;
 }
 
 static BOOLEAN checkpointHandler(EsMqttAsyncMessage *message) {
@@ -416,31 +941,503 @@ static BOOLEAN checkpointHandler(EsMqttAsyncMessage *message) {
             EsI32ToSmallInteger(id));
 }
 
-static void submitToAsyncQueue(EsWorkTask *task) {
-    EsObject receiver, selector;
-    AsyncMessageHandlerFunc handler;
-    EsMqttAsyncMessage *msg;
-
-    msg = (EsMqttAsyncMessage *) EsWorkTask_getUserData(task);
-    if (!msg) {
-        return;
-    }
+static BOOLEAN messageBatchHandler(EsMqttAsyncMessage *message) {
+    EsMqttMessageBatch *batch = (EsMqttMessageBatch *) message->args[0].ptr;
+    U_32 batchHandle;
+    BOOLEAN posted;
 
-    /* Get valid receiver>>selector */
-    if (!getAsyncMessageTarget(msg->cbType, &receiver, &selector)) {
-        EsMqttAsyncMessage_free(msg);
-        EsWorkTask_free(task);
+    if (!handleFromPointer(batch, &batchHandle)) {
+        return FALSE;
     }
-
+    posted = EsMqttPostAsyncMessage(
+            message->receiver,
+            message->selector,
+            2,
+            EsI32ToSmallInteger((I_32) batchHandle),
+            EsI32ToSmallInteger((I_32) batch->count));
+    if (!posted) {
+        removeHandle(batchHandle);
+    }
+    return posted;
+}
+
+static BOOLEAN onSuccessHandler(EsMqttAsyncMessage *message) {
+    void *context = message->args[0].ptr;
+    I_32 token = message->args[1].i;
+
+    return EsMqttPostAsyncMessage(
+            message->receiver,
+            message->selector,
+            2,
+            EsI32ToSmallInteger(context),
+            EsI32ToSmallInteger(token));
+}
+
+static BOOLEAN onConnectHandler(EsMqttAsyncMessage *message) {
+    void *context = message->args[0].ptr;
+    I_32 token = message->args[1].i;
+    I_32 mqttVersion = message->args[2].i;
+    I_32 sessionPresent = message->args[3].i;
+    char *serverURI = message->args[4].str;
+    U_32 serverURIHandle;
+    BOOLEAN posted;
+
+    if (!handleFromPointer(serverURI, &serverURIHandle)) {
+        return FALSE;
+    }
+    posted = EsMqttPostAsyncMessage(
+            message->receiver,
+            message->selector,
+            5,
+            EsI32ToSmallInteger(context),
+            EsI32ToSmallInteger(token),
+            EsI32ToSmallInteger(mqttVersion),
+            EsI32ToSmallInteger(sessionPresent),
+            EsI32ToSmallInteger((I_32) serverURIHandle));
+    if (!posted) {
+        removeHandle(serverURIHandle);
+    }
+    return posted;
+}
+
+static BOOLEAN onSubscribeHandler(EsMqttAsyncMessage *message) {
+    void *context = message->args[0].ptr;
+    I_32 token = message->args[1].i;
+    I_32 qos = message->args[2].i;
+
+    return EsMqttPostAsyncMessage(
+            message->receiver,
+            message->selector,
+            3,
+            EsI32ToSmallInteger(context),
+            EsI32ToSmallInteger(token),
+            EsI32ToSmallInteger(qos));
+}
+
+static BOOLEAN onFailureHandler(EsMqttAsyncMessage *message) {
+    void *context = message->args[0].ptr;
+    I_32 token = message->args[1].i;
+    I_32 code = message->args[2].i;
+    char *failureMessage = message->args[3].str;
+    U_32 failureMessageHandle;
+    BOOLEAN posted;
+
+    if (!handleFromPointer(failureMessage, &failureMessageHandle)) {
+        return FALSE;
+    }
+    posted = EsMqttPostAsyncMessage(
+            message->receiver,
+            message->selector,
+            4,
+            EsI32ToSmallInteger(context),
+            EsI32ToSmallInteger(token),
+            EsI32ToSmallInteger(code),
+            EsI32ToSmallInteger((I_32) failureMessageHandle));
+    if (!posted) {
+        removeHandle(failureMessageHandle);
+    }
+    return posted;
+}
+
+/**
+ * @brief Post the message to the VAST async queue
+ * @note Failed posts are retried with exponential backoff
+ * @note Every try is counted for the flow control statistics
+ * @param msg
+ * @param maxAttempts number of posts to try (1 for no retry, or ASYNC_MSG_POST_UNTIL_POSTED)
+ * @return TRUE if posted (or dropped by topic routing), FALSE otherwise
+ */
+static BOOLEAN postAsyncMessage(EsMqttAsyncMessage *msg, U_32 maxAttempts) {
+    EsObject receiver, selector;
+    AsyncMessageHandlerFunc handler;
+    U_32 backoffMs = ASYNC_MSG_POST_BACKOFF_MS;
+    U_32 attempt;
+
+    /* Get valid receiver>>selector (of the topic route for arrived messages) */
+    if (msg->cbType == ESMQTT_CB_TYPE_MESSAGEARRIVED && hasTopicRoutes()) {
+        if (!getTopicRouteTarget(msg->args[1].str, msg->args[2].i, &receiver, &selector)) {
+            /* Nobody is subscribed: dropped without waking the vm, as if it was posted (the callback returns 1) */
+            p_atomic_int_inc(&_NumUnrouted);
+            if (msg->argsOwner == ARGS_BORROWED) {
+                msg->argsOwner = ARGS_ADOPTED;
+            }
+            return TRUE;
+        }
+    } else if (!getAsyncMessageTarget(msg->cbType, &receiver, &selector)) {
+        return FALSE;
+    }
+
     msg->receiver = receiver;
     msg->selector = selector;
     /* Get valid handler which will post msg */
     if (!getAsyncMessageHandler(msg->cbType, &handler)) {
+        return FALSE;
+    }
+
+    for (attempt = 1; maxAttempts == ASYNC_MSG_POST_UNTIL_POSTED || attempt <= maxAttempts; attempt++) {
+        p_atomic_int_inc(&_NumPosts);
+        if (handler(msg)) {
+            /* Smalltalk owns the arg data once the post succeeds */
+            msg->argsOwner = ARGS_POSTED;
+            p_atomic_int_set(&_PostFailureStreak, 0);
+            return TRUE;
+        }
+        p_atomic_int_inc(&_NumFailedPosts);
+        p_atomic_int_inc(&_PostFailureStreak);
+        if (attempt == maxAttempts || p_atomic_int_get(&_AsyncMessagesShutdown) != 0) {
+            break;
+        }
+        p_uthread_sleep(backoffMs);
+        backoffMs = (backoffMs * 2 < ASYNC_MSG_POST_MAX_BACKOFF_MS) ? backoffMs * 2 : ASYNC_MSG_POST_MAX_BACKOFF_MS;
+    }
+    /* Dropped: let arrived messages test the vm async queue again */
+    p_atomic_int_set(&_PostFailureStreak, 0);
+    return FALSE;
+}
+
+/**
+ * @brief Answer how many posts the dispatcher tries for the callback type
+ *
+ * With a pause mark the number of queued arrived messages is bounded,
+ * so they (and their batches) are retried until posted instead of lost.
+ *
+ * @param cbType
+ * @return number of posts to try
+ */
+static U_32 getPostAttempts(enum EsMqttVastCallbackTypes cbType) {
+    if ((cbType == ESMQTT_CB_TYPE_MESSAGEARRIVED || cbType == ESMQTT_CB_TYPE_MESSAGEBATCH)
+        && p_atomic_int_get(&_FlowPauseMark) > 0) {
+        return ASYNC_MSG_POST_UNTIL_POSTED;
+    }
+    return ASYNC_MSG_POST_MAX_ATTEMPTS;
+}
+
+/**
+ * @brief Decide if an arrived message may be queued for the dispatcher
+ *
+ * Past the throttle mark the Paho thread is slowed down for each message.
+ * Past the pause mark, or while the vm async queue keeps failing posts,
+ * the message is refused so the callback returns 0 and Paho redelivers it.
+ * This holds back the Paho receive loop (and so the broker) instead of
+ * queueing messages that can not be posted.
+ *
+ * @note Called on the Paho thread
+ * @return TRUE if admitted, FALSE if refused
+ */
+static BOOLEAN admitArrivedMessage() {
+    I_32 throttleMark = p_atomic_int_get(&_FlowThrottleMark);
+    I_32 pauseMark = p_atomic_int_get(&_FlowPauseMark);
+    I_32 numQueued = p_atomic_int_get(&_AsyncMessagesQueued);
+
+    if (pauseMark > 0 && (numQueued >= pauseMark
+                          || p_atomic_int_get(&_PostFailureStreak) >= ASYNC_MSG_FLOW_FAILURE_STREAK)) {
+        p_atomic_int_inc(&_NumRefused);
+        /* Paho redelivers right away, pace its retries */
+        p_uthread_sleep(ASYNC_MSG_FLOW_PAUSE_MS);
+        return FALSE;
+    }
+    if (throttleMark > 0 && numQueued >= throttleMark) {
+        p_atomic_int_inc(&_NumThrottled);
+        p_uthread_sleep(ASYNC_MSG_FLOW_THROTTLE_MS);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Post the pending batch (if any) as one async message
+ * @note Dispatcher thread only. The batch is freed if it could not be posted.
+ */
+static void flushMessageBatch() {
+    EsMqttMessageBatch *batch = _PendingBatch.batch;
+    EsMqttAsyncMessage *msg;
+
+    if (batch == NULL) {
         return;
     }
+    _PendingBatch.batch = NULL;
+    _PendingBatch.numBytes = 0;
+
+    msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_MESSAGEBATCH, 1, batch);
+    if (msg == NULL) {
+        freeMessageBatch(batch);
+        return;
+    }
+    postAsyncMessage(msg, getPostAttempts(ESMQTT_CB_TYPE_MESSAGEBATCH));
+    EsMqttAsyncMessage_free(msg);
+}
+
+/**
+ * @brief Move an arrived message into the pending batch
+ *
+ * A new batch is started if there is none, or if the pending one holds
+ * data of the other owner (copies vs Paho's originals).
+ * The batch is flushed as soon as it reaches the count or byte limit.
+ *
+ * @note Dispatcher thread only
+ * @param msg arrived message, its args are owned by the batch if moved
+ * @return TRUE if moved, FALSE if not batching (post it as a single message)
+ */
+static BOOLEAN batchArrivedMessage(EsMqttAsyncMessage *msg) {
+    U_32 maxCount = (U_32) p_atomic_int_get(&_BatchMaxCount);
+    U_32 maxBytes = (U_32) p_atomic_int_get(&_BatchMaxBytes);
+    U_32 passThrough = (msg->argsOwner == ARGS_ADOPTED) ? 1 : 0;
+    EsMqttMessageBatch *batch;
+    EsMqttMessageBatchEntry *entry;
+    EsObject receiver, selector;
+
+    /* Routed messages each go to their own target */
+    if (maxCount <= 1 || _PendingBatch.age == NULL || hasTopicRoutes()
+        || !getAsyncMessageTarget(ESMQTT_CB_TYPE_MESSAGEBATCH, &receiver, &selector)) {
+        return FALSE;
+    }
+
+    if (_PendingBatch.batch != NULL && _PendingBatch.batch->passThrough != passThrough) {
+        flushMessageBatch();
+    }
+    if (_PendingBatch.batch == NULL) {
+        batch = (EsMqttMessageBatch *) EsAllocateMemory(
+                sizeof(EsMqttMessageBatch) + sizeof(EsMqttMessageBatchEntry) * maxCount);
+        if (batch == NULL) {
+            return FALSE;
+        }
+        batch->count = 0;
+        batch->passThrough = passThrough;
+        _PendingBatch.batch = batch;
+        _PendingBatch.capacity = maxCount;
+        _PendingBatch.numBytes = 0;
+        p_time_profiler_reset(_PendingBatch.age);
+    }
+
+    batch = _PendingBatch.batch;
+    entry = &batch->entries[batch->count++];
+    entry->context = msg->args[0].ptr;
+    entry->topicName = msg->args[1].str;
+    entry->topicLen = msg->args[2].i;
+    entry->message = msg->args[3].msg;
+    entry->payloadBuffer = (!passThrough && entry->message != NULL)
+                           ? EsRefBuffer_getHandle(entry->message->payload) : ES_HANDLE_NONE;
+    msg->argsOwner = ARGS_BATCHED;
+
+    _PendingBatch.numBytes += (U_32) entry->topicLen;
+    if (entry->message != NULL) {
+        _PendingBatch.numBytes += (U_32) entry->message->payloadlen;
+    }
+    if (batch->count >= _PendingBatch.capacity || batch->count >= maxCount
+        || (maxBytes > 0 && _PendingBatch.numBytes >= maxBytes)) {
+        flushMessageBatch();
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Flush the pending batch once it is due
+ *
+ * There is no timer thread, so while no other message is queued the
+ * dispatcher waits out the batch deadline here (it has nothing else to do),
+ * sleeping in 1 ms steps rather than spinning. If more messages are
+ * queued, the batch stays pending for the next task.
+ * @note Dispatcher thread only
+ */
+static void lingerMessageBatch() {
+    U_64 maxDelayUs;
+    U_64 ageUs;
+
+    if (_PendingBatch.batch == NULL) {
+        return;
+    }
+
+    while (p_atomic_int_get(&_BatchMaxCount) > 1) {
+        maxDelayUs = (U_64) p_atomic_int_get(&_BatchMaxDelayUs);
+        ageUs = p_time_profiler_elapsed_usecs(_PendingBatch.age);
+        if (ageUs >= maxDelayUs) {
+            break;
+        }
+        if (p_atomic_int_get(&_AsyncMessagesQueued) > 0) {
+            return;
+        }
+        /* Sleeps are whole milliseconds, the last one may overshoot the deadline */
+        p_uthread_sleep(1);
+    }
+    flushMessageBatch();
+}
+
+/**
+ * @brief Take the pending message out of the slot of its topic,
+ * so no newer args replace them while it is posted
+ * @note Dispatcher thread only
+ * @param msg coalesced arrived message
+ */
+static void takePendingMessage(EsMqttAsyncMessage *msg) {
+    CoalescedTopic *topic;
+
+    p_mutex_lock(_CoalescedTopicsLock);
+    topic = (CoalescedTopic *) EsTopicTable_at(_CoalescedTopics, msg->args[1].str, (U_32) msg->args[2].i);
+    if (topic != NULL && topic->pending == msg) {
+        topic->pending = NULL;
+    }
+    p_mutex_unlock(_CoalescedTopicsLock);
+}
+
+/**
+ * @brief Work task function that posts the message to the VAST async queue
+ * @note This runs on the dispatcher thread, so a failed post is retried
+ * @note A coalesced message takes the newest args of its topic from here on.
+ * @note Arrived messages may be moved into a batch instead (@see EsMqttAsyncMessage_SetBatching).
+ * Any other message flushes the pending batch first to keep the delivery order.
+ * @note The message is freed along with the task. The arg copies
+ * are only freed with it if they were not handed over by the post.
+ * @param task
+ */
+static void submitToAsyncQueue(EsWorkTask *task) {
+    EsMqttAsyncMessage *msg;
+
+    msg = (EsMqttAsyncMessage *) EsWorkTask_getUserData(task);
+    if (!msg) {
+        return;
+    }
+
+    if (msg->coalesced) {
+        takePendingMessage(msg);
+    }
+    if (msg->cbType != ESMQTT_CB_TYPE_MESSAGEARRIVED || !batchArrivedMessage(msg)) {
+        flushMessageBatch();
+        postAsyncMessage(msg, getPostAttempts(msg->cbType));
+    }
+    p_atomic_int_add(&_AsyncMessagesQueued, -1);
+    lingerMessageBatch();
+}
+
+/**
+ * @brief Free function for the message that is the task user data
+ * @param message
+ */
+static void freeAsyncMessage(void *message) {
+    EsMqttAsyncMessage_free((EsMqttAsyncMessage *) message);
+}
+
+/**
+ * @brief Hand off the message to the dispatcher
+ * @param message freed if it could not be queued
+ * @return TRUE if queued, FALSE otherwise
+ */
+static BOOLEAN queueAsyncMessage(EsMqttAsyncMessage *message) {
+    EsWorkTask *task;
+
+    task = EsWorkTaskPool_acquireInit(_AsyncTaskPool, submitToAsyncQueue, message);
+    if (!task) {
+        EsMqttAsyncMessage_free(message);
+        return FALSE;
+    }
+    EsWorkTask_setFreeUserDataFunc(task, freeAsyncMessage);
+
+    /* Once queued, the message owns the Paho data (the callback returns 1) */
+    if (message->argsOwner == ARGS_BORROWED) {
+        message->argsOwner = ARGS_ADOPTED;
+    }
+    /* Counted before the submit, the dispatcher may finish it right away */
+    p_atomic_int_inc(&_AsyncMessagesQueued);
+    if (!EsWorkQueue_submit(_AsyncMessageQueue, task)) {
+        /* Rejected: task (and message) is still ours, and Paho keeps its data */
+        p_atomic_int_add(&_AsyncMessagesQueued, -1);
+        if (message->argsOwner == ARGS_ADOPTED) {
+            message->argsOwner = ARGS_BORROWED;
+        }
+        EsWorkTask_release(task);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Answer if the topic of the arrived message is coalesced
+ * @param msg arrived message
+ * @return TRUE if a coalesced topic filter matches, FALSE otherwise
+ */
+static BOOLEAN isCoalescedTopic(EsMqttAsyncMessage *msg) {
+    if (EsTopicTrie_getSize(_CoalescedFilters) == 0 || msg->args[1].str == NULL || msg->args[2].i < 0) {
+        return FALSE;
+    }
+    return EsTopicTrie_match(_CoalescedFilters, msg->args[1].str, (U_32) msg->args[2].i, NULL, NULL);
+}
 
-    handler(msg);
+/**
+ * @brief Move the args of the arrived message into the pending message of its topic
+ *
+ * The older args of the pending message are freed, and the pending message
+ * keeps its place in the queue.
+ *
+ * @note The coalesce lock must be held
+ * @param topic
+ * @param msg arrived message, its args are owned by the pending message if moved
+ * @return TRUE if moved, FALSE if the topic has no pending message
+ */
+static BOOLEAN replacePendingMessage(CoalescedTopic *topic, EsMqttAsyncMessage *msg) {
+    EsMqttAsyncMessage *pending = topic->pending;
+    U_32 i;
 
+    if (pending == NULL) {
+        return FALSE;
+    }
+    freeMessageArgs(pending);
+    for (i = 0; i < _AsyncMessageArity[ESMQTT_CB_TYPE_MESSAGEARRIVED]; i++) {
+        pending->args[i] = msg->args[i];
+    }
+    /* Paho's data is adopted, as it would be by queueing the message */
+    pending->argsOwner = (msg->argsOwner == ARGS_BORROWED) ? ARGS_ADOPTED : msg->argsOwner;
+    msg->argsOwner = ARGS_MOVED;
+    topic->numCoalesced++;
+    p_atomic_int_inc(&_NumCoalesced);
+    return TRUE;
+}
+
+/**
+ * @brief Hand off an arrived message of a coalesced topic to the dispatcher
+ *
+ * If the dispatcher has not taken the last message of the topic yet,
+ * that message takes the newer args instead of queueing another one.
+ * So the queue holds at most one message per coalesced topic name.
+ *
+ * @note Called on the Paho thread
+ * @param msg arrived message, freed if it is not queued
+ * @return TRUE if queued (or coalesced), FALSE otherwise
+ */
+static BOOLEAN coalesceArrivedMessage(EsMqttAsyncMessage *msg) {
+    CoalescedTopic *topic;
+    BOOLEAN queued;
+
+    p_mutex_lock(_CoalescedTopicsLock);
+    topic = (CoalescedTopic *) EsTopicTable_atOrAdd(_CoalescedTopics, msg->args[1].str, (U_32) msg->args[2].i);
+    if (topic != NULL && replacePendingMessage(topic, msg)) {
+        p_mutex_unlock(_CoalescedTopicsLock);
+        EsMqttAsyncMessage_free(msg);
+        return TRUE;
+    }
+    p_mutex_unlock(_CoalescedTopicsLock);
+
+    /* Refused: Paho keeps its data and redelivers (the callback returns 0) */
+    if (!admitArrivedMessage()) {
+        EsMqttAsyncMessage_free(msg);
+        return FALSE;
+    }
+    if (topic == NULL) {
+        return queueAsyncMessage(msg);
+    }
+
+    /* Queued under the lock, so newer messages of the topic find it pending */
+    p_mutex_lock(_CoalescedTopicsLock);
+    if (replacePendingMessage(topic, msg)) {
+        p_mutex_unlock(_CoalescedTopicsLock);
+        EsMqttAsyncMessage_free(msg);
+        return TRUE;
+    }
+    msg->coalesced = TRUE;
+    topic->pending = msg;
+    queued = queueAsyncMessage(msg);
+    if (!queued) {
+        topic->pending = NULL;
+    }
+    p_mutex_unlock(_CoalescedTopicsLock);
+    return queued;
 }
 
 /******************************************************/
@@ -448,71 +1445,144 @@ static void submitToAsyncQueue(EsWorkTask *task) {
 /******************************************************/
 
 void EsMqttAsyncMessages_ModuleInit(EsGlobalInfo *globalInfo) {
+    U_32 i;
+
     _DummyVMContext.globalInfo = globalInfo;
-    _AsyncMessageTargetsLock = p_rwlock_new();
+    p_atomic_int_set(&_AsyncMessagesShutdown, 0);
+    for (i = 0; i < ASYNC_MSG_TARGETS_SIZE; i++) {
+        _InitialAsyncMessageTargets.targets[i] = EsNil;
+    }
+    _AsyncMessageTargetsEpoch = EsEpoch_new();
+    _AsyncMessageTargetsWriteLock = p_mutex_new();
+    for (i = 0; i < NUM_MQTT_CALLBACKS; i++) {
+        _AsyncMessageSlabs[i] = EsSlab_new(
+                sizeof(EsMqttAsyncMessage) + sizeof(EsMqttAsyncMessageArg) * _AsyncMessageArity[i],
+                ASYNC_MSG_SLAB_BLOCKS_PER_CHUNK);
+    }
+    _PendingBatch.age = p_time_profiler_new();
+    _AsyncMessageHandles = EsHandleTable_new(ASYNC_MSG_HANDLES_CAPACITY);
+    _TopicRoutes = EsTopicTrie_new();
+    _TopicFilters = EsTopicTrie_new();
+    _CoalescedFilters = EsTopicTrie_new();
+    _CoalescedTopics = EsTopicTable_new(sizeof(CoalescedTopic), ASYNC_MSG_COALESCE_MAX_TOPICS);
+    _CoalescedTopicsLock = p_mutex_new();
+    _AsyncTaskPool = EsWorkTaskPool_new();
+    _AsyncMessageQueue = EsWorkQueue_new(ESQ_TYPE_THREAD_POOL);
+    EsProperties_atPut(EsWorkQueue_getProperties(_AsyncMessageQueue), ESQ_PROP_NUM_THREADS,
+                       ASYNC_MSG_QUEUE_NUM_THREADS);
+    EsWorkQueue_init(_AsyncMessageQueue);
 }
 
 void EsMqttAsyncMessages_ModuleShutdown() {
+    U_32 i;
+
+    /* Post pending messages before the globalInfo is cleared (without endless retries) */
+    p_atomic_int_set(&_AsyncMessagesShutdown, 1);
+    EsWorkQueue_free(_AsyncMessageQueue);
+    _AsyncMessageQueue = NULL;
+    /* The last task flushed the batch, this only covers a shutdown race */
+    flushMessageBatch();
+    if (_PendingBatch.age != NULL) {
+        p_time_profiler_free(_PendingBatch.age);
+        _PendingBatch.age = NULL;
+    }
+    EsTopicTrie_free(_TopicRoutes, free);
+    _TopicRoutes = NULL;
+    EsTopicTrie_free(_TopicFilters, freeMessageFilter);
+    _TopicFilters = NULL;
+    /* The queue took all pending messages */
+    EsTopicTrie_free(_CoalescedFilters, NULL);
+    _CoalescedFilters = NULL;
+    EsTopicTable_free(_CoalescedTopics);
+    _CoalescedTopics = NULL;
+    p_mutex_free(_CoalescedTopicsLock);
+    _CoalescedTopicsLock = NULL;
+    /* Handles Smalltalk did not take can no longer be resolved */
+    EsHandleTable_free(_AsyncMessageHandles);
+    _AsyncMessageHandles = NULL;
+    /* All tasks have been released by the queue */
+    EsWorkTaskPool_free(_AsyncTaskPool);
+    _AsyncTaskPool = NULL;
+    /* All messages have been freed by the queue */
+    for (i = 0; i < NUM_MQTT_CALLBACKS; i++) {
+        EsSlab_free(_AsyncMessageSlabs[i]);
+        _AsyncMessageSlabs[i] = NULL;
+    }
+    /* Targets are reset for the next init */
+    if (_AsyncMessageTargets != &_InitialAsyncMessageTargets) {
+        free(_AsyncMessageTargets);
+        _AsyncMessageTargets = &_InitialAsyncMessageTargets;
+    }
+    EsEpoch_free(_AsyncMessageTargetsEpoch);
+    _AsyncMessageTargetsEpoch = NULL;
+    p_mutex_free(_AsyncMessageTargetsWriteLock);
+    _AsyncMessageTargetsWriteLock = NULL;
     _DummyVMContext.globalInfo = NULL;
 }
 
 EsMqttAsyncMessage *EsMqttAsyncMessage_newInit(enum EsMqttVastCallbackTypes cbType, U_32 argCount, ...) {
     EsMqttAsyncMessage *msg;
+    EsSlab *slab;
     va_list argsList;
+    BOOLEAN copied = TRUE;
 
-    msg = (EsMqttAsyncMessage *) EsAllocateMemory(
-            sizeof(EsMqttAsyncMessage) + sizeof(EsMqttAsyncMessageArg) * argCount);
+    if (!EsMqttCallbacks_IsValidCallbackType(cbType) || argCount != _AsyncMessageArity[cbType]) {
+        return (EsMqttAsyncMessage *) NULL;
+    }
+
+    /* Fall back to the vm heap if the module is not initialized */
+    slab = _AsyncMessageSlabs[cbType];
+    if (slab != NULL) {
+        msg = (EsMqttAsyncMessage *) EsSlab_alloc(slab);
+    } else {
+        msg = (EsMqttAsyncMessage *) EsAllocateMemory(
+                sizeof(EsMqttAsyncMessage) + sizeof(EsMqttAsyncMessageArg) * argCount);
+    }
     if (!msg) {
         return (EsMqttAsyncMessage *) NULL;
     }
 
+    msg->slab = slab;
     msg->cbType = cbType;
+    msg->argsOwner = ARGS_COPIED;
+    msg->coalesced = FALSE;
     msg->receiver = EsNil;
     msg->selector = EsNil;
     va_start(argsList, argCount);
     switch (cbType) {
         case ESMQTT_CB_TYPE_TRACE:
-            if (argCount != 2) {
-                return NULL;
-            }
             msg->args[0].i = va_arg(argsList, I_32);
             msg->args[1].str = EsCopyString(va_arg(argsList, char*));
             break;
         case ESMQTT_CB_TYPE_CONNECTIONLOST:
-            if (argCount != 2) {
-                return NULL;
-            }
-            msg->args[0].i = va_arg(argsList, I_32);
+            msg->args[0].ptr = va_arg(argsList, void*);
             msg->args[1].str = EsCopyString(va_arg(argsList, char*));
             break;
         case ESMQTT_CB_TYPE_DISCONNECTED:
-            if (argCount != 3) {
-                return NULL;
-            }
             msg->args[0].ptr = va_arg(argsList, void*);
             msg->args[1].props = EsCopyProperties(va_arg(argsList, MQTTProperties*));
             msg->args[2].reasonCode = va_arg(argsList, enum MQTTReasonCodes);
             break;
         case ESMQTT_CB_TYPE_MESSAGEARRIVED:
-            if (argCount != 4) {
-                return NULL;
-            }
             msg->args[0].ptr = va_arg(argsList, void*);
             msg->args[1].str = va_arg(argsList, char*);
             msg->args[2].i = va_arg(argsList, I_32);
-            msg->args[3].msg = EsCopyMessage(va_arg(argsList, MQTTClient_message*));
+            msg->args[3].msg = va_arg(argsList, MQTTClient_message*);
+            if (EsMqttAsyncArguments_IsPassThrough()) {
+                /* Adopted from Paho once the message is queued */
+                msg->argsOwner = ARGS_BORROWED;
+            } else {
+                msg->args[1].str = EsCopyTopicString(msg->args[1].str, msg->args[2].i);
+                msg->args[3].msg = EsCopyMessage(msg->args[3].msg);
+                /* i.e. no payload buffer handle is left, Paho keeps the message and redelivers it */
+                copied = (BOOLEAN) (msg->args[1].str != NULL && msg->args[3].msg != NULL);
+            }
             break;
         case ESMQTT_CB_TYPE_DELIVERYCOMPLETE:
-            if (argCount != 2) {
-                return NULL;
-            }
             msg->args[0].ptr = va_arg(argsList, void*);
             msg->args[1].token = va_arg(argsList, MQTTClient_deliveryToken);
             break;
         case ESMQTT_CB_TYPE_PUBLISHED:
-            if (argCount != 5) {
-                return NULL;
-            }
             msg->args[0].ptr = va_arg(argsList, void*);
             msg->args[1].i = va_arg(argsList, I_32);
             msg->args[2].i = va_arg(argsList, I_32);
@@ -520,28 +1590,183 @@ EsMqttAsyncMessage *EsMqttAsyncMessage_newInit(enum EsMqttVastCallbackTypes cbTy
             msg->args[4].reasonCode = va_arg(argsList, enum MQTTReasonCodes);
             break;
         case ESMQTT_CB_TYPE_CHECKPOINT:
-            if (argCount != 1) {
-                return NULL;
-            }
             msg->args[0].i = va_arg(argsList, I_32);
             break;
+        case ESMQTT_CB_TYPE_MESSAGEBATCH:
+            /* Allocated with EsAllocateMemory by the dispatcher */
+            msg->args[0].ptr = va_arg(argsList, void*);
+            break;
+        case ESMQTT_CB_TYPE_ONSUCCESS:
+            msg->args[0].ptr = va_arg(argsList, void*);
+            msg->args[1].i = va_arg(argsList, I_32);
+            break;
+        case ESMQTT_CB_TYPE_ONCONNECT:
+            msg->args[0].ptr = va_arg(argsList, void*);
+            msg->args[1].i = va_arg(argsList, I_32);
+            msg->args[2].i = va_arg(argsList, I_32);
+            msg->args[3].i = va_arg(argsList, I_32);
+            msg->args[4].str = EsCopyString(va_arg(argsList, char*));
+            break;
+        case ESMQTT_CB_TYPE_ONSUBSCRIBE:
+            msg->args[0].ptr = va_arg(argsList, void*);
+            msg->args[1].i = va_arg(argsList, I_32);
+            msg->args[2].i = va_arg(argsList, I_32);
+            break;
+        case ESMQTT_CB_TYPE_ONFAILURE:
+            msg->args[0].ptr = va_arg(argsList, void*);
+            msg->args[1].i = va_arg(argsList, I_32);
+            msg->args[2].i = va_arg(argsList, I_32);
+            msg->args[3].str = EsCopyString(va_arg(argsList, char*));
+            break;
         default:
             break;
     }
     va_end(argsList);
 
+    if (!copied) {
+        EsMqttAsyncMessage_free(msg);
+        return (EsMqttAsyncMessage *) NULL;
+    }
     return msg;
 }
 
 void EsMqttAsyncMessage_free(EsMqttAsyncMessage *message) {
     if (message) {
-        if (message->args) {
-            EsFreeMemory(message->args);
+        freeMessageArgs(message);
+        /* args are a flexible array member allocated with the message */
+        if (message->slab != NULL) {
+            EsSlab_release(message->slab, message);
+        } else {
+            EsFreeMemory(message);
         }
-        EsFreeMemory(message);
     }
 }
 
+BOOLEAN EsMqttAsyncMessage_GetSlabStats(enum EsMqttVastCallbackTypes cbType, EsSlabStats *stats) {
+    if (stats == NULL || !EsMqttCallbacks_IsValidCallbackType(cbType)) {
+        return FALSE;
+    }
+    EsSlab_getStats(_AsyncMessageSlabs[cbType], stats);
+    return TRUE;
+}
+
+void *EsMqttAsyncMessage_HandleAt(U_32 handle) {
+    return EsHandleTable_at(_AsyncMessageHandles, handle);
+}
+
+void *EsMqttAsyncMessage_HandleRemove(U_32 handle) {
+    return EsHandleTable_remove(_AsyncMessageHandles, handle);
+}
+
+MQTTClient_message *EsMqttAsyncMessage_MessageAt(U_32 handle, BOOLEAN *passThrough) {
+    U_32 tag = HANDLE_DATA;
+    void *ptr = EsHandleTable_atTagged(_AsyncMessageHandles, handle, &tag);
+
+    if (ptr == NULL || tag == HANDLE_DATA) {
+        return NULL;
+    }
+    if (passThrough != NULL) {
+        *passThrough = (BOOLEAN) (tag == HANDLE_PAHO_MESSAGE);
+    }
+    return (MQTTClient_message *) ptr;
+}
+
+MQTTClient_message *EsMqttAsyncMessage_MessageRemove(U_32 handle, BOOLEAN *passThrough) {
+    U_32 tag = HANDLE_DATA;
+    void *ptr = EsHandleTable_atTagged(_AsyncMessageHandles, handle, &tag);
+
+    if (ptr == NULL || tag == HANDLE_DATA) {
+        return NULL;
+    }
+    /* NULL if another remove of the same handle came first */
+    ptr = EsHandleTable_removeTagged(_AsyncMessageHandles, handle, &tag);
+    if (ptr != NULL && passThrough != NULL) {
+        *passThrough = (BOOLEAN) (tag == HANDLE_PAHO_MESSAGE);
+    }
+    return (MQTTClient_message *) ptr;
+}
+
+BOOLEAN EsMqttAsyncMessage_SetTopicRoute(const char *filter, EsObject receiver, EsObject selector) {
+    AsyncMessageTarget *target;
+    void *oldTarget = NULL;
+
+    if (!EsTopicTrie_isValidFilter(filter)) {
+        return FALSE;
+    }
+
+    if (EsIsNil(receiver) || EsIsNil(selector)) {
+        /* Readers only use targets under the trie lock */
+        free(EsTopicTrie_remove(_TopicRoutes, filter));
+        return TRUE;
+    }
+
+    target = (AsyncMessageTarget *) malloc(sizeof(AsyncMessageTarget));
+    if (target == NULL) {
+        return FALSE;
+    }
+    target->receiver = receiver;
+    target->selector = selector;
+    if (!EsTopicTrie_put(_TopicRoutes, filter, target, &oldTarget)) {
+        free(target);
+        return FALSE;
+    }
+    free(oldTarget);
+    return TRUE;
+}
+
+BOOLEAN EsMqttAsyncMessage_SetTopicFilter(const char *filter, U_32 type, U_32 param) {
+    EsMessageFilter *messageFilter;
+    void *oldFilter = NULL;
+
+    if (!EsTopicTrie_isValidFilter(filter)) {
+        return FALSE;
+    }
+
+    if (type == ESMF_TYPE_NONE) {
+        /* Readers only use message filters under the trie lock */
+        EsMessageFilter_free((EsMessageFilter *) EsTopicTrie_remove(_TopicFilters, filter));
+        return TRUE;
+    }
+
+    messageFilter = EsMessageFilter_new((enum EsMessageFilterTypes) type, param);
+    if (messageFilter == NULL) {
+        return FALSE;
+    }
+    if (!EsTopicTrie_put(_TopicFilters, filter, messageFilter, &oldFilter)) {
+        EsMessageFilter_free(messageFilter);
+        return FALSE;
+    }
+    EsMessageFilter_free((EsMessageFilter *) oldFilter);
+    return TRUE;
+}
+
+BOOLEAN EsMqttAsyncMessage_SetTopicCoalescing(const char *filter, BOOLEAN enabled) {
+    if (!EsTopicTrie_isValidFilter(filter)) {
+        return FALSE;
+    }
+    if (!enabled) {
+        EsTopicTrie_remove(_CoalescedFilters, filter);
+        return TRUE;
+    }
+    return EsTopicTrie_put(_CoalescedFilters, filter, ASYNC_MSG_COALESCE_MARK, NULL);
+}
+
+U_32 EsMqttAsyncMessage_GetNumCoalesced(const char *topicName) {
+    CoalescedTopic *topic;
+    U_32 numCoalesced = 0;
+
+    if (topicName == NULL) {
+        return 0;
+    }
+    p_mutex_lock(_CoalescedTopicsLock);
+    topic = (CoalescedTopic *) EsTopicTable_at(_CoalescedTopics, topicName, 0);
+    if (topic != NULL) {
+        numCoalesced = topic->numCoalesced;
+    }
+    p_mutex_unlock(_CoalescedTopicsLock);
+    return numCoalesced;
+}
+
 BOOLEAN EsMqttAsyncMessage_GetTarget(enum EsMqttVastCallbackTypes cbType, EsObject *receiver, EsObject *selector) {
     return getAsyncMessageTarget(cbType, receiver, selector);
 }
@@ -551,14 +1776,86 @@ BOOLEAN EsMqttAsyncMessage_SetTarget(enum EsMqttVastCallbackTypes cbType, EsObje
 }
 
 
-BOOLEAN EsMqttAsyncMessage_send(EsMqttAsyncMessage *message) {
-    EsWorkTask *task;
+void EsMqttAsyncMessage_SetDispatcher(BOOLEAN enabled) {
+    p_atomic_int_set(&_AsyncMessageDispatcher, enabled ? 1 : 0);
+}
 
-    task = EsWorkTask_newInit(submitToAsyncQueue, message);
-    if (!task) {
+BOOLEAN EsMqttAsyncMessage_IsDispatcher() {
+    return (BOOLEAN) (p_atomic_int_get(&_AsyncMessageDispatcher) != 0);
+}
+
+BOOLEAN EsMqttAsyncMessage_SetBatching(U_32 maxCount, U_32 maxBytes, U_32 maxDelayUs) {
+    if (maxCount > ASYNC_MSG_BATCH_MAX_COUNT || maxBytes > 0x7FFFFFFFU || maxDelayUs > ASYNC_MSG_BATCH_MAX_DELAY_US) {
         return FALSE;
     }
+    /* Limits first, the count enables batching */
+    p_atomic_int_set(&_BatchMaxBytes, (I_32) maxBytes);
+    p_atomic_int_set(&_BatchMaxDelayUs, (I_32) maxDelayUs);
+    p_atomic_int_set(&_BatchMaxCount, (I_32) maxCount);
+    return TRUE;
+}
 
-    EsWorkTask_run(task);
+BOOLEAN EsMqttAsyncMessage_IsBatching() {
+    return (BOOLEAN) (p_atomic_int_get(&_BatchMaxCount) > 1);
+}
+
+BOOLEAN EsMqttAsyncMessage_SetFlowControl(U_32 throttleMark, U_32 pauseMark) {
+    if (throttleMark > 0x7FFFFFFFU || pauseMark > 0x7FFFFFFFU) {
+        return FALSE;
+    }
+    p_atomic_int_set(&_FlowThrottleMark, (I_32) throttleMark);
+    p_atomic_int_set(&_FlowPauseMark, (I_32) pauseMark);
     return TRUE;
 }
+
+void EsMqttAsyncMessage_GetFlowStats(EsMqttFlowStats *stats) {
+    I_32 numQueued;
+
+    if (stats == NULL) {
+        return;
+    }
+    numQueued = p_atomic_int_get(&_AsyncMessagesQueued);
+    stats->numQueued = (numQueued > 0) ? (U_32) numQueued : 0;
+    stats->numPosts = (U_32) p_atomic_int_get(&_NumPosts);
+    stats->numFailedPosts = (U_32) p_atomic_int_get(&_NumFailedPosts);
+    stats->numThrottled = (U_32) p_atomic_int_get(&_NumThrottled);
+    stats->numRefused = (U_32) p_atomic_int_get(&_NumRefused);
+    stats->numUnrouted = (U_32) p_atomic_int_get(&_NumUnrouted);
+    stats->numFiltered = (U_32) p_atomic_int_get(&_NumFiltered);
+    stats->numCoalesced = (U_32) p_atomic_int_get(&_NumCoalesced);
+}
+
+BOOLEAN EsMqttAsyncMessage_send(EsMqttAsyncMessage *message) {
+    if (!message) {
+        return FALSE;
+    }
+
+    /* Filtered: freed without waking the vm, as if it was posted (the callback returns 1) */
+    if (message->cbType == ESMQTT_CB_TYPE_MESSAGEARRIVED && !acceptArrivedMessage(message)) {
+        p_atomic_int_inc(&_NumFiltered);
+        if (message->argsOwner == ARGS_BORROWED) {
+            message->argsOwner = ARGS_ADOPTED;
+        }
+        EsMqttAsyncMessage_free(message);
+        return TRUE;
+    }
+
+    if (p_atomic_int_get(&_AsyncMessageDispatcher) == 0) {
+        /* Inline: post once on the calling thread, Paho redelivers on failure */
+        BOOLEAN posted = postAsyncMessage(message, 1);
+        EsMqttAsyncMessage_free(message);
+        return posted;
+    }
+
+    /* Coalesced: at most one message per topic name is queued */
+    if (message->cbType == ESMQTT_CB_TYPE_MESSAGEARRIVED && isCoalescedTopic(message)) {
+        return coalesceArrivedMessage(message);
+    }
+
+    /* Refused: Paho keeps its data and redelivers (the callback returns 0) */
+    if (message->cbType == ESMQTT_CB_TYPE_MESSAGEARRIVED && !admitArrivedMessage()) {
+        EsMqttAsyncMessage_free(message);
+        return FALSE;
+    }
+    return queueAsyncMessage(message);
+}
@@ -45,13 +45,19 @@
  *  during this time.
  *  Issue2: Addresses (especially 64-bit) can be bigger than a SmallInteger immediate and require a LargeInteger
  *  which is a heap allocated object. How do we pass back the address to Smalltalk when we can't represent it?
- *  Here is where there are any number of clever schemes that could be employed. For simplicity, the address
- *  is split into high/low parts and passed as 2 arguments. Then they are put back together on the Smalltalk side.
+ *  Here is where there are any number of clever schemes that could be employed. The address is put in a
+ *  handle table (@see EsHandleTable.h) and only its handle, which always fits in a SmallInteger, is passed.
+ *  On the Smalltalk side, a user-prim resolves the handle back into the address (it can allocate a LargeInteger
+ *  since it runs on the vm thread) and removes it once the data is taken. A stale handle is detected and
+ *  answers nil instead of whatever now occupies its slot.
  *******************************************************************************/
 #ifndef ES_MQTT_ASYNC_QUEUE_MESSAGES_H
 #define ES_MQTT_ASYNC_QUEUE_MESSAGES_H
 
+#include "MQTTClient.h"
+
 #include "EsMqttCallbacks.h"
+#include "EsSlab.h"
 
 /**************************/
 /*   D A T A  T Y P E S   */
@@ -62,6 +68,63 @@
  */
 typedef struct _EsMqttAsyncMessage EsMqttAsyncMessage;
 
+/**
+ * @brief One arrived message of a batch
+ * @note Same data as the args of a single messageArrived post, plus the
+ * handle of the payload ref buffer (ES_HANDLE_NONE if passed through or no payload)
+ */
+typedef struct _EsMqttMessageBatchEntry EsMqttMessageBatchEntry;
+struct _EsMqttMessageBatchEntry {
+    void *context;
+    char *topicName;
+    I_32 topicLen;
+    U_32 payloadBuffer;
+    MQTTClient_message *message;
+};
+
+/**
+ * @brief Batch of arrived messages posted as one async message
+ *
+ * The batch is allocated with EsAllocateMemory and is owned by Smalltalk
+ * once posted. Smalltalk frees each entry as it would a single arrived
+ * message taken with EsMqttVastHandleRemove (Paho's free functions if
+ * passThrough is non-zero, otherwise it releases payloadBuffer and frees the
+ * copies with EsFreeMemory) and then the batch itself with EsFreeMemory.
+ * Entries have no message handle, so EsMqttVastMessageTakePayload does not apply.
+ * @note This layout is read from the Smalltalk image
+ */
+typedef struct _EsMqttMessageBatch EsMqttMessageBatch;
+struct _EsMqttMessageBatch {
+    U_32 count;
+    U_32 passThrough;
+    EsMqttMessageBatchEntry entries[];
+};
+
+/**
+ * @brief Flow control statistics of the dispatcher
+ * @note Counters wrap around, compare two reads for a rate
+ *
+ * numQueued: Messages queued for the dispatcher (in-flight)
+ * numPosts: Posts tried, including retries
+ * numFailedPosts: Posts that the vm async queue did not accept
+ * numThrottled: Arrived messages that slowed down the Paho thread
+ * numRefused: Arrived messages that Paho was told to redeliver
+ * numUnrouted: Arrived messages dropped since no topic route matched
+ * numFiltered: Arrived messages dropped by a topic filter's message filter
+ * numCoalesced: Arrived messages replaced by a newer one of their topic before they were posted
+ */
+typedef struct _EsMqttFlowStats EsMqttFlowStats;
+struct _EsMqttFlowStats {
+    U_32 numQueued;
+    U_32 numPosts;
+    U_32 numFailedPosts;
+    U_32 numThrottled;
+    U_32 numRefused;
+    U_32 numUnrouted;
+    U_32 numFiltered;
+    U_32 numCoalesced;
+};
+
 /***********************************/
 /*   S E T U P / S H U T D O W N   */
 /***********************************/
@@ -99,6 +162,97 @@ BOOLEAN EsMqttAsyncMessage_GetTarget(enum EsMqttVastCallbackTypes cbType, EsObje
  */
 BOOLEAN EsMqttAsyncMessage_SetTarget(enum EsMqttVastCallbackTypes cbType, EsObject receiver, EsObject selector);
 
+/**
+ * @brief Route arrived messages that match the topic filter to a Smalltalk receiver>>selector
+ *
+ * While there is any route, each arrived message is posted to the target
+ * of the most specific matching filter (@see EsTopicTrie.h) instead of the
+ * messageArrived target, with the same args. A message that matches no
+ * filter is freed in C and never posted. Routed messages are not batched.
+ *
+ * @param filter null-terminated MQTT topic filter ('+' and '#' wildcards)
+ * @param receiver async msg target class (nil to remove the route)
+ * @param selector async msg target symbol selector (nil to remove the route)
+ * @return TRUE if successful set (or removed), FALSE otherwise
+ */
+BOOLEAN EsMqttAsyncMessage_SetTopicRoute(const char *filter, EsObject receiver, EsObject selector);
+
+/**
+ * @brief Filter arrived messages that match the topic filter natively
+ *
+ * Each arrived message is given to the message filter of the most specific
+ * matching topic filter (@see EsMessageFilter.h). A message it drops is
+ * freed in C and never queued or posted, as if Smalltalk had taken it.
+ * Messages that match no topic filter are not filtered.
+ *
+ * @param filter null-terminated MQTT topic filter ('+' and '#' wildcards)
+ * @param type EsMessageFilterTypes (ESMF_TYPE_NONE to remove the filter)
+ * @param param parameter of the type
+ * @return TRUE if successful set (or removed), FALSE otherwise
+ */
+BOOLEAN EsMqttAsyncMessage_SetTopicFilter(const char *filter, U_32 type, U_32 param);
+
+/**
+ * @brief Coalesce arrived messages that match the topic filter to their latest value
+ *
+ * In dispatcher mode each matching topic name has a slot for its queued
+ * message. While the dispatcher has not taken that message, a newer message
+ * of the topic replaces its args (the older ones are freed) instead of being
+ * queued. So while the vm is busy the queue grows with the number of topic
+ * names, not with the message rate. Inline posts are not coalesced.
+ *
+ * @param filter null-terminated MQTT topic filter ('+' and '#' wildcards)
+ * @param enabled TRUE to coalesce, FALSE to stop coalescing
+ * @return TRUE if successful set (or removed), FALSE otherwise
+ */
+BOOLEAN EsMqttAsyncMessage_SetTopicCoalescing(const char *filter, BOOLEAN enabled);
+
+/**
+ * @brief Answer the number of coalesced (replaced) messages of a topic name
+ * @param topicName null-terminated
+ * @return number of messages, 0 if the topic name was never coalesced
+ */
+U_32 EsMqttAsyncMessage_GetNumCoalesced(const char *topicName);
+
+/***********************************************/
+/*   A S Y N C  M E S S A G E  H A N D L E S   */
+/***********************************************/
+
+/**
+ * @brief Answer the pointer of a handle passed in an async message
+ * @param handle
+ * @return pointer or NULL if the handle is stale (or invalid)
+ */
+void *EsMqttAsyncMessage_HandleAt(U_32 handle);
+
+/**
+ * @brief Remove a handle passed in an async message and answer its pointer
+ * @note The caller takes over the data the handle referred to
+ * @param handle
+ * @return pointer or NULL if the handle is stale (or invalid)
+ */
+void *EsMqttAsyncMessage_HandleRemove(U_32 handle);
+
+/**
+ * @brief Answer the arrived message of a handle passed in a messageArrived async message
+ * @note The owner of the message is recorded natively when its handle is made
+ * @param handle
+ * @param passThrough[out] TRUE if it is Paho's message (free with EsFreePahoMessage()),
+ * FALSE if it is a copy (free with EsFreeMessageCopy()), may be NULL
+ * @return message or NULL if the handle is stale, invalid or not of an arrived message
+ */
+MQTTClient_message *EsMqttAsyncMessage_MessageAt(U_32 handle, BOOLEAN *passThrough);
+
+/**
+ * @brief Remove the handle of an arrived message and answer the message
+ * @note The caller takes over the message and frees it as passThrough tells
+ * @param handle
+ * @param passThrough[out] TRUE if it is Paho's message (free with EsFreePahoMessage()),
+ * FALSE if it is a copy (free with EsFreeMessageCopy()), may be NULL
+ * @return message or NULL if the handle is stale, invalid or not of an arrived message
+ */
+MQTTClient_message *EsMqttAsyncMessage_MessageRemove(U_32 handle, BOOLEAN *passThrough);
+
 /********************************/
 /*   A S Y N C  M E S S A G E   */
 /********************************/
@@ -106,28 +260,121 @@ BOOLEAN EsMqttAsyncMessage_SetTarget(enum EsMqttVastCallbackTypes cbType, EsObje
 /**
  * @brief Answer a new async message to post
  * @param cbType MqttVastCallbackTypes
- * @param argCount um of msg args for variadic function
+ * @param argCount num of msg args for variadic function (must be the arity of cbType)
  * @param ... msg args to post
- * @return EsMqttAsyncMessage* or NULL if
+ * @note An arrived message whose topic or message can not be copied is not
+ * created, so the callback returns 0 and Paho redelivers it
+ * @return EsMqttAsyncMessage* or NULL if invalid or out of memory
  */
 EsMqttAsyncMessage *EsMqttAsyncMessage_newInit(enum EsMqttVastCallbackTypes cbType, U_32 argCount, ...);
 
 /**
  * @brief Free the memory associated with the message
+ * @note The message block is recycled by the slab of its callback type
  * @param message
  */
 void EsMqttAsyncMessage_free(EsMqttAsyncMessage *message);
 
+/**
+ * @brief Read the message slab statistics for the callback type
+ * @note Used to tune the slab chunk size (occupancy and high-water mark)
+ * @param cbType MqttVastCallbackTypes
+ * @param stats[out] slab statistics
+ * @return TRUE if successful get, FALSE otherwise
+ */
+BOOLEAN EsMqttAsyncMessage_GetSlabStats(enum EsMqttVastCallbackTypes cbType, EsSlabStats *stats);
+
 /*******************************************/
 /*   A S Y N C  M E S S A G E  Q U E U E   */
 /*******************************************/
 
 /**
- * @brief Post the message to the VAST Async Queue
- * @note This can fail if the async queue is full or
- * Smalltalk has async disable (i.e. ST critical section)
+ * @brief Select where messages are posted to the VAST Async Queue
+ *
+ * Dispatcher (default): Paho threads only enqueue the message. A dedicated
+ * dispatcher thread posts it and retries failed posts with backoff, so the
+ * Paho network loop never stalls on Smalltalk (i.e. during a GC).
+ * Inline: The message is posted once on the Paho thread. A failed
+ * arrived-message post is reported to Paho, which redelivers it later.
+ *
+ * @note Should be set before callbacks are registered, messages already
+ * queued for the dispatcher may be posted after later inline messages.
+ * @param enabled TRUE for dispatcher, FALSE for inline
+ */
+void EsMqttAsyncMessage_SetDispatcher(BOOLEAN enabled);
+
+/**
+ * @brief Answer if messages are posted by the dispatcher thread
+ * @return TRUE if dispatcher, FALSE if inline
+ */
+BOOLEAN EsMqttAsyncMessage_IsDispatcher();
+
+/**
+ * @brief Configure batching of arrived messages
+ *
+ * When batching is enabled and a ESMQTT_CB_TYPE_MESSAGEBATCH target is
+ * registered, the dispatcher accumulates arrived messages into a
+ * EsMqttMessageBatch and posts one async message per batch.
+ * A batch is flushed when it holds maxCount messages, when its topic and
+ * payload bytes reach maxBytes, or when its oldest message is maxDelayUs old.
+ * It is also flushed before any other kind of message is posted, so
+ * callbacks are still seen by Smalltalk in the order Paho delivered them.
+ *
+ * @note Batching requires the dispatcher, inline posts are never batched
+ * @param maxCount messages per batch (0 or 1 disables batching)
+ * @param maxBytes topic and payload bytes per batch (0 for no limit)
+ * @param maxDelayUs microseconds a message may wait in a batch (checked in 1 ms steps)
+ * (0 flushes as soon as the dispatcher has nothing else queued)
+ * @return TRUE if configured, FALSE if an argument is out of range
+ */
+BOOLEAN EsMqttAsyncMessage_SetBatching(U_32 maxCount, U_32 maxBytes, U_32 maxDelayUs);
+
+/**
+ * @brief Answer if arrived messages are batched
+ * @return TRUE if batching is configured, FALSE otherwise
+ */
+BOOLEAN EsMqttAsyncMessage_IsBatching();
+
+/**
+ * @brief Configure flow control of arrived messages in dispatcher mode
+ *
+ * The number of queued (in-flight) messages and the failed posts are
+ * tracked so overload degrades gracefully instead of losing messages.
+ * Throttle: Past this many queued messages the Paho thread is slowed
+ * down briefly for each arrived message.
+ * Pause: Past this many queued messages, or while the vm async queue keeps
+ * failing posts, arrived messages are refused and Paho redelivers them later.
+ * Queued arrived messages are then retried until posted, since the queue is bounded.
+ *
+ * @param throttleMark number of queued messages (0 disables throttling)
+ * @param pauseMark number of queued messages (0 disables pausing)
+ * @return TRUE if configured, FALSE if a mark is out of range
+ */
+BOOLEAN EsMqttAsyncMessage_SetFlowControl(U_32 throttleMark, U_32 pauseMark);
+
+/**
+ * @brief Read the flow control statistics
+ * @param stats[out]
+ */
+void EsMqttAsyncMessage_GetFlowStats(EsMqttFlowStats *stats);
+
+/**
+ * @brief Hand off the message to be posted to the VAST Async Queue
+ * @note In dispatcher mode the message is posted from a separate work
+ * queue thread so the calling (Paho) thread is not blocked by the post.
+ * @see EsMqttAsyncMessage_SetDispatcher
+ * @note This takes ownership of the message which is freed
+ * after it is posted, or right away if it could not be queued.
+ * @note A pass-through arrived message adopts Paho's message and topic
+ * only if it is queued, filtered or dropped for matching no topic route.
+ * Otherwise Paho keeps them so the callback can return 0 and have the
+ * message redelivered.
+ * @note An arrived message may be refused by flow control
+ * (@see EsMqttAsyncMessage_SetFlowControl), dropped by its topic filter
+ * (@see EsMqttAsyncMessage_SetTopicFilter) or coalesced with a queued message
+ * (@see EsMqttAsyncMessage_SetTopicCoalescing)
  * @param message
- * @return TRUE if posted, FALSE otherwise (full queue)
+ * @return TRUE if queued (or posted inline, filtered, unrouted or coalesced), FALSE otherwise (i.e. module shutdown)
  */
 BOOLEAN EsMqttAsyncMessage_send(EsMqttAsyncMessage *message);
 
@@ -0,0 +1,403 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsMqttBulk.c
+ *  @brief Bulk Publish and Receive Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "plibsys.h"
+#include "MQTTClient.h"
+
+#include "EsMqttBulk.h"
+#include "EsMqttAsyncArguments.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Received message that did not fit into the buffer of a bulk receive
+ * @note Still owned by this module, freed with the Paho functions
+ */
+typedef struct _HeldMessage HeldMessage;
+struct _HeldMessage {
+    MQTTClient client;
+    char *topicName;
+    I_32 topicLen;
+    MQTTClient_message *message;
+    HeldMessage *next;
+};
+
+/*******************************************/
+/*   M O D U L E  P R I V A T E  V A R S   */
+/*******************************************/
+
+/**
+ * @brief Paho's MQTTClient_publishMessage() and MQTTClient_publishMessage5() or NULL
+ */
+static EsMqttPublishMessageFunc _PahoPublishMessage = NULL;
+static EsMqttPublishMessage5Func _PahoPublishMessage5 = NULL;
+
+/**
+ * @brief Paho functions that receive and free messages, or NULL
+ *
+ * The free functions are only ever replaced by other valid Paho
+ * functions, so held messages can always be freed.
+ */
+static EsMqttReceiveFunc _PahoReceive = NULL;
+static EsMqttFreeMessageFunc _PahoFreeMessage = NULL;
+static EsMqttFreeFunc _PahoFree = NULL;
+
+/**
+ * @brief Held messages, at most one per client
+ */
+static HeldMessage *_HeldMessages = NULL;
+static PMutex *_HeldMessagesLock = NULL;
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Answer the size of a record, including the padding to 4 bytes
+ * @param record
+ * @return size
+ */
+static U_SIZE getRecordSize(const EsMqttPublishRecord *record) {
+    return (sizeof(EsMqttPublishRecord) + (U_SIZE) record->topicLen + 1 + (U_SIZE) record->payloadLen + 3) & ~(U_SIZE) 3;
+}
+
+/**
+ * @brief Answer if the record is well-formed and lies within the remaining bytes
+ * @param record
+ * @param remaining number of bytes from the record to the end of the records
+ * @return TRUE if valid, FALSE otherwise
+ */
+static BOOLEAN isValidRecord(const EsMqttPublishRecord *record, U_SIZE remaining) {
+    const char *topic;
+
+    /* At least the header and the topic's null */
+    if (remaining <= sizeof(EsMqttPublishRecord)) {
+        return FALSE;
+    }
+    remaining -= sizeof(EsMqttPublishRecord);
+    /* Each length is capped first so their sum can not wrap on 32-bit */
+    if (record->topicLen == 0 || (U_SIZE) record->topicLen > remaining - 1 || record->payloadLen > 0x7FFFFFFFU
+        || (U_SIZE) record->payloadLen > remaining - 1 - (U_SIZE) record->topicLen) {
+        return FALSE;
+    }
+    topic = (const char *) (record + 1);
+    return (BOOLEAN) (topic[record->topicLen] == '\0');
+}
+
+/**
+ * @brief Answer the length of the received topic
+ * @note Non-0 len could be due to embedded nulls...so use that if != 0
+ * @param topicName
+ * @param topicLen as answered by Paho
+ * @return length in bytes
+ */
+static U_32 getTopicLength(const char *topicName, I_32 topicLen) {
+    return (topicLen > 0) ? (U_32) topicLen : (U_32) strlen(topicName);
+}
+
+/**
+ * @brief Answer the size of the receive record of the message
+ * @param topicName
+ * @param topicLen as answered by Paho
+ * @param message
+ * @return size (a multiple of 4)
+ */
+static U_SIZE getReceiveRecordSize(const char *topicName, I_32 topicLen, const MQTTClient_message *message) {
+    U_SIZE payloadLen = (message->payload != NULL && message->payloadlen > 0) ? (U_SIZE) message->payloadlen : 0;
+
+    return sizeof(EsMqttReceiveRecord)
+           + (((U_SIZE) getTopicLength(topicName, topicLen) + 1 + 3) & ~(U_SIZE) 3)
+           + EsPackedPropertiesSize(&message->properties)
+           + ((payloadLen + 3) & ~(U_SIZE) 3);
+}
+
+/**
+ * @brief Write the receive record of the message
+ * @param topicName
+ * @param topicLen as answered by Paho
+ * @param message
+ * @param dest[out] at least getReceiveRecordSize() bytes, 4-byte aligned
+ */
+static void writeReceiveRecord(const char *topicName, I_32 topicLen, const MQTTClient_message *message, U_8 *dest) {
+    EsMqttReceiveRecord record;
+    U_SIZE topicSize;
+    U_SIZE payloadSize;
+
+    record.topicLen = getTopicLength(topicName, topicLen);
+    record.propertiesLen = (U_32) EsPackedPropertiesSize(&message->properties);
+    record.payloadLen = (message->payload != NULL && message->payloadlen > 0) ? (U_32) message->payloadlen : 0;
+    record.qos = message->qos;
+    record.retained = message->retained;
+    record.dup = message->dup;
+    record.msgid = message->msgid;
+    memcpy(dest, &record, sizeof(record));
+    dest += sizeof(record);
+
+    topicSize = ((U_SIZE) record.topicLen + 1 + 3) & ~(U_SIZE) 3;
+    memcpy(dest, topicName, record.topicLen);
+    memset(dest + record.topicLen, 0, topicSize - record.topicLen);
+    dest += topicSize;
+
+    EsPackProperties(&message->properties, dest);
+    dest += record.propertiesLen;
+
+    payloadSize = ((U_SIZE) record.payloadLen + 3) & ~(U_SIZE) 3;
+    if (record.payloadLen > 0) {
+        memcpy(dest, message->payload, record.payloadLen);
+    }
+    memset(dest + record.payloadLen, 0, payloadSize - record.payloadLen);
+}
+
+/**
+ * @brief Give a received message back to Paho
+ * @param topicName
+ * @param message
+ */
+static void freeReceivedMessage(char *topicName, MQTTClient_message *message) {
+    EsMqttFreeMessageFunc freeMessage;
+    EsMqttFreeFunc freeFunc;
+
+    freeMessage = (EsMqttFreeMessageFunc) p_atomic_pointer_get((const volatile void *) &_PahoFreeMessage);
+    freeFunc = (EsMqttFreeFunc) p_atomic_pointer_get((const volatile void *) &_PahoFree);
+    if (message != NULL && freeMessage != NULL) {
+        freeMessage(&message);
+    }
+    if (topicName != NULL && freeFunc != NULL) {
+        freeFunc(topicName);
+    }
+}
+
+/**
+ * @brief Remove and answer the held message of the client
+ * @note Caller must hold _HeldMessagesLock
+ * @param client
+ * @return held message or NULL if none
+ */
+static HeldMessage *takeHeldMessage(MQTTClient client) {
+    HeldMessage **link;
+    HeldMessage *held;
+
+    for (link = &_HeldMessages; *link != NULL; link = &(*link)->next) {
+        if ((*link)->client == client) {
+            held = *link;
+            *link = held->next;
+            return held;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Hold the received message for the next bulk receive of the client
+ * @note The message is given back to Paho if it can not be held
+ * @param client
+ * @param topicName
+ * @param topicLen
+ * @param message
+ */
+static void holdMessage(MQTTClient client, char *topicName, I_32 topicLen, MQTTClient_message *message) {
+    HeldMessage *held;
+
+    held = (HeldMessage *) malloc(sizeof(HeldMessage));
+    if (held == NULL) {
+        freeReceivedMessage(topicName, message);
+        return;
+    }
+    held->client = client;
+    held->topicName = topicName;
+    held->topicLen = topicLen;
+    held->message = message;
+
+    /* LOCK */
+    p_mutex_lock(_HeldMessagesLock);
+    held->next = _HeldMessages;
+    _HeldMessages = held;
+    p_mutex_unlock(_HeldMessagesLock);
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+void EsMqttBulk_ModuleInit(EsGlobalInfo *globalInfo) {
+    ES_UNUSED(globalInfo);
+
+    _HeldMessagesLock = p_mutex_new();
+}
+
+void EsMqttBulk_ModuleShutdown() {
+    HeldMessage *held;
+
+    p_atomic_pointer_set((volatile void *) &_PahoPublishMessage, NULL);
+    p_atomic_pointer_set((volatile void *) &_PahoPublishMessage5, NULL);
+    p_atomic_pointer_set((volatile void *) &_PahoReceive, NULL);
+    while (_HeldMessages != NULL) {
+        held = _HeldMessages;
+        _HeldMessages = held->next;
+        freeReceivedMessage(held->topicName, held->message);
+        free(held);
+    }
+    p_mutex_free(_HeldMessagesLock);
+    _HeldMessagesLock = NULL;
+}
+
+void EsMqttBulk_SetPublishFunc(EsMqttPublishMessageFunc publishMessageFunc) {
+    p_atomic_pointer_set((volatile void *) &_PahoPublishMessage, (void *) publishMessageFunc);
+}
+
+void EsMqttBulk_SetPublish5Func(EsMqttPublishMessage5Func publishMessage5Func) {
+    p_atomic_pointer_set((volatile void *) &_PahoPublishMessage5, (void *) publishMessage5Func);
+}
+
+U_32 EsMqttBulk_Publish(MQTTClient client, const void *records, U_32 recordsSize, U_32 count, I_32 *tokens) {
+    EsMqttPublishMessageFunc publishMessage;
+    EsMqttPublishMessage5Func publishMessage5;
+    MQTTResponse response;
+    const EsMqttPublishRecord *record;
+    const U_8 *position = (const U_8 *) records;
+    const U_8 *end = position + recordsSize;
+    MQTTClient_message message = MQTTClient_message_initializer;
+    MQTTClient_deliveryToken token;
+    U_32 i;
+    I_32 rc;
+
+    publishMessage = (EsMqttPublishMessageFunc) p_atomic_pointer_get((const volatile void *) &_PahoPublishMessage);
+    publishMessage5 = (EsMqttPublishMessage5Func) p_atomic_pointer_get((const volatile void *) &_PahoPublishMessage5);
+    if ((publishMessage == NULL && publishMessage5 == NULL) || records == NULL || tokens == NULL
+        || ((U_PTR) records & 3) != 0 || ((U_PTR) tokens & 3) != 0) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        record = (const EsMqttPublishRecord *) position;
+        if (!isValidRecord(record, (U_SIZE) (end - position))) {
+            break;
+        }
+        /* Paho only reads the payload, the message is set up again for each record */
+        message.payload = (void *) ((const char *) (record + 1) + record->topicLen + 1);
+        message.payloadlen = (int) record->payloadLen;
+        message.qos = record->qos;
+        message.retained = record->retained;
+        token = 0;
+        rc = MQTTCLIENT_WRONG_MQTT_VERSION;
+        if (publishMessage != NULL) {
+            rc = publishMessage(client, (const char *) (record + 1), &message, &token);
+        }
+        if (rc == MQTTCLIENT_WRONG_MQTT_VERSION && publishMessage5 != NULL) {
+            /* MQTT v5 client: the rest of the records go the v5 way too */
+            publishMessage = NULL;
+            response = publishMessage5(client, (const char *) (record + 1), &message, &token);
+            rc = (I_32) response.reasonCode;
+        }
+        tokens[i] = (rc == MQTTCLIENT_SUCCESS) ? (I_32) token : rc;
+
+        /* The last record may end without its padding */
+        if (getRecordSize(record) >= (U_SIZE) (end - position)) {
+            position = end;
+        } else {
+            position += getRecordSize(record);
+        }
+    }
+    return i;
+}
+
+BOOLEAN EsMqttBulk_SetReceiveFuncs(EsMqttReceiveFunc receiveFunc, EsMqttFreeMessageFunc freeMessageFunc,
+                                   EsMqttFreeFunc freeFunc) {
+    if (receiveFunc != NULL && freeMessageFunc != NULL && freeFunc != NULL) {
+        p_atomic_pointer_set((volatile void *) &_PahoFreeMessage, (void *) freeMessageFunc);
+        p_atomic_pointer_set((volatile void *) &_PahoFree, (void *) freeFunc);
+        p_atomic_pointer_set((volatile void *) &_PahoReceive, (void *) receiveFunc);
+        return TRUE;
+    }
+    p_atomic_pointer_set((volatile void *) &_PahoReceive, NULL);
+    return FALSE;
+}
+
+U_32 EsMqttBulk_Receive(MQTTClient client, void *buffer, U_32 bufferSize, U_32 offset, U_32 maxCount,
+                        U_32 timeoutMs, I_32 *rc) {
+    EsMqttReceiveFunc receive;
+    HeldMessage *held;
+    char *topicName;
+    I_32 topicLen;
+    MQTTClient_message *message;
+    U_SIZE size;
+    U_32 position = offset;
+    U_32 count = 0;
+    I_32 result = MQTTCLIENT_SUCCESS;
+
+    receive = (EsMqttReceiveFunc) p_atomic_pointer_get((const volatile void *) &_PahoReceive);
+    if (receive == NULL || buffer == NULL || offset > bufferSize || (offset & 3) != 0) {
+        result = MQTTCLIENT_FAILURE;
+        maxCount = 0;
+    }
+
+    /* LOCK */
+    p_mutex_lock(_HeldMessagesLock);
+    held = (maxCount > 0) ? takeHeldMessage(client) : NULL;
+    p_mutex_unlock(_HeldMessagesLock);
+
+    while (count < maxCount) {
+        if (held != NULL) {
+            topicName = held->topicName;
+            topicLen = held->topicLen;
+            message = held->message;
+            free(held);
+            held = NULL;
+        } else {
+            /* Only wait for the first message, then take the ones that are ready */
+            topicName = NULL;
+            topicLen = 0;
+            message = NULL;
+            result = receive(client, &topicName, &topicLen, &message, (count == 0) ? timeoutMs : 0);
+            if (result == MQTTCLIENT_TOPICNAME_TRUNCATED) {
+                result = MQTTCLIENT_SUCCESS;
+            }
+            if (result != MQTTCLIENT_SUCCESS || message == NULL) {
+                freeReceivedMessage(topicName, message);
+                break;
+            }
+        }
+
+        size = getReceiveRecordSize(topicName, topicLen, message);
+        if (size > bufferSize - position) {
+            holdMessage(client, topicName, topicLen, message);
+            break;
+        }
+        writeReceiveRecord(topicName, topicLen, message, (U_8 *) buffer + position);
+        freeReceivedMessage(topicName, message);
+        position += (U_32) size;
+        count++;
+    }
+
+    if (rc != NULL) {
+        *rc = result;
+    }
+    return position;
+}
+
+U_32 EsMqttBulk_GetHeldSize(MQTTClient client) {
+    HeldMessage *held;
+    U_32 size = 0;
+
+    /* LOCK */
+    p_mutex_lock(_HeldMessagesLock);
+    for (held = _HeldMessages; held != NULL; held = held->next) {
+        if (held->client == client) {
+            size = (U_32) getReceiveRecordSize(held->topicName, held->topicLen, held->message);
+            break;
+        }
+    }
+    p_mutex_unlock(_HeldMessagesLock);
+    return size;
+}
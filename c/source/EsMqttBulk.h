@@ -0,0 +1,202 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsMqttBulk.h
+ *  @brief Bulk Publish and Receive Interface
+ *  @author Seth Berman
+ *
+ *  Publishing or receiving a message from Smalltalk is one FFI call into Paho,
+ *  with its argument marshalling, for each message. This module publishes a
+ *  whole vector of messages, packed by Smalltalk into one buffer, and receives
+ *  many messages into one buffer, each in a single user-prim call.
+ *
+ *  Since this library does not link against Paho itself, Smalltalk supplies
+ *  Paho's MQTTClient_publishMessage() (for MQTT v3 clients) and/or
+ *  MQTTClient_publishMessage5() (for MQTT v5 clients) once before publishing
+ *  in bulk, and MQTTClient_receive(), MQTTClient_freeMessage() and
+ *  MQTTClient_free() once before receiving in bulk.
+ *
+ *  Publish Records:
+ *  Records are packed back-to-back into a 4-byte aligned buffer, each one
+ *  starts on a 4-byte boundary and is laid out as
+ *  U_32 topicLen (of the topic in bytes, without the null)
+ *  U_32 payloadLen (of the payload in bytes)
+ *  I_32 qos
+ *  I_32 retained
+ *  char topic[topicLen + 1] (null-terminated)
+ *  U_8 payload[payloadLen]
+ *
+ *  Tokens:
+ *  For each record an I_32 is written to the tokens array. It is the delivery
+ *  token (>= 0) if Paho accepted the message, or Paho's negative return code
+ *  (i.e. MQTTCLIENT_DISCONNECTED) if it did not.
+ *  Messages of MQTT v5 clients are published without properties.
+ *
+ *  Receive Records:
+ *  Received messages are written back-to-back into the caller's buffer,
+ *  each one starts on a 4-byte boundary and is laid out as
+ *  U_32 topicLen (of the topic in bytes, without the null)
+ *  U_32 propertiesLen (of the packed properties in bytes, @see EsPackProperties)
+ *  U_32 payloadLen (of the payload in bytes)
+ *  I_32 qos
+ *  I_32 retained
+ *  I_32 dup
+ *  I_32 msgid
+ *  char topic[topicLen + 1] (null-terminated, zero-padded to 4)
+ *  U_8 properties[propertiesLen]
+ *  U_8 payload[payloadLen] (zero-padded to 4)
+ *
+ *  A received message that does not fit into the rest of the buffer is held
+ *  natively and written first by the next bulk receive of its client. Receiving
+ *  only works for clients without a messageArrived callback (a Paho rule).
+ *******************************************************************************/
+#ifndef ES_MQTT_BULK_H
+#define ES_MQTT_BULK_H
+
+#include "MQTTClient.h"
+
+#include "EsMqtt.h"
+#include "EsMqttAsyncArguments.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Paho's MQTTClient_publishMessage() signature
+ */
+typedef int (*EsMqttPublishMessageFunc)(MQTTClient handle, const char *topicName, MQTTClient_message *msg,
+                                        MQTTClient_deliveryToken *dt);
+
+/**
+ * @brief Paho's MQTTClient_publishMessage5() signature
+ * @note The response of a publish holds no allocated data (only its reasonCode is set)
+ */
+typedef MQTTResponse (*EsMqttPublishMessage5Func)(MQTTClient handle, const char *topicName, MQTTClient_message *msg,
+                                                  MQTTClient_deliveryToken *dt);
+
+/**
+ * @brief Paho's MQTTClient_receive() signature
+ */
+typedef int (*EsMqttReceiveFunc)(MQTTClient handle, char **topicName, int *topicLen, MQTTClient_message **message,
+                                 unsigned long timeout);
+
+/**
+ * @brief Header of a publish record
+ * @note This layout is written by the Smalltalk image
+ */
+typedef struct _EsMqttPublishRecord EsMqttPublishRecord;
+struct _EsMqttPublishRecord {
+    U_32 topicLen;
+    U_32 payloadLen;
+    I_32 qos;
+    I_32 retained;
+};
+
+/**
+ * @brief Header of a receive record
+ * @note This layout is read from the Smalltalk image
+ */
+typedef struct _EsMqttReceiveRecord EsMqttReceiveRecord;
+struct _EsMqttReceiveRecord {
+    U_32 topicLen;
+    U_32 propertiesLen;
+    U_32 payloadLen;
+    I_32 qos;
+    I_32 retained;
+    I_32 dup;
+    I_32 msgid;
+};
+
+/***********************************/
+/*   S E T U P / S H U T D O W N   */
+/***********************************/
+
+/**
+ * @brief Initialize the library modules, if necessary
+ * @param EsGlobalInfo
+ */
+void EsMqttBulk_ModuleInit(EsGlobalInfo *globalInfo);
+
+/**
+ * @brief Destruct and clear library module state
+ */
+void EsMqttBulk_ModuleShutdown();
+
+/************************************/
+/*   B U L K  P U B L I S H I N G   */
+/************************************/
+
+/**
+ * @brief Supply the Paho function that publishes a message
+ * @param publishMessageFunc Paho's MQTTClient_publishMessage() or NULL to disable bulk publishing
+ */
+void EsMqttBulk_SetPublishFunc(EsMqttPublishMessageFunc publishMessageFunc);
+
+/**
+ * @brief Supply the Paho function that publishes a message of an MQTT v5 client
+ * @note It is used for the clients that MQTTClient_publishMessage() refuses
+ * with MQTTCLIENT_WRONG_MQTT_VERSION (or if that one is not supplied)
+ * @param publishMessage5Func Paho's MQTTClient_publishMessage5() or NULL
+ */
+void EsMqttBulk_SetPublish5Func(EsMqttPublishMessage5Func publishMessage5Func);
+
+/**
+ * @brief Publish the packed records in order
+ * @note Paho copies what it keeps of each message, so the records
+ * can be reused once this returns
+ * @param client Paho MQTTClient handle
+ * @param records packed publish records (4-byte aligned)
+ * @param recordsSize number of bytes of the records
+ * @param count number of records to publish
+ * @param tokens[out] one token (or negative return code) per record (4-byte aligned)
+ * @return number of records processed, less than count if a record is malformed
+ * or runs past recordsSize (0 if there is no publish function or a buffer is misaligned)
+ */
+U_32 EsMqttBulk_Publish(MQTTClient client, const void *records, U_32 recordsSize, U_32 count, I_32 *tokens);
+
+/**********************************/
+/*   B U L K  R E C E I V I N G   */
+/**********************************/
+
+/**
+ * @brief Supply the Paho functions that receive and free messages
+ * @note Bulk receiving is enabled if all functions are supplied
+ * @param receiveFunc Paho's MQTTClient_receive() or NULL
+ * @param freeMessageFunc Paho's MQTTClient_freeMessage() or NULL
+ * @param freeFunc Paho's MQTTClient_free() or NULL
+ * @return TRUE if bulk receiving is enabled, FALSE otherwise
+ */
+BOOLEAN EsMqttBulk_SetReceiveFuncs(EsMqttReceiveFunc receiveFunc, EsMqttFreeMessageFunc freeMessageFunc,
+                                   EsMqttFreeFunc freeFunc);
+
+/**
+ * @brief Receive up to maxCount messages of the client into the buffer
+ *
+ * Waits up to timeoutMs for the first message, then only takes the
+ * messages that are ready. Each message is copied into a receive record
+ * and given back to Paho.
+ *
+ * @param client Paho MQTTClient handle
+ * @param buffer destination of the records
+ * @param bufferSize number of bytes of the buffer
+ * @param offset where the first record is written (4-byte aligned)
+ * @param maxCount max number of records to write
+ * @param timeoutMs max milliseconds to wait for the first message
+ * @param rc[out] MQTTCLIENT_SUCCESS or Paho's return code of a failed receive
+ * @return offset after the last record written (offset if none)
+ */
+U_32 EsMqttBulk_Receive(MQTTClient client, void *buffer, U_32 bufferSize, U_32 offset, U_32 maxCount,
+                        U_32 timeoutMs, I_32 *rc);
+
+/**
+ * @brief Answer the size of the record of the client's held message
+ * @note A held message is one that did not fit into the buffer of a bulk receive
+ * @param client Paho MQTTClient handle
+ * @return record size in bytes, 0 if no message is held
+ */
+U_32 EsMqttBulk_GetHeldSize(MQTTClient client);
+
+#endif //ES_MQTT_BULK_H
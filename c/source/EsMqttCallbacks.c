@@ -9,9 +9,11 @@
  *******************************************************************************/
 #include "plibsys.h"
 #include "MQTTClient.h"
+#include "MQTTAsync.h"
 
 #include "EsMqttCallbacks.h"
 #include "EsMqttAsyncMessages.h"
+#include "EsMqttTrace.h"
 
 /***************************/
 /*   P R O T O T Y P E S   */
@@ -81,6 +83,38 @@ static void publishedCallback(void *context, I_32 dt, I_32 packet_type, MQTTProp
  */
 static void dummyCheckpointCallback(I_32 id);
 
+/**
+ * @brief MQTT Paho MQTTAsync.h callback when a request (i.e. send) completed successfully
+ * @see MQTTAsync_onSuccess
+ * @param context
+ * @param response may be NULL (i.e. disconnect)
+ */
+static void onSuccessCallback(void *context, MQTTAsync_successData *response);
+
+/**
+ * @brief MQTT Paho MQTTAsync.h callback when a connect request completed successfully
+ * @see MQTTAsync_onSuccess
+ * @param context
+ * @param response
+ */
+static void onConnectCallback(void *context, MQTTAsync_successData *response);
+
+/**
+ * @brief MQTT Paho MQTTAsync.h callback when a subscribe request completed successfully
+ * @see MQTTAsync_onSuccess
+ * @param context
+ * @param response
+ */
+static void onSubscribeCallback(void *context, MQTTAsync_successData *response);
+
+/**
+ * @brief MQTT Paho MQTTAsync.h callback when a request failed
+ * @see MQTTAsync_onFailure
+ * @param context
+ * @param response may be NULL (i.e. connect timeout)
+ */
+static void onFailureCallback(void *context, MQTTAsync_failureData *response);
+
 /*******************************************/
 /*   M O D U L E  P R I V A T E  V A R S   */
 /*******************************************/
@@ -98,7 +132,12 @@ static void *_CallbackTargets[NUM_MQTT_CALLBACKS] = {
         messageArrivedCallback,
         deliveryCompleteCallback,
         publishedCallback,
-        dummyCheckpointCallback
+        dummyCheckpointCallback,
+        messageArrivedCallback, /* batches are filled from arrived messages */
+        onSuccessCallback,
+        onConnectCallback,
+        onSubscribeCallback,
+        onFailureCallback
 };
 
 /*********************/
@@ -134,6 +173,10 @@ static BOOLEAN getCallbackTarget(enum EsMqttVastCallbackTypes cbType, void **tar
 static void traceCallback(I_32 level, char *message) {
     EsMqttAsyncMessage *msg = NULL;
 
+    /* Filtered or recorded natively, nothing to post */
+    if (EsMqttTrace_Record(level, message)) {
+        return;
+    }
     msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_TRACE, 2, level, message);
     if (msg != NULL) {
         EsMqttAsyncMessage_send(msg);
@@ -152,7 +195,7 @@ static void connectionLostCallback(void *context, char *cause) {
 static void disconnectedCallback(void *context, MQTTProperties *properties, enum MQTTReasonCodes reasonCode) {
     EsMqttAsyncMessage *msg = NULL;
 
-    msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_DISCONNECTED, 3, context, context, properties, reasonCode);
+    msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_DISCONNECTED, 3, context, properties, reasonCode);
     if (msg != NULL) {
         EsMqttAsyncMessage_send(msg);
     }
@@ -192,6 +235,56 @@ static void dummyCheckpointCallback(I_32 id) {
     ES_UNUSED(id);
 }
 
+static void onSuccessCallback(void *context, MQTTAsync_successData *response) {
+    EsMqttAsyncMessage *msg = NULL;
+    MQTTAsync_token token = (response != NULL) ? response->token : 0;
+
+    msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_ONSUCCESS, 2, context, token);
+    if (msg != NULL) {
+        EsMqttAsyncMessage_send(msg);
+    }
+}
+
+static void onConnectCallback(void *context, MQTTAsync_successData *response) {
+    EsMqttAsyncMessage *msg = NULL;
+
+    if (response == NULL) {
+        msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_ONCONNECT, 5, context, 0, 0, 0, NULL);
+    } else {
+        msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_ONCONNECT, 5, context, response->token,
+                                         response->alt.connect.MQTTVersion, response->alt.connect.sessionPresent,
+                                         response->alt.connect.serverURI);
+    }
+    if (msg != NULL) {
+        EsMqttAsyncMessage_send(msg);
+    }
+}
+
+static void onSubscribeCallback(void *context, MQTTAsync_successData *response) {
+    EsMqttAsyncMessage *msg = NULL;
+    MQTTAsync_token token = (response != NULL) ? response->token : 0;
+    I_32 qos = (response != NULL) ? response->alt.qos : 0;
+
+    msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_ONSUBSCRIBE, 3, context, token, qos);
+    if (msg != NULL) {
+        EsMqttAsyncMessage_send(msg);
+    }
+}
+
+static void onFailureCallback(void *context, MQTTAsync_failureData *response) {
+    EsMqttAsyncMessage *msg = NULL;
+
+    if (response == NULL) {
+        msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_ONFAILURE, 4, context, 0, MQTTASYNC_FAILURE, NULL);
+    } else {
+        msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_ONFAILURE, 4, context, response->token, response->code,
+                                         response->message);
+    }
+    if (msg != NULL) {
+        EsMqttAsyncMessage_send(msg);
+    }
+}
+
 /******************************************************/
 /*   I N T E R F A C E  I M P L E M E N T A T I O N   */
 /******************************************************/
@@ -29,6 +29,23 @@
  *
  *  The answer to fix this is the Smalltalk Asynchronous Queue
  *  @see EsMqttAsyncQueueMessages.h for a discussion on how this works
+ *
+ *  MQTTAsync:
+ *  Besides the MQTTClient callbacks, this module provides the onSuccess and
+ *  onFailure callbacks of Paho's MQTTAsync API (MQTTAsync_responseOptions).
+ *  With these a publish, subscribe or connect call returns right away and its
+ *  completion is posted later through the same async message machinery, so
+ *  Smalltalk can keep many requests in flight without blocking a call engine
+ *  thread for each. The response data only lives for the duration of the
+ *  callback, so its fields are copied into the async message.
+ *  The success response is a union whose meaning depends on the request,
+ *  so there is a success callback for each kind of request:
+ *  - onConnect: connect
+ *  - onSubscribe: subscribe (single topic)
+ *  - onSuccess: any other request (i.e. send, unsubscribe, disconnect)
+ *  MQTTAsync_setCallbacks() takes the same connectionLost, messageArrived and
+ *  deliveryComplete callbacks as MQTTClient, since MQTTAsync_message and
+ *  MQTTAsync_token have the same layout as their MQTTClient counterparts.
  *******************************************************************************/
 #ifndef ES_MQTT_CALLBACKS_H
 #define ES_MQTT_CALLBACKS_H
@@ -47,7 +64,7 @@
  * must also be reflected in smalltalk
  */
 #define MIN_MQTT_CALLBACKS          0
-#define NUM_MQTT_CALLBACKS          7
+#define NUM_MQTT_CALLBACKS          12
 enum EsMqttVastCallbackTypes {
     ESMQTT_CB_TYPE_TRACE = MIN_MQTT_CALLBACKS,
     ESMQTT_CB_TYPE_CONNECTIONLOST,
@@ -55,7 +72,12 @@ enum EsMqttVastCallbackTypes {
     ESMQTT_CB_TYPE_MESSAGEARRIVED,
     ESMQTT_CB_TYPE_DELIVERYCOMPLETE,
     ESMQTT_CB_TYPE_PUBLISHED,
-    ESMQTT_CB_TYPE_CHECKPOINT
+    ESMQTT_CB_TYPE_CHECKPOINT,
+    ESMQTT_CB_TYPE_MESSAGEBATCH,
+    ESMQTT_CB_TYPE_ONSUCCESS,
+    ESMQTT_CB_TYPE_ONCONNECT,
+    ESMQTT_CB_TYPE_ONSUBSCRIBE,
+    ESMQTT_CB_TYPE_ONFAILURE
 };
 
 /***********************************/
@@ -14,6 +14,8 @@
 #include "EsMqttCallbacks.h"
 #include "EsMqttAsyncMessages.h"
 #include "EsMqttAsyncArguments.h"
+#include "EsMqttTrace.h"
+#include "EsMqttBulk.h"
 
 /*******************************************/
 /*   M O D U L E  P R I V A T E  V A R S   */
@@ -33,6 +35,8 @@ void EsMqttLibraryInit(EsGlobalInfo *globalInfo) {
         p_libsys_init();
         EsMqttAsyncArguments_ModuleInit(globalInfo);
         EsMqttAsyncMessages_ModuleInit(globalInfo);
+        EsMqttTrace_ModuleInit(globalInfo);
+        EsMqttBulk_ModuleInit(globalInfo);
         EsMqttCallbacks_ModuleInit(globalInfo);
     }
 }
@@ -41,6 +45,8 @@ void EsMqttLibraryShutdown() {
     if (p_atomic_int_compare_and_exchange(&_State, ESMQTT_LIBRARY_INIT, ESMQTT_LIBRARY_SHUTDOWN)) {
         EsMqttAsyncArguments_ModuleShutdown();
         EsMqttAsyncMessages_ModuleShutdown();
+        EsMqttTrace_ModuleShutdown();
+        EsMqttBulk_ModuleShutdown();
         EsMqttCallbacks_ModuleShutdown();
         p_libsys_shutdown();
     }
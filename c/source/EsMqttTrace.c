@@ -0,0 +1,225 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsMqttTrace.c
+ *  @brief Native Trace Filter and Trace Ring Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stddef.h>
+#include <string.h>
+
+#include "plibsys.h"
+
+#include "EsMqttTrace.h"
+#include "EsRing.h"
+#include "EsEpoch.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Trace record as it is kept in the ring
+ * @note Only the header and the used text bytes are pushed
+ */
+typedef struct _TraceRecord TraceRecord;
+struct _TraceRecord {
+    I_32 level;
+    U_32 length;
+    char text[ESMQTT_TRACE_MAX_TEXT];
+};
+
+/**
+ * @brief Size of the record header (level and length)
+ */
+#define TRACE_RECORD_HEADER_SIZE    ((U_32) offsetof(TraceRecord, text))
+
+/*******************************************/
+/*   M O D U L E  P R I V A T E  V A R S   */
+/*******************************************/
+
+/**
+ * @brief Lowest trace level that is kept
+ */
+static volatile I_32 _TraceMinLevel = 0;
+
+/**
+ * @brief Ring of trace records or NULL if trace lines are posted
+ *
+ * Paho threads push to the ring in an epoch critical section,
+ * so a replaced ring is only freed once no thread can still push to it.
+ */
+static EsRing *volatile _TraceRing = NULL;
+static EsEpoch *_TraceRingEpoch = NULL;
+
+/**
+ * @brief Serializes the drains (the single ring consumer) and ring replacements
+ */
+static PMutex *_TraceRingLock = NULL;
+
+/**
+ * @brief Trace counters (@see EsMqttTraceStats)
+ */
+static volatile I_32 _NumRecorded = 0;
+static volatile I_32 _NumDropped = 0;
+static volatile I_32 _NumFiltered = 0;
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Push the trace line to the ring
+ * @param ring
+ * @param level
+ * @param text null-terminated (may be NULL)
+ * @return TRUE if pushed, FALSE if the ring is full
+ */
+static BOOLEAN pushTraceRecord(EsRing *ring, I_32 level, const char *text) {
+    TraceRecord record;
+    U_SIZE length;
+
+    length = (text != NULL) ? strlen(text) : 0;
+    if (length > ESMQTT_TRACE_MAX_TEXT) {
+        length = ESMQTT_TRACE_MAX_TEXT;
+    }
+    record.level = level;
+    record.length = (U_32) length;
+    if (length > 0) {
+        memcpy(record.text, text, length);
+    }
+    return EsRing_push(ring, &record, TRACE_RECORD_HEADER_SIZE + (U_32) length);
+}
+
+/**
+ * @brief Answer the size of a drained record, including the padding to 4 bytes
+ * @param record
+ * @return size
+ */
+static U_32 getDrainedSize(const TraceRecord *record) {
+    return (TRACE_RECORD_HEADER_SIZE + record->length + 3) & ~3U;
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+void EsMqttTrace_ModuleInit(EsGlobalInfo *globalInfo) {
+    ES_UNUSED(globalInfo);
+
+    p_atomic_int_set(&_TraceMinLevel, 0);
+    _TraceRingEpoch = EsEpoch_new();
+    _TraceRingLock = p_mutex_new();
+}
+
+void EsMqttTrace_ModuleShutdown() {
+    EsRing *ring;
+
+    /* LOCK */
+    p_mutex_lock(_TraceRingLock);
+    ring = (EsRing *) p_atomic_pointer_get(&_TraceRing);
+    p_atomic_pointer_set(&_TraceRing, NULL);
+    /* Wait out a producer that is still pushing to the ring */
+    EsEpoch_synchronize(_TraceRingEpoch);
+    p_mutex_unlock(_TraceRingLock);
+
+    EsRing_free(ring);
+    EsEpoch_free(_TraceRingEpoch);
+    _TraceRingEpoch = NULL;
+    p_mutex_free(_TraceRingLock);
+    _TraceRingLock = NULL;
+}
+
+BOOLEAN EsMqttTrace_SetTracing(I_32 minLevel, U_32 ringCapacity) {
+    EsRing *newRing = NULL;
+    EsRing *oldRing;
+
+    if (ringCapacity > ESMQTT_TRACE_MAX_RING_CAPACITY) {
+        return FALSE;
+    }
+    if (ringCapacity > 0) {
+        newRing = EsRing_new(ringCapacity, (U_32) sizeof(TraceRecord));
+        if (newRing == NULL) {
+            return FALSE;
+        }
+    }
+
+    p_atomic_int_set(&_TraceMinLevel, minLevel);
+
+    /* LOCK */
+    p_mutex_lock(_TraceRingLock);
+    oldRing = (EsRing *) p_atomic_pointer_get(&_TraceRing);
+    p_atomic_pointer_set(&_TraceRing, newRing);
+    /* Wait out the producers of the old ring before freeing it */
+    EsEpoch_synchronize(_TraceRingEpoch);
+    p_mutex_unlock(_TraceRingLock);
+
+    EsRing_free(oldRing);
+    return TRUE;
+}
+
+BOOLEAN EsMqttTrace_Record(I_32 level, const char *text) {
+    EsRing *ring;
+    BOOLEAN pushed;
+
+    if (level < p_atomic_int_get(&_TraceMinLevel)) {
+        p_atomic_int_inc(&_NumFiltered);
+        return TRUE;
+    }
+    if (p_atomic_pointer_get(&_TraceRing) == NULL || !EsEpoch_enter(_TraceRingEpoch)) {
+        return FALSE;
+    }
+
+    ring = (EsRing *) p_atomic_pointer_get(&_TraceRing);
+    if (ring == NULL) {
+        EsEpoch_exit(_TraceRingEpoch);
+        return FALSE;
+    }
+    pushed = pushTraceRecord(ring, level, text);
+    EsEpoch_exit(_TraceRingEpoch);
+
+    p_atomic_int_inc(pushed ? &_NumRecorded : &_NumDropped);
+    return TRUE;
+}
+
+U_32 EsMqttTrace_Drain(void *buffer, U_32 bufferSize) {
+    const TraceRecord *record;
+    EsRing *ring;
+    U_8 *dest = (U_8 *) buffer;
+    U_32 offset = 0;
+    U_32 numRecords = 0;
+    U_32 size;
+
+    if (buffer == NULL) {
+        return 0;
+    }
+
+    /* LOCK */
+    p_mutex_lock(_TraceRingLock);
+    ring = (EsRing *) p_atomic_pointer_get(&_TraceRing);
+    while (ring != NULL && (record = (const TraceRecord *) EsRing_peek(ring)) != NULL) {
+        size = getDrainedSize(record);
+        if (size > bufferSize - offset) {
+            break;
+        }
+        memcpy(dest + offset, record, TRACE_RECORD_HEADER_SIZE + record->length);
+        memset(dest + offset + TRACE_RECORD_HEADER_SIZE + record->length, 0,
+               size - TRACE_RECORD_HEADER_SIZE - record->length);
+        offset += size;
+        numRecords++;
+        EsRing_pop(ring);
+    }
+    p_mutex_unlock(_TraceRingLock);
+    return numRecords;
+}
+
+void EsMqttTrace_GetStats(EsMqttTraceStats *stats) {
+    if (stats == NULL) {
+        return;
+    }
+    stats->numRecorded = (U_32) p_atomic_int_get(&_NumRecorded);
+    stats->numDropped = (U_32) p_atomic_int_get(&_NumDropped);
+    stats->numFiltered = (U_32) p_atomic_int_get(&_NumFiltered);
+}
@@ -0,0 +1,121 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsMqttTrace.h
+ *  @brief Native Trace Filter and Trace Ring Interface
+ *  @author Seth Berman
+ *
+ *  By default every Paho trace line is copied and posted to Smalltalk as
+ *  a trace async message. This module lets trace lines be handled natively
+ *  before that happens, so tracing can stay on at little cost.
+ *
+ *  Minimum Level:
+ *  Trace lines below the minimum level (Paho's MQTTCLIENT_TRACE_LEVELS)
+ *  are dropped in C.
+ *
+ *  Trace Ring:
+ *  If the ring is enabled, trace lines are recorded into a lock-free ring
+ *  (@see EsRing.h) instead of being posted, and Smalltalk drains them in
+ *  bulk. If the ring is full, the newest lines are dropped and counted.
+ *  Lines longer than ESMQTT_TRACE_MAX_TEXT bytes are truncated.
+ *
+ *  Drained Records:
+ *  Records are written back-to-back into the caller's buffer, each one
+ *  starts on a 4-byte boundary and is laid out as
+ *  I_32 level
+ *  U_32 length (of the text in bytes)
+ *  char text[length] (not null-terminated)
+ *******************************************************************************/
+#ifndef ES_MQTT_TRACE_H
+#define ES_MQTT_TRACE_H
+
+#include "EsMqtt.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Upper bound of the text bytes of a trace record
+ */
+#define ESMQTT_TRACE_MAX_TEXT           248
+
+/**
+ * @brief Upper bound of the trace ring capacity (number of records)
+ */
+#define ESMQTT_TRACE_MAX_RING_CAPACITY  65536
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Trace statistics
+ * @note Counters wrap around, compare two reads for a rate
+ *
+ * numRecorded: Trace lines recorded into the ring
+ * numDropped: Trace lines dropped since the ring was full
+ * numFiltered: Trace lines dropped since they were below the minimum level
+ */
+typedef struct _EsMqttTraceStats EsMqttTraceStats;
+struct _EsMqttTraceStats {
+    U_32 numRecorded;
+    U_32 numDropped;
+    U_32 numFiltered;
+};
+
+/***********************************/
+/*   S E T U P / S H U T D O W N   */
+/***********************************/
+
+/**
+ * @brief Initialize the library modules, if necessary
+ * @param EsGlobalInfo
+ */
+void EsMqttTrace_ModuleInit(EsGlobalInfo *globalInfo);
+
+/**
+ * @brief Destruct and clear library module state
+ */
+void EsMqttTrace_ModuleShutdown();
+
+/*********************/
+/*   T R A C I N G   */
+/*********************/
+
+/**
+ * @brief Configure the native handling of trace lines
+ * @note Records of a previous ring that were not drained are discarded
+ * @param minLevel lowest trace level that is kept (0 keeps all)
+ * @param ringCapacity number of records of the ring (0 to post trace lines instead)
+ * @return TRUE if configured, FALSE if the capacity is out of range or out of memory
+ */
+BOOLEAN EsMqttTrace_SetTracing(I_32 minLevel, U_32 ringCapacity);
+
+/**
+ * @brief Handle a trace line natively if configured to
+ * @note Called on the Paho thread, lock-free
+ * @param level trace level
+ * @param text null-terminated trace line
+ * @return TRUE if handled (filtered, recorded or dropped), FALSE if it should be posted
+ */
+BOOLEAN EsMqttTrace_Record(I_32 level, const char *text);
+
+/**
+ * @brief Move the recorded trace lines into the buffer, oldest first
+ * @note Drains are serialized, records that do not fit stay in the ring
+ * @param buffer destination of the records
+ * @param bufferSize number of bytes of the buffer
+ * @return number of records written
+ */
+U_32 EsMqttTrace_Drain(void *buffer, U_32 bufferSize);
+
+/**
+ * @brief Read the trace statistics
+ * @param stats[out]
+ */
+void EsMqttTrace_GetStats(EsMqttTraceStats *stats);
+
+#endif //ES_MQTT_TRACE_H
@@ -7,6 +7,8 @@
  *  @brief VA Smalltalk virtual machine user-primitives for MQTT Paho Impl
  *  @author Seth Berman
  *******************************************************************************/
+#include <string.h>
+
 #include "plibsys.h"
 
 #include "EsMqtt.h"
@@ -14,8 +16,27 @@
 #include "EsMqttCallbacks.h"
 #include "EsMqttLibrary.h"
 #include "EsMqttAsyncMessages.h"
+#include "EsMqttAsyncArguments.h"
+#include "EsMqttTrace.h"
+#include "EsMqttBulk.h"
+#include "EsRefBuffer.h"
 #include "EsMqttVersionInfo.h"
 
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Join high/low i32 parts back into a pointer address
+ * @note Inverse of the high/low split used for async message args
+ * @param iHigh
+ * @param iLow
+ * @return pointer
+ */
+static void *pointerFromHiLow(I_32 iHigh, I_32 iLow) {
+    return (void *) (U_PTR) ((((U_64) (U_32) iHigh) << 31u) | ((U_64) (U_32) iLow & 0x7FFFFFFFUL));
+}
+
 /******************************************************/
 /*   I N T E R F A C E  I M P L E M E N T A T I O N   */
 /******************************************************/
@@ -75,11 +96,569 @@ EsUserPrimitive(EsMqttVastCheckpoint) {
     id = EsSmallIntegerToI32(EsPrimArgument(1));
     msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_CHECKPOINT, 1, id);
     sent = EsMqttAsyncMessage_send(msg);
-    EsMqttAsyncMessage_free(msg);
 
     EsPrimSucceedBoolean(sent);
 }
 
+EsUserPrimitive(EsMqttVastSetPublishFunction) {
+    void *publishMessageAddr;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 2 args
+    // publishMessageHigh (I_32), publishMessageLow (I_32)
+    if (EsPrimArgumentCount != 2) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Type-check: Arg 2 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(2)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    publishMessageAddr = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                                          EsSmallIntegerToI32(EsPrimArgument(2)));
+    EsMqttBulk_SetPublishFunc((EsMqttPublishMessageFunc) publishMessageAddr);
+
+    EsPrimSucceedBoolean(publishMessageAddr != NULL);
+}
+
+EsUserPrimitive(EsMqttVastSetPublish5Function) {
+    void *publishMessage5Addr;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 2 args
+    // publishMessage5High (I_32), publishMessage5Low (I_32)
+    if (EsPrimArgumentCount != 2) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Type-check: Arg 2 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(2)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    publishMessage5Addr = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                                           EsSmallIntegerToI32(EsPrimArgument(2)));
+    EsMqttBulk_SetPublish5Func((EsMqttPublishMessage5Func) publishMessage5Addr);
+
+    EsPrimSucceedBoolean(publishMessage5Addr != NULL);
+}
+
+EsUserPrimitive(EsMqttVastPublishBulk) {
+    U_32 i;
+    U_32 rc;
+    I_32 recordsSize;
+    I_32 count;
+    void *client;
+    void *records;
+    I_32 *tokens;
+    U_32 numProcessed;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 8 args
+    // clientHigh (I_32), clientLow (I_32), recordsHigh (I_32), recordsLow (I_32),
+    // recordsSize (I_32), count (I_32), tokensHigh (I_32), tokensLow (I_32)
+    if (EsPrimArgumentCount != 8) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-8 must be SmallInteger
+    for (i = 1; i <= 8; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    // Type-check: Args 5-6 must be non-negative
+    recordsSize = EsSmallIntegerToI32(EsPrimArgument(5));
+    if (ES_UNLIKELY(recordsSize < 0)) {
+        EsPrimFail(EsPrimErrInvalidClass, 5);
+    }
+    count = EsSmallIntegerToI32(EsPrimArgument(6));
+    if (ES_UNLIKELY(count < 0)) {
+        EsPrimFail(EsPrimErrInvalidClass, 6);
+    }
+
+    client = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)), EsSmallIntegerToI32(EsPrimArgument(2)));
+    records = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(3)), EsSmallIntegerToI32(EsPrimArgument(4)));
+    tokens = (I_32 *) pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(7)),
+                                       EsSmallIntegerToI32(EsPrimArgument(8)));
+
+    numProcessed = EsMqttBulk_Publish((MQTTClient) client, records, (U_32) recordsSize, (U_32) count, tokens);
+    rc = EsMakeUnsignedInteger(numProcessed, &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastSetReceiveFunctions) {
+    U_32 i;
+    void *receiveAddr;
+    void *freeMessageAddr;
+    void *freeAddr;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 6 args
+    // receiveHigh (I_32), receiveLow (I_32), freeMessageHigh (I_32), freeMessageLow (I_32),
+    // freeHigh (I_32), freeLow (I_32)
+    if (EsPrimArgumentCount != 6) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-6 must be SmallInteger
+    for (i = 1; i <= 6; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    receiveAddr = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                                   EsSmallIntegerToI32(EsPrimArgument(2)));
+    freeMessageAddr = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(3)),
+                                       EsSmallIntegerToI32(EsPrimArgument(4)));
+    freeAddr = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(5)),
+                                EsSmallIntegerToI32(EsPrimArgument(6)));
+
+    EsPrimSucceedBoolean(EsMqttBulk_SetReceiveFuncs((EsMqttReceiveFunc) receiveAddr,
+                                                    (EsMqttFreeMessageFunc) freeMessageAddr,
+                                                    (EsMqttFreeFunc) freeAddr));
+}
+
+EsUserPrimitive(EsMqttVastReceiveBulk) {
+    U_32 i;
+    I_32 args[4];
+    void *client;
+    void *buffer;
+    U_32 endOffset;
+    I_32 receiveRc;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 8 args
+    // clientHigh (I_32), clientLow (I_32), bufferHigh (I_32), bufferLow (I_32),
+    // bufferSize (I_32), offset (I_32), maxCount (I_32), timeoutMs (I_32)
+    if (EsPrimArgumentCount != 8) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-8 must be SmallInteger
+    for (i = 1; i <= 8; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    // Type-check: Args 5-8 must be non-negative
+    for (i = 5; i <= 8; i++) {
+        args[i - 5] = EsSmallIntegerToI32(EsPrimArgument(i));
+        if (ES_UNLIKELY(args[i - 5] < 0)) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    client = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)), EsSmallIntegerToI32(EsPrimArgument(2)));
+    buffer = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(3)), EsSmallIntegerToI32(EsPrimArgument(4)));
+
+    endOffset = EsMqttBulk_Receive((MQTTClient) client, buffer, (U_32) args[0], (U_32) args[1], (U_32) args[2],
+                                   (U_32) args[3], &receiveRc);
+    if (endOffset == (U_32) args[1] && receiveRc != MQTTCLIENT_SUCCESS) {
+        EsPrimSucceed(EsI32ToSmallInteger(receiveRc));
+    }
+    /* The buffer size is a SmallInteger, so is the offset */
+    EsPrimSucceed(EsI32ToSmallInteger((I_32) endOffset));
+}
+
+EsUserPrimitive(EsMqttVastReceiveHeldSize) {
+    U_32 rc;
+    void *client;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 2 args
+    // clientHigh (I_32), clientLow (I_32)
+    if (EsPrimArgumentCount != 2) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Type-check: Arg 2 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(2)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    client = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)), EsSmallIntegerToI32(EsPrimArgument(2)));
+    rc = EsMakeUnsignedInteger(EsMqttBulk_GetHeldSize((MQTTClient) client), &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastBufferAcquire) {
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // bufferHandle (I_32)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    EsPrimSucceedBoolean(EsRefBuffer_acquireHandle((U_32) EsSmallIntegerToI32(EsPrimArgument(1))));
+}
+
+EsUserPrimitive(EsMqttVastBufferRelease) {
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // bufferHandle (I_32)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    EsPrimSucceedBoolean(EsRefBuffer_releaseHandle((U_32) EsSmallIntegerToI32(EsPrimArgument(1))));
+}
+
+EsUserPrimitive(EsMqttVastSetTopicRoute) {
+    const char *filter;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 4 args
+    // filterHigh (I_32), filterLow (I_32), receiver (EsObject), selector (EsObject)
+    if (EsPrimArgumentCount != 4) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Type-check: Arg 2 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(2)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    filter = (const char *) pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                                             EsSmallIntegerToI32(EsPrimArgument(2)));
+    EsPrimSucceedBoolean(EsMqttAsyncMessage_SetTopicRoute(filter, EsPrimArgument(3), EsPrimArgument(4)));
+}
+
+EsUserPrimitive(EsMqttVastSetTopicFilter) {
+    const char *filter;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 4 args
+    // filterHigh (I_32), filterLow (I_32), type (U_32), param (U_32)
+    if (EsPrimArgumentCount != 4) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Type-check: Arg 2 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(2)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    // Type-check: Arg 3 must be non-negative SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(3)) || EsSmallIntegerToI32(EsPrimArgument(3)) < 0)) {
+        EsPrimFail(EsPrimErrInvalidClass, 3);
+    }
+
+    // Type-check: Arg 4 must be non-negative SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(4)) || EsSmallIntegerToI32(EsPrimArgument(4)) < 0)) {
+        EsPrimFail(EsPrimErrInvalidClass, 4);
+    }
+
+    filter = (const char *) pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                                             EsSmallIntegerToI32(EsPrimArgument(2)));
+    EsPrimSucceedBoolean(EsMqttAsyncMessage_SetTopicFilter(
+            filter,
+            (U_32) EsSmallIntegerToI32(EsPrimArgument(3)),
+            (U_32) EsSmallIntegerToI32(EsPrimArgument(4))));
+}
+
+EsUserPrimitive(EsMqttVastSetTopicCoalescing) {
+    const char *filter;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 3 args
+    // filterHigh (I_32), filterLow (I_32), enabled (Boolean)
+    if (EsPrimArgumentCount != 3) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Type-check: Arg 2 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(2)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    // Type-check: Arg 3 must be Boolean
+    if (ES_UNLIKELY(EsPrimArgument(3) != EsTrue && EsPrimArgument(3) != EsFalse)) {
+        EsPrimFail(EsPrimErrInvalidClass, 3);
+    }
+
+    filter = (const char *) pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                                             EsSmallIntegerToI32(EsPrimArgument(2)));
+    EsPrimSucceedBoolean(EsMqttAsyncMessage_SetTopicCoalescing(filter, (BOOLEAN) (EsPrimArgument(3) == EsTrue)));
+}
+
+EsUserPrimitive(EsMqttVastCoalescedStat) {
+    const char *topicName;
+    EsObject result = NULL;
+    U_32 rc;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 2 args
+    // topicHigh (I_32), topicLow (I_32)
+    if (EsPrimArgumentCount != 2) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Type-check: Arg 2 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(2)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    topicName = (const char *) pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                                                EsSmallIntegerToI32(EsPrimArgument(2)));
+    rc = EsMakeUnsignedInteger(EsMqttAsyncMessage_GetNumCoalesced(topicName), &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastHandleAt) {
+    void *addr;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // handle (I_32)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    addr = EsMqttAsyncMessage_HandleAt((U_32) EsSmallIntegerToI32(EsPrimArgument(1)));
+    if (ES_LIKELY(addr != NULL)) {
+        EsMakePointerInteger((U_PTR) addr, &result, EsPrimVMContext);
+    } else {
+        result = EsNil;
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastHandleRemove) {
+    void *addr;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // handle (I_32)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    addr = EsMqttAsyncMessage_HandleRemove((U_32) EsSmallIntegerToI32(EsPrimArgument(1)));
+    if (ES_LIKELY(addr != NULL)) {
+        EsMakePointerInteger((U_PTR) addr, &result, EsPrimVMContext);
+    } else {
+        result = EsNil;
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastMessagePayloadSize) {
+    MQTTClient_message *message;
+    U_32 payloadLen;
+    U_32 rc;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // handle (I_32)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    message = EsMqttAsyncMessage_MessageAt((U_32) EsSmallIntegerToI32(EsPrimArgument(1)), NULL);
+    if (ES_UNLIKELY(message == NULL)) {
+        EsPrimSucceed(EsNil);
+    }
+
+    payloadLen = (message->payload != NULL && message->payloadlen > 0) ? (U_32) message->payloadlen : 0;
+    rc = EsMakeUnsignedInteger(payloadLen, &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastMessagePayloadBuffer) {
+    MQTTClient_message *message;
+    BOOLEAN passThrough = FALSE;
+    U_32 bufferHandle;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // handle (I_32)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Only copies have a ref buffer payload, Paho's (pass-through) payload is plain memory
+    message = EsMqttAsyncMessage_MessageAt((U_32) EsSmallIntegerToI32(EsPrimArgument(1)), &passThrough);
+    if (ES_UNLIKELY(message == NULL || passThrough || message->payload == NULL)) {
+        EsPrimSucceed(EsNil);
+    }
+
+    bufferHandle = EsRefBuffer_getHandle(message->payload);
+    EsPrimSucceed(EsI32ToSmallInteger((I_32) bufferHandle));
+}
+
+EsUserPrimitive(EsMqttVastMessageTakePayload) {
+    U_32 i;
+    U_32 rc;
+    U_32 handle;
+    I_32 bufferSize;
+    void *buffer;
+    BOOLEAN passThrough = FALSE;
+    MQTTClient_message *message;
+    U_32 payloadLen;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 4 args
+    // handle (I_32), bufferHigh (I_32), bufferLow (I_32), bufferSize (I_32)
+    if (EsPrimArgumentCount != 4) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-4 must be SmallInteger
+    for (i = 1; i <= 4; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    // Type-check: Arg 4 must be non-negative
+    bufferSize = EsSmallIntegerToI32(EsPrimArgument(4));
+    if (ES_UNLIKELY(bufferSize < 0)) {
+        EsPrimFail(EsPrimErrInvalidClass, 4);
+    }
+
+    handle = (U_32) EsSmallIntegerToI32(EsPrimArgument(1));
+    message = EsMqttAsyncMessage_MessageAt(handle, NULL);
+    if (ES_UNLIKELY(message == NULL)) {
+        EsPrimSucceed(EsNil);
+    }
+
+    // Check the buffer before the message is taken, so a failed prim can be retried
+    payloadLen = (message->payload != NULL && message->payloadlen > 0) ? (U_32) message->payloadlen : 0;
+    if (ES_UNLIKELY(payloadLen > (U_32) bufferSize)) {
+        EsPrimFail(EsPrimErrInvalidClass, 4);
+    }
+    buffer = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(2)), EsSmallIntegerToI32(EsPrimArgument(3)));
+    if (ES_UNLIKELY(buffer == NULL && payloadLen > 0)) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    // Taken first, so no one else frees the message while it is copied
+    message = EsMqttAsyncMessage_MessageRemove(handle, &passThrough);
+    if (ES_UNLIKELY(message == NULL)) {
+        EsPrimSucceed(EsNil);
+    }
+    if (payloadLen > 0) {
+        memcpy(buffer, message->payload, payloadLen);
+    }
+    if (passThrough) {
+        EsFreePahoMessage(message);
+    } else {
+        // Also releases the initial payload reference, which belongs to the copy (not to Smalltalk)
+        EsFreeMessageCopy(message);
+    }
+
+    rc = EsMakeUnsignedInteger(payloadLen, &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
+
 EsUserPrimitive(EsMqttVastVersionString) {
     EsObject string = NULL;
     U_32 rc;
@@ -90,3 +669,327 @@ EsUserPrimitive(EsMqttVastVersionString) {
     }
     EsPrimSucceed(string);
 }
+
+EsUserPrimitive(EsMqttVastAsyncMessageStat) {
+    I_32 cbType;
+    I_32 stat;
+    U_32 value;
+    U_32 rc;
+    EsSlabStats stats;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 2 args
+    // callbackType (I_32), stat (I_32)
+    if (EsPrimArgumentCount != 2) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    // Type-check: Arg 2 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(2)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    cbType = EsSmallIntegerToI32(EsPrimArgument(1));
+    stat = EsSmallIntegerToI32(EsPrimArgument(2));
+    if (!EsMqttAsyncMessage_GetSlabStats((enum EsMqttVastCallbackTypes) cbType, &stats)) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    switch (stat) {
+        case 0:
+            value = stats.blockSize;
+            break;
+        case 1:
+            value = stats.numBlocks;
+            break;
+        case 2:
+            value = stats.numInUse;
+            break;
+        case 3:
+            value = stats.highWater;
+            break;
+        default:
+            EsPrimFail(EsPrimErrInvalidClass, 2);
+    }
+
+    rc = EsMakeUnsignedInteger(value, &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastSetPassThrough) {
+    U_32 i;
+    void *freeMessageAddr;
+    void *freeAddr;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 4 args
+    // freeMessageHigh (I_32), freeMessageLow (I_32), freeHigh (I_32), freeLow (I_32)
+    if (EsPrimArgumentCount != 4) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-4 must be SmallInteger
+    for (i = 1; i <= 4; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    freeMessageAddr = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                                       EsSmallIntegerToI32(EsPrimArgument(2)));
+    freeAddr = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(3)),
+                                EsSmallIntegerToI32(EsPrimArgument(4)));
+    EsMqttAsyncArguments_SetPassThrough((EsMqttFreeMessageFunc) freeMessageAddr, (EsMqttFreeFunc) freeAddr);
+
+    EsPrimSucceedBoolean(EsMqttAsyncArguments_IsPassThrough());
+}
+
+EsUserPrimitive(EsMqttVastSetDispatcher) {
+    EsObject enabled;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // enabled (Boolean)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be Boolean
+    enabled = EsPrimArgument(1);
+    if (ES_UNLIKELY(enabled != EsTrue && enabled != EsFalse)) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    EsMqttAsyncMessage_SetDispatcher((BOOLEAN) (enabled == EsTrue));
+    EsPrimSucceedBoolean(EsMqttAsyncMessage_IsDispatcher());
+}
+
+EsUserPrimitive(EsMqttVastSetMessageBatching) {
+    U_32 i;
+    I_32 limits[3];
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 3 args
+    // maxCount (I_32), maxBytes (I_32), maxDelayUs (I_32)
+    if (EsPrimArgumentCount != 3) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-3 must be non-negative SmallInteger
+    for (i = 1; i <= 3; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+        limits[i - 1] = EsSmallIntegerToI32(EsPrimArgument(i));
+        if (ES_UNLIKELY(limits[i - 1] < 0)) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    EsPrimSucceedBoolean(EsMqttAsyncMessage_SetBatching((U_32) limits[0], (U_32) limits[1], (U_32) limits[2]));
+}
+
+EsUserPrimitive(EsMqttVastSetFlowControl) {
+    U_32 i;
+    I_32 marks[2];
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 2 args
+    // throttleMark (I_32), pauseMark (I_32)
+    if (EsPrimArgumentCount != 2) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-2 must be non-negative SmallInteger
+    for (i = 1; i <= 2; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+        marks[i - 1] = EsSmallIntegerToI32(EsPrimArgument(i));
+        if (ES_UNLIKELY(marks[i - 1] < 0)) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    EsPrimSucceedBoolean(EsMqttAsyncMessage_SetFlowControl((U_32) marks[0], (U_32) marks[1]));
+}
+
+EsUserPrimitive(EsMqttVastFlowControlStat) {
+    I_32 stat;
+    U_32 value;
+    U_32 rc;
+    EsMqttFlowStats stats;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // stat (I_32)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    stat = EsSmallIntegerToI32(EsPrimArgument(1));
+    EsMqttAsyncMessage_GetFlowStats(&stats);
+    switch (stat) {
+        case 0:
+            value = stats.numQueued;
+            break;
+        case 1:
+            value = stats.numPosts;
+            break;
+        case 2:
+            value = stats.numFailedPosts;
+            break;
+        case 3:
+            value = stats.numThrottled;
+            break;
+        case 4:
+            value = stats.numRefused;
+            break;
+        case 5:
+            value = stats.numUnrouted;
+            break;
+        case 6:
+            value = stats.numFiltered;
+            break;
+        case 7:
+            value = stats.numCoalesced;
+            break;
+        default:
+            EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    rc = EsMakeUnsignedInteger(value, &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastSetTracing) {
+    U_32 i;
+    I_32 args[2];
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 2 args
+    // minLevel (I_32), ringCapacity (I_32)
+    if (EsPrimArgumentCount != 2) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-2 must be non-negative SmallInteger
+    for (i = 1; i <= 2; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+        args[i - 1] = EsSmallIntegerToI32(EsPrimArgument(i));
+        if (ES_UNLIKELY(args[i - 1] < 0)) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    EsPrimSucceedBoolean(EsMqttTrace_SetTracing(args[0], (U_32) args[1]));
+}
+
+EsUserPrimitive(EsMqttVastTraceDrain) {
+    U_32 i;
+    U_32 rc;
+    I_32 bufferSize;
+    void *buffer;
+    U_32 numRecords;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 3 args
+    // bufferHigh (I_32), bufferLow (I_32), bufferSize (I_32)
+    if (EsPrimArgumentCount != 3) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Args 1-3 must be SmallInteger
+    for (i = 1; i <= 3; i++) {
+        if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(i)))) {
+            EsPrimFail(EsPrimErrInvalidClass, i);
+        }
+    }
+
+    // Type-check: Arg 3 must be non-negative
+    bufferSize = EsSmallIntegerToI32(EsPrimArgument(3));
+    if (ES_UNLIKELY(bufferSize < 0)) {
+        EsPrimFail(EsPrimErrInvalidClass, 3);
+    }
+
+    buffer = pointerFromHiLow(EsSmallIntegerToI32(EsPrimArgument(1)),
+                              EsSmallIntegerToI32(EsPrimArgument(2)));
+    numRecords = EsMqttTrace_Drain(buffer, (U_32) bufferSize);
+    rc = EsMakeUnsignedInteger(numRecords, &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
+
+EsUserPrimitive(EsMqttVastTraceStat) {
+    I_32 stat;
+    U_32 value;
+    U_32 rc;
+    EsMqttTraceStats stats;
+    EsObject result = NULL;
+
+    EsMqttLibraryInit(EsPrimVMContext->globalInfo);
+
+    // ArgCount-check: 1 args
+    // stat (I_32)
+    if (EsPrimArgumentCount != 1) {
+        EsPrimFail(EsPrimErrInvalidArgumentCount, EsPrimArgNumNoArg);
+    }
+
+    // Type-check: Arg 1 must be SmallInteger
+    if (ES_UNLIKELY(!EsIsSmallInteger(EsPrimArgument(1)))) {
+        EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    stat = EsSmallIntegerToI32(EsPrimArgument(1));
+    EsMqttTrace_GetStats(&stats);
+    switch (stat) {
+        case 0:
+            value = stats.numRecorded;
+            break;
+        case 1:
+            value = stats.numDropped;
+            break;
+        case 2:
+            value = stats.numFiltered;
+            break;
+        default:
+            EsPrimFail(EsPrimErrInvalidClass, 1);
+    }
+
+    rc = EsMakeUnsignedInteger(value, &result, EsPrimVMContext);
+    if (ES_UNLIKELY(rc != EsPrimErrNoError)) {
+        EsPrimFail(rc, 0);
+    }
+    EsPrimSucceed(result);
+}
@@ -74,6 +74,371 @@ EsDeclareUserPrimitive(EsMqttVastRegisterCallback);
  */
 EsDeclareUserPrimitive(EsMqttVastCheckpoint);
 
+/**
+ * @brief Supplies Paho's MQTTClient_publishMessage() for bulk publishing,
+ * since this library does not link against Paho itself.
+ * @see EsMqttVastPublishBulk
+ *
+ * Smalltalk Arguments
+ * Arg1: High 32-bits of MQTTClient_publishMessage address (0 with Arg2 to disable)
+ * Arg2: Low 32-bits of MQTTClient_publishMessage address
+ * Returns: true if bulk publishing is enabled, false otherwise
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetPublishFunction);
+
+/**
+ * @brief Supplies Paho's MQTTClient_publishMessage5() for bulk publishing
+ * with MQTT v5 clients, since this library does not link against Paho itself.
+ * @see EsMqttVastPublishBulk
+ *
+ * Smalltalk Arguments
+ * Arg1: High 32-bits of MQTTClient_publishMessage5 address (0 with Arg2 to disable)
+ * Arg2: Low 32-bits of MQTTClient_publishMessage5 address
+ * Returns: true if bulk publishing with MQTT v5 clients is enabled, false otherwise
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetPublish5Function);
+
+/**
+ * @brief Publishes a vector of messages, packed into one buffer,
+ * in a single call and answers their delivery tokens.
+ * @see EsMqttBulk.h for the layout of the records and tokens
+ *
+ * Smalltalk Arguments
+ * Arg1: High 32-bits of MQTTClient handle
+ * Arg2: Low 32-bits of MQTTClient handle
+ * Arg3: High 32-bits of records address (4-byte aligned)
+ * Arg4: Low 32-bits of records address
+ * Arg5: Size of the records in bytes
+ * Arg6: Number of records
+ * Arg7: High 32-bits of tokens address (room for one I_32 per record)
+ * Arg8: Low 32-bits of tokens address
+ * Returns: Smalltalk Integer (number of records processed)
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastPublishBulk);
+
+/**
+ * @brief Supplies Paho's MQTTClient_receive(), MQTTClient_freeMessage() and
+ * MQTTClient_free() for bulk receiving, since this library does not link
+ * against Paho itself.
+ * @see EsMqttVastReceiveBulk
+ *
+ * Smalltalk Arguments
+ * Arg1: High 32-bits of MQTTClient_receive address
+ * Arg2: Low 32-bits of MQTTClient_receive address
+ * Arg3: High 32-bits of MQTTClient_freeMessage address
+ * Arg4: Low 32-bits of MQTTClient_freeMessage address
+ * Arg5: High 32-bits of MQTTClient_free address
+ * Arg6: Low 32-bits of MQTTClient_free address
+ * Returns: true if bulk receiving is enabled, false otherwise
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetReceiveFunctions);
+
+/**
+ * @brief Receives up to N messages of a client into a caller supplied buffer,
+ * waiting up to a timeout for the first one.
+ * A message that does not fit is held for the next call (@see EsMqttVastReceiveHeldSize)
+ * @see EsMqttBulk.h for the layout of the records
+ *
+ * Smalltalk Arguments
+ * Arg1: High 32-bits of MQTTClient handle
+ * Arg2: Low 32-bits of MQTTClient handle
+ * Arg3: High 32-bits of buffer address
+ * Arg4: Low 32-bits of buffer address
+ * Arg5: Size of the buffer in bytes
+ * Arg6: Offset of the first record (4-byte aligned)
+ * Arg7: Max number of messages
+ * Arg8: Max milliseconds to wait for the first message
+ * Returns: Smalltalk Integer, the offset after the last record written,
+ * or Paho's negative return code if receiving failed before any record was written
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastReceiveBulk);
+
+/**
+ * @brief Answers the record size of the message held for a client
+ * since it did not fit into the buffer of its last bulk receive.
+ *
+ * Smalltalk Arguments
+ * Arg1: High 32-bits of MQTTClient handle
+ * Arg2: Low 32-bits of MQTTClient handle
+ * Returns: Smalltalk Integer (0 if no message is held)
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastReceiveHeldSize);
+
+/**
+ * @brief Adds a reference to a shared payload buffer.
+ * Each holder of the payload acquires its own reference.
+ * @see EsRefBuffer.h
+ *
+ * Smalltalk Arguments
+ * Arg1: Buffer Handle (@see EsMqttVastMessagePayloadBuffer)
+ * Returns: true if acquired, false if the handle is not of a live buffer
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastBufferAcquire);
+
+/**
+ * @brief Removes a reference from a shared payload buffer.
+ * The buffer is freed when the last reference is released.
+ * Smalltalk releases the initial reference only for a message copy it frees
+ * itself, not after EsMqttVastMessageTakePayload (which releases it natively).
+ * @see EsRefBuffer.h
+ * @see EsMqttAsyncArguments.h for who holds which reference
+ *
+ * Smalltalk Arguments
+ * Arg1: Buffer Handle (@see EsMqttVastMessagePayloadBuffer)
+ * Returns: true if released, false if the handle is not of a live buffer
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastBufferRelease);
+
+/**
+ * @brief Routes arrived messages that match an MQTT topic filter
+ * ('+' and '#' wildcards) to a receiver>>selector.
+ * Once any route is set, arrived messages go to the target of the most
+ * specific matching filter, and messages that match no filter are dropped
+ * natively without waking the vm.
+ * The filter is a null-terminated string in os memory (i.e. OSStringZ) and is
+ * copied, its address is split into high/low parts (Smalltalk to C).
+ *
+ * Smalltalk Arguments
+ * Arg1: Topic filter address (high part)
+ * Arg2: Topic filter address (low part)
+ * Arg3: Receiver (nil to remove the route)
+ * Arg4: Selector (nil to remove the route)
+ * Returns: true if set (or removed), false if the filter is invalid
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetTopicRoute);
+
+/**
+ * @brief Filters arrived messages that match an MQTT topic filter
+ * ('+' and '#' wildcards) natively, before they are queued.
+ * Messages that the filter drops are freed without waking the vm.
+ * Each topic name that matches keeps its own filter state.
+ * The filter is a null-terminated string in os memory (i.e. OSStringZ) and is
+ * copied, its address is split into high/low parts (Smalltalk to C).
+ *
+ * Smalltalk Arguments
+ * Arg1: Topic filter address (high part)
+ * Arg2: Topic filter address (low part)
+ * Arg3: Filter type
+ *  - 0: none (removes the filter)
+ *  - 1: sample, pass the first and then every Nth message
+ *  - 2: rate limit, pass at most one message per interval
+ *  - 3: dedupe, drop payloads equal to the last passed one
+ * Arg4: Param of the type
+ *  - sample: N (> 0)
+ *  - rate limit: interval in milliseconds (> 0)
+ *  - dedupe: milliseconds a duplicate is dropped for (0 for no limit)
+ * Returns: true if set (or removed), false if the filter, type or param is invalid
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetTopicFilter);
+
+/**
+ * @brief Coalesces arrived messages that match an MQTT topic filter
+ * ('+' and '#' wildcards) to the latest value of each topic name.
+ * A newer message replaces the queued message of its topic name if that
+ * one was not posted yet, so the queue is bounded by the number of topics.
+ * The filter is a null-terminated string in os memory (i.e. OSStringZ) and is
+ * copied, its address is split into high/low parts (Smalltalk to C).
+ *
+ * Smalltalk Arguments
+ * Arg1: Topic filter address (high part)
+ * Arg2: Topic filter address (low part)
+ * Arg3: true to coalesce, false to stop
+ * Returns: true if set, false if the filter is invalid
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetTopicCoalescing);
+
+/**
+ * @brief Answers the number of messages of a topic name that were
+ * replaced by a newer one before they were posted (coalesced drops).
+ * The topic name is a null-terminated string in os memory (i.e. OSStringZ),
+ * its address is split into high/low parts (Smalltalk to C).
+ *
+ * Smalltalk Arguments
+ * Arg1: Topic name address (high part)
+ * Arg2: Topic name address (low part)
+ * Returns: Smalltalk Integer
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastCoalescedStat);
+
+/**
+ * @brief Answers the address that an async message handle refers to.
+ * Async messages pass data (messages, topics, strings, properties and
+ * batches) as one SmallInteger handle instead of a split address.
+ *
+ * Smalltalk Arguments
+ * Arg1: Handle
+ * Returns: Smalltalk Integer address or nil if the handle is stale
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastHandleAt);
+
+/**
+ * @brief Removes an async message handle and answers the address it
+ * referred to. Smalltalk then owns the data at the address.
+ * Every handle of a posted async message must be removed once.
+ * An arrived message copy taken this way is freed with EsFreeMemory after its
+ * payload buffer is released, so Smalltalk asks for the buffer handle first
+ * (@see EsMqttVastMessagePayloadBuffer).
+ *
+ * Smalltalk Arguments
+ * Arg1: Handle
+ * Returns: Smalltalk Integer address or nil if the handle is stale
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastHandleRemove);
+
+/**
+ * @brief Answers the payload size of the arrived message an async
+ * message handle refers to, so Smalltalk can preallocate its ByteArray.
+ * @see EsMqttVastMessageTakePayload
+ *
+ * Smalltalk Arguments
+ * Arg1: Message Handle
+ * Returns: Smalltalk Integer or nil if the handle is stale (or not of an arrived message)
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastMessagePayloadSize);
+
+/**
+ * @brief Answers the handle of the shared payload buffer of the arrived
+ * message an async message handle refers to, which Smalltalk passes to
+ * EsMqttVastBufferAcquire and EsMqttVastBufferRelease.
+ * It is only answered while the message handle is live, so Smalltalk asks
+ * for it before it removes the message handle.
+ * Messages of a batch carry their buffer handle in the batch entry.
+ * @see EsRefBuffer.h
+ *
+ * Smalltalk Arguments
+ * Arg1: Message Handle
+ * Returns: Smalltalk Integer or nil if the handle is stale (or not of an arrived
+ * message), the message was passed through or it has no payload
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastMessagePayloadBuffer);
+
+/**
+ * @brief Copies the payload of the arrived message an async message
+ * handle refers to into a preallocated buffer (i.e. a pinned ByteArray),
+ * then removes the handle and frees the native message in the same call.
+ * The message is freed by whoever owns it (a copy or Paho's pass-through
+ * message), which is recorded natively with the handle.
+ * Freeing a copy releases the initial reference of its payload buffer, so
+ * Smalltalk does not release it too; references acquired with
+ * EsMqttVastBufferAcquire are unaffected and still released by their holders.
+ * Messages of a batch have no message handle and can not be taken, Smalltalk
+ * reads them from the batch entries (@see EsMqttMessageBatch).
+ * The prim fails, and the handle stays valid, if the buffer is too small.
+ * The topic name handle of the same async message is not touched, it stays
+ * live until Smalltalk removes it (@see EsMqttVastHandleRemove).
+ *
+ * Smalltalk Arguments
+ * Arg1: Message Handle
+ * Arg2: High 32-bits of buffer address
+ * Arg3: Low 32-bits of buffer address
+ * Arg4: Size of the buffer in bytes
+ * Returns: Smalltalk Integer (number of bytes copied) or nil if the handle is stale
+ * (or not of an arrived message)
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastMessageTakePayload);
+
 /**
  * @brief Answers a Smalltalk String representation
  * of the product version (major.minor.mod).
@@ -91,4 +456,189 @@ EsDeclareUserPrimitive(EsMqttVastCheckpoint);
  */
 EsDeclareUserPrimitive(EsMqttVastVersionString);
 
+/**
+ * @brief Answers a statistic of the async message slab
+ * for the callback type. This is used to tune the slab chunk size.
+ *
+ * Smalltalk Arguments
+ * Arg1: Callback Type (@see EsMqttVastCallbackTypes)
+ * Arg2: Statistic
+ *  - 0: block size in bytes
+ *  - 1: number of blocks (capacity)
+ *  - 2: number of blocks in use (occupancy)
+ *  - 3: high-water mark of blocks in use
+ * Returns: Smalltalk Integer
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastAsyncMessageStat);
+
+/**
+ * @brief Enables or disables zero-copy pass-through of arrived messages.
+ * In pass-through mode the MQTTClient_message and topic that Paho hands
+ * over are posted as is, and Smalltalk must release them with
+ * MQTTClient_freeMessage/MQTTClient_free (not EsFreeMemory).
+ * Addresses are split into high/low parts (Smalltalk to C).
+ * Passing 0 addresses disables pass-through (messages are copied).
+ *
+ * Smalltalk Arguments
+ * Arg1: MQTTClient_freeMessage address (high part)
+ * Arg2: MQTTClient_freeMessage address (low part)
+ * Arg3: MQTTClient_free address (high part)
+ * Arg4: MQTTClient_free address (low part)
+ * Returns: true if pass-through is enabled, false otherwise
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetPassThrough);
+
+/**
+ * @brief Selects whether async messages are posted by the native
+ * dispatcher thread (default) or inline on the Paho thread.
+ * The dispatcher retries failed posts with backoff so the Paho
+ * network loop never stalls on Smalltalk.
+ *
+ * Smalltalk Arguments
+ * Arg1: true for dispatcher, false for inline
+ * Returns: true if the dispatcher is enabled, false otherwise
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetDispatcher);
+
+/**
+ * @brief Configures batching of arrived messages by the dispatcher.
+ * Arrived messages are collected into a native batch descriptor and
+ * posted as one async message to the messageBatch callback target
+ * with the descriptor handle and the message count.
+ * @see EsMqttAsyncMessage_SetBatching for when a batch is flushed
+ *
+ * Smalltalk Arguments
+ * Arg1: Max messages per batch (0 or 1 disables batching)
+ * Arg2: Max topic and payload bytes per batch (0 for no limit)
+ * Arg3: Max microseconds a message waits in a batch (up to 1000000)
+ * Returns: true if configured, false if an argument is out of range
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetMessageBatching);
+
+/**
+ * @brief Configures flow control of arrived messages by the dispatcher.
+ * Past the throttle mark the Paho receive thread is slowed down, and past
+ * the pause mark (or while the vm async queue keeps failing posts) arrived
+ * messages are refused so Paho redelivers them later.
+ * @see EsMqttAsyncMessage_SetFlowControl
+ *
+ * Smalltalk Arguments
+ * Arg1: Throttle mark, number of queued messages (0 disables)
+ * Arg2: Pause mark, number of queued messages (0 disables)
+ * Returns: true if configured, false if an argument is out of range
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetFlowControl);
+
+/**
+ * @brief Answers a flow control statistic of the dispatcher.
+ * Counters wrap around, so rates are computed from two reads.
+ *
+ * Smalltalk Arguments
+ * Arg1: Statistic
+ *  - 0: number of queued (in-flight) messages
+ *  - 1: number of posts tried
+ *  - 2: number of failed posts
+ *  - 3: number of throttled arrived messages
+ *  - 4: number of refused arrived messages (redelivered by Paho)
+ *  - 5: number of arrived messages dropped since no topic route matched
+ *  - 6: number of arrived messages dropped by a topic filter
+ *  - 7: number of arrived messages replaced by a newer one (coalesced)
+ * Returns: Smalltalk Integer
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastFlowControlStat);
+
+/**
+ * @brief Configures the native handling of Paho trace lines.
+ * Trace lines below the minimum level are dropped in C. If the ring
+ * capacity is not 0, the other trace lines are recorded into a native
+ * ring instead of being posted, to be drained by EsMqttVastTraceDrain.
+ * @see EsMqttTrace_SetTracing
+ *
+ * Smalltalk Arguments
+ * Arg1: Minimum trace level (0 keeps all)
+ * Arg2: Ring capacity, number of trace lines (0 posts trace lines)
+ * Returns: true if configured, false if an argument is out of range
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastSetTracing);
+
+/**
+ * @brief Moves the trace lines recorded in the native ring into
+ * a caller supplied buffer, oldest first.
+ * @see EsMqttTrace.h for the layout of the drained records
+ *
+ * Smalltalk Arguments
+ * Arg1: High 32-bits of buffer address
+ * Arg2: Low 32-bits of buffer address
+ * Arg3: Size of the buffer in bytes
+ * Returns: Smalltalk Integer (number of records written)
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastTraceDrain);
+
+/**
+ * @brief Answers a statistic of the native trace handling.
+ * Counters wrap around, so rates are computed from two reads.
+ *
+ * Smalltalk Arguments
+ * Arg1: Statistic
+ *  - 0: number of trace lines recorded into the ring
+ *  - 1: number of trace lines dropped since the ring was full
+ *  - 2: number of trace lines dropped below the minimum level
+ * Returns: Smalltalk Integer
+ *
+ * C Arguments
+ * @param EsPrimVMContext
+ * @param EsPrimArgumentCount
+ * @param EsPrimPushCount
+ * @return TRUE
+ */
+EsDeclareUserPrimitive(EsMqttVastTraceStat);
+
 #endif //ES_MQTT_USER_PRIMS_H
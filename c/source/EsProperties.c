@@ -18,91 +18,249 @@
  */
 #define STREQ(_s1, _s2) ((strcmp((_s1), (_s2)) == 0) ? TRUE : FALSE)
 
+/**
+ * @brief Number of entries stored inline in the properties object
+ * @note Beyond this, entries spill to a heap array that grows by doubling
+ */
+#define ES_PROPS_INLINE_CAPACITY    4
+
+/**
+ * @brief Bytes of the inline arena that values are bump-allocated from
+ * @note Values that do not fit are copied to the heap
+ */
+#define ES_PROPS_ARENA_SIZE         64
+
+/**
+ * @brief Index slot that is not in use
+ */
+#define ES_PROPS_EMPTY_SLOT     (-1)
+
 /**************************/
 /*   D A T A  T Y P E S   */
 /**************************/
 
 /**
- * @brief Property Node for properties linked list
+ * @brief Property entry
+ * @note The key hash is cached so lookups and index rebuilds never rehash
  */
 typedef struct _EsProperty EsProperty;
 struct _EsProperty {
     const char *key;
     char *value;
-    EsProperty *next;
+    U_32 hash;
 };
 
 /**
  * @brief Container for properties
  * @note This is what the user has a handle to
+ *
+ * Entries are kept in a dense array in insertion order, which makes
+ * size and index access O(1). The first few entries and their values
+ * live inside this object (inline entries and a bump arena), so small
+ * properties cost a single allocation and a single free.
+ * Once the inline entries are outgrown, entries spill to the heap and
+ * an open-addressing (linear probe) index of entry positions makes key
+ * lookup O(1). The index always has at least twice as many slots as entries.
  */
 struct _EsProperties {
-    EsProperty *head;
+    EsProperty *entries;
+    U_32 numEntries;
+    U_32 capacity;
+    I_32 *index;
+    U_32 indexMask;
+    U_32 arenaUsed;
+    EsProperty inlineEntries[ES_PROPS_INLINE_CAPACITY];
+    char arena[ES_PROPS_ARENA_SIZE];
 };
 
-/***************************/
-/*   P R O P E R T I E S   */
-/***************************/
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
 
 /**
- * @brief Answer new init instance of property
+ * @brief Answer the FNV-1a hash of the key
  * @param key null-terminated string
+ * @return hash
+ */
+static U_32 hashKey(const char *key) {
+    U_32 hash = 2166136261u;
+
+    while (*key != '\0') {
+        hash ^= (U_8) *key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Answer TRUE if the entry has the key
+ * @note Keys are usually the same literal, so identity is checked before strcmp
+ * @param entry
+ * @param key null-terminated string
+ * @param hash of key
+ * @return TRUE if match, FALSE otherwise
+ */
+static BOOLEAN entryHasKey(const EsProperty *entry, const char *key, U_32 hash) {
+    return (BOOLEAN) (entry->hash == hash && (entry->key == key || STREQ(entry->key, key)));
+}
+
+/**
+ * @brief Answer TRUE if the value was allocated from the inline arena
+ * @param props
+ * @param value
+ * @return TRUE if arena value, FALSE if heap value
+ */
+static BOOLEAN isArenaValue(const EsProperties *props, const char *value) {
+    return (BOOLEAN) (value >= props->arena && value < props->arena + ES_PROPS_ARENA_SIZE);
+}
+
+/**
+ * @brief Answer a copy of the value from the inline arena, or the heap if it does not fit
+ * @note Arena space is not reused when a value is replaced or removed
+ * @param props
  * @param value null-terminated string
- * @return new property or NULL if out of memory
+ * @return value copy or NULL if out of memory
  */
-static EsProperty *newProperty(const char *key, char *value) {
-    EsProperty *node = (EsProperty *) malloc(sizeof(*node));
-	if (node != NULL) {
-		node->key = key;
-		node->value = strdup(value); /* Store Copy */
-		node->next = NULL;
-	}
-    return node;
+static char *copyValue(EsProperties *props, const char *value) {
+    U_SIZE size = strlen(value) + 1;
+    char *copy;
+
+    if (size <= ES_PROPS_ARENA_SIZE - props->arenaUsed) {
+        copy = props->arena + props->arenaUsed;
+        props->arenaUsed += (U_32) size;
+        memcpy(copy, value, size);
+        return copy;
+    }
+    return strdup(value);
 }
 
 /**
- * @brief Answer the node before the node with key
+ * @brief Free a value copy unless it lives in the inline arena
  * @param props
- * @param key null-terminated key
- * @return EsProperty*
- * @return NULL if node to find is first in list, props is NULL or key is NULL
+ * @param value
+ */
+static void freeValue(const EsProperties *props, char *value) {
+    if (!isArenaValue(props, value)) {
+        free(value);
+    }
+}
+
+/**
+ * @brief Insert the entry position into the index
+ * @note The index must have an empty slot
+ * @param props
+ * @param entryIndex position in the entries array
+ */
+static void indexInsert(EsProperties *props, U_32 entryIndex) {
+    U_32 slot = props->entries[entryIndex].hash & props->indexMask;
+
+    while (props->index[slot] != ES_PROPS_EMPTY_SLOT) {
+        slot = (slot + 1) & props->indexMask;
+    }
+    props->index[slot] = (I_32) entryIndex;
+}
+
+/**
+ * @brief Rebuild the index with the number of slots
+ * @param props
+ * @param numSlots power of 2
+ * @return TRUE if success, FALSE if out of memory (old index is kept)
  */
-static EsProperty *propertyNodeBeforeNodeAt(const EsProperties *props, const char *key) {
-    EsProperty *prev = NULL;
-
-    if (props != NULL && key != NULL) {
-        EsProperty *next = props->head;
-        while (next != NULL) {
-            if (STREQ(next->key, key)) {
-                break;
+static BOOLEAN rebuildIndex(EsProperties *props, U_32 numSlots) {
+    I_32 *index;
+    U_32 i;
+
+    if (numSlots - 1 != props->indexMask || props->index == NULL) {
+        index = (I_32 *) malloc(sizeof(I_32) * numSlots);
+        if (index == NULL) {
+            return FALSE;
+        }
+        free(props->index);
+        props->index = index;
+        props->indexMask = numSlots - 1;
+    }
+    memset(props->index, 0xFF, sizeof(I_32) * numSlots); /* ES_PROPS_EMPTY_SLOT */
+    for (i = 0; i < props->numEntries; i++) {
+        indexInsert(props, i);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Make room for one more entry
+ * @note The index is only used once the entries spill to the heap
+ * @param props
+ * @return TRUE if success, FALSE if out of memory
+ */
+static BOOLEAN growIfFull(EsProperties *props) {
+    EsProperty *entries;
+    U_32 capacity;
+
+    if (props->numEntries >= props->capacity) {
+        capacity = props->capacity * 2;
+        if (props->entries == props->inlineEntries) {
+            /* Spill the inline entries to the heap */
+            entries = (EsProperty *) malloc(sizeof(EsProperty) * capacity);
+            if (entries != NULL) {
+                memcpy(entries, props->inlineEntries, sizeof(EsProperty) * props->numEntries);
             }
-            prev = next;
-            next = next->next;
+        } else {
+            entries = (EsProperty *) realloc(props->entries, sizeof(EsProperty) * capacity);
         }
+        if (entries == NULL) {
+            return FALSE;
+        }
+        props->entries = entries;
+        props->capacity = capacity;
+    }
+
+    if (props->entries != props->inlineEntries
+        && (props->index == NULL || props->indexMask + 1 < props->capacity * 2)) {
+        return rebuildIndex(props, props->capacity * 2);
     }
-    return prev;
+    return TRUE;
 }
 
+/***************************/
+/*   P R O P E R T I E S   */
+/***************************/
+
 /**
- * @brief Answer the node with matching key
+ * @brief Answer the position of the entry with matching key
  * @param props
  * @param key null-terminated key
- * @return EsProperty*
- * @return NULL if node not found, props is NULL or key is NULL
+ * @return position in the entries array
+ * @return -1 if not found, props is NULL or key is NULL
  */
-static EsProperty *propertyNodeAt(const EsProperties *props, const char *key) {
-    EsProperty *node = NULL;
-
-    if (props != NULL && key != NULL) {
-        node = props->head;
-        while (node != NULL) {
-            if (STREQ(node->key, key)) {
-                break;
+static I_32 propertyIndexAt(const EsProperties *props, const char *key) {
+    U_32 hash;
+    U_32 slot;
+
+    if (props == NULL || key == NULL || props->numEntries == 0) {
+        return -1;
+    }
+
+    hash = hashKey(key);
+    if (props->index == NULL) {
+        /* Inline entries only: a short scan of cached hashes */
+        I_32 i;
+        for (i = 0; i < (I_32) props->numEntries; i++) {
+            if (entryHasKey(&props->entries[i], key, hash)) {
+                return i;
             }
-            node = node->next;
         }
+        return -1;
     }
-    return node;
+
+    slot = hash & props->indexMask;
+    while (props->index[slot] != ES_PROPS_EMPTY_SLOT) {
+        I_32 entryIndex = props->index[slot];
+        if (entryHasKey(&props->entries[entryIndex], key, hash)) {
+            return entryIndex;
+        }
+        slot = (slot + 1) & props->indexMask;
+    }
+    return -1;
 }
 
 /******************************************************/
@@ -110,53 +268,41 @@ static EsProperty *propertyNodeAt(const EsProperties *props, const char *key) {
 /******************************************************/
 
 EsProperties *EsProperties_new() {
-    return (EsProperties *) calloc(1, sizeof(EsProperties));
+    EsProperties *props;
+
+    props = (EsProperties *) calloc(1, sizeof(EsProperties));
+    if (props != NULL) {
+        props->entries = props->inlineEntries;
+        props->capacity = ES_PROPS_INLINE_CAPACITY;
+    }
+    return props;
 }
 
 void EsProperties_free(EsProperties *props) {
+    U_32 i;
+
     if (props != NULL) {
-        EsProperty *curr = props->head;
-        while (curr != NULL) {
-            EsProperty *temp = curr;
-            curr = curr->next;
-            free(temp->value);
-            free(temp);
+        for (i = 0; i < props->numEntries; i++) {
+            freeValue(props, props->entries[i].value);
+        }
+        if (props->entries != props->inlineEntries) {
+            free(props->entries);
         }
+        free(props->index);
         free(props);
     }
 }
 
 U_32 EsProperties_getSize(const EsProperties *props) {
-    U_32 numProps = 0;
-
-    if (props != NULL) {
-        EsProperty *curr = props->head;
-        while (curr != NULL) {
-            numProps++;
-            curr = curr->next;
-        }
-    }
-    return numProps;
+    return (props != NULL) ? props->numEntries : 0;
 }
 
 void EsProperties_atIndex(const EsProperties *props, U_32 index, EsPropertyPair *pair) {
-    EsProperty *curr = NULL;
-    U_32 i;
-
     if (pair != NULL) {
-        if (props != NULL) {
-            curr = props->head;
-            /* Cursor forward until index (or reached the end) */
-            for (i = 0; curr != NULL && i != index; curr = curr->next, i++);
-            if (curr != NULL && i == index) {
-                pair->key = curr->key;
-                pair->value = curr->value;
-            } else {
-                pair->key = NULL;
-                pair->value = NULL;
-            }
+        if (props != NULL && index < props->numEntries) {
+            pair->key = props->entries[index].key;
+            pair->value = props->entries[index].value;
         } else {
-            /* props or props head was NULL */
             pair->key = NULL;
             pair->value = NULL;
         }
@@ -164,52 +310,66 @@ void EsProperties_atIndex(const EsProperties *props, U_32 index, EsPropertyPair
 }
 
 const char *EsProperties_at(const EsProperties *props, const char *key) {
-    EsProperty *node = NULL;
+    I_32 entryIndex;
 
-    node = propertyNodeAt(props, key);
-    return (node != NULL) ? node->value : NULL;
+    entryIndex = propertyIndexAt(props, key);
+    return (entryIndex >= 0) ? props->entries[entryIndex].value : NULL;
 }
 
 void EsProperties_atPut(EsProperties *props, const char *key, char *value) {
+    I_32 entryIndex;
+    char *valueCopy;
+    EsProperty *entry;
+
     if (props != NULL && key != NULL && value != NULL) {
-        EsProperty *node = propertyNodeAt(props, key);
-        if (node != NULL) {
+        valueCopy = copyValue(props, value); /* Store Copy */
+        if (valueCopy == NULL) {
+            return;
+        }
+        entryIndex = propertyIndexAt(props, key);
+        if (entryIndex >= 0) {
             /* Update Existing Entry */
-            node->value = value;
-        } else {
-            /* New Entry */
-            node = newProperty(key, value);
-            if (props->head != NULL) {
-                EsProperty *lastNode = props->head;
-                while (lastNode->next != NULL) {
-                    lastNode = lastNode->next;
-                }
-                lastNode->next = node;
-            } else {
-                props->head = node;
+            entry = &props->entries[entryIndex];
+            freeValue(props, entry->value);
+            entry->value = valueCopy;
+        } else if (growIfFull(props)) {
+            /* New Entry (appended to keep insertion order) */
+            entry = &props->entries[props->numEntries];
+            entry->key = key;
+            entry->value = valueCopy;
+            entry->hash = hashKey(key);
+            if (props->index != NULL) {
+                indexInsert(props, props->numEntries);
             }
+            props->numEntries++;
+        } else {
+            freeValue(props, valueCopy);
         }
     }
 }
 
 BOOLEAN EsProperties_includesKey(const EsProperties *props, const char *key) {
-    return (EsProperties_at(props, key) != NULL) ? TRUE : FALSE;
+    return (propertyIndexAt(props, key) >= 0) ? TRUE : FALSE;
 }
 
 char *EsProperties_removeKey(EsProperties *props, const char *key) {
     char *value = NULL;
+    I_32 entryIndex;
 
-    EsProperty *node = propertyNodeAt(props, key);
-    if (node != NULL) {
-        EsProperty *beforeNode = propertyNodeBeforeNodeAt(props, key);
-        value = node->value;
-        if (beforeNode != NULL) {
-            beforeNode->next = node->next;
-        } else {
-            props->head = node->next;
+    entryIndex = propertyIndexAt(props, key);
+    if (entryIndex >= 0) {
+        value = props->entries[entryIndex].value;
+        if (isArenaValue(props, value)) {
+            /* The caller frees the answered value, so it must be a heap copy */
+            value = strdup(value);
+        }
+        /* Close the gap to keep insertion order, then reindex the shifted entries */
+        props->numEntries--;
+        memmove(&props->entries[entryIndex], &props->entries[entryIndex + 1],
+                sizeof(EsProperty) * (props->numEntries - (U_32) entryIndex));
+        if (props->index != NULL) {
+            rebuildIndex(props, props->indexMask + 1);
         }
-        node->next = NULL;
-        free(node);
     }
     return value;
 }
@@ -220,4 +380,3 @@ BOOLEAN EsProperties_valueEquals(const EsProperties *props, const char *key, con
     result = EsProperties_at(props, key);
     return (result != NULL && value != NULL) ? STREQ(result, value) : FALSE;
 }
-
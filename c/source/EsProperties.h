@@ -11,6 +11,16 @@
  *
  *  EsProperties is a sequenceable collection of EsPropertyPairs
  *  with the constraint that each EsPropertyPair has a unique key member.
+ *  Pairs are kept in insertion order.
+ *
+ *  Performance:
+ *  Pairs are hash-indexed, so key lookup (at, atPut, includesKey) is O(1),
+ *  as are getSize and atIndex. removeKey is O(n) since it keeps the order.
+ *  The first few pairs and their values are stored inside the properties
+ *  object itself, so small properties (i.e. task metadata) are a single
+ *  allocation and EsProperties_free() is a single free.
+ *  Keys are not copied, they are expected to be long-lived (i.e. literals).
+ *  Using the same literal for a key compares by identity before strcmp.
  *
  *  Map Interface:
  *  EsProperties *p = EsProperties_new();
@@ -121,6 +131,7 @@ BOOLEAN EsProperties_includesKey(const EsProperties *props, const char *key);
 
 /**
  * @brief Remove the key/value string pair and answer the old value
+ * @note The caller owns the answered value and must free() it
  * @param props
  * @param key null-terminated string
  * @return value null-terminated string
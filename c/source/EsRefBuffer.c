@@ -0,0 +1,282 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsRefBuffer.c
+ *  @brief Reference Counted Buffer Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "plibsys.h"
+
+#include "EsRefBuffer.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Max number of live buffers
+ */
+#define ES_REF_BUFFER_REGISTRY_CAPACITY     65536
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Hidden header in front of the buffer data
+ * @note 16 bytes so the data that follows is 8-byte aligned
+ */
+typedef struct _EsRefBufferHeader EsRefBufferHeader;
+struct _EsRefBufferHeader {
+    volatile I_32 refCount;
+    U_32 handle;
+    U_64 size;
+};
+
+/**
+ * @brief Registry of the live buffers
+ *
+ * Maps the handles given to Smalltalk to buffer headers.
+ * The lock orders handle lookups (and their count changes) against the
+ * removal of a buffer whose last reference was released, so a handle
+ * never answers a freed header.
+ */
+typedef struct _EsRefBufferRegistry EsRefBufferRegistry;
+struct _EsRefBufferRegistry {
+    PMutex *lock;
+    EsHandleTable *buffers;
+};
+
+/*******************************************/
+/*   M O D U L E  P R I V A T E  V A R S   */
+/*******************************************/
+
+/**
+ * @brief Registry of the live buffers
+ * @note Made on first use and kept for the life of the process,
+ * since buffers held by Smalltalk may outlive the library
+ */
+static EsRefBufferRegistry *volatile _Registry = NULL;
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Free a registry that was never published
+ * @param registry
+ */
+static void freeRegistry(EsRefBufferRegistry *registry) {
+    if (registry->lock != NULL) {
+        p_mutex_free(registry->lock);
+    }
+    EsHandleTable_free(registry->buffers);
+    free(registry);
+}
+
+/**
+ * @brief Answer the registry, make it on first use
+ * @return registry or NULL if out of memory
+ */
+static EsRefBufferRegistry *getRegistry() {
+    EsRefBufferRegistry *registry = (EsRefBufferRegistry *) p_atomic_pointer_get(&_Registry);
+
+    if (registry != NULL) {
+        return registry;
+    }
+    registry = (EsRefBufferRegistry *) calloc(1, sizeof(EsRefBufferRegistry));
+    if (registry == NULL) {
+        return NULL;
+    }
+    registry->lock = p_mutex_new();
+    registry->buffers = EsHandleTable_new(ES_REF_BUFFER_REGISTRY_CAPACITY);
+    if (registry->lock == NULL || registry->buffers == NULL) {
+        freeRegistry(registry);
+        return NULL;
+    }
+    if (!p_atomic_pointer_compare_and_exchange(&_Registry, NULL, registry)) {
+        /* Another thread made it first */
+        freeRegistry(registry);
+    }
+    return (EsRefBufferRegistry *) p_atomic_pointer_get(&_Registry);
+}
+
+/**
+ * @brief Answer the header of the buffer data
+ * @note Only for data from C, which holds a reference of the buffer
+ * @param data
+ * @return header or NULL if data is NULL
+ */
+static EsRefBufferHeader *headerOf(const void *data) {
+    return (data != NULL) ? ((EsRefBufferHeader *) data) - 1 : NULL;
+}
+
+/**
+ * @brief Unregister and free a buffer whose last reference was released
+ * @param header
+ */
+static void destroyBuffer(EsRefBufferHeader *header) {
+    EsRefBufferRegistry *registry = (EsRefBufferRegistry *) p_atomic_pointer_get(&_Registry);
+
+    p_mutex_lock(registry->lock);
+    EsHandleTable_remove(registry->buffers, header->handle);
+    p_mutex_unlock(registry->lock);
+    free(header);
+}
+
+/**
+ * @brief Add 1 to the count, unless it is 0 (the buffer is being freed)
+ * @param header
+ * @return TRUE if added, FALSE otherwise
+ */
+static BOOLEAN incrementIfLive(EsRefBufferHeader *header) {
+    I_32 count;
+
+    do {
+        count = p_atomic_int_get(&header->refCount);
+        if (count <= 0) {
+            return FALSE;
+        }
+    } while (!p_atomic_int_compare_and_exchange(&header->refCount, count, count + 1));
+    return TRUE;
+}
+
+/**
+ * @brief Subtract 1 from the count, unless it is 0 (the buffer is being freed)
+ * @param header
+ * @param last[out] TRUE if this removed the last reference
+ * @return TRUE if subtracted, FALSE otherwise
+ */
+static BOOLEAN decrementIfLive(EsRefBufferHeader *header, BOOLEAN *last) {
+    I_32 count;
+
+    do {
+        count = p_atomic_int_get(&header->refCount);
+        if (count <= 0) {
+            return FALSE;
+        }
+    } while (!p_atomic_int_compare_and_exchange(&header->refCount, count, count - 1));
+    *last = (BOOLEAN) (count == 1);
+    return TRUE;
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+void *EsRefBuffer_new(U_SIZE size) {
+    EsRefBufferRegistry *registry = getRegistry();
+    EsRefBufferHeader *header;
+
+    if (registry == NULL) {
+        return NULL;
+    }
+    header = (EsRefBufferHeader *) malloc(sizeof(EsRefBufferHeader) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->refCount = 1;
+    header->size = (U_64) size;
+    header->handle = EsHandleTable_add(registry->buffers, header);
+    if (header->handle == ES_HANDLE_NONE) {
+        free(header);
+        return NULL;
+    }
+    return header + 1;
+}
+
+void *EsRefBuffer_newCopy(const void *bytes, U_SIZE size) {
+    void *data;
+
+    data = EsRefBuffer_new(size);
+    if (data != NULL && bytes != NULL && size > 0) {
+        memcpy(data, bytes, size);
+    }
+    return data;
+}
+
+BOOLEAN EsRefBuffer_acquire(void *data) {
+    EsRefBufferHeader *header = headerOf(data);
+
+    if (header == NULL) {
+        return FALSE;
+    }
+    p_atomic_int_inc(&header->refCount);
+    return TRUE;
+}
+
+BOOLEAN EsRefBuffer_release(void *data) {
+    EsRefBufferHeader *header = headerOf(data);
+
+    if (header == NULL) {
+        return FALSE;
+    }
+    if (p_atomic_int_dec_and_test(&header->refCount)) {
+        destroyBuffer(header);
+    }
+    return TRUE;
+}
+
+BOOLEAN EsRefBuffer_acquireHandle(U_32 handle) {
+    EsRefBufferRegistry *registry = getRegistry();
+    EsRefBufferHeader *header;
+    BOOLEAN acquired = FALSE;
+
+    if (registry == NULL) {
+        return FALSE;
+    }
+    p_mutex_lock(registry->lock);
+    header = (EsRefBufferHeader *) EsHandleTable_at(registry->buffers, handle);
+    if (header != NULL) {
+        acquired = incrementIfLive(header);
+    }
+    p_mutex_unlock(registry->lock);
+    return acquired;
+}
+
+BOOLEAN EsRefBuffer_releaseHandle(U_32 handle) {
+    EsRefBufferRegistry *registry = getRegistry();
+    EsRefBufferHeader *header;
+    BOOLEAN released = FALSE;
+    BOOLEAN last = FALSE;
+
+    if (registry == NULL) {
+        return FALSE;
+    }
+    p_mutex_lock(registry->lock);
+    header = (EsRefBufferHeader *) EsHandleTable_at(registry->buffers, handle);
+    if (header != NULL) {
+        released = decrementIfLive(header, &last);
+        if (last) {
+            EsHandleTable_remove(registry->buffers, handle);
+        }
+    }
+    p_mutex_unlock(registry->lock);
+    if (last) {
+        free(header);
+    }
+    return released;
+}
+
+U_32 EsRefBuffer_getHandle(const void *data) {
+    EsRefBufferHeader *header = headerOf(data);
+
+    return (header != NULL) ? header->handle : ES_HANDLE_NONE;
+}
+
+U_SIZE EsRefBuffer_getSize(const void *data) {
+    EsRefBufferHeader *header = headerOf(data);
+
+    return (header != NULL) ? (U_SIZE) header->size : 0;
+}
+
+U_32 EsRefBuffer_getRefCount(const void *data) {
+    EsRefBufferHeader *header = headerOf(data);
+
+    return (header != NULL) ? (U_32) p_atomic_int_get(&header->refCount) : 0;
+}
@@ -0,0 +1,119 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsRefBuffer.h
+ *  @brief Reference Counted Buffer Interface
+ *  @author Seth Berman
+ *
+ *  A ref buffer is a block of bytes whose lifetime is tied to an atomic
+ *  reference count. Each holder (C or Smalltalk) acquires a reference and
+ *  releases it when done. The buffer is freed when the last reference is
+ *  released, so many holders can share the same bytes without a copy each.
+ *
+ *  C code, which always holds a reference, uses the address of the data.
+ *  A hidden header in front of the data holds the count and size.
+ *
+ *  Smalltalk reads the data as os memory (i.e. a message payload), but it
+ *  acquires/releases the buffer by its handle (@see EsHandleTable.h), since an
+ *  address coming from Smalltalk can not be trusted. Every live buffer is in a
+ *  registry of handles, so a stale or bogus handle is rejected without touching
+ *  the memory it once referred to.
+ *
+ *  U_8 *data = (U_8 *) EsRefBuffer_new(size);     <-- count is 1
+ *  EsRefBuffer_acquire(data);                     <-- count is 2
+ *  U_32 handle = EsRefBuffer_getHandle(data);
+ *  EsRefBuffer_releaseHandle(handle);             <-- count is 1
+ *  EsRefBuffer_release(data);                     <-- freed, handle is stale
+ *******************************************************************************/
+#ifndef ES_REF_BUFFER_H
+#define ES_REF_BUFFER_H
+
+#include "EsMqtt.h"
+#include "EsHandleTable.h"
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer the data of a new buffer with a reference count of 1
+ * @note The data contents are undefined
+ * @param size number of data bytes (may be 0)
+ * @return data or NULL if out of memory or too many live buffers
+ */
+void *EsRefBuffer_new(U_SIZE size);
+
+/**
+ * @brief Answer the data of a new buffer with a copy of the bytes
+ * @param bytes to copy (may be NULL if size is 0)
+ * @param size number of bytes
+ * @return data or NULL if out of memory or too many live buffers
+ */
+void *EsRefBuffer_newCopy(const void *bytes, U_SIZE size);
+
+/******************************************/
+/*   R E F E R E N C E  C O U N T I N G   */
+/******************************************/
+
+/**
+ * @brief Add a reference to the buffer
+ * @note thread-safe
+ * @param data of a live buffer the caller holds a reference of
+ * @return TRUE if acquired, FALSE if data is NULL
+ */
+BOOLEAN EsRefBuffer_acquire(void *data);
+
+/**
+ * @brief Remove a reference from the buffer.
+ * The buffer is freed when the last reference is removed.
+ * @note thread-safe
+ * @param data of a live buffer the caller holds a reference of
+ * @return TRUE if released, FALSE if data is NULL
+ */
+BOOLEAN EsRefBuffer_release(void *data);
+
+/**
+ * @brief Add a reference to the buffer of the handle
+ * @note thread-safe, for handles coming from Smalltalk
+ * @param handle
+ * @return TRUE if acquired, FALSE if the handle is not of a live buffer
+ */
+BOOLEAN EsRefBuffer_acquireHandle(U_32 handle);
+
+/**
+ * @brief Remove a reference from the buffer of the handle.
+ * The buffer is freed when the last reference is removed.
+ * @note thread-safe, for handles coming from Smalltalk
+ * @param handle
+ * @return TRUE if released, FALSE if the handle is not of a live buffer
+ */
+BOOLEAN EsRefBuffer_releaseHandle(U_32 handle);
+
+/*************************/
+/*   A C C E S S I N G   */
+/*************************/
+
+/**
+ * @brief Answer the handle of the buffer, which stays valid while it is live
+ * @param data
+ * @return handle or ES_HANDLE_NONE if data is NULL
+ */
+U_32 EsRefBuffer_getHandle(const void *data);
+
+/**
+ * @brief Answer the number of data bytes
+ * @param data
+ * @return size or 0 if data is NULL
+ */
+U_SIZE EsRefBuffer_getSize(const void *data);
+
+/**
+ * @brief Answer the current reference count
+ * @param data
+ * @return count or 0 if data is NULL
+ */
+U_32 EsRefBuffer_getRefCount(const void *data);
+
+#endif //ES_REF_BUFFER_H
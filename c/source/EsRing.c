@@ -0,0 +1,310 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsRing.c
+ *  @brief Lock-Free Ring Buffer Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "plibsys.h"
+
+#include "EsRing.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Size of the padding that keeps the producer and consumer
+ * positions on their own cache lines
+ */
+#define ES_RING_CACHE_LINE      64
+
+/**
+ * @brief Alignment of the slots
+ */
+#define ES_RING_SLOT_ALIGN      sizeof(U_64)
+
+/**
+ * @brief Ring positions
+ *
+ * Positions count up and wrap around in 31 bits. The top bit of
+ * the tail closes the ring, so no producer can claim a slot once it is set.
+ */
+#define ES_RING_POS_MASK        0x7FFFFFFFU
+#define ES_RING_CLOSED          0x80000000U
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Slot of one record
+ *
+ * A slot at position pos is free for the producer of pos when its
+ * sequence is pos, and holds the record for the consumer when it is pos + 1.
+ * The consumer frees it for the next round with pos + capacity.
+ */
+typedef struct _EsRingSlot EsRingSlot;
+struct _EsRingSlot {
+    volatile I_32 sequence;
+    U_32 reserved;
+    U_8 record[];
+};
+
+/**
+ * @brief Hidden implementation for EsRing
+ *
+ * Positions count up and wrap around, the slot index is the position
+ * masked by the capacity. Producers claim positions with a CAS on
+ * the tail, takers with a CAS on the head (a single consumer that
+ * peeks and pops just stores it).
+ */
+struct _EsRing {
+    U_32 mask;
+    U_32 recordSize;
+    U_32 slotSize;
+    U_8 *slots;
+    U_8 pad1[ES_RING_CACHE_LINE];
+    volatile I_32 tail;
+    U_8 pad2[ES_RING_CACHE_LINE - sizeof(I_32)];
+    volatile I_32 head;
+    U_8 pad3[ES_RING_CACHE_LINE - sizeof(I_32)];
+};
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Answer the slot of a position
+ * @param ring
+ * @param pos
+ * @return slot
+ */
+static EsRingSlot *getSlot(EsRing *ring, I_32 pos) {
+    return (EsRingSlot *) (ring->slots + (U_SIZE) ((U_32) pos & ring->mask) * ring->slotSize);
+}
+
+/**
+ * @brief Answer the position that follows pos by delta (wraps around)
+ * @param pos
+ * @param delta
+ * @return position
+ */
+static I_32 advancePos(I_32 pos, U_32 delta) {
+    return (I_32) (((U_32) pos + delta) & ES_RING_POS_MASK);
+}
+
+/**
+ * @brief Answer the distance of the sequence from the position
+ * @param sequence
+ * @param pos
+ * @return 0 if equal, < 0 if sequence is behind, > 0 if ahead
+ */
+static I_32 distance(I_32 sequence, I_32 pos) {
+    U_32 diff = ((U_32) sequence - (U_32) pos) & ES_RING_POS_MASK;
+
+    return (diff > (ES_RING_POS_MASK >> 1u)) ? (I_32) diff - (I_32) ES_RING_POS_MASK - 1 : (I_32) diff;
+}
+
+/**
+ * @brief Claim the run of free slots at the tail
+ * @param ring
+ * @param max number of slots wanted
+ * @param pos[out] position of the first claimed slot
+ * @return number of slots claimed, 0 if the ring is full or closed
+ */
+static U_32 claimTail(EsRing *ring, U_32 max, I_32 *pos) {
+    I_32 tail, dist;
+    U_32 n;
+
+    do {
+        tail = p_atomic_int_get(&ring->tail);
+        if (((U_32) tail & ES_RING_CLOSED) != 0) {
+            return 0;
+        }
+        n = 0;
+        dist = 0;
+        while (n < max && n <= ring->mask) {
+            dist = distance(p_atomic_int_get(&getSlot(ring, advancePos(tail, n))->sequence), advancePos(tail, n));
+            if (dist != 0) {
+                break;
+            }
+            n++;
+        }
+        if (n > 0) {
+            if (p_atomic_int_compare_and_exchange(&ring->tail, tail, advancePos(tail, n))) {
+                *pos = tail;
+                return n;
+            }
+        } else if (dist < 0) {
+            /* The consumer has not freed the slot of the last round */
+            return 0;
+        }
+        /* Another producer claimed the position (or the ring was closed) */
+    } while (TRUE);
+}
+
+/**
+ * @brief Claim the run of published slots at the head
+ * @param ring
+ * @param max number of slots wanted
+ * @param pos[out] position of the first claimed slot
+ * @return number of slots claimed, 0 if none is published
+ */
+static U_32 claimHead(EsRing *ring, U_32 max, I_32 *pos) {
+    I_32 head, dist;
+    U_32 n;
+
+    do {
+        head = p_atomic_int_get(&ring->head);
+        n = 0;
+        dist = 0;
+        while (n < max) {
+            dist = distance(p_atomic_int_get(&getSlot(ring, advancePos(head, n))->sequence), advancePos(head, n + 1));
+            if (dist != 0) {
+                break;
+            }
+            n++;
+        }
+        if (n > 0) {
+            if (p_atomic_int_compare_and_exchange(&ring->head, head, advancePos(head, n))) {
+                *pos = head;
+                return n;
+            }
+        } else if (dist < 0) {
+            return 0;
+        }
+        /* Another taker claimed the position */
+    } while (TRUE);
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+EsRing *EsRing_new(U_32 capacity, U_32 recordSize) {
+    EsRing *ring;
+    U_32 size = 2;
+    U_32 i;
+
+    if (capacity == 0 || capacity > ES_RING_MAX_CAPACITY || recordSize == 0 || recordSize > 0x7FFFFFF0U) {
+        return NULL;
+    }
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    ring = (EsRing *) calloc(1, sizeof(EsRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->mask = size - 1;
+    ring->recordSize = recordSize;
+    ring->slotSize = (U_32) ((sizeof(EsRingSlot) + recordSize + ES_RING_SLOT_ALIGN - 1) & ~(ES_RING_SLOT_ALIGN - 1));
+    ring->slots = (U_8 *) malloc((U_SIZE) size * ring->slotSize);
+    if (ring->slots == NULL) {
+        free(ring);
+        return NULL;
+    }
+    for (i = 0; i < size; i++) {
+        getSlot(ring, (I_32) i)->sequence = (I_32) i;
+    }
+    return ring;
+}
+
+void EsRing_free(EsRing *ring) {
+    if (ring != NULL) {
+        free(ring->slots);
+        free(ring);
+    }
+}
+
+BOOLEAN EsRing_push(EsRing *ring, const void *record, U_32 size) {
+    EsRingSlot *slot;
+    I_32 pos;
+
+    if (size > ring->recordSize || claimTail(ring, 1, &pos) == 0) {
+        return FALSE;
+    }
+    slot = getSlot(ring, pos);
+    memcpy(slot->record, record, size);
+    /* Publish the record to the consumer */
+    p_atomic_int_set(&slot->sequence, advancePos(pos, 1));
+    return TRUE;
+}
+
+U_32 EsRing_pushAll(EsRing *ring, const void *records, U_32 count) {
+    EsRingSlot *slot;
+    I_32 pos;
+    U_32 n, i;
+
+    n = claimTail(ring, count, &pos);
+    for (i = 0; i < n; i++) {
+        slot = getSlot(ring, advancePos(pos, i));
+        memcpy(slot->record, (const U_8 *) records + (U_SIZE) i * ring->recordSize, ring->recordSize);
+        p_atomic_int_set(&slot->sequence, advancePos(pos, i + 1));
+    }
+    return n;
+}
+
+void EsRing_close(EsRing *ring) {
+    I_32 tail;
+
+    do {
+        tail = p_atomic_int_get(&ring->tail);
+    } while (((U_32) tail & ES_RING_CLOSED) == 0
+             && !p_atomic_int_compare_and_exchange(&ring->tail, tail, (I_32) ((U_32) tail | ES_RING_CLOSED)));
+}
+
+const void *EsRing_peek(EsRing *ring) {
+    return EsRing_isReady(ring) ? getSlot(ring, ring->head)->record : NULL;
+}
+
+void EsRing_pop(EsRing *ring) {
+    I_32 pos = ring->head;
+
+    /* Free the slot for the producer of the next round */
+    p_atomic_int_set(&getSlot(ring, pos)->sequence, advancePos(pos, ring->mask + 1));
+    p_atomic_int_set(&ring->head, advancePos(pos, 1));
+}
+
+U_32 EsRing_takeAll(EsRing *ring, void *records, U_32 max) {
+    EsRingSlot *slot;
+    I_32 pos;
+    U_32 n, i;
+
+    n = claimHead(ring, max, &pos);
+    for (i = 0; i < n; i++) {
+        slot = getSlot(ring, advancePos(pos, i));
+        memcpy((U_8 *) records + (U_SIZE) i * ring->recordSize, slot->record, ring->recordSize);
+        p_atomic_int_set(&slot->sequence, advancePos(pos, i + ring->mask + 1));
+    }
+    return n;
+}
+
+BOOLEAN EsRing_isReady(EsRing *ring) {
+    I_32 pos = p_atomic_int_get(&ring->head);
+
+    return (BOOLEAN) (distance(p_atomic_int_get(&getSlot(ring, pos)->sequence), advancePos(pos, 1)) == 0);
+}
+
+U_32 EsRing_getCapacity(EsRing *ring) {
+    return ring->mask + 1;
+}
+
+U_32 EsRing_getCount(EsRing *ring) {
+    I_32 count;
+
+    count = distance((I_32) ((U_32) p_atomic_int_get(&ring->tail) & ES_RING_POS_MASK), p_atomic_int_get(&ring->head));
+    return (count > 0) ? (U_32) count : 0;
+}
+
+BOOLEAN EsRing_isClosed(EsRing *ring) {
+    return (BOOLEAN) (((U_32) p_atomic_int_get(&ring->tail) & ES_RING_CLOSED) != 0);
+}
@@ -0,0 +1,175 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsRing.h
+ *  @brief Lock-Free Ring Buffer Interface
+ *  @author Seth Berman
+ *
+ *  A ring is a bounded queue of fixed-size records.
+ *  Any number of threads can push records without taking a lock
+ *  (a full ring refuses the record instead of blocking the producer),
+ *  and they are taken out in the order their positions were claimed.
+ *  It is the one ring behind the trace buffer (@see EsMqttTrace.h) and
+ *  the ring buffer work queue (@see EsWorkQueue.h).
+ *
+ *  Each slot carries a sequence number that tells producers and the
+ *  consumer whose turn it is, so a record is only visible once it has
+ *  been written completely. A run of records is pushed (or taken) with a
+ *  single compareExchange of the tail (or head), plus one sequence store
+ *  per record.
+ *
+ *  Closing the ring refuses all later pushes. Records that were already
+ *  claimed are still published, so a consumer can drain the ring until
+ *  it is closed and empty.
+ *
+ *  Producer:
+ *  if (!EsRing_push(ring, &record, sizeof(record))) ...count the drop...
+ *
+ *  Single consumer (reads records in place):
+ *  while ((record = EsRing_peek(ring)) != NULL) {
+ *      ...read record...
+ *      EsRing_pop(ring);
+ *  }
+ *
+ *  Any number of takers (copy records out):
+ *  n = EsRing_takeAll(ring, records, max);
+ *******************************************************************************/
+#ifndef ES_RING_H
+#define ES_RING_H
+
+#include "EsMqtt.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Upper bound of the ring capacity
+ */
+#define ES_RING_MAX_CAPACITY    (1 << 24)
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Ring of fixed-size records
+ * @note This is an opaque datatype
+ */
+typedef struct _EsRing EsRing;
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer a new empty ring
+ * @param capacity number of records (rounded up to a power of 2, at most ES_RING_MAX_CAPACITY)
+ * @param recordSize number of bytes of each record (> 0)
+ * @return ring or NULL if an argument is out of range or out of memory
+ */
+EsRing *EsRing_new(U_32 capacity, U_32 recordSize);
+
+/**
+ * @brief Destroy the ring and the records it holds
+ * @note There must be no producers or consumer using the ring
+ * @param ring may be NULL
+ */
+void EsRing_free(EsRing *ring);
+
+/*************************/
+/*   P R O D U C E R S   */
+/*************************/
+
+/**
+ * @brief Push a copy of the record
+ * @note thread-safe and lock-free
+ * @param ring
+ * @param record
+ * @param size number of bytes to copy (at most the record size, the rest is undefined)
+ * @return TRUE if pushed, FALSE if the ring is full, closed or size is too large
+ */
+BOOLEAN EsRing_push(EsRing *ring, const void *record, U_32 size);
+
+/**
+ * @brief Push copies of as many of the records as there is room for
+ * @note thread-safe and lock-free
+ * @param ring
+ * @param records count records of the record size each, back-to-back
+ * @param count number of records
+ * @return number of records pushed (from the front of records), 0 if full or closed
+ */
+U_32 EsRing_pushAll(EsRing *ring, const void *records, U_32 count);
+
+/**
+ * @brief Refuse all later pushes
+ * @note thread-safe, closing a closed ring does nothing
+ * @param ring
+ */
+void EsRing_close(EsRing *ring);
+
+/***********************/
+/*   C O N S U M E R   */
+/***********************/
+
+/**
+ * @brief Answer the oldest record without removing it
+ * @note Single consumer only, not mixed with EsRing_takeAll()
+ * @param ring
+ * @return record or NULL if the ring is empty
+ */
+const void *EsRing_peek(EsRing *ring);
+
+/**
+ * @brief Remove the oldest record (the one answered by EsRing_peek())
+ * @note Single consumer only, and only after EsRing_peek() answered a record
+ * @param ring
+ */
+void EsRing_pop(EsRing *ring);
+
+/**
+ * @brief Remove up to max of the oldest records and copy them out
+ * @note thread-safe and lock-free, not mixed with EsRing_peek()/EsRing_pop()
+ * @param ring
+ * @param records[out] room for max records of the record size each
+ * @param max number of records to take
+ * @return number of records taken (in order), 0 if none is published
+ */
+U_32 EsRing_takeAll(EsRing *ring, void *records, U_32 max);
+
+/**
+ * @brief Answer if the oldest record is published, so it can be taken
+ * @param ring
+ * @return TRUE if a record is ready, FALSE otherwise
+ */
+BOOLEAN EsRing_isReady(EsRing *ring);
+
+/*************************/
+/*   A C C E S S I N G   */
+/*************************/
+
+/**
+ * @brief Answer the number of records the ring can hold
+ * @param ring
+ * @return capacity
+ */
+U_32 EsRing_getCapacity(EsRing *ring);
+
+/**
+ * @brief Answer the number of claimed records (published or not)
+ * @note This is a snapshot since producers and consumers may be active
+ * @param ring
+ * @return count
+ */
+U_32 EsRing_getCount(EsRing *ring);
+
+/**
+ * @brief Answer if the ring was closed
+ * @param ring
+ * @return TRUE if closed, FALSE otherwise
+ */
+BOOLEAN EsRing_isClosed(EsRing *ring);
+
+#endif //ES_RING_H
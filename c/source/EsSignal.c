@@ -0,0 +1,91 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsSignal.c
+ *  @brief Wait/Notify Signal Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+
+#include "plibsys.h"
+
+#include "EsSignal.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Hidden implementation for EsSignal
+ *
+ * The generation is an event count which is bumped
+ * (under the lock) on every notify that has waiters.
+ * A ticket is the generation seen by the waiter, so
+ * the waiter sleeps until the generation moves on.
+ */
+struct _EsSignal {
+    PMutex *lock;
+    PCondVariable *cond;
+    volatile I_32 generation;
+    volatile I_32 numWaiters;
+};
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+EsSignal *EsSignal_new() {
+    EsSignal *signal;
+
+    signal = (EsSignal *) calloc(1, sizeof(EsSignal));
+    if (signal != NULL) {
+        signal->lock = p_mutex_new();
+        signal->cond = p_cond_variable_new();
+        if (signal->lock == NULL || signal->cond == NULL) {
+            EsSignal_free(signal);
+            signal = NULL;
+        }
+    }
+    return signal;
+}
+
+void EsSignal_free(EsSignal *signal) {
+    if (signal != NULL) {
+        if (signal->cond != NULL) {
+            p_cond_variable_free(signal->cond);
+        }
+        if (signal->lock != NULL) {
+            p_mutex_free(signal->lock);
+        }
+        free(signal);
+    }
+}
+
+U_32 EsSignal_prepareWait(EsSignal *signal) {
+    p_atomic_int_inc(&signal->numWaiters);
+    return (U_32) p_atomic_int_get(&signal->generation);
+}
+
+void EsSignal_cancelWait(EsSignal *signal) {
+    p_atomic_int_dec_and_test(&signal->numWaiters);
+}
+
+void EsSignal_wait(EsSignal *signal, U_32 ticket) {
+    p_mutex_lock(signal->lock);
+    while ((U_32) signal->generation == ticket) {
+        p_cond_variable_wait(signal->cond, signal->lock);
+    }
+    p_mutex_unlock(signal->lock);
+    p_atomic_int_dec_and_test(&signal->numWaiters);
+}
+
+void EsSignal_notifyAll(EsSignal *signal) {
+    if (signal != NULL && p_atomic_int_get(&signal->numWaiters) > 0) {
+        p_mutex_lock(signal->lock);
+        p_atomic_int_inc(&signal->generation);
+        p_mutex_unlock(signal->lock);
+        p_cond_variable_broadcast(signal->cond);
+    }
+}
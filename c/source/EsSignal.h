@@ -0,0 +1,103 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsSignal.h
+ *  @brief Wait/Notify Signal Interface for blocking on state changes
+ *  @author Seth Berman
+ *
+ *  A signal lets threads sleep until some shared state (which is usually
+ *  updated with lock-free atomics) changes, instead of spinning or polling.
+ *
+ *  A waiter first takes a ticket, then checks the state and only waits if
+ *  the state is still not what it needs. A notifier updates the state and
+ *  then notifies. Any notify that happens after the ticket was taken will
+ *  end the wait, so no wakeups are lost between the check and the wait.
+ *
+ *  Notifying is cheap when there are no waiters (a single atomic read), so
+ *  producers on a hot path can notify unconditionally.
+ *
+ *  @example Wait until count drops to 0
+ *  while (TRUE) {
+ *      U_32 ticket = EsSignal_prepareWait(signal);
+ *      if (p_atomic_int_get(&count) == 0) {
+ *          EsSignal_cancelWait(signal);
+ *          break;
+ *      }
+ *      EsSignal_wait(signal, ticket);
+ *  }
+ *
+ *  @example Notify from another thread
+ *  if (p_atomic_int_dec_and_test(&count)) {
+ *      EsSignal_notifyAll(signal);
+ *  }
+ *
+ *******************************************************************************/
+#ifndef ES_SIGNAL_H
+#define ES_SIGNAL_H
+
+#include "EsMqtt.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Wait/Notify signal
+ * @note This is an opaque datatype
+ */
+typedef struct _EsSignal EsSignal;
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer a new signal
+ * @return signal or NULL if out of memory
+ */
+EsSignal *EsSignal_new();
+
+/**
+ * @brief Destroy the signal
+ * @note There must not be any waiters
+ * @param signal
+ */
+void EsSignal_free(EsSignal *signal);
+
+/*******************************/
+/*   W A I T / N O T I F Y   */
+/*******************************/
+
+/**
+ * @brief Register as a waiter and answer a ticket
+ * @note Must be followed by either EsSignal_wait() or EsSignal_cancelWait()
+ * @param signal
+ * @return ticket to pass to EsSignal_wait()
+ */
+U_32 EsSignal_prepareWait(EsSignal *signal);
+
+/**
+ * @brief Unregister as a waiter without waiting
+ * @note Use when the state checked after EsSignal_prepareWait() is ready
+ * @param signal
+ */
+void EsSignal_cancelWait(EsSignal *signal);
+
+/**
+ * @brief Block until a notify occurs after the ticket was taken
+ * @note Returns right away if a notify already occurred
+ * @param signal
+ * @param ticket from EsSignal_prepareWait()
+ */
+void EsSignal_wait(EsSignal *signal, U_32 ticket);
+
+/**
+ * @brief Wake up all threads waiting on the signal
+ * @note thread-safe
+ * @param signal
+ */
+void EsSignal_notifyAll(EsSignal *signal);
+
+#endif //ES_SIGNAL_H
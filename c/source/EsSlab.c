@@ -0,0 +1,195 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsSlab.c
+ *  @brief Fixed-Size Block (Slab) Allocator Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+
+#include "plibsys.h"
+
+#include "EsSlab.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Alignment of every block (and size of the chunk header)
+ */
+#define ES_SLAB_ALIGNMENT       sizeof(U_64)
+
+/**
+ * @brief Round _n up to the block alignment
+ */
+#define ES_SLAB_ALIGN(_n)       (((_n) + ES_SLAB_ALIGNMENT - 1) & ~(ES_SLAB_ALIGNMENT - 1))
+
+/**
+ * @brief Default number of blocks per chunk
+ */
+#define ES_SLAB_DEFAULT_BLOCKS_PER_CHUNK    64
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Free block
+ * @note Overlays the first bytes of a free block
+ */
+typedef struct _EsSlabFreeBlock EsSlabFreeBlock;
+struct _EsSlabFreeBlock {
+    EsSlabFreeBlock *next;
+};
+
+/**
+ * @brief Chunk header
+ * @note Padded so the blocks that follow are aligned
+ */
+typedef union _EsSlabChunk EsSlabChunk;
+union _EsSlabChunk {
+    EsSlabChunk *next;
+    U_64 align;
+};
+
+/**
+ * @brief Hidden implementation for EsSlab
+ *
+ * Free blocks are linked through their first bytes,
+ * and chunks are linked through their header.
+ * All state is guarded by the lock.
+ */
+struct _EsSlab {
+    PMutex *lock;
+    EsSlabFreeBlock *freeBlocks;
+    EsSlabChunk *chunks;
+    U_32 blockSize;
+    U_32 blocksPerChunk;
+    U_32 numBlocks;
+    U_32 numInUse;
+    U_32 highWater;
+};
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Add a new chunk and put its blocks on the free list
+ * @note lock must be held
+ * @param slab
+ * @return TRUE if grown, FALSE if out of memory
+ */
+static BOOLEAN slabGrow(EsSlab *slab) {
+    EsSlabChunk *chunk;
+    EsSlabFreeBlock *block;
+    U_8 *blocks;
+    U_32 i;
+
+    chunk = (EsSlabChunk *) malloc(sizeof(EsSlabChunk) + (size_t) slab->blockSize * slab->blocksPerChunk);
+    if (chunk == NULL) {
+        return FALSE;
+    }
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+
+    /* Link in reverse so blocks are handed out in address order */
+    blocks = (U_8 *) (chunk + 1);
+    for (i = slab->blocksPerChunk; i > 0; i--) {
+        block = (EsSlabFreeBlock *) (blocks + (size_t) (i - 1) * slab->blockSize);
+        block->next = slab->freeBlocks;
+        slab->freeBlocks = block;
+    }
+    slab->numBlocks += slab->blocksPerChunk;
+    return TRUE;
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+EsSlab *EsSlab_new(U_32 blockSize, U_32 blocksPerChunk) {
+    EsSlab *slab;
+
+    slab = (EsSlab *) calloc(1, sizeof(EsSlab));
+    if (slab != NULL) {
+        if (blockSize < sizeof(EsSlabFreeBlock)) {
+            blockSize = sizeof(EsSlabFreeBlock);
+        }
+        slab->blockSize = (U_32) ES_SLAB_ALIGN(blockSize);
+        slab->blocksPerChunk = (blocksPerChunk > 0) ? blocksPerChunk : ES_SLAB_DEFAULT_BLOCKS_PER_CHUNK;
+        slab->lock = p_mutex_new();
+        if (slab->lock == NULL) {
+            free(slab);
+            slab = NULL;
+        }
+    }
+    return slab;
+}
+
+void EsSlab_free(EsSlab *slab) {
+    EsSlabChunk *chunk;
+
+    if (slab != NULL) {
+        while ((chunk = slab->chunks) != NULL) {
+            slab->chunks = chunk->next;
+            free(chunk);
+        }
+        p_mutex_free(slab->lock);
+        free(slab);
+    }
+}
+
+void *EsSlab_alloc(EsSlab *slab) {
+    EsSlabFreeBlock *block = NULL;
+
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    p_mutex_lock(slab->lock);
+    if (slab->freeBlocks != NULL || slabGrow(slab)) {
+        block = slab->freeBlocks;
+        slab->freeBlocks = block->next;
+        slab->numInUse++;
+        if (slab->numInUse > slab->highWater) {
+            slab->highWater = slab->numInUse;
+        }
+    }
+    p_mutex_unlock(slab->lock);
+    return block;
+}
+
+void EsSlab_release(EsSlab *slab, void *block) {
+    EsSlabFreeBlock *freeBlock = (EsSlabFreeBlock *) block;
+
+    if (slab == NULL || block == NULL) {
+        return;
+    }
+
+    p_mutex_lock(slab->lock);
+    freeBlock->next = slab->freeBlocks;
+    slab->freeBlocks = freeBlock;
+    slab->numInUse--;
+    p_mutex_unlock(slab->lock);
+}
+
+void EsSlab_getStats(EsSlab *slab, EsSlabStats *stats) {
+    if (stats == NULL) {
+        return;
+    }
+    if (slab == NULL) {
+        stats->blockSize = stats->numBlocks = stats->numInUse = stats->highWater = 0;
+        return;
+    }
+
+    p_mutex_lock(slab->lock);
+    stats->blockSize = slab->blockSize;
+    stats->numBlocks = slab->numBlocks;
+    stats->numInUse = slab->numInUse;
+    stats->highWater = slab->highWater;
+    p_mutex_unlock(slab->lock);
+}
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsSlab.h
+ *  @brief Fixed-Size Block (Slab) Allocator Interface
+ *  @author Seth Berman
+ *
+ *  A slab hands out memory blocks that all have the same size.
+ *  Blocks are carved out of larger chunks, and released blocks are kept
+ *  on a free list for the next allocation instead of being returned to
+ *  the system allocator. This makes alloc/release a short critical section
+ *  with no call to the system (or vm) allocator in the steady state.
+ *
+ *  Chunks are only returned when the slab is freed, so the memory held by
+ *  a slab is the high-water mark of blocks in use, rounded up to chunks.
+ *  Statistics are available to tune the chunk size.
+ *
+ *  EsSlab *slab = EsSlab_new(sizeof(MyStruct), 64);
+ *  MyStruct *s = (MyStruct *) EsSlab_alloc(slab);
+ *  ...
+ *  EsSlab_release(slab, s);
+ *  EsSlab_free(slab);
+ *******************************************************************************/
+#ifndef ES_SLAB_H
+#define ES_SLAB_H
+
+#include "EsMqtt.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Fixed-size block allocator
+ * @note This is an opaque datatype
+ */
+typedef struct _EsSlab EsSlab;
+
+/**
+ * @brief Slab statistics snapshot
+ *
+ * blockSize: Size of each block in bytes (after alignment)
+ * numBlocks: Number of blocks carved out of chunks (capacity)
+ * numInUse: Number of blocks currently allocated (occupancy)
+ * highWater: Max number of blocks that were allocated at the same time
+ */
+typedef struct _EsSlabStats EsSlabStats;
+struct _EsSlabStats {
+    U_32 blockSize;
+    U_32 numBlocks;
+    U_32 numInUse;
+    U_32 highWater;
+};
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer a new slab
+ * @param blockSize size in bytes of each block
+ * @param blocksPerChunk number of blocks to add each time the slab grows
+ * @return slab or NULL if out of memory
+ */
+EsSlab *EsSlab_new(U_32 blockSize, U_32 blocksPerChunk);
+
+/**
+ * @brief Destroy the slab and all its chunks
+ * @note All blocks allocated from the slab become invalid
+ * @param slab
+ */
+void EsSlab_free(EsSlab *slab);
+
+/***************************/
+/*   A L L O C A T I O N   */
+/***************************/
+
+/**
+ * @brief Answer a block from the slab
+ * @note thread-safe
+ * @note The block contents are undefined
+ * @param slab
+ * @return block or NULL if out of memory
+ */
+void *EsSlab_alloc(EsSlab *slab);
+
+/**
+ * @brief Give back a block to the slab it was allocated from
+ * @note thread-safe
+ * @param slab
+ * @param block
+ */
+void EsSlab_release(EsSlab *slab, void *block);
+
+/*************************/
+/*   A C C E S S I N G   */
+/*************************/
+
+/**
+ * @brief Read a snapshot of the slab statistics
+ * @note thread-safe
+ * @param slab
+ * @param stats[out] zeroed if slab is NULL
+ */
+void EsSlab_getStats(EsSlab *slab, EsSlabStats *stats);
+
+#endif //ES_SLAB_H
@@ -0,0 +1,230 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsTopicTable.c
+ *  @brief Topic Name Table Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "EsTopicTable.h"
+
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Initial number of buckets (power of 2)
+ */
+#define ES_TOPIC_TABLE_INITIAL_BUCKETS  16
+
+/**
+ * @brief FNV-1a 64-bit hash parameters
+ */
+#define ES_TOPIC_TABLE_FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define ES_TOPIC_TABLE_FNV_PRIME        0x00000100000001B3ULL
+
+/**
+ * @brief Alignment of the state that follows the topic name
+ */
+#define ES_TOPIC_TABLE_STATE_ALIGN      sizeof(U_64)
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Table entry of one topic name
+ *
+ * The topic name and the state are allocated with the entry,
+ * the state is aligned after the topic name.
+ */
+typedef struct _EsTopicTableEntry EsTopicTableEntry;
+struct _EsTopicTableEntry {
+    EsTopicTableEntry *next;
+    U_64 topicHash;
+    void *state;
+    U_32 topicLen;
+    char topic[];
+};
+
+/**
+ * @brief Hidden implementation for EsTopicTable
+ *
+ * Entries are kept in a chained hash table that doubles
+ * when it holds more entries than buckets.
+ */
+struct _EsTopicTable {
+    EsTopicTableEntry **buckets;
+    U_32 numBuckets;
+    U_32 size;
+    U_32 stateSize;
+    U_32 maxTopics;
+};
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Answer the FNV-1a hash of the topic name
+ * @param topic
+ * @param topicLen
+ * @return hash
+ */
+static U_64 hashTopic(const char *topic, U_32 topicLen) {
+    U_64 hash = ES_TOPIC_TABLE_FNV_OFFSET_BASIS;
+    U_32 i;
+
+    for (i = 0; i < topicLen; i++) {
+        hash ^= (U_64) (U_8) topic[i];
+        hash *= ES_TOPIC_TABLE_FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Rehash the entries into twice the number of buckets
+ * @note The table is left as is if out of memory
+ * @param table
+ */
+static void growTable(EsTopicTable *table) {
+    EsTopicTableEntry **buckets;
+    EsTopicTableEntry *entry;
+    EsTopicTableEntry *next;
+    U_32 numBuckets = table->numBuckets * 2;
+    U_32 i;
+
+    buckets = (EsTopicTableEntry **) calloc(numBuckets, sizeof(EsTopicTableEntry *));
+    if (buckets == NULL) {
+        return;
+    }
+    for (i = 0; i < table->numBuckets; i++) {
+        for (entry = table->buckets[i]; entry != NULL; entry = next) {
+            next = entry->next;
+            entry->next = buckets[entry->topicHash & (numBuckets - 1)];
+            buckets[entry->topicHash & (numBuckets - 1)] = entry;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->numBuckets = numBuckets;
+}
+
+/**
+ * @brief Answer the entry of the topic name
+ * @param table
+ * @param topic
+ * @param topicLen (not 0)
+ * @param topicHash
+ * @return entry or NULL if not found
+ */
+static EsTopicTableEntry *findEntry(EsTopicTable *table, const char *topic, U_32 topicLen, U_64 topicHash) {
+    EsTopicTableEntry *entry;
+
+    for (entry = table->buckets[topicHash & (table->numBuckets - 1)]; entry != NULL; entry = entry->next) {
+        if (entry->topicHash == topicHash && entry->topicLen == topicLen
+            && memcmp(entry->topic, topic, topicLen) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+EsTopicTable *EsTopicTable_new(U_32 stateSize, U_32 maxTopics) {
+    EsTopicTable *table;
+
+    if (maxTopics == 0) {
+        return NULL;
+    }
+
+    table = (EsTopicTable *) calloc(1, sizeof(EsTopicTable));
+    if (table != NULL) {
+        table->stateSize = stateSize;
+        table->maxTopics = maxTopics;
+        table->numBuckets = ES_TOPIC_TABLE_INITIAL_BUCKETS;
+        table->buckets = (EsTopicTableEntry **) calloc(table->numBuckets, sizeof(EsTopicTableEntry *));
+        if (table->buckets == NULL) {
+            free(table);
+            table = NULL;
+        }
+    }
+    return table;
+}
+
+void EsTopicTable_free(EsTopicTable *table) {
+    EsTopicTableEntry *entry;
+    U_32 i;
+
+    if (table == NULL) {
+        return;
+    }
+
+    for (i = 0; i < table->numBuckets; i++) {
+        while ((entry = table->buckets[i]) != NULL) {
+            table->buckets[i] = entry->next;
+            free(entry);
+        }
+    }
+    free(table->buckets);
+    free(table);
+}
+
+void *EsTopicTable_at(EsTopicTable *table, const char *topic, U_32 topicLen) {
+    EsTopicTableEntry *entry;
+
+    if (topicLen == 0) {
+        topicLen = (U_32) strlen(topic);
+    }
+    entry = findEntry(table, topic, topicLen, hashTopic(topic, topicLen));
+    return (entry != NULL) ? entry->state : NULL;
+}
+
+void *EsTopicTable_atOrAdd(EsTopicTable *table, const char *topic, U_32 topicLen) {
+    EsTopicTableEntry *entry;
+    EsTopicTableEntry **bucket;
+    U_64 topicHash;
+    U_SIZE stateOffset;
+
+    if (topicLen == 0) {
+        topicLen = (U_32) strlen(topic);
+    }
+    topicHash = hashTopic(topic, topicLen);
+    entry = findEntry(table, topic, topicLen, topicHash);
+    if (entry != NULL) {
+        return entry->state;
+    }
+
+    if (table->size >= table->maxTopics) {
+        return NULL;
+    }
+    stateOffset = sizeof(EsTopicTableEntry) + topicLen;
+    stateOffset = (stateOffset + ES_TOPIC_TABLE_STATE_ALIGN - 1) & ~(ES_TOPIC_TABLE_STATE_ALIGN - 1);
+    entry = (EsTopicTableEntry *) calloc(1, stateOffset + table->stateSize);
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->topicHash = topicHash;
+    entry->state = (U_8 *) entry + stateOffset;
+    entry->topicLen = topicLen;
+    memcpy(entry->topic, topic, topicLen);
+    bucket = &table->buckets[topicHash & (table->numBuckets - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    table->size++;
+    if (table->size > table->numBuckets) {
+        growTable(table);
+    }
+    return entry->state;
+}
+
+U_32 EsTopicTable_getSize(EsTopicTable *table) {
+    return table->size;
+}
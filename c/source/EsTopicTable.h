@@ -0,0 +1,79 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsTopicTable.h
+ *  @brief Topic Name Table Interface
+ *  @author Seth Berman
+ *
+ *  A topic table keeps a fixed-size state for each topic name, i.e. the
+ *  per-topic state of a message filter. States are zeroed when a topic
+ *  name is added and live until the table is freed.
+ *  The number of topic names is capped, since they come from the network.
+ *
+ *  The table is not thread-safe, the caller guards it with its own lock.
+ *******************************************************************************/
+#ifndef ES_TOPIC_TABLE_H
+#define ES_TOPIC_TABLE_H
+
+#include "EsMqtt.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Topic name table
+ * @note This is an opaque datatype
+ */
+typedef struct _EsTopicTable EsTopicTable;
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer a new empty table
+ * @param stateSize number of bytes of each state
+ * @param maxTopics upper bound of the topic names (> 0)
+ * @return table or NULL if maxTopics is 0 or out of memory
+ */
+EsTopicTable *EsTopicTable_new(U_32 stateSize, U_32 maxTopics);
+
+/**
+ * @brief Destroy the table and its states
+ * @param table may be NULL
+ */
+void EsTopicTable_free(EsTopicTable *table);
+
+/*************************/
+/*   A C C E S S I N G   */
+/*************************/
+
+/**
+ * @brief Answer the state of the topic name
+ * @param table
+ * @param topic topic name
+ * @param topicLen length of the topic name (0 if null-terminated)
+ * @return state or NULL if the topic name is not in the table
+ */
+void *EsTopicTable_at(EsTopicTable *table, const char *topic, U_32 topicLen);
+
+/**
+ * @brief Answer the state of the topic name, adding a zeroed state on first use
+ * @param table
+ * @param topic topic name
+ * @param topicLen length of the topic name (0 if null-terminated)
+ * @return state or NULL if the table is full or out of memory
+ */
+void *EsTopicTable_atOrAdd(EsTopicTable *table, const char *topic, U_32 topicLen);
+
+/**
+ * @brief Answer the number of topic names
+ * @param table
+ * @return number of topic names
+ */
+U_32 EsTopicTable_getSize(EsTopicTable *table);
+
+#endif //ES_TOPIC_TABLE_H
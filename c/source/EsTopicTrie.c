@@ -0,0 +1,367 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsTopicTrie.c
+ *  @brief MQTT Topic Filter Trie Implementation
+ *  @author Seth Berman
+ *******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "plibsys.h"
+
+#include "EsTopicTrie.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Trie node for one topic level
+ *
+ * Exact levels are kept in the sibling list of children,
+ * the wildcard levels have their own child pointer.
+ * The level string is allocated with the node.
+ */
+typedef struct _EsTopicTrieNode EsTopicTrieNode;
+struct _EsTopicTrieNode {
+    EsTopicTrieNode *parent;
+    EsTopicTrieNode *children;
+    EsTopicTrieNode *nextSibling;
+    EsTopicTrieNode *plusChild;
+    EsTopicTrieNode *hashChild;
+    void *value;
+    U_32 levelLen;
+    char level[];
+};
+
+/**
+ * @brief Hidden implementation for EsTopicTrie
+ *
+ * Matching takes the read lock, put/remove take the write lock.
+ */
+struct _EsTopicTrie {
+    PRWLock *lock;
+    EsTopicTrieNode *root;
+    U_32 size;
+};
+
+/*********************/
+/*   U T I L I T Y   */
+/*********************/
+
+/**
+ * @brief Answer the end of the level that starts at p
+ * @param p start of the level
+ * @param end end of the topic
+ * @return end of the level ('/' or end)
+ */
+static const char *levelEnd(const char *p, const char *end) {
+    const char *q = (const char *) memchr(p, '/', (size_t) (end - p));
+    return (q != NULL) ? q : end;
+}
+
+/**
+ * @brief Answer a new node for the level
+ * @param level
+ * @param levelLen
+ * @param parent
+ * @return node or NULL if out of memory
+ */
+static EsTopicTrieNode *newNode(const char *level, U_32 levelLen, EsTopicTrieNode *parent) {
+    EsTopicTrieNode *node;
+
+    node = (EsTopicTrieNode *) calloc(1, sizeof(EsTopicTrieNode) + levelLen + 1);
+    if (node != NULL) {
+        memcpy(node->level, level, levelLen);
+        node->level[levelLen] = '\0';
+        node->levelLen = levelLen;
+        node->parent = parent;
+    }
+    return node;
+}
+
+/**
+ * @brief Free the node and all of its descendants
+ * @param node may be NULL
+ * @param freeFunc frees each value (may be NULL)
+ */
+static void freeNode(EsTopicTrieNode *node, EsTopicTrieFreeFunc freeFunc) {
+    EsTopicTrieNode *child;
+
+    if (node == NULL) {
+        return;
+    }
+    while ((child = node->children) != NULL) {
+        node->children = child->nextSibling;
+        freeNode(child, freeFunc);
+    }
+    freeNode(node->plusChild, freeFunc);
+    freeNode(node->hashChild, freeFunc);
+    if (node->value != NULL && freeFunc != NULL) {
+        freeFunc(node->value);
+    }
+    free(node);
+}
+
+/**
+ * @brief Answer the child for the level
+ * @param node
+ * @param level
+ * @param levelLen
+ * @param create TRUE to add the child if there is none
+ * @return child or NULL if not found (or out of memory)
+ */
+static EsTopicTrieNode *childAt(EsTopicTrieNode *node, const char *level, U_32 levelLen, BOOLEAN create) {
+    EsTopicTrieNode **slot;
+    EsTopicTrieNode *child;
+
+    if (levelLen == 1 && level[0] == '+') {
+        slot = &node->plusChild;
+    } else if (levelLen == 1 && level[0] == '#') {
+        slot = &node->hashChild;
+    } else {
+        for (child = node->children; child != NULL; child = child->nextSibling) {
+            if (child->levelLen == levelLen && memcmp(child->level, level, levelLen) == 0) {
+                return child;
+            }
+        }
+        if (!create || (child = newNode(level, levelLen, node)) == NULL) {
+            return NULL;
+        }
+        child->nextSibling = node->children;
+        node->children = child;
+        return child;
+    }
+
+    if (*slot == NULL && create) {
+        *slot = newNode(level, levelLen, node);
+    }
+    return *slot;
+}
+
+/**
+ * @brief Unlink and free nodes that no longer lead to a value
+ * @param node to start pruning from (towards the root)
+ * @param root is never pruned
+ */
+static void pruneNode(EsTopicTrieNode *node, EsTopicTrieNode *root) {
+    EsTopicTrieNode *parent;
+    EsTopicTrieNode **link;
+
+    while (node != root && node->value == NULL && node->children == NULL
+           && node->plusChild == NULL && node->hashChild == NULL) {
+        parent = node->parent;
+        if (parent->plusChild == node) {
+            parent->plusChild = NULL;
+        } else if (parent->hashChild == node) {
+            parent->hashChild = NULL;
+        } else {
+            for (link = &parent->children; *link != node; link = &(*link)->nextSibling);
+            *link = node->nextSibling;
+        }
+        free(node);
+        node = parent;
+    }
+}
+
+/**
+ * @brief Answer the node of the most specific filter that matches the topic levels
+ *
+ * @param node to match the level at p against its children
+ * @param p start of the level, or NULL if all levels are matched
+ * @param end end of the topic
+ * @param isFirst TRUE if p is the first level
+ * @return node with a value or NULL if no match
+ */
+static EsTopicTrieNode *matchNode(EsTopicTrieNode *node, const char *p, const char *end, BOOLEAN isFirst) {
+    EsTopicTrieNode *child;
+    EsTopicTrieNode *match;
+    const char *q;
+    const char *next;
+    BOOLEAN wildcards;
+
+    if (p == NULL) {
+        if (node->value != NULL) {
+            return node;
+        }
+        /* "a/#" also matches "a" */
+        return (node->hashChild != NULL && node->hashChild->value != NULL) ? node->hashChild : NULL;
+    }
+
+    q = levelEnd(p, end);
+    next = (q < end) ? q + 1 : NULL;
+    for (child = node->children; child != NULL; child = child->nextSibling) {
+        if (child->levelLen == (U_32) (q - p) && memcmp(child->level, p, child->levelLen) == 0) {
+            if ((match = matchNode(child, next, end, FALSE)) != NULL) {
+                return match;
+            }
+            break;
+        }
+    }
+
+    /* Wildcards at the first level do not match "$SYS" like topics */
+    wildcards = (BOOLEAN) (!isFirst || p == end || *p != '$');
+    if (wildcards && node->plusChild != NULL) {
+        if ((match = matchNode(node->plusChild, next, end, FALSE)) != NULL) {
+            return match;
+        }
+    }
+    if (wildcards && node->hashChild != NULL && node->hashChild->value != NULL) {
+        return node->hashChild;
+    }
+    return NULL;
+}
+
+/******************************************************/
+/*   I N T E R F A C E  I M P L E M E N T A T I O N   */
+/******************************************************/
+
+EsTopicTrie *EsTopicTrie_new() {
+    EsTopicTrie *trie;
+
+    trie = (EsTopicTrie *) calloc(1, sizeof(EsTopicTrie));
+    if (trie != NULL) {
+        trie->lock = p_rwlock_new();
+        trie->root = newNode("", 0, NULL);
+        if (trie->lock == NULL || trie->root == NULL) {
+            EsTopicTrie_free(trie, NULL);
+            trie = NULL;
+        }
+    }
+    return trie;
+}
+
+void EsTopicTrie_free(EsTopicTrie *trie, EsTopicTrieFreeFunc freeFunc) {
+    if (trie != NULL) {
+        freeNode(trie->root, freeFunc);
+        if (trie->lock != NULL) {
+            p_rwlock_free(trie->lock);
+        }
+        free(trie);
+    }
+}
+
+BOOLEAN EsTopicTrie_isValidFilter(const char *filter) {
+    const char *p;
+    const char *q;
+    const char *end;
+
+    if (filter == NULL || *filter == '\0') {
+        return FALSE;
+    }
+
+    end = filter + strlen(filter);
+    for (p = filter; p != NULL; p = (q < end) ? q + 1 : NULL) {
+        q = levelEnd(p, end);
+        if (memchr(p, '+', (size_t) (q - p)) != NULL && q - p != 1) {
+            return FALSE;
+        }
+        if (memchr(p, '#', (size_t) (q - p)) != NULL && (q - p != 1 || q != end)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+BOOLEAN EsTopicTrie_put(EsTopicTrie *trie, const char *filter, void *value, void **oldValue) {
+    EsTopicTrieNode *node;
+    EsTopicTrieNode *child;
+    const char *p;
+    const char *q;
+    const char *end;
+
+    if (oldValue != NULL) {
+        *oldValue = NULL;
+    }
+    if (trie == NULL || value == NULL || !EsTopicTrie_isValidFilter(filter)) {
+        return FALSE;
+    }
+
+    end = filter + strlen(filter);
+    p_rwlock_writer_lock(trie->lock);
+    node = trie->root;
+    for (p = filter; p != NULL; p = (q < end) ? q + 1 : NULL) {
+        q = levelEnd(p, end);
+        if ((child = childAt(node, p, (U_32) (q - p), TRUE)) == NULL) {
+            break;
+        }
+        node = child;
+    }
+    if (p != NULL) {
+        /* Out of memory: drop the partial path again */
+        pruneNode(node, trie->root);
+        p_rwlock_writer_unlock(trie->lock);
+        return FALSE;
+    }
+    if (node->value == NULL) {
+        trie->size++;
+    } else if (oldValue != NULL) {
+        *oldValue = node->value;
+    }
+    node->value = value;
+    p_rwlock_writer_unlock(trie->lock);
+    return TRUE;
+}
+
+void *EsTopicTrie_remove(EsTopicTrie *trie, const char *filter) {
+    EsTopicTrieNode *node;
+    const char *p;
+    const char *q;
+    const char *end;
+    void *value = NULL;
+
+    if (trie == NULL || !EsTopicTrie_isValidFilter(filter)) {
+        return NULL;
+    }
+
+    end = filter + strlen(filter);
+    p_rwlock_writer_lock(trie->lock);
+    node = trie->root;
+    for (p = filter; p != NULL && node != NULL; p = (q < end) ? q + 1 : NULL) {
+        q = levelEnd(p, end);
+        node = childAt(node, p, (U_32) (q - p), FALSE);
+    }
+    if (node != NULL) {
+        value = node->value;
+        if (value != NULL) {
+            node->value = NULL;
+            trie->size--;
+        }
+        pruneNode(node, trie->root);
+    }
+    p_rwlock_writer_unlock(trie->lock);
+    return value;
+}
+
+U_32 EsTopicTrie_getSize(EsTopicTrie *trie) {
+    U_32 size = 0;
+
+    if (trie != NULL) {
+        p_rwlock_reader_lock(trie->lock);
+        size = trie->size;
+        p_rwlock_reader_unlock(trie->lock);
+    }
+    return size;
+}
+
+BOOLEAN EsTopicTrie_match(EsTopicTrie *trie, const char *topic, U_32 topicLen,
+                          EsTopicTrieMatchFunc func, void *userData) {
+    EsTopicTrieNode *match;
+    const char *end;
+
+    if (trie == NULL || topic == NULL) {
+        return FALSE;
+    }
+
+    end = topic + ((topicLen > 0) ? topicLen : strlen(topic));
+    p_rwlock_reader_lock(trie->lock);
+    match = matchNode(trie->root, topic, end, TRUE);
+    if (match != NULL && func != NULL) {
+        func(match->value, userData);
+    }
+    p_rwlock_reader_unlock(trie->lock);
+    return (BOOLEAN) (match != NULL);
+}
@@ -0,0 +1,130 @@
+/*******************************************************************************
+ *  Copyright (c) 2019 Instantiations, Inc
+ *
+ *  Distributed under the MIT License (see License.txt file)
+ *
+ *  @file EsTopicTrie.h
+ *  @brief MQTT Topic Filter Trie Interface
+ *  @author Seth Berman
+ *
+ *  A topic trie maps MQTT topic filters to values and answers the value
+ *  of the filter that matches a topic name. Each node is one topic level.
+ *  Filters may use the MQTT wildcards:
+ *  '+' matches exactly one level (i.e. "a/+/c" matches "a/b/c")
+ *  '#' matches any number of levels, including the parent (i.e. "a/#" matches "a" and "a/b/c")
+ *  As in MQTT, wildcards at the first level do not match topics starting with '$'.
+ *
+ *  If more than one filter matches, the most specific one wins: at each level
+ *  an exact level is preferred over '+', and '+' is preferred over '#'.
+ *
+ *  Values are only handed to the match function while the trie is read-locked,
+ *  so a value answered by EsTopicTrie_remove() is no longer in use by a reader.
+ *
+ *  EsTopicTrie *trie = EsTopicTrie_new();
+ *  EsTopicTrie_put(trie, "sensors/+/temp", value, NULL);
+ *  EsTopicTrie_match(trie, "sensors/1/temp", 0, copyValue, &copy);
+ *  EsTopicTrie_free(trie, NULL);
+ *******************************************************************************/
+#ifndef ES_TOPIC_TRIE_H
+#define ES_TOPIC_TRIE_H
+
+#include "EsMqtt.h"
+
+/**************************/
+/*   D A T A  T Y P E S   */
+/**************************/
+
+/**
+ * @brief Trie of MQTT topic filters
+ * @note This is an opaque datatype
+ */
+typedef struct _EsTopicTrie EsTopicTrie;
+
+/**
+ * @brief Function that is given the value of the matching filter
+ * @param value
+ * @param userData
+ */
+typedef void (*EsTopicTrieMatchFunc)(void *value, void *userData);
+
+/**
+ * @brief Function that frees a value
+ * @param value
+ */
+typedef void (*EsTopicTrieFreeFunc)(void *value);
+
+/*************************/
+/*   L I F E C Y C L E   */
+/*************************/
+
+/**
+ * @brief Answer a new empty trie
+ * @return trie or NULL if out of memory
+ */
+EsTopicTrie *EsTopicTrie_new();
+
+/**
+ * @brief Destroy the trie
+ * @param trie
+ * @param freeFunc frees each value (may be NULL)
+ */
+void EsTopicTrie_free(EsTopicTrie *trie, EsTopicTrieFreeFunc freeFunc);
+
+/*********************/
+/*   F I L T E R S   */
+/*********************/
+
+/**
+ * @brief Answer if the filter is a valid MQTT topic filter
+ * @note '+' and '#' must be a whole level, and '#' must be the last level
+ * @param filter null-terminated
+ * @return TRUE if valid, FALSE otherwise
+ */
+BOOLEAN EsTopicTrie_isValidFilter(const char *filter);
+
+/**
+ * @brief Add or replace the value of a filter
+ * @note thread-safe
+ * @param trie
+ * @param filter null-terminated topic filter
+ * @param value must not be NULL
+ * @param oldValue[out] replaced value or NULL (may be NULL if not wanted)
+ * @return TRUE if added, FALSE if the filter is invalid or out of memory
+ */
+BOOLEAN EsTopicTrie_put(EsTopicTrie *trie, const char *filter, void *value, void **oldValue);
+
+/**
+ * @brief Remove a filter
+ * @note thread-safe
+ * @param trie
+ * @param filter null-terminated topic filter
+ * @return value of the filter or NULL if not found
+ */
+void *EsTopicTrie_remove(EsTopicTrie *trie, const char *filter);
+
+/**
+ * @brief Answer the number of filters
+ * @param trie
+ * @return number of filters
+ */
+U_32 EsTopicTrie_getSize(EsTopicTrie *trie);
+
+/*********************/
+/*   M A T C H I N G   */
+/*********************/
+
+/**
+ * @brief Find the most specific filter that matches the topic name
+ * and call the function with its value while the trie is read-locked
+ * @note thread-safe
+ * @param trie
+ * @param topic topic name
+ * @param topicLen length of the topic name (0 if null-terminated)
+ * @param func called once with the value if matched (may be NULL)
+ * @param userData passed to func
+ * @return TRUE if matched, FALSE otherwise
+ */
+BOOLEAN EsTopicTrie_match(EsTopicTrie *trie, const char *topic, U_32 topicLen,
+                          EsTopicTrieMatchFunc func, void *userData);
+
+#endif //ES_TOPIC_TRIE_H
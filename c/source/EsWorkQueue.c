@@ -11,6 +11,8 @@
 
 #include "plibsys.h"
 
+#include "EsRing.h"
+#include "EsSignal.h"
 #include "EsWorkQueue.h"
 
 /*******************/
@@ -30,6 +32,7 @@
 #define I_SET       p_atomic_int_set
 #define I_INC       p_atomic_int_inc
 #define I_DEC       p_atomic_int_dec_and_test
+#define I_ADD       p_atomic_int_add
 
 /**
  * @brief Mutex Operations
@@ -39,6 +42,35 @@
 #define MUTEX_NEW       p_mutex_new
 #define MUTEX_FREE      p_mutex_free
 
+/**
+ * @brief Condition Variable Operations
+ */
+#define COND_NEW        p_cond_variable_new
+#define COND_FREE       p_cond_variable_free
+#define COND_WAIT       p_cond_variable_wait
+#define COND_SIGNAL     p_cond_variable_signal
+#define COND_BROADCAST  p_cond_variable_broadcast
+
+/**
+ * @brief Thread Pool Defaults
+ */
+#define ESQ_THREAD_POOL_DEFAULT_NUM_THREADS     4
+#define ESQ_THREAD_POOL_MAX_NUM_THREADS         64
+#define ESQ_THREAD_POOL_INITIAL_CAPACITY        64
+#define ESQ_THREAD_POOL_MAX_DEQUEUE_BATCH       16
+
+/**
+ * @brief Ring Buffer Defaults
+ */
+#define ESQ_RING_DEFAULT_CAPACITY       1024
+#define ESQ_RING_MAX_CAPACITY           (1u << 24u)
+#define ESQ_RING_MAX_DEQUEUE_BATCH      32
+
+/**
+ * @brief Size used to keep hot fields on separate cache lines
+ */
+#define ES_CACHE_LINE_SIZE      64
+
 /**************************/
 /*   D A T A  T Y P E S   */
 /**************************/
@@ -81,13 +113,23 @@ struct _EsWorkQueue {
     U_32 (*getNumTasks)(const EsWorkQueue *self);
 
     /* Queue API */
-    void (*enqueue)(EsWorkQueue *self, EsWorkTask *task);
+    BOOLEAN (*enqueue)(EsWorkQueue *self, EsWorkTask *task);
 
     EsWorkTask *(*dequeue)(EsWorkQueue *self);
 
+    U_32 (*enqueueAll)(EsWorkQueue *self, EsWorkTask **tasks, U_32 count);
+
+    U_32 (*dequeueAll)(EsWorkQueue *self, EsWorkTask **tasks, U_32 max);
+
+    void (*waitIdle)(EsWorkQueue *self);
+
     /* State */
     EsProperties *props;
     enum EsWorkQueueType type;
+
+    /* Wait/Notify */
+    EsSignal *idle;
+    volatile I_32 numActive;
 };
 
 /*******************************************/
@@ -115,16 +157,26 @@ static void genericShutdown(EsWorkQueue *self) {
 }
 
 /**
- * @brief Free memory associated with the queue
+ * @brief Free the generic state and the queue memory
+ * @note Concrete queues call this last from their free
  * @param self
  */
-static void genericFree(EsWorkQueue *self) {
+static void freeWorkQueue(EsWorkQueue *self) {
     if (self != NULL) {
         EsProperties_free(self->props);
+        EsSignal_free(self->idle);
         free(self);
     }
 }
 
+/**
+ * @brief Free memory associated with the queue
+ * @param self
+ */
+static void genericFree(EsWorkQueue *self) {
+    freeWorkQueue(self);
+}
+
 /**
  * @brief Generic properties accessor
  * @param self
@@ -148,10 +200,12 @@ static U_32 genericGetNumTasks(const EsWorkQueue *self) {
  * @brief Generic adding task to the queue
  * @note No-Op
  * @param queue
+ * @return FALSE (task is rejected)
  */
-static void genericEnqueue(EsWorkQueue *self, EsWorkTask *task) {
+static BOOLEAN genericEnqueue(EsWorkQueue *self, EsWorkTask *task) {
     ES_UNUSED(self);
     ES_UNUSED(task);
+    return FALSE;
 }
 
 /**
@@ -165,15 +219,127 @@ static EsWorkTask *genericDequeue(EsWorkQueue *self) {
     return NULL;
 }
 
+/**
+ * @brief Generic adding of many tasks to the queue
+ * @note Enqueues one at a time until a task is rejected
+ * @param self
+ * @param tasks to enqueue
+ * @param count number of tasks
+ * @return number of tasks accepted (from the front of tasks)
+ */
+static U_32 genericEnqueueAll(EsWorkQueue *self, EsWorkTask **tasks, U_32 count) {
+    U_32 i;
+
+    for (i = 0; i < count; i++) {
+        if (!self->enqueue(self, tasks[i])) {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief Generic removal of many tasks from the queue
+ * @note Dequeues one at a time until the queue is empty
+ * @param self
+ * @param tasks[out] dequeued tasks
+ * @param max number of tasks to dequeue
+ * @return number of tasks dequeued
+ */
+static U_32 genericDequeueAll(EsWorkQueue *self, EsWorkTask **tasks, U_32 max) {
+    U_32 i;
+
+    for (i = 0; i < max; i++) {
+        if ((tasks[i] = self->dequeue(self)) == NULL) {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief Block until there are no pending or running tasks
+ * @note thread-safe
+ * @param self
+ */
+static void genericWaitIdle(EsWorkQueue *self) {
+    U_32 ticket;
+
+    do {
+        ticket = EsSignal_prepareWait(self->idle);
+        if (I_GET(&self->numActive) <= 0) {
+            EsSignal_cancelWait(self->idle);
+            break;
+        }
+        EsSignal_wait(self->idle, ticket);
+    } while (TRUE);
+}
+
+/**
+ * @brief Count tasks that the queue is taking responsibility for
+ * @note Must be called before the tasks are visible to consumers
+ * @param self
+ * @param count number of tasks
+ */
+static void beginTasks(EsWorkQueue *self, U_32 count) {
+    I_ADD(&self->numActive, (I_32) count);
+}
+
+/**
+ * @brief Uncount tasks that finished, were dropped or were rejected
+ * @note Wakes up idle waiters when these were the last ones
+ * @param self
+ * @param count number of tasks
+ */
+static void endTasks(EsWorkQueue *self, U_32 count) {
+    if (count > 0 && I_ADD(&self->numActive, -(I_32) count) == (I_32) count) {
+        EsSignal_notifyAll(self->idle);
+    }
+}
+
+/**
+ * @brief Run and release the task
+ * @param self
+ * @param task
+ */
+static void runTask(EsWorkQueue *self, EsWorkTask *task) {
+    EsWorkTask_run(task);
+    EsWorkTask_release(task);
+    endTasks(self, 1);
+}
+
+/**
+ * @brief Answer the U_32 value of the queue property at key
+ * @param self
+ * @param key null-terminated string
+ * @param defaultValue answered if key not found or value is not a number
+ * @return U_32 value
+ */
+static U_32 getU32Property(const EsWorkQueue *self, const char *key, U_32 defaultValue) {
+    const char *value;
+    char *end = NULL;
+    unsigned long result;
+
+    value = EsProperties_at(self->props, key);
+    if (value == NULL) {
+        return defaultValue;
+    }
+    result = strtoul(value, &end, 10);
+    return (end != value && *end == '\0') ? (U_32) result : defaultValue;
+}
+
 /**
  * @brief Init the state and queue slots with generic functions.
  * @param queue
+ * @return TRUE if initialized, FALSE if out of memory
  */
-static void initWorkQueue(EsWorkQueue *queue) {
+static BOOLEAN initWorkQueue(EsWorkQueue *queue) {
     if (queue != NULL) {
         /* State */
         queue->type = ESQ_TYPE_UNDEFINED;
         queue->props = EsProperties_new();
+        queue->idle = EsSignal_new();
+        queue->numActive = 0;
 
         /* Function Slots */
         queue->init = genericInit;
@@ -183,7 +349,11 @@ static void initWorkQueue(EsWorkQueue *queue) {
         queue->getNumTasks = genericGetNumTasks;
         queue->enqueue = genericEnqueue;
         queue->dequeue = genericDequeue;
+        queue->enqueueAll = genericEnqueueAll;
+        queue->dequeueAll = genericDequeueAll;
+        queue->waitIdle = genericWaitIdle;
     }
+    return (queue != NULL && queue->props != NULL && queue->idle != NULL) ? TRUE : FALSE;
 }
 
 /*************************************************/
@@ -204,8 +374,9 @@ static void initWorkQueue(EsWorkQueue *queue) {
  * The moment a task is successfully "submitted", it is then
  * executed. In effect, the producer is the consumer.
  * Therefore, the "queue" can be thought of as the line that
- * forms when looping on atomic compareExchange guards that
- * control state transitions.
+ * forms on atomic compareExchange guards that control state
+ * transitions. Producers that lose the race sleep on a signal
+ * until the running task is done.
  *
  * This type of queue is quite limiting unless a simple
  * low-throughput, but thread-safe, queue is desired.
@@ -218,6 +389,7 @@ struct _EsSyncWorkQueue {
     EsWorkQueue parent;
     volatile I_32 state;
     volatile I_32 numTasks;
+    EsSignal *turn;
 };
 
 /**
@@ -235,9 +407,10 @@ static const I_32 ESQ_SYNC_STATE_BUSY = 3;
 static const I_32 ESQ_SYNC_STATE_SHUTDOWN = 4;
 
 /**
- * @brief Add task to "virtual" queue to be executed by single consumer
+ * @brief Add tasks to "virtual" queue to be executed by single consumer
  * @param self
- * @param task to enqueue
+ * @param tasks to enqueue
+ * @param count number of tasks
  * @note thread-safe
  *
  * Multiple-Producers / Single Consumer
@@ -245,29 +418,70 @@ static const I_32 ESQ_SYNC_STATE_SHUTDOWN = 4;
  * pending tasks.
  * On entry, the number of tasks is incremented.
  * Go into loop attempting atomic state transition from IDLE -> BUSY
- * Once transitioned, the task is executed and then transitions back to IDLE
+ * and wait for the next turn while another task is BUSY.
+ * Once transitioned, the tasks are executed (and freed) in order and
+ * then transitions back to IDLE
  * This means a single task can be executed at a time (even if submitting from
  * many OS threads at the same time)
- * Exit if a transition occurs to the SHUTDOWN state. If the task has not been
- * run, then it is simply cancelled.
+ * Exit if a transition occurs to the SHUTDOWN state. If the tasks have not been
+ * run, then they are simply rejected.
+ *
+ * @return number of tasks accepted (all or none)
  */
-static void syncEnqueue(EsWorkQueue *self, EsWorkTask *task) {
+static U_32 syncEnqueueAll(EsWorkQueue *self, EsWorkTask **tasks, U_32 count) {
     DECL_SELF(EsSyncWorkQueue, queue);
+    U_32 accepted = 0;
+    U_32 ticket;
+    U_32 i;
 
-    if (queue != NULL && task != NULL) {
-        I_INC(&queue->numTasks);
-        do {
-            if (I_CMPXCHG(&queue->state, ESQ_SYNC_STATE_IDLE, ESQ_SYNC_STATE_BUSY) == TRUE) {
-                I_DEC(&queue->numTasks);
-                EsWorkTask_run(task);
-                queue->state = ESQ_SYNC_STATE_IDLE;
-                break;
-            } else if (queue->state == ESQ_SYNC_STATE_SHUTDOWN) {
+    if (queue == NULL || tasks == NULL || count == 0) {
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        if (tasks[i] == NULL) {
+            return 0;
+        }
+    }
+
+    beginTasks(self, count);
+    I_ADD(&queue->numTasks, (I_32) count);
+    do {
+        if (I_CMPXCHG(&queue->state, ESQ_SYNC_STATE_IDLE, ESQ_SYNC_STATE_BUSY) == TRUE) {
+            for (i = 0; i < count; i++) {
                 I_DEC(&queue->numTasks);
-                break;
+                EsWorkTask_run(tasks[i]);
+                EsWorkTask_release(tasks[i]);
             }
-        } while (TRUE);
-    }
+            I_SET(&queue->state, ESQ_SYNC_STATE_IDLE);
+            EsSignal_notifyAll(queue->turn);
+            endTasks(self, count);
+            accepted = count;
+            break;
+        } else if (I_GET(&queue->state) == ESQ_SYNC_STATE_SHUTDOWN) {
+            I_ADD(&queue->numTasks, -(I_32) count);
+            endTasks(self, count);
+            break;
+        }
+        ticket = EsSignal_prepareWait(queue->turn);
+        if (I_GET(&queue->state) == ESQ_SYNC_STATE_BUSY) {
+            EsSignal_wait(queue->turn, ticket);
+        } else {
+            EsSignal_cancelWait(queue->turn);
+        }
+    } while (TRUE);
+    return accepted;
+}
+
+/**
+ * @brief Add task to "virtual" queue to be executed by single consumer
+ * @param self
+ * @param task to enqueue
+ * @note thread-safe
+ * @see syncEnqueueAll()
+ * @return TRUE if accepted, FALSE if shutdown
+ */
+static BOOLEAN syncEnqueue(EsWorkQueue *self, EsWorkTask *task) {
+    return (syncEnqueueAll(self, &task, 1) == 1) ? TRUE : FALSE;
 }
 
 /**
@@ -276,25 +490,32 @@ static void syncEnqueue(EsWorkQueue *self, EsWorkTask *task) {
  * @note A task in progress is allowed to finish
  * @note thread-safe
  *
- * Try state transitions from IDLE -> SHUTDOWN until successful.
- * On success, wait until the number of tasks waiting drops to 0.
+ * Try state transitions from IDLE -> SHUTDOWN until successful,
+ * waiting for the next turn while a task is BUSY.
+ * On success, wake up the waiting producers (which will be rejected)
+ * and wait until they have all left.
  * Any future enqueues attempted will be rejected.
  * If the queue already shutdown, then just leave
  */
 static void syncShutdown(EsWorkQueue *self) {
     DECL_SELF(EsSyncWorkQueue, queue);
+    U_32 ticket;
 
     if (queue != NULL) {
         do {
             if (I_CMPXCHG(&queue->state, ESQ_SYNC_STATE_IDLE, ESQ_SYNC_STATE_SHUTDOWN) == TRUE) {
-                /* Flush existing tasks */
-                while (queue->numTasks > 0) {
-                    p_uthread_sleep(50);
-                }
+                EsSignal_notifyAll(queue->turn);
+                genericWaitIdle(self);
                 break;
-            } else if (queue->state == ESQ_SYNC_STATE_SHUTDOWN) {
+            } else if (I_GET(&queue->state) == ESQ_SYNC_STATE_SHUTDOWN) {
                 break;
             }
+            ticket = EsSignal_prepareWait(queue->turn);
+            if (I_GET(&queue->state) == ESQ_SYNC_STATE_BUSY) {
+                EsSignal_wait(queue->turn, ticket);
+            } else {
+                EsSignal_cancelWait(queue->turn);
+            }
         } while (TRUE);
     }
 }
@@ -306,9 +527,13 @@ static void syncShutdown(EsWorkQueue *self) {
  * @param self
  */
 static void syncFree(EsWorkQueue *self) {
-    syncShutdown(self);
-    EsProperties_free(self->props);
-    free(self);
+    DECL_SELF(EsSyncWorkQueue, queue);
+
+    if (queue != NULL) {
+        syncShutdown(self);
+        EsSignal_free(queue->turn);
+        freeWorkQueue(self);
+    }
 }
 
 /**
@@ -321,18 +546,10 @@ static U_32 syncGetNumTasks(const EsWorkQueue *self) {
     DECL_SELF(EsSyncWorkQueue, queue);
     I_32 numTasks = 0;
 
-    if (queue != NULL) {
-        do {
-            if (I_CMPXCHG(&queue->state, ESQ_SYNC_STATE_IDLE, ESQ_SYNC_STATE_BUSY) == TRUE) {
-                numTasks = queue->numTasks;
-                queue->state = ESQ_SYNC_STATE_IDLE;
-                break;
-            } else if (queue->state == ESQ_SYNC_STATE_SHUTDOWN) {
-                return 0;
-            }
-        } while (TRUE);
+    if (queue != NULL && I_GET(&queue->state) != ESQ_SYNC_STATE_SHUTDOWN) {
+        numTasks = I_GET(&queue->numTasks);
     }
-    return (U_32) numTasks;
+    return (numTasks > 0) ? (U_32) numTasks : 0;
 }
 
 /**
@@ -344,7 +561,12 @@ static EsWorkQueue *EsSyncWorkQueue_new() {
 
     impl = (EsSyncWorkQueue *) calloc(1, sizeof(*impl));
     if (impl != NULL) {
-        initWorkQueue((EsWorkQueue *) impl);
+        impl->turn = EsSignal_new();
+        if (!initWorkQueue((EsWorkQueue *) impl) || impl->turn == NULL) {
+            EsSignal_free(impl->turn);
+            freeWorkQueue((EsWorkQueue *) impl);
+            return NULL;
+        }
 
         impl->state = ESQ_SYNC_STATE_IDLE;
         impl->numTasks = 0;
@@ -353,6 +575,7 @@ static EsWorkQueue *EsSyncWorkQueue_new() {
         impl->parent.type = ESQ_TYPE_SYNCHRONOUS;
         impl->parent.shutDown = syncShutdown;
         impl->parent.enqueue = syncEnqueue;
+        impl->parent.enqueueAll = syncEnqueueAll;
         impl->parent.getNumTasks = syncGetNumTasks;
         impl->parent.free = syncFree;
     }
@@ -360,6 +583,873 @@ static EsWorkQueue *EsSyncWorkQueue_new() {
     return (EsWorkQueue *) impl;
 }
 
+/*************************************************/
+/*   T H R E A D  P O O L  Q U E U E  I M P L   */
+/*************************************************/
+
+/**
+ * @struct EsThreadPoolWorkQueue
+ * @brief Concrete Multi-Producer/Multi-Consumer work queue
+ * @note Thread-safe (via mutex and condition variable)
+ *
+ * A Thread Pool work queue accepts tasks from multiple producers
+ * (from different OS threads) and hands them off to a fixed number
+ * of consumer threads. The producer only pays for a short critical
+ * section to append the task, so it can return to its own work
+ * right away.
+ *
+ * Pending tasks are held in a circular buffer which grows (doubles)
+ * when full. Enqueue and dequeue are therefore amortized constant time
+ * and no memory is allocated per task in the steady state.
+ *
+ * Consumer threads are started in init and sleep on a condition
+ * variable while the queue is empty. Shutdown will let the consumers
+ * drain all pending tasks before they are joined.
+ *
+ * Tasks will execute in submission order when the queue is configured
+ * with a single consumer thread. With more threads, tasks will still be
+ * dequeued in order, but may complete in any order.
+ */
+typedef struct _EsThreadPoolWorkQueue EsThreadPoolWorkQueue;
+struct _EsThreadPoolWorkQueue {
+    EsWorkQueue parent;
+    PMutex *lock;
+    PCondVariable *notEmpty;
+    EsWorkTask **tasks;
+    U_32 capacity;
+    U_32 head;
+    U_32 numTasks;
+    PUThread **workers;
+    U_32 numWorkers;
+    I_32 state;
+};
+
+/**
+ * @brief Thread Pool Queue States
+ *
+ * The module state lifecycle is
+ * IDLE -> RUNNING -> SHUTDOWN
+ *
+ * IDLE: Initial State - Tasks are accepted but no consumers are running
+ * RUNNING: Consumers are started and executing tasks
+ * SHUTDOWN: Terminal state - No new tasks
+ */
+static const I_32 ESQ_POOL_STATE_IDLE = 2;
+static const I_32 ESQ_POOL_STATE_RUNNING = 3;
+static const I_32 ESQ_POOL_STATE_SHUTDOWN = 4;
+
+/**
+ * @brief Grow the circular buffer of tasks to twice its size
+ * @note lock must be held
+ * @param queue
+ * @return TRUE if grown, FALSE if out of memory
+ */
+static BOOLEAN poolGrow(EsThreadPoolWorkQueue *queue) {
+    EsWorkTask **newTasks;
+    U_32 newCapacity;
+    U_32 i;
+
+    newCapacity = (queue->capacity == 0) ? ESQ_THREAD_POOL_INITIAL_CAPACITY : queue->capacity * 2;
+    newTasks = (EsWorkTask **) malloc(sizeof(EsWorkTask *) * newCapacity);
+    if (newTasks == NULL) {
+        return FALSE;
+    }
+
+    /* Unwrap the pending tasks to the front of the new buffer */
+    for (i = 0; i < queue->numTasks; i++) {
+        newTasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+    }
+    free(queue->tasks);
+    queue->tasks = newTasks;
+    queue->capacity = newCapacity;
+    queue->head = 0;
+    return TRUE;
+}
+
+/**
+ * @brief Remove the task at the head of the buffer
+ * @note lock must be held
+ * @param queue
+ * @return task or NULL if empty
+ */
+static EsWorkTask *poolTakeHead(EsThreadPoolWorkQueue *queue) {
+    EsWorkTask *task = NULL;
+
+    if (queue->numTasks > 0) {
+        task = queue->tasks[queue->head];
+        queue->tasks[queue->head] = NULL;
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->numTasks--;
+    }
+    return task;
+}
+
+/**
+ * @brief Add tasks to the tail of the queue for the consumers
+ * @param self
+ * @param tasks to enqueue
+ * @param count number of tasks
+ * @note thread-safe
+ *
+ * All tasks are appended in one critical section and
+ * enough consumers are woken up to run them.
+ *
+ * @return number of tasks accepted (all or none)
+ */
+static U_32 poolEnqueueAll(EsWorkQueue *self, EsWorkTask **tasks, U_32 count) {
+    DECL_SELF(EsThreadPoolWorkQueue, queue);
+    U_32 accepted = 0;
+    U_32 i;
+
+    if (queue == NULL || tasks == NULL || count == 0) {
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        if (tasks[i] == NULL) {
+            return 0;
+        }
+    }
+
+    MUTEX_LOCK(queue->lock);
+    if (queue->state != ESQ_POOL_STATE_SHUTDOWN) {
+        while (queue->capacity - queue->numTasks < count && poolGrow(queue)) {
+            /* Grow until there is room for all */
+        }
+        if (queue->capacity - queue->numTasks >= count) {
+            for (i = 0; i < count; i++) {
+                queue->tasks[(queue->head + queue->numTasks) % queue->capacity] = tasks[i];
+                queue->numTasks++;
+            }
+            beginTasks(self, count);
+            accepted = count;
+        }
+    }
+    MUTEX_UNLOCK(queue->lock);
+    if (accepted == 1) {
+        COND_SIGNAL(queue->notEmpty);
+    } else if (accepted > 1) {
+        COND_BROADCAST(queue->notEmpty);
+    }
+    return accepted;
+}
+
+/**
+ * @brief Add task to the tail of the queue for the consumers
+ * @param self
+ * @param task to enqueue
+ * @note thread-safe
+ * @return TRUE if accepted, FALSE if shutdown or out of memory
+ */
+static BOOLEAN poolEnqueue(EsWorkQueue *self, EsWorkTask *task) {
+    return (poolEnqueueAll(self, &task, 1) == 1) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Remove the next pending task without waiting
+ * @param self
+ * @note thread-safe
+ * @return task or NULL if empty
+ */
+static EsWorkTask *poolDequeue(EsWorkQueue *self) {
+    DECL_SELF(EsThreadPoolWorkQueue, queue);
+    EsWorkTask *task = NULL;
+
+    if (queue != NULL) {
+        MUTEX_LOCK(queue->lock);
+        task = poolTakeHead(queue);
+        MUTEX_UNLOCK(queue->lock);
+    }
+    return task;
+}
+
+/**
+ * @brief Remove up to max pending tasks without waiting
+ * @param self
+ * @param tasks[out] dequeued tasks in submission order
+ * @param max number of tasks to dequeue
+ * @note thread-safe
+ * @return number of tasks dequeued
+ */
+static U_32 poolDequeueAll(EsWorkQueue *self, EsWorkTask **tasks, U_32 max) {
+    DECL_SELF(EsThreadPoolWorkQueue, queue);
+    U_32 n = 0;
+
+    if (queue != NULL && tasks != NULL) {
+        MUTEX_LOCK(queue->lock);
+        while (n < max && (tasks[n] = poolTakeHead(queue)) != NULL) {
+            n++;
+        }
+        MUTEX_UNLOCK(queue->lock);
+    }
+    return n;
+}
+
+/**
+ * @brief Answer the current number of tasks in the queue
+ * @note Executing tasks are not considered since they are dequeued
+ * @param self
+ * @return U_32
+ */
+static U_32 poolGetNumTasks(const EsWorkQueue *self) {
+    DECL_SELF(EsThreadPoolWorkQueue, queue);
+    U_32 numTasks = 0;
+
+    if (queue != NULL) {
+        MUTEX_LOCK(queue->lock);
+        numTasks = queue->numTasks;
+        MUTEX_UNLOCK(queue->lock);
+    }
+    return numTasks;
+}
+
+/**
+ * @brief Consumer thread function
+ *
+ * Wait for tasks and run them until the queue
+ * is shutdown and there are no more pending tasks.
+ * Each wakeup takes a fair share of the pending tasks
+ * (up to ESQ_THREAD_POOL_MAX_DEQUEUE_BATCH) so the lock
+ * is taken once per batch instead of once per task.
+ *
+ * @param arg EsThreadPoolWorkQueue
+ * @return NULL
+ */
+static ppointer poolWorker(ppointer arg) {
+    EsThreadPoolWorkQueue *queue = (EsThreadPoolWorkQueue *) arg;
+    EsWorkTask *batch[ESQ_THREAD_POOL_MAX_DEQUEUE_BATCH];
+    U_32 share;
+    U_32 n;
+    U_32 i;
+
+    do {
+        MUTEX_LOCK(queue->lock);
+        while (queue->numTasks == 0 && queue->state != ESQ_POOL_STATE_SHUTDOWN) {
+            COND_WAIT(queue->notEmpty, queue->lock);
+        }
+        share = queue->numTasks / (queue->numWorkers > 0 ? queue->numWorkers : 1);
+        share = (share == 0) ? 1 : (share > ESQ_THREAD_POOL_MAX_DEQUEUE_BATCH) ? ESQ_THREAD_POOL_MAX_DEQUEUE_BATCH : share;
+        n = 0;
+        while (n < share && (batch[n] = poolTakeHead(queue)) != NULL) {
+            n++;
+        }
+        MUTEX_UNLOCK(queue->lock);
+
+        for (i = 0; i < n; i++) {
+            runTask((EsWorkQueue *) queue, batch[i]);
+        }
+    } while (n > 0);
+
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/**
+ * @brief Start the consumer threads
+ * @note The number of threads is read from ESQ_PROP_NUM_THREADS
+ * @param self
+ */
+static void poolInit(EsWorkQueue *self) {
+    DECL_SELF(EsThreadPoolWorkQueue, queue);
+    U_32 numThreads;
+    U_32 i;
+
+    if (queue == NULL) {
+        return;
+    }
+
+    MUTEX_LOCK(queue->lock);
+    if (queue->state != ESQ_POOL_STATE_IDLE) {
+        MUTEX_UNLOCK(queue->lock);
+        return;
+    }
+    numThreads = getU32Property(self, ESQ_PROP_NUM_THREADS, ESQ_THREAD_POOL_DEFAULT_NUM_THREADS);
+    if (numThreads == 0 || numThreads > ESQ_THREAD_POOL_MAX_NUM_THREADS) {
+        numThreads = ESQ_THREAD_POOL_DEFAULT_NUM_THREADS;
+    }
+    queue->workers = (PUThread **) calloc(numThreads, sizeof(PUThread *));
+    if (queue->workers != NULL) {
+        for (i = 0; i < numThreads; i++) {
+            queue->workers[i] = p_uthread_create((PUThreadFunc) poolWorker, (ppointer) queue, TRUE);
+            if (queue->workers[i] == NULL) {
+                break;
+            }
+        }
+        queue->numWorkers = i;
+    }
+    queue->state = ESQ_POOL_STATE_RUNNING;
+    MUTEX_UNLOCK(queue->lock);
+}
+
+/**
+ * @brief Shutdown the queue and join the consumer threads
+ * @param self
+ * @note Pending tasks are allowed to finish
+ * @note thread-safe
+ *
+ * Transition to SHUTDOWN so future enqueues will be rejected
+ * and wake up all consumers. The consumers will drain the
+ * pending tasks and exit. If no consumers were ever started,
+ * then the pending tasks are run in the calling thread.
+ * If the queue already shutdown, then just leave
+ */
+static void poolShutdown(EsWorkQueue *self) {
+    DECL_SELF(EsThreadPoolWorkQueue, queue);
+    EsWorkTask *task;
+    U_32 i;
+
+    if (queue == NULL) {
+        return;
+    }
+
+    MUTEX_LOCK(queue->lock);
+    if (queue->state == ESQ_POOL_STATE_SHUTDOWN) {
+        MUTEX_UNLOCK(queue->lock);
+        return;
+    }
+    queue->state = ESQ_POOL_STATE_SHUTDOWN;
+    MUTEX_UNLOCK(queue->lock);
+    COND_BROADCAST(queue->notEmpty);
+
+    for (i = 0; i < queue->numWorkers; i++) {
+        p_uthread_join(queue->workers[i]);
+        p_uthread_unref(queue->workers[i]);
+        queue->workers[i] = NULL;
+    }
+    queue->numWorkers = 0;
+
+    /* Flush tasks that had no consumer */
+    while ((task = poolDequeue(self)) != NULL) {
+        runTask(self, task);
+    }
+}
+
+/**
+ * @brief Free memory associated with the queue
+ * @note A shutdown is performed first to ensure
+ * the consumer threads are no longer running
+ * @param self
+ */
+static void poolFree(EsWorkQueue *self) {
+    DECL_SELF(EsThreadPoolWorkQueue, queue);
+
+    if (queue != NULL) {
+        poolShutdown(self);
+        COND_FREE(queue->notEmpty);
+        MUTEX_FREE(queue->lock);
+        free(queue->workers);
+        free(queue->tasks);
+        freeWorkQueue(self);
+    }
+}
+
+/**
+ * @brief Answer a new thread pool work queue
+ * @return queue or NULL if out of memory
+ */
+static EsWorkQueue *EsThreadPoolWorkQueue_new() {
+    EsThreadPoolWorkQueue *impl = NULL;
+
+    impl = (EsThreadPoolWorkQueue *) calloc(1, sizeof(*impl));
+    if (impl != NULL) {
+        impl->state = ESQ_POOL_STATE_IDLE;
+        impl->lock = MUTEX_NEW();
+        impl->notEmpty = COND_NEW();
+        if (!initWorkQueue((EsWorkQueue *) impl) || impl->lock == NULL || impl->notEmpty == NULL || !poolGrow(impl)) {
+            if (impl->notEmpty != NULL) {
+                COND_FREE(impl->notEmpty);
+            }
+            if (impl->lock != NULL) {
+                MUTEX_FREE(impl->lock);
+            }
+            free(impl->tasks);
+            freeWorkQueue((EsWorkQueue *) impl);
+            return NULL;
+        }
+
+        /* Overrides */
+        impl->parent.type = ESQ_TYPE_THREAD_POOL;
+        impl->parent.init = poolInit;
+        impl->parent.shutDown = poolShutdown;
+        impl->parent.enqueue = poolEnqueue;
+        impl->parent.dequeue = poolDequeue;
+        impl->parent.enqueueAll = poolEnqueueAll;
+        impl->parent.dequeueAll = poolDequeueAll;
+        impl->parent.getNumTasks = poolGetNumTasks;
+        impl->parent.free = poolFree;
+    }
+
+    return (EsWorkQueue *) impl;
+}
+
+
+/***********************************************/
+/*   R I N G  B U F F E R  Q U E U E  I M P L   */
+/***********************************************/
+
+/**
+ * @brief Ring Buffer Full Policies
+ * @see ESQ_PROP_FULL_POLICY
+ */
+enum EsRingFullPolicy {
+    ESQ_RING_FULL_BLOCK,
+    ESQ_RING_FULL_DROP_OLDEST,
+    ESQ_RING_FULL_REJECT
+};
+
+/**
+ * @struct EsRingWorkQueue
+ * @brief Concrete Lock-Free Multi-Producer/Single Consumer bounded work queue
+ * @note Thread-safe (via lock-free atomics)
+ *
+ * A Ring Buffer work queue holds pending tasks in a fixed-capacity
+ * ring of task pointers that is allocated once (@see EsRing.h). Producers
+ * (from different OS threads) claim a run of slots with a single
+ * compareExchange on the tail and publish each task through its slot
+ * sequence. There is no lock and no allocation per submit, so the
+ * enqueue latency is predictable.
+ *
+ * A single consumer thread (started in init) takes tasks from the head
+ * and runs them in submission order. The consumer sleeps on the notEmpty
+ * signal when the ring is empty, and producers under the block policy
+ * sleep on the notFull signal when the ring is full. Notifying a signal
+ * without waiters is a single atomic read, so the fast path stays lock-free.
+ *
+ * The ring keeps its tail and head on their own cache lines, and the busy
+ * flag, which only the consumer writes, is kept away from the fields that
+ * every thread reads. Producers do not count themselves or their tasks:
+ * shutdown closes the ring, and the consumer (which owns the busy flag)
+ * answers idle.
+ *
+ * The ring is published once the consumer is running, so tasks are
+ * rejected before init. The capacity and what happens when the ring is full
+ * are configured with the ESQ_PROP_CAPACITY and ESQ_PROP_FULL_POLICY properties.
+ * Under the drop-oldest policy a producer takes the oldest task itself.
+ */
+typedef struct _EsRingWorkQueue EsRingWorkQueue;
+struct _EsRingWorkQueue {
+    EsWorkQueue parent;
+    EsRing *volatile ring;
+    enum EsRingFullPolicy policy;
+    EsSignal *notEmpty;
+    EsSignal *notFull;
+    volatile I_32 state;
+    PUThread *consumer;
+    U_8 pad0[ES_CACHE_LINE_SIZE];
+    volatile I_32 busy;
+    U_8 pad1[ES_CACHE_LINE_SIZE - sizeof(I_32)];
+};
+
+/**
+ * @brief Ring Queue States
+ *
+ * The module state lifecycle is
+ * IDLE -> RUNNING -> SHUTDOWN
+ *
+ * IDLE: Initial State - Ring is not allocated, tasks are rejected
+ * RUNNING: Consumer is started and executing tasks
+ * SHUTDOWN: Terminal state - No new tasks
+ */
+static const I_32 ESQ_RING_STATE_IDLE = 2;
+static const I_32 ESQ_RING_STATE_RUNNING = 3;
+static const I_32 ESQ_RING_STATE_SHUTDOWN = 4;
+
+/**
+ * @brief Answer the ring of the queue
+ * @param queue
+ * @return ring or NULL before init
+ */
+static EsRing *ringOf(const EsRingWorkQueue *queue) {
+    return (EsRing *) p_atomic_pointer_get(&queue->ring);
+}
+
+/**
+ * @brief Try to take the task at the head of the ring
+ * @param ring
+ * @return task or NULL if empty
+ * @note thread-safe
+ */
+static EsWorkTask *ringTakeHead(EsRing *ring) {
+    EsWorkTask *task = NULL;
+
+    return (EsRing_takeAll(ring, &task, 1) == 1) ? task : NULL;
+}
+
+/**
+ * @brief Answer the current number of claimed slots (published or not)
+ * @note This is a snapshot since producers and the consumer may be active
+ * @param queue
+ * @return U_32
+ */
+static U_32 ringCount(const EsRingWorkQueue *queue) {
+    EsRing *ring = ringOf(queue);
+
+    return (ring != NULL) ? EsRing_getCount(ring) : 0;
+}
+
+/**
+ * @brief Answer TRUE if there is no room in the ring
+ * @note This is a snapshot since the consumer may be active
+ * @param ring
+ * @return BOOLEAN
+ */
+static BOOLEAN ringIsFull(EsRing *ring) {
+    return EsRing_getCount(ring) >= EsRing_getCapacity(ring) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Add tasks to the ring to be executed by the single consumer
+ * @param self
+ * @param tasks to enqueue
+ * @param count number of tasks
+ * @note thread-safe
+ *
+ * If the ring is full, then the configured full policy decides
+ * if we wait for room, discard the oldest task or reject the remaining tasks.
+ * Tasks are only accepted while the ring is open (after init, before shutdown).
+ * When there is room, a submit is the tail compareExchange,
+ * the sequence store and a read of the consumer's notEmpty signal.
+ *
+ * @return number of tasks accepted (from the front of tasks)
+ */
+static U_32 ringEnqueueAll(EsWorkQueue *self, EsWorkTask **tasks, U_32 count) {
+    DECL_SELF(EsRingWorkQueue, queue);
+    EsRing *ring;
+    U_32 accepted = 0;
+    U_32 ticket;
+    U_32 i;
+
+    if (queue == NULL || tasks == NULL || count == 0) {
+        return 0;
+    }
+    ring = ringOf(queue);
+    if (ring == NULL) {
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        if (tasks[i] == NULL) {
+            return 0;
+        }
+    }
+
+    while (accepted < count) {
+        i = EsRing_pushAll(ring, tasks + accepted, count - accepted);
+        if (i > 0) {
+            accepted += i;
+            EsSignal_notifyAll(queue->notEmpty);
+            continue;
+        }
+        if (EsRing_isClosed(ring)) {
+            break;
+        }
+
+        /* Ring is full */
+        if (queue->policy == ESQ_RING_FULL_REJECT) {
+            break;
+        } else if (queue->policy == ESQ_RING_FULL_DROP_OLDEST) {
+            EsWorkTask *oldest = ringTakeHead(ring);
+            if (oldest != NULL) {
+                EsWorkTask_release(oldest);
+            }
+        } else {
+            ticket = EsSignal_prepareWait(queue->notFull);
+            if (ringIsFull(ring) && !EsRing_isClosed(ring)) {
+                EsSignal_wait(queue->notFull, ticket);
+            } else {
+                EsSignal_cancelWait(queue->notFull);
+            }
+        }
+    }
+    return accepted;
+}
+
+/**
+ * @brief Add task to the ring to be executed by the single consumer
+ * @param self
+ * @param task to enqueue
+ * @note thread-safe
+ * @see ringEnqueueAll()
+ * @return TRUE if accepted, FALSE if rejected
+ */
+static BOOLEAN ringEnqueue(EsWorkQueue *self, EsWorkTask *task) {
+    return (ringEnqueueAll(self, &task, 1) == 1) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Remove the next pending task without waiting
+ * @param self
+ * @return task or NULL if empty
+ */
+static EsWorkTask *ringDequeue(EsWorkQueue *self) {
+    DECL_SELF(EsRingWorkQueue, queue);
+    EsRing *ring = (queue != NULL) ? ringOf(queue) : NULL;
+
+    return (ring != NULL) ? ringTakeHead(ring) : NULL;
+}
+
+/**
+ * @brief Remove up to max pending tasks without waiting
+ * @param self
+ * @param tasks[out] dequeued tasks in submission order
+ * @param max number of tasks to dequeue
+ * @return number of tasks dequeued
+ */
+static U_32 ringDequeueAll(EsWorkQueue *self, EsWorkTask **tasks, U_32 max) {
+    DECL_SELF(EsRingWorkQueue, queue);
+    EsRing *ring = (queue != NULL) ? ringOf(queue) : NULL;
+
+    return (ring != NULL && tasks != NULL) ? EsRing_takeAll(ring, tasks, max) : 0;
+}
+
+/**
+ * @brief Answer the current number of tasks in the queue
+ * @note This is a snapshot since producers may be active
+ * @param self
+ * @return U_32
+ */
+static U_32 ringGetNumTasks(const EsWorkQueue *self) {
+    DECL_SELF(EsRingWorkQueue, queue);
+
+    return (queue != NULL) ? ringCount(queue) : 0;
+}
+
+/**
+ * @brief Block until the ring is empty and the consumer is not running a task
+ * @note thread-safe
+ * @param self
+ */
+static void ringWaitIdle(EsWorkQueue *self) {
+    DECL_SELF(EsRingWorkQueue, queue);
+    U_32 ticket;
+
+    do {
+        ticket = EsSignal_prepareWait(self->idle);
+        if (ringCount(queue) == 0 && !I_GET(&queue->busy)) {
+            EsSignal_cancelWait(self->idle);
+            break;
+        }
+        EsSignal_wait(self->idle, ticket);
+    } while (TRUE);
+}
+
+/**
+ * @brief Consumer thread function
+ *
+ * Run tasks until the queue is shutdown, the ring is closed and empty.
+ * (The ring is only published once the queue is running.)
+ * Up to ESQ_RING_MAX_DEQUEUE_BATCH tasks are taken per wakeup.
+ * Sleep on the notEmpty signal while there is nothing to do,
+ * after clearing the busy flag and notifying idle waiters.
+ *
+ * @param arg EsRingWorkQueue
+ * @return NULL
+ */
+static ppointer ringWorker(ppointer arg) {
+    EsRingWorkQueue *queue = (EsRingWorkQueue *) arg;
+    EsWorkTask *batch[ESQ_RING_MAX_DEQUEUE_BATCH];
+    EsRing *ring;
+    U_32 ticket;
+    U_32 n, i;
+
+    do {
+        ring = ringOf(queue);
+        n = (ring != NULL) ? EsRing_takeAll(ring, batch, ESQ_RING_MAX_DEQUEUE_BATCH) : 0;
+        if (n > 0) {
+            EsSignal_notifyAll(queue->notFull);
+            for (i = 0; i < n; i++) {
+                EsWorkTask_run(batch[i]);
+                EsWorkTask_release(batch[i]);
+            }
+            continue;
+        }
+        ticket = EsSignal_prepareWait(queue->notEmpty);
+        if (ring != NULL && EsRing_isReady(ring)) {
+            EsSignal_cancelWait(queue->notEmpty);
+        } else if (I_GET(&queue->state) == ESQ_RING_STATE_SHUTDOWN
+                   && (ring == NULL || (EsRing_isClosed(ring) && EsRing_getCount(ring) == 0))) {
+            EsSignal_cancelWait(queue->notEmpty);
+            break;
+        } else {
+            /* A producer that claimed the head slot notifies once it is published */
+            I_SET(&queue->busy, FALSE);
+            EsSignal_notifyAll(queue->parent.idle);
+            EsSignal_wait(queue->notEmpty, ticket);
+            I_SET(&queue->busy, TRUE);
+        }
+    } while (TRUE);
+
+    I_SET(&queue->busy, FALSE);
+    EsSignal_notifyAll(queue->parent.idle);
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/**
+ * @brief Answer the ring capacity (power of 2) from the queue properties
+ * @param self
+ * @return U_32 capacity
+ */
+static U_32 ringCapacityFromProps(const EsWorkQueue *self) {
+    U_32 requested;
+    U_32 capacity = 2;
+
+    requested = getU32Property(self, ESQ_PROP_CAPACITY, ESQ_RING_DEFAULT_CAPACITY);
+    if (requested == 0 || requested > ESQ_RING_MAX_CAPACITY) {
+        requested = ESQ_RING_DEFAULT_CAPACITY;
+    }
+    while (capacity < requested) {
+        capacity <<= 1u;
+    }
+    return capacity;
+}
+
+/**
+ * @brief Answer the full policy from the queue properties
+ * @param self
+ * @return EsRingFullPolicy
+ */
+static enum EsRingFullPolicy ringPolicyFromProps(const EsWorkQueue *self) {
+    if (EsProperties_valueEquals(self->props, ESQ_PROP_FULL_POLICY, ESQ_FULL_POLICY_REJECT)) {
+        return ESQ_RING_FULL_REJECT;
+    } else if (EsProperties_valueEquals(self->props, ESQ_PROP_FULL_POLICY, ESQ_FULL_POLICY_DROP_OLDEST)) {
+        return ESQ_RING_FULL_DROP_OLDEST;
+    } else {
+        return ESQ_RING_FULL_BLOCK;
+    }
+}
+
+/**
+ * @brief Allocate the ring and start the consumer thread
+ * @note The capacity and full policy are read from
+ * ESQ_PROP_CAPACITY and ESQ_PROP_FULL_POLICY
+ * @param self
+ */
+static void ringInit(EsWorkQueue *self) {
+    DECL_SELF(EsRingWorkQueue, queue);
+    EsRing *ring;
+
+    if (queue == NULL || queue->consumer != NULL || I_GET(&queue->state) != ESQ_RING_STATE_IDLE) {
+        return;
+    }
+
+    ring = EsRing_new(ringCapacityFromProps(self), (U_32) sizeof(EsWorkTask *));
+    if (ring == NULL) {
+        return;
+    }
+    queue->policy = ringPolicyFromProps(self);
+
+    queue->busy = TRUE;
+    queue->consumer = p_uthread_create((PUThreadFunc) ringWorker, (ppointer) queue, TRUE);
+    if (queue->consumer == NULL) {
+        queue->busy = FALSE;
+        EsRing_free(ring);
+        return;
+    }
+    /* Open to producers, a shutdown from here on closes (and frees) the ring */
+    p_atomic_pointer_set(&queue->ring, ring);
+    if (I_CMPXCHG(&queue->state, ESQ_RING_STATE_IDLE, ESQ_RING_STATE_RUNNING) == FALSE) {
+        /* Shutdown came first and may have missed the ring */
+        EsRing_close(ring);
+        EsSignal_notifyAll(queue->notEmpty);
+    }
+}
+
+/**
+ * @brief Shutdown the queue and join the consumer thread
+ * @param self
+ * @note Pending tasks are allowed to finish
+ * @note thread-safe
+ *
+ * Transition to SHUTDOWN and close the ring so future enqueues will be rejected.
+ * Producers that claimed a slot before the ring was closed still publish
+ * their task, and the consumer drains every claimed slot before it exits.
+ * If the queue already shutdown, then just leave
+ */
+static void ringShutdown(EsWorkQueue *self) {
+    DECL_SELF(EsRingWorkQueue, queue);
+    EsRing *ring;
+    I_32 state;
+
+    if (queue == NULL) {
+        return;
+    }
+
+    do {
+        state = I_GET(&queue->state);
+        if (state == ESQ_RING_STATE_SHUTDOWN) {
+            return;
+        }
+    } while (I_CMPXCHG(&queue->state, state, ESQ_RING_STATE_SHUTDOWN) == FALSE);
+
+    ring = ringOf(queue);
+    if (ring != NULL) {
+        EsRing_close(ring);
+    }
+
+    /* Wake the consumer to drain and blocked producers to leave */
+    EsSignal_notifyAll(queue->notEmpty);
+    EsSignal_notifyAll(queue->notFull);
+
+    if (queue->consumer != NULL) {
+        p_uthread_join(queue->consumer);
+        p_uthread_unref(queue->consumer);
+        queue->consumer = NULL;
+    }
+}
+
+/**
+ * @brief Free memory associated with the queue
+ * @note A shutdown is performed first to ensure
+ * the consumer thread is no longer running
+ * @param self
+ */
+static void ringFree(EsWorkQueue *self) {
+    DECL_SELF(EsRingWorkQueue, queue);
+
+    if (queue != NULL) {
+        ringShutdown(self);
+        EsRing_free(ringOf(queue));
+        EsSignal_free(queue->notEmpty);
+        EsSignal_free(queue->notFull);
+        freeWorkQueue(self);
+    }
+}
+
+/**
+ * @brief Answer a new ring buffer work queue
+ * @note The ring is allocated in init, once the properties are set
+ * @return queue or NULL if out of memory
+ */
+static EsWorkQueue *EsRingWorkQueue_new() {
+    EsRingWorkQueue *impl = NULL;
+
+    impl = (EsRingWorkQueue *) calloc(1, sizeof(*impl));
+    if (impl != NULL) {
+        impl->notEmpty = EsSignal_new();
+        impl->notFull = EsSignal_new();
+        if (!initWorkQueue((EsWorkQueue *) impl) || impl->notEmpty == NULL || impl->notFull == NULL) {
+            EsSignal_free(impl->notEmpty);
+            EsSignal_free(impl->notFull);
+            freeWorkQueue((EsWorkQueue *) impl);
+            return NULL;
+        }
+
+        impl->state = ESQ_RING_STATE_IDLE;
+
+        /* Overrides */
+        impl->parent.type = ESQ_TYPE_RING_BUFFER;
+        impl->parent.init = ringInit;
+        impl->parent.shutDown = ringShutdown;
+        impl->parent.enqueue = ringEnqueue;
+        impl->parent.dequeue = ringDequeue;
+        impl->parent.enqueueAll = ringEnqueueAll;
+        impl->parent.dequeueAll = ringDequeueAll;
+        impl->parent.getNumTasks = ringGetNumTasks;
+        impl->parent.waitIdle = ringWaitIdle;
+        impl->parent.free = ringFree;
+    }
+
+    return (EsWorkQueue *) impl;
+}
 
 /******************************************************/
 /*   I N T E R F A C E  I M P L E M E N T A T I O N   */
@@ -376,6 +1466,12 @@ EsWorkQueue *EsWorkQueue_new(enum EsWorkQueueType type) {
         case ESQ_TYPE_SYNCHRONOUS:
             queueImpl = EsSyncWorkQueue_new();
             break;
+        case ESQ_TYPE_THREAD_POOL:
+            queueImpl = EsThreadPoolWorkQueue_new();
+            break;
+        case ESQ_TYPE_RING_BUFFER:
+            queueImpl = EsRingWorkQueue_new();
+            break;
         default:
             break;
     }
@@ -401,12 +1497,20 @@ void EsWorkQueue_shutdown(EsWorkQueue *queue) {
     }
 }
 
-void EsWorkQueue_submit(EsWorkQueue *queue, EsWorkTask *task) {
-    if (queue != NULL) {
-        queue->enqueue(queue, task);
-    }
+BOOLEAN EsWorkQueue_submit(EsWorkQueue *queue, EsWorkTask *task) {
+    return (queue != NULL) ? queue->enqueue(queue, task) : FALSE;
+}
+
+U_32 EsWorkQueue_submitAll(EsWorkQueue *queue, EsWorkTask **tasks, U_32 count) {
+    return (queue != NULL && tasks != NULL) ? queue->enqueueAll(queue, tasks, count) : 0;
 }
 
 U_32 EsWorkQueue_getSize(const EsWorkQueue *queue) {
     return (queue != NULL) ? queue->getNumTasks(queue) : 0;
 }
+
+void EsWorkQueue_waitUntilIdle(EsWorkQueue *queue) {
+    if (queue != NULL) {
+        queue->waitIdle(queue);
+    }
+}
@@ -11,15 +11,23 @@
  *  The following module provides the implementation for Work Queues
  *  to help implement Producer/Consumer models.
  *
+ *  Task Ownership:
+ *  A task that is accepted by EsWorkQueue_submit() is owned by the queue.
+ *  The queue will release the task (@see EsWorkTask_release) once it has run,
+ *  so tasks acquired from a task pool are recycled.
+ *  If the task is rejected, then ownership remains with the caller.
+ *
  *  @example
  *  static void printHelloWorld(EsWorkTask *task) { printf("Hello World\n"); }
  *
- *  EsWorkQueue *queue = EsWorkQueue_new(ESQ_TYPE_SYNCHRONOUS);
+ *  EsWorkQueue *queue = EsWorkQueue_new(ESQ_TYPE_THREAD_POOL);
+ *  EsProperties_atPut(EsWorkQueue_getProperties(queue), ESQ_PROP_NUM_THREADS, "2");
  *  EsWorkQueue_init(queue);
  *  EsWorkTask *task = EsWorkTask_newInit(printHelloWorld, NULL);
- *  EsWorkQueue_submit(queue, task);
+ *  if (!EsWorkQueue_submit(queue, task)) {
+ *      EsWorkTask_free(task);
+ *  }
  *  EsWorkQueue_shutdown(queue);
- *  EsWorkTask_free(task);
  *  EsWorkQueue_free(queue);
  *
  *******************************************************************************/
@@ -38,9 +46,32 @@
  */
 enum EsWorkQueueType {
     ESQ_TYPE_UNDEFINED,
-    ESQ_TYPE_SYNCHRONOUS
+    ESQ_TYPE_SYNCHRONOUS,
+    ESQ_TYPE_THREAD_POOL,
+    ESQ_TYPE_RING_BUFFER
 };
 
+/**
+ * @brief Queue property keys
+ * @note Properties are read by EsWorkQueue_init()
+ * so they should be set before the queue is initialized
+ *
+ * ESQ_PROP_NUM_THREADS: Number of consumer threads (ESQ_TYPE_THREAD_POOL)
+ * ESQ_PROP_CAPACITY: Max number of pending tasks (ESQ_TYPE_RING_BUFFER)
+ *  - rounded up to a power of 2
+ * ESQ_PROP_FULL_POLICY: What a submit does when the queue is full (ESQ_TYPE_RING_BUFFER)
+ *  - ESQ_FULL_POLICY_BLOCK: Wait until there is room (default)
+ *  - ESQ_FULL_POLICY_DROP_OLDEST: Discard (release without running) the oldest pending task
+ *  - ESQ_FULL_POLICY_REJECT: Reject the new task
+ */
+#define ESQ_PROP_NUM_THREADS    "numThreads"
+#define ESQ_PROP_CAPACITY       "capacity"
+#define ESQ_PROP_FULL_POLICY    "fullPolicy"
+
+#define ESQ_FULL_POLICY_BLOCK       "block"
+#define ESQ_FULL_POLICY_DROP_OLDEST "dropOldest"
+#define ESQ_FULL_POLICY_REJECT      "reject"
+
 /**
  * @brief Work Queue that accepts and executes tasks
  * @note This is an opaque datatype
@@ -63,12 +94,14 @@ EsWorkQueue *EsWorkQueue_new(enum EsWorkQueueType type);
 /**
  * @brief Initialize the queue
  * @example starting thread consumers might be done here
+ * @note Queue properties are read here
  * @param queue
  */
 void EsWorkQueue_init(EsWorkQueue *queue);
 
 /**
  * @brief Shuts down the queue gracefully
+ * @note Pending tasks are run before this returns
  * @param queue
  */
 void EsWorkQueue_shutdown(EsWorkQueue *queue);
@@ -98,10 +131,25 @@ EsProperties *EsWorkQueue_getProperties(const EsWorkQueue *queue);
 
 /**
  * @brief Adds a new task to the queue
+ * @note The queue owns (and will release) the task if accepted
  * @param queue
  * @param task
+ * @return TRUE if accepted, FALSE if rejected (i.e. queue is shutdown or full)
+ */
+BOOLEAN EsWorkQueue_submit(EsWorkQueue *queue, EsWorkTask *task);
+
+/**
+ * @brief Adds many tasks to the queue in one operation
+ * @note The queue owns (and will release) the tasks that are accepted.
+ * Accepted tasks are always the first ones in the array, so the caller
+ * still owns tasks[result..count-1].
+ * @note Tasks are queued in array order
+ * @param queue
+ * @param tasks array of tasks
+ * @param count number of tasks in the array
+ * @return number of tasks accepted
  */
-void EsWorkQueue_submit(EsWorkQueue *queue, EsWorkTask *task);
+U_32 EsWorkQueue_submitAll(EsWorkQueue *queue, EsWorkTask **tasks, U_32 count);
 
 /**
  * @brief Answer the number of tasks waiting to execute
@@ -110,4 +158,13 @@ void EsWorkQueue_submit(EsWorkQueue *queue, EsWorkTask *task);
  */
 U_32 EsWorkQueue_getSize(const EsWorkQueue *queue);
 
+/**
+ * @brief Block until all accepted tasks have finished
+ * @note Returns as soon as the last pending or running task is done.
+ * Tasks submitted while waiting are also waited for.
+ * @note Must not be called from a task running on the same queue
+ * @param queue
+ */
+void EsWorkQueue_waitUntilIdle(EsWorkQueue *queue);
+
 #endif //ES_WORK_QUEUE_H
@@ -8,9 +8,35 @@
  *  @author Seth Berman
  *******************************************************************************/
 #include <stdlib.h>
+#include <string.h>
+
+#include "plibsys.h"
 
 #include "EsWorkTask.h"
 
+/*******************/
+/*   M A C R O S   */
+/*******************/
+
+/**
+ * @brief Task Pool Sizes
+ *
+ * CACHE_SIZE: Max free tasks held by each thread
+ * TRANSFER_SIZE: Tasks moved between a thread cache and the overflow list at a time
+ * MAX_OVERFLOW: Max free tasks held by the shared overflow list (the rest are freed)
+ */
+#define ESWT_POOL_CACHE_SIZE        64
+#define ESWT_POOL_TRANSFER_SIZE     32
+#define ESWT_POOL_MAX_OVERFLOW      4096
+
+/**
+ * @brief Pool counter operations
+ * @note Counters are only written by the thread owning the cache,
+ * but they are read by any thread querying the pool
+ */
+#define COUNTER_INC(_c)     p_atomic_pointer_add(&(_c), 1)
+#define COUNTER_GET(_c)     ((U_64) (pssize) p_atomic_pointer_get(&(_c)))
+
 /**************************/
 /*   D A T A  T Y P E S   */
 /**************************/
@@ -21,14 +47,235 @@
  * Contains function to apply against args
  * Contains key=value properties that can
  * be queried
+ * Pooled tasks know the pool they return to
  */
 struct _EsWorkTask {
     EsProperties *props;
     EsWorkTaskFreeUserDataFunc freeUserDataFunc;
     EsWorkTaskRunFunc runFunc;
     void *userData;
+    EsWorkTaskPool *pool;
+    EsWorkTask *next;
+};
+
+/**
+ * @brief Per-thread cache of free tasks
+ *
+ * Only the owning thread touches the tasks.
+ * Caches are registered with the pool so they
+ * can be reclaimed when the pool is freed.
+ */
+typedef struct _EsWorkTaskCache EsWorkTaskCache;
+struct _EsWorkTaskCache {
+    EsWorkTaskPool *pool;
+    EsWorkTaskCache *prevCache;
+    EsWorkTaskCache *nextCache;
+    volatile pssize numHits;
+    volatile pssize numMisses;
+    U_32 numTasks;
+    EsWorkTask *tasks[ESWT_POOL_CACHE_SIZE];
+};
+
+/**
+ * @brief Hidden implementation for EsWorkTaskPool
+ *
+ * Each thread gets its own cache (thread-local) on first use.
+ * The overflow list and the cache registry are guarded by the lock.
+ * Counters of caches whose thread has exited are kept in the
+ * retired counts.
+ *
+ * Freeing a thread-local key does not remove the thread exit hooks
+ * on every platform (plibsys POSIX keeps the pthread key), so a cache
+ * is only ever freed by the exit hook of its thread. The pool stays
+ * allocated until it was freed and its last cache is retired.
+ */
+struct _EsWorkTaskPool {
+    PUThreadKey *cacheKey;
+    PMutex *lock;
+    EsWorkTask *overflow;
+    volatile pint numOverflow;
+    EsWorkTaskCache *caches;
+    U_64 retiredHits;
+    U_64 retiredMisses;
+    BOOLEAN freed;
 };
 
+/************************/
+/*   T A S K  P O O L   */
+/************************/
+
+/**
+ * @brief Push the task on the overflow list or free it if the list is full
+ * @note lock must be held
+ * @param pool
+ * @param task zeroed
+ */
+static void poolPushOverflow(EsWorkTaskPool *pool, EsWorkTask *task) {
+    if (pool->numOverflow < ESWT_POOL_MAX_OVERFLOW) {
+        task->next = pool->overflow;
+        pool->overflow = task;
+        p_atomic_int_set(&pool->numOverflow, pool->numOverflow + 1);
+    } else {
+        free(task);
+    }
+}
+
+/**
+ * @brief Release the memory of the pool and its overflow list
+ * @param pool
+ */
+static void destroyPool(EsWorkTaskPool *pool) {
+    EsWorkTask *task;
+
+    while ((task = pool->overflow) != NULL) {
+        pool->overflow = task->next;
+        free(task);
+    }
+    if (pool->lock != NULL) {
+        p_mutex_free(pool->lock);
+    }
+    free(pool);
+}
+
+/**
+ * @brief Thread exit hook that hands the cached tasks back to the pool
+ * @note Destroys the pool if it was freed and this was its last cache
+ * @param arg EsWorkTaskCache
+ */
+static void retireCache(void *arg) {
+    EsWorkTaskCache *cache = (EsWorkTaskCache *) arg;
+    EsWorkTaskPool *pool;
+    BOOLEAN lastReference;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    pool = cache->pool;
+    p_mutex_lock(pool->lock);
+    while (cache->numTasks > 0) {
+        poolPushOverflow(pool, cache->tasks[--cache->numTasks]);
+    }
+    pool->retiredHits += COUNTER_GET(cache->numHits);
+    pool->retiredMisses += COUNTER_GET(cache->numMisses);
+    if (cache->prevCache != NULL) {
+        cache->prevCache->nextCache = cache->nextCache;
+    } else {
+        pool->caches = cache->nextCache;
+    }
+    if (cache->nextCache != NULL) {
+        cache->nextCache->prevCache = cache->prevCache;
+    }
+    lastReference = (BOOLEAN) (pool->freed && pool->caches == NULL);
+    p_mutex_unlock(pool->lock);
+    free(cache);
+    if (lastReference) {
+        destroyPool(pool);
+    }
+}
+
+/**
+ * @brief Answer the calling thread's cache, creating it on first use
+ * @param pool
+ * @return cache or NULL if out of memory
+ */
+static EsWorkTaskCache *getCache(EsWorkTaskPool *pool) {
+    EsWorkTaskCache *cache;
+
+    cache = (EsWorkTaskCache *) p_uthread_get_local(pool->cacheKey);
+    if (cache == NULL) {
+        cache = (EsWorkTaskCache *) calloc(1, sizeof(EsWorkTaskCache));
+        if (cache != NULL) {
+            cache->pool = pool;
+            p_mutex_lock(pool->lock);
+            cache->nextCache = pool->caches;
+            if (pool->caches != NULL) {
+                pool->caches->prevCache = cache;
+            }
+            pool->caches = cache;
+            p_mutex_unlock(pool->lock);
+            p_uthread_set_local(pool->cacheKey, cache);
+        }
+    }
+    return cache;
+}
+
+/**
+ * @brief Move a batch of tasks from the overflow list to the cache
+ * @param pool
+ * @param cache empty cache
+ */
+static void refillCache(EsWorkTaskPool *pool, EsWorkTaskCache *cache) {
+    EsWorkTask *task;
+
+    if (p_atomic_int_get(&pool->numOverflow) == 0) {
+        return;
+    }
+    p_mutex_lock(pool->lock);
+    while (cache->numTasks < ESWT_POOL_TRANSFER_SIZE && (task = pool->overflow) != NULL) {
+        pool->overflow = task->next;
+        task->next = NULL;
+        cache->tasks[cache->numTasks++] = task;
+    }
+    p_atomic_int_set(&pool->numOverflow, pool->numOverflow - (pint) cache->numTasks);
+    p_mutex_unlock(pool->lock);
+}
+
+/**
+ * @brief Move a batch of tasks from the cache to the overflow list
+ * @param pool
+ * @param cache full cache
+ */
+static void spillCache(EsWorkTaskPool *pool, EsWorkTaskCache *cache) {
+    U_32 i;
+
+    p_mutex_lock(pool->lock);
+    for (i = 0; i < ESWT_POOL_TRANSFER_SIZE; i++) {
+        poolPushOverflow(pool, cache->tasks[--cache->numTasks]);
+    }
+    p_mutex_unlock(pool->lock);
+}
+
+/**
+ * @brief Put a released task back in the pool
+ * @param pool
+ * @param task zeroed
+ */
+static void recycleTask(EsWorkTaskPool *pool, EsWorkTask *task) {
+    EsWorkTaskCache *cache;
+
+    cache = getCache(pool);
+    if (cache == NULL) {
+        p_mutex_lock(pool->lock);
+        poolPushOverflow(pool, task);
+        p_mutex_unlock(pool->lock);
+        return;
+    }
+    if (cache->numTasks == ESWT_POOL_CACHE_SIZE) {
+        spillCache(pool, cache);
+    }
+    cache->tasks[cache->numTasks++] = task;
+}
+
+/**
+ * @brief Sum a counter over the live caches and the retired count
+ * @param pool
+ * @param hits TRUE for hits, FALSE for misses
+ * @return U_64 total
+ */
+static U_64 sumCounter(EsWorkTaskPool *pool, BOOLEAN hits) {
+    EsWorkTaskCache *cache;
+    U_64 total;
+
+    p_mutex_lock(pool->lock);
+    total = hits ? pool->retiredHits : pool->retiredMisses;
+    for (cache = pool->caches; cache != NULL; cache = cache->nextCache) {
+        total += hits ? COUNTER_GET(cache->numHits) : COUNTER_GET(cache->numMisses);
+    }
+    p_mutex_unlock(pool->lock);
+    return total;
+}
+
 /******************************************************/
 /*   I N T E R F A C E  I M P L E M E N T A T I O N   */
 /******************************************************/
@@ -58,6 +305,26 @@ void EsWorkTask_free(EsWorkTask *task) {
     }
 }
 
+void EsWorkTask_release(EsWorkTask *task) {
+    EsWorkTaskPool *pool;
+
+    if (task == NULL) {
+        return;
+    }
+
+    pool = task->pool;
+    if (pool == NULL) {
+        EsWorkTask_free(task);
+        return;
+    }
+    if (task->freeUserDataFunc != NULL) {
+        task->freeUserDataFunc(task->userData);
+    }
+    EsProperties_free(task->props);
+    memset(task, 0, sizeof(EsWorkTask));
+    recycleTask(pool, task);
+}
+
 EsProperties *EsWorkTask_getProperties(const EsWorkTask *task) {
     return (task != NULL) ? task->props : NULL;
 }
@@ -97,3 +364,104 @@ void EsWorkTask_run(EsWorkTask *task) {
         task->runFunc(task);
     }
 }
+
+EsWorkTaskPool *EsWorkTaskPool_new() {
+    EsWorkTaskPool *pool;
+
+    pool = (EsWorkTaskPool *) calloc(1, sizeof(EsWorkTaskPool));
+    if (pool != NULL) {
+        pool->lock = p_mutex_new();
+        pool->cacheKey = p_uthread_local_new(retireCache);
+        if (pool->lock == NULL || pool->cacheKey == NULL) {
+            if (pool->cacheKey != NULL) {
+                p_uthread_local_free(pool->cacheKey);
+            }
+            destroyPool(pool);
+            pool = NULL;
+        }
+    }
+    return pool;
+}
+
+void EsWorkTaskPool_free(EsWorkTaskPool *pool) {
+    EsWorkTaskCache *cache;
+    EsWorkTask *task;
+    BOOLEAN lastReference;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    p_uthread_local_free(pool->cacheKey);
+    pool->cacheKey = NULL;
+
+    /*
+     * Free the cached tasks now (no thread uses the pool anymore), the
+     * caches themselves are retired by their thread exit hooks
+     */
+    p_mutex_lock(pool->lock);
+    pool->freed = TRUE;
+    for (cache = pool->caches; cache != NULL; cache = cache->nextCache) {
+        while (cache->numTasks > 0) {
+            free(cache->tasks[--cache->numTasks]);
+        }
+    }
+    while ((task = pool->overflow) != NULL) {
+        pool->overflow = task->next;
+        free(task);
+    }
+    pool->numOverflow = 0;
+    lastReference = (BOOLEAN) (pool->caches == NULL);
+    p_mutex_unlock(pool->lock);
+    if (lastReference) {
+        destroyPool(pool);
+    }
+}
+
+EsWorkTask *EsWorkTaskPool_acquire(EsWorkTaskPool *pool) {
+    EsWorkTaskCache *cache;
+    EsWorkTask *task = NULL;
+
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    cache = getCache(pool);
+    if (cache != NULL) {
+        if (cache->numTasks == 0) {
+            refillCache(pool, cache);
+        }
+        if (cache->numTasks > 0) {
+            task = cache->tasks[--cache->numTasks];
+            COUNTER_INC(cache->numHits);
+        } else {
+            COUNTER_INC(cache->numMisses);
+        }
+    }
+    if (task == NULL) {
+        task = EsWorkTask_new();
+    }
+    if (task != NULL) {
+        task->pool = pool;
+    }
+    return task;
+}
+
+EsWorkTask *EsWorkTaskPool_acquireInit(EsWorkTaskPool *pool, EsWorkTaskRunFunc func, void *args) {
+    EsWorkTask *task;
+
+    task = EsWorkTaskPool_acquire(pool);
+    if (task != NULL) {
+        task->runFunc = func;
+        task->userData = args;
+    }
+    return task;
+}
+
+U_64 EsWorkTaskPool_getNumHits(EsWorkTaskPool *pool) {
+    return (pool != NULL) ? sumCounter(pool, TRUE) : 0;
+}
+
+U_64 EsWorkTaskPool_getNumMisses(EsWorkTaskPool *pool) {
+    return (pool != NULL) ? sumCounter(pool, FALSE) : 0;
+}
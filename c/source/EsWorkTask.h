@@ -25,6 +25,20 @@
  *  EsWorkTask_run(task);
  *  EsWorkTask_free(task);
  *
+ *  Tasks that are created at a high rate can be taken from a task pool
+ *  (@see EsWorkTaskPool) instead. A pooled task is given back with
+ *  EsWorkTask_release() so its memory is reused by the next acquire.
+ *  Each thread keeps a small cache of free tasks, so acquire and release
+ *  normally do not take a lock or call the allocator. Tasks released on
+ *  one thread and acquired on another move between the caches in batches
+ *  through a shared overflow list.
+ *
+ *  EsWorkTaskPool *pool = EsWorkTaskPool_new();
+ *  EsWorkTask *task = EsWorkTaskPool_acquireInit(pool, printProperties, NULL);
+ *  EsWorkTask_run(task);
+ *  EsWorkTask_release(task);
+ *  EsWorkTaskPool_free(pool);
+ *
  *******************************************************************************/
 #ifndef ES_WORK_TASK_H
 #define ES_WORK_TASK_H
@@ -40,6 +54,11 @@
  */
 typedef struct _EsWorkTask EsWorkTask;
 
+/**
+ * @brief Opaque pool of recyclable work tasks
+ */
+typedef struct _EsWorkTaskPool EsWorkTaskPool;
+
 /**
  * @brief Function that task consumer runs
  */
@@ -75,6 +94,14 @@ EsWorkTask *EsWorkTask_newInit(EsWorkTaskRunFunc func, void *args);
  */
 void EsWorkTask_free(EsWorkTask *task);
 
+/**
+ * @brief Give back the work task
+ * @note The user data is freed (if a free func is set) as with EsWorkTask_free().
+ * A pooled task is then returned to its pool for reuse. Any other task is freed.
+ * @param task
+ */
+void EsWorkTask_release(EsWorkTask *task);
+
 /*************************/
 /*   A C C E S S I N G   */
 /*************************/
@@ -143,4 +170,57 @@ void EsWorkTask_setFreeUserDataFunc(EsWorkTask *task, EsWorkTaskFreeUserDataFunc
  */
 void EsWorkTask_run(EsWorkTask *task);
 
+/*********************/
+/*   P O O L I N G   */
+/*********************/
+
+/**
+ * @brief Answer a new work task pool
+ * @return pool or NULL if out of memory
+ */
+EsWorkTaskPool *EsWorkTaskPool_new();
+
+/**
+ * @brief Destroy the pool and all the free tasks it holds
+ * @note All tasks acquired from the pool must have been released
+ * (or freed) and no other thread may be using the pool.
+ * The cache of a thread that has used the pool is reclaimed when that
+ * thread exits, together with the rest of the pool if it was the last one.
+ * @param pool
+ */
+void EsWorkTaskPool_free(EsWorkTaskPool *pool);
+
+/**
+ * @brief Answer a zeroed work task from the pool
+ * @note thread-safe
+ * @note Give it back with EsWorkTask_release()
+ * @param pool
+ * @return task or NULL if out of memory
+ */
+EsWorkTask *EsWorkTaskPool_acquire(EsWorkTaskPool *pool);
+
+/**
+ * @brief Answer an initialized work task from the pool
+ * @note thread-safe
+ * @param pool
+ * @param func to run
+ * @param args user-supplied data
+ * @return task or NULL if out of memory
+ */
+EsWorkTask *EsWorkTaskPool_acquireInit(EsWorkTaskPool *pool, EsWorkTaskRunFunc func, void *args);
+
+/**
+ * @brief Answer the number of acquires served by a recycled task
+ * @param pool
+ * @return U_64 hits
+ */
+U_64 EsWorkTaskPool_getNumHits(EsWorkTaskPool *pool);
+
+/**
+ * @brief Answer the number of acquires that had to allocate a new task
+ * @param pool
+ * @return U_64 misses
+ */
+U_64 EsWorkTaskPool_getNumMisses(EsWorkTaskPool *pool);
+
 #endif //ES_WORK_TASK_H
@@ -0,0 +1,172 @@
+#include <stdlib.h>
+
+#include "EsUnitTest.h"
+#include "EsEpoch.h"
+
+#define NUM_READERS     4
+#define NUM_WRITES      200
+
+static EsEpoch *Epoch;
+static U_32 *volatile SharedData;
+static volatile pint NumReadersDone;
+static volatile pint ReaderEntered;
+static volatile pint EpochFreed;
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Thread-Function that reads the shared data until the writer is done
+ * @param arg unused
+ * @return (ppointer) TRUE if every read saw a consistent value
+ */
+static void *readSharedData(void *arg) {
+    pboolean consistent = TRUE;
+    U_32 *data;
+
+    ES_UNUSED(arg);
+    while (p_atomic_pointer_get(&SharedData) != NULL) {
+        if (EsEpoch_enter(Epoch)) {
+            data = (U_32 *) p_atomic_pointer_get(&SharedData);
+            /* A freed (reclaimed) snapshot would fail here or under a sanitizer */
+            if (data != NULL && data[0] != data[1]) {
+                consistent = FALSE;
+            }
+            EsEpoch_exit(Epoch);
+        }
+    }
+    p_atomic_int_inc(&NumReadersDone);
+    p_uthread_exit(consistent);
+    return NULL;
+}
+
+/**
+ * @brief Thread-Function that reads once and exits after the epoch was freed
+ * @param arg unused
+ * @return NULL
+ */
+static void *readThenOutliveEpoch(void *arg) {
+    ES_UNUSED(arg);
+    if (EsEpoch_enter(Epoch)) {
+        EsEpoch_exit(Epoch);
+    }
+    p_atomic_int_set(&ReaderEntered, TRUE);
+    while (!p_atomic_int_get(&EpochFreed)) {
+        p_uthread_yield();
+    }
+    /* Thread exit hooks may still run for the reader record */
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/**
+ * @brief Answer new shared data with the value in both slots
+ * @param value
+ * @return data
+ */
+static U_32 *newData(U_32 value) {
+    U_32 *data = (U_32 *) malloc(sizeof(U_32) * 2);
+
+    data[0] = value;
+    data[1] = value;
+    return data;
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test new/free and enter/exit on the calling thread
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_newFree() {
+    Epoch = EsEpoch_new();
+    ES_DENY(Epoch == NULL);
+    ES_ASSERT(EsEpoch_enter(Epoch));
+    EsEpoch_exit(Epoch);
+
+    /* No readers inside: returns right away */
+    EsEpoch_synchronize(Epoch);
+    EsEpoch_free(Epoch);
+    EsEpoch_free(NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test a writer replacing and freeing data while readers read it
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_synchronize() {
+    PUThread *threads[NUM_READERS];
+    U_32 *oldData;
+
+    Epoch = EsEpoch_new();
+    SharedData = newData(0);
+    NumReadersDone = 0;
+    for (U_32 i = 0; i < NUM_READERS; i++) {
+        threads[i] = p_uthread_create((PUThreadFunc) readSharedData, NULL, TRUE);
+        ES_DENY(threads[i] == NULL);
+    }
+
+    for (U_32 i = 1; i <= NUM_WRITES; i++) {
+        oldData = SharedData;
+        p_atomic_pointer_set(&SharedData, newData(i));
+        EsEpoch_synchronize(Epoch);
+        /* Scribble on the old data so a late reader would see it torn */
+        oldData[0] = 0xFFFFFFFF;
+        free(oldData);
+    }
+
+    oldData = SharedData;
+    p_atomic_pointer_set(&SharedData, NULL);
+    EsEpoch_synchronize(Epoch);
+    free(oldData);
+
+    for (U_32 i = 0; i < NUM_READERS; i++) {
+        ES_ASSERT(p_uthread_join(threads[i]) == TRUE);
+        p_uthread_unref(threads[i]);
+    }
+    ES_ASSERT(NumReadersDone == NUM_READERS);
+    EsEpoch_free(Epoch);
+    return TRUE;
+}
+
+/**
+ * @brief Test a reader thread that exits after the epoch was freed
+ * @note Its reader record must stay valid until its thread exit hook
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_readerOutlivesEpoch() {
+    PUThread *thread;
+
+    Epoch = EsEpoch_new();
+    ReaderEntered = FALSE;
+    EpochFreed = FALSE;
+    thread = p_uthread_create((PUThreadFunc) readThenOutliveEpoch, NULL, TRUE);
+    ES_DENY(thread == NULL);
+    while (!p_atomic_int_get(&ReaderEntered)) {
+        p_uthread_yield();
+    }
+    EsEpoch_free(Epoch);
+    p_atomic_int_set(&EpochFreed, TRUE);
+    p_uthread_join(thread);
+    p_uthread_unref(thread);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_newFree);
+    ES_RUN_TEST(test_synchronize);
+    ES_RUN_TEST(test_readerOutlivesEpoch);
+    ES_RETURN_TEST_RESULTS();
+}
@@ -0,0 +1,171 @@
+#include "EsUnitTest.h"
+#include "EsHandleTable.h"
+
+static EsHandleTable *Table;
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Thread-Function that adds and removes handles
+ * @param arg number of rounds
+ * @return NULL
+ */
+static void *addRemoveHandles(void *arg) {
+    U_32 numRounds = (U_32) (U_PTR) arg;
+    U_32 handle;
+
+    for (U_32 round = 0; round < numRounds; round++) {
+        handle = EsHandleTable_add(Table, arg);
+        if (handle != ES_HANDLE_NONE) {
+            EsHandleTable_remove(Table, handle);
+        }
+    }
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test add/at/remove
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_addRemove() {
+    int a, b;
+    U_32 handleA, handleB;
+
+    ES_ASSERT(EsHandleTable_new(0) == NULL);
+    ES_ASSERT(EsHandleTable_new(ES_HANDLE_TABLE_MAX_CAPACITY + 1) == NULL);
+
+    Table = EsHandleTable_new(8);
+    ES_DENY(Table == NULL);
+    ES_ASSERT(EsHandleTable_add(Table, NULL) == ES_HANDLE_NONE);
+
+    handleA = EsHandleTable_add(Table, &a);
+    handleB = EsHandleTable_add(Table, &b);
+    ES_DENY(handleA == ES_HANDLE_NONE);
+    ES_DENY(handleA == handleB);
+    ES_ASSERT(handleA < (1u << 30u));
+    ES_ASSERT(EsHandleTable_getSize(Table) == 2);
+    ES_ASSERT(EsHandleTable_at(Table, handleA) == &a);
+    ES_ASSERT(EsHandleTable_at(Table, handleB) == &b);
+    ES_ASSERT(EsHandleTable_at(Table, ES_HANDLE_NONE) == NULL);
+
+    ES_ASSERT(EsHandleTable_remove(Table, handleA) == &a);
+    ES_ASSERT(EsHandleTable_getSize(Table) == 1);
+    ES_ASSERT(EsHandleTable_at(Table, handleA) == NULL);
+    ES_ASSERT(EsHandleTable_remove(Table, handleA) == NULL);
+    ES_ASSERT(EsHandleTable_remove(Table, handleB) == &b);
+    ES_ASSERT(EsHandleTable_getSize(Table) == 0);
+    EsHandleTable_free(Table);
+    return TRUE;
+}
+
+/**
+ * @brief Test a stale handle is not answered the new pointer of its slot
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_stale() {
+    int a, b;
+    U_32 handleA, handleB;
+
+    Table = EsHandleTable_new(1);
+    handleA = EsHandleTable_add(Table, &a);
+    ES_ASSERT(EsHandleTable_add(Table, &b) == ES_HANDLE_NONE);
+    EsHandleTable_remove(Table, handleA);
+
+    /* Same slot, new generation */
+    handleB = EsHandleTable_add(Table, &b);
+    ES_DENY(handleB == ES_HANDLE_NONE);
+    ES_DENY(handleA == handleB);
+    ES_ASSERT(EsHandleTable_at(Table, handleA) == NULL);
+    ES_ASSERT(EsHandleTable_remove(Table, handleA) == NULL);
+    ES_ASSERT(EsHandleTable_at(Table, handleB) == &b);
+
+    /* Generations wrap around without ever making handle 0 */
+    for (U_32 i = 0; i < 5000; i++) {
+        EsHandleTable_remove(Table, handleB);
+        handleB = EsHandleTable_add(Table, &b);
+        ES_DENY(handleB == ES_HANDLE_NONE);
+    }
+    EsHandleTable_free(Table);
+    return TRUE;
+}
+
+/**
+ * @brief Test the tag of a handle is answered with its pointer
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_tagged() {
+    int a, b;
+    U_32 handleA, handleB;
+    U_32 tag;
+
+    Table = EsHandleTable_new(2);
+    handleA = EsHandleTable_addTagged(Table, &a, 7);
+    handleB = EsHandleTable_add(Table, &b);
+
+    tag = 0;
+    ES_ASSERT(EsHandleTable_atTagged(Table, handleA, &tag) == &a);
+    ES_ASSERT(tag == 7);
+    ES_ASSERT(EsHandleTable_atTagged(Table, handleB, &tag) == &b);
+    ES_ASSERT(tag == 0);
+    ES_ASSERT(EsHandleTable_atTagged(Table, handleA, NULL) == &a);
+
+    /* The tag does not survive the handle, and the free list is intact */
+    tag = 0;
+    ES_ASSERT(EsHandleTable_removeTagged(Table, handleA, &tag) == &a);
+    ES_ASSERT(tag == 7);
+    tag = 42;
+    ES_ASSERT(EsHandleTable_atTagged(Table, handleA, &tag) == NULL);
+    ES_ASSERT(EsHandleTable_removeTagged(Table, handleA, &tag) == NULL);
+    ES_ASSERT(tag == 42);
+    handleA = EsHandleTable_add(Table, &a);
+    ES_DENY(handleA == ES_HANDLE_NONE);
+    ES_ASSERT(EsHandleTable_atTagged(Table, handleA, &tag) == &a);
+    ES_ASSERT(tag == 0);
+    ES_ASSERT(EsHandleTable_add(Table, &a) == ES_HANDLE_NONE);
+    EsHandleTable_free(Table);
+    return TRUE;
+}
+
+/**
+ * @brief Test add/remove from many threads
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_threads() {
+    PUThread *threads[4];
+
+    Table = EsHandleTable_new(16);
+    for (U_32 i = 0; i < 4; i++) {
+        threads[i] = p_uthread_create((PUThreadFunc) addRemoveHandles, (ppointer) (U_PTR) 10000, TRUE);
+        ES_DENY(threads[i] == NULL);
+    }
+    for (U_32 i = 0; i < 4; i++) {
+        p_uthread_join(threads[i]);
+        p_uthread_unref(threads[i]);
+    }
+    ES_ASSERT(EsHandleTable_getSize(Table) == 0);
+    EsHandleTable_free(Table);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_addRemove);
+    ES_RUN_TEST(test_stale);
+    ES_RUN_TEST(test_tagged);
+    ES_RUN_TEST(test_threads);
+    ES_RETURN_TEST_RESULTS();
+}
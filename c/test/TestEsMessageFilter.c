@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsMessageFilter.h"
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Answer if the filter accepts the topic/payload
+ * @param filter
+ * @param topic null-terminated
+ * @param payload null-terminated
+ * @return TRUE if accepted, FALSE otherwise
+ */
+static BOOLEAN accept(EsMessageFilter *filter, const char *topic, const char *payload) {
+    return EsMessageFilter_accept(filter, topic, 0, payload, (U_32) strlen(payload));
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test the filter types and params are checked
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_new() {
+    EsMessageFilter *filter;
+
+    ES_ASSERT(EsMessageFilter_new(ESMF_TYPE_NONE, 1) == NULL);
+    ES_ASSERT(EsMessageFilter_new(ESMF_TYPE_SAMPLE, 0) == NULL);
+    ES_ASSERT(EsMessageFilter_new(ESMF_TYPE_RATE_LIMIT, 0) == NULL);
+    ES_ASSERT(EsMessageFilter_new((enum EsMessageFilterTypes) 99, 1) == NULL);
+
+    filter = EsMessageFilter_new(ESMF_TYPE_DEDUPE, 0);
+    ES_DENY(filter == NULL);
+    EsMessageFilter_free(filter);
+    EsMessageFilter_free(NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test 1/N sampling is counted per topic name
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_sample() {
+    EsMessageFilter *filter;
+    EsMessageFilterStats stats;
+    U_32 numAccepted = 0;
+
+    filter = EsMessageFilter_new(ESMF_TYPE_SAMPLE, 3);
+    for (U_32 i = 0; i < 9; i++) {
+        if (accept(filter, "sensors/1/temp", "20")) {
+            numAccepted++;
+        }
+    }
+    ES_ASSERT(numAccepted == 3);
+
+    /* A new topic name starts with its first message */
+    ES_ASSERT(accept(filter, "sensors/2/temp", "20"));
+    ES_DENY(accept(filter, "sensors/2/temp", "20"));
+    ES_ASSERT(accept(filter, "sensors/1/temp", "20"));
+
+    EsMessageFilter_getStats(filter, &stats);
+    ES_ASSERT(stats.numTopics == 2);
+    ES_ASSERT(stats.numAccepted == 5);
+    ES_ASSERT(stats.numDropped == 7);
+    EsMessageFilter_free(filter);
+
+    /* 1/1 accepts everything */
+    filter = EsMessageFilter_new(ESMF_TYPE_SAMPLE, 1);
+    ES_ASSERT(accept(filter, "a", "x"));
+    ES_ASSERT(accept(filter, "a", "x"));
+    EsMessageFilter_free(filter);
+    return TRUE;
+}
+
+/**
+ * @brief Test rate limiting per topic name
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_rateLimit() {
+    EsMessageFilter *filter;
+
+    filter = EsMessageFilter_new(ESMF_TYPE_RATE_LIMIT, 100);
+    ES_ASSERT(accept(filter, "a/b", "1"));
+    ES_DENY(accept(filter, "a/b", "2"));
+    ES_DENY(accept(filter, "a/b", "3"));
+    ES_ASSERT(accept(filter, "a/c", "1"));
+
+    p_uthread_sleep(150);
+    ES_ASSERT(accept(filter, "a/b", "4"));
+    ES_DENY(accept(filter, "a/b", "5"));
+    EsMessageFilter_free(filter);
+    return TRUE;
+}
+
+/**
+ * @brief Test duplicate payloads are dropped per topic name
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_dedupe() {
+    EsMessageFilter *filter;
+
+    filter = EsMessageFilter_new(ESMF_TYPE_DEDUPE, 0);
+    ES_ASSERT(accept(filter, "a", "on"));
+    ES_DENY(accept(filter, "a", "on"));
+    ES_ASSERT(accept(filter, "b", "on"));
+    ES_ASSERT(accept(filter, "a", "off"));
+    ES_ASSERT(accept(filter, "a", "on"));
+    ES_DENY(accept(filter, "a", "on"));
+
+    /* Empty payloads are compared too */
+    ES_ASSERT(EsMessageFilter_accept(filter, "c", 0, NULL, 0));
+    ES_DENY(EsMessageFilter_accept(filter, "c", 0, NULL, 0));
+
+    /* Topic names with a length are not null-terminated */
+    ES_DENY(EsMessageFilter_accept(filter, "a/x", 1, "on", 2));
+    EsMessageFilter_free(filter);
+
+    /* A duplicate passes again once the param expired */
+    filter = EsMessageFilter_new(ESMF_TYPE_DEDUPE, 100);
+    ES_ASSERT(accept(filter, "a", "on"));
+    ES_DENY(accept(filter, "a", "on"));
+    p_uthread_sleep(150);
+    ES_ASSERT(accept(filter, "a", "on"));
+    EsMessageFilter_free(filter);
+    return TRUE;
+}
+
+/**
+ * @brief Test many topic names keep their own state
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_manyTopics() {
+    EsMessageFilter *filter;
+    EsMessageFilterStats stats;
+    char topic[32];
+
+    filter = EsMessageFilter_new(ESMF_TYPE_SAMPLE, 2);
+    for (U_32 i = 0; i < 1000; i++) {
+        snprintf(topic, sizeof(topic), "sensors/%u", i);
+        ES_ASSERT(accept(filter, topic, "1"));
+    }
+    for (U_32 i = 0; i < 1000; i++) {
+        snprintf(topic, sizeof(topic), "sensors/%u", i);
+        ES_DENY(accept(filter, topic, "1"));
+    }
+    EsMessageFilter_getStats(filter, &stats);
+    ES_ASSERT(stats.numTopics == 1000);
+    EsMessageFilter_free(filter);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_new);
+    ES_RUN_TEST(test_sample);
+    ES_RUN_TEST(test_rateLimit);
+    ES_RUN_TEST(test_dedupe);
+    ES_RUN_TEST(test_manyTopics);
+    ES_RETURN_TEST_RESULTS();
+}
@@ -0,0 +1,211 @@
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsMqttAsyncArguments.h"
+#include "EsRefBuffer.h"
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Answer TRUE if ptr lies inside the block
+ * @param ptr
+ * @param block
+ * @param size of block
+ * @return TRUE if inside, FALSE otherwise
+ */
+static pboolean isInBlock(const void *ptr, const void *block, U_SIZE size) {
+    return (const U_8 *) ptr >= (const U_8 *) block && (const U_8 *) ptr < (const U_8 *) block + size;
+}
+
+/**
+ * @brief Fill the props with one property of each value kind
+ * @param props[out]
+ * @param array[out] backing array of 3 properties
+ */
+static void initProperties(MQTTProperties *props, MQTTProperty *array) {
+    memset(array, 0, sizeof(MQTTProperty) * 3);
+    array[0].identifier = MQTTPROPERTY_CODE_MESSAGE_EXPIRY_INTERVAL;
+    array[0].value.integer4 = 60;
+    array[1].identifier = MQTTPROPERTY_CODE_REASON_STRING;
+    array[1].value.data.len = 6;
+    array[1].value.data.data = "reason";
+    array[2].identifier = MQTTPROPERTY_CODE_USER_PROPERTY;
+    array[2].value.data.len = 3;
+    array[2].value.data.data = "key";
+    array[2].value.value.len = 5;
+    array[2].value.value.data = "value";
+
+    props->count = 3;
+    props->max_count = 10;
+    props->length = 42;
+    props->array = array;
+}
+
+/**
+ * @brief Answer TRUE if copy is a deep copy of the props from initProperties()
+ * @param copy
+ * @param props
+ * @param block that must hold the copied array and values
+ * @param size of block
+ * @return TRUE if deep copy, FALSE otherwise
+ */
+static pboolean isDeepCopy(const MQTTProperties *copy, const MQTTProperties *props, const void *block, U_SIZE size) {
+    MQTTProperty *array = copy->array;
+
+    return copy->count == 3 && copy->max_count == 3 && copy->length == props->length
+           && array != props->array && isInBlock(array, block, size)
+           && array[0].value.integer4 == 60
+           && array[1].value.data.len == 6 && strcmp(array[1].value.data.data, "reason") == 0
+           && array[1].value.data.data != props->array[1].value.data.data
+           && isInBlock(array[1].value.data.data, block, size)
+           && strcmp(array[2].value.data.data, "key") == 0
+           && array[2].value.value.len == 5 && strcmp(array[2].value.value.data, "value") == 0
+           && isInBlock(array[2].value.value.data + array[2].value.value.len, block, size);
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test properties are deep copied into a single block
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_copyProperties() {
+    MQTTProperties props = MQTTProperties_initializer;
+    MQTTProperty array[3];
+    MQTTProperties *copy;
+    U_SIZE blockSize = sizeof(MQTTProperties) + sizeof(array) + 7 + 4 + 6;
+
+    copy = EsCopyProperties(&props);
+    ES_DENY(copy == NULL);
+    ES_ASSERT(copy->count == 0);
+    ES_ASSERT(copy->array == NULL);
+    EsFreeMemory(copy);
+
+    initProperties(&props, array);
+    copy = EsCopyProperties(&props);
+    ES_DENY(copy == NULL);
+    ES_ASSERT(isDeepCopy(copy, &props, copy, blockSize));
+    EsFreeMemory(copy);
+
+    ES_ASSERT(EsCopyProperties(NULL) == NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test message copy has a shared payload buffer and deep copied properties
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_copyMessage() {
+    MQTTClient_message msg = MQTTClient_message_initializer;
+    MQTTProperty array[3];
+    MQTTClient_message *copy;
+    U_SIZE blockSize = sizeof(MQTTClient_message) + sizeof(array) + 7 + 4 + 6;
+
+    msg.payload = "hello";
+    msg.payloadlen = 5;
+    msg.qos = 1;
+    initProperties(&msg.properties, array);
+
+    copy = EsCopyMessage(&msg);
+    ES_DENY(copy == NULL);
+    ES_ASSERT(copy->qos == 1);
+    ES_ASSERT(copy->payloadlen == 5);
+    ES_ASSERT(memcmp(copy->payload, "hello", 5) == 0);
+    ES_DENY(EsRefBuffer_getHandle(copy->payload) == ES_HANDLE_NONE);
+    ES_ASSERT(EsRefBuffer_getRefCount(copy->payload) == 1);
+    ES_ASSERT(isDeepCopy(&copy->properties, &msg.properties, copy, blockSize));
+    EsFreeMessageCopy(copy);
+
+    ES_ASSERT(EsCopyMessage(NULL) == NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test freeing a message copy releases only the initial payload reference
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_freeMessageCopy() {
+    MQTTClient_message msg = MQTTClient_message_initializer;
+    MQTTClient_message *copy;
+    U_32 buffer;
+
+    msg.payload = "hello";
+    msg.payloadlen = 5;
+    copy = EsCopyMessage(&msg);
+    ES_DENY(copy == NULL);
+    buffer = EsRefBuffer_getHandle(copy->payload);
+
+    /* Another holder keeps the payload alive after the copy is freed */
+    ES_ASSERT(EsRefBuffer_acquireHandle(buffer));
+    EsFreeMessageCopy(copy);
+    ES_ASSERT(EsRefBuffer_acquireHandle(buffer));
+    ES_ASSERT(EsRefBuffer_releaseHandle(buffer));
+    ES_ASSERT(EsRefBuffer_releaseHandle(buffer));
+
+    /* The last holder freed it */
+    ES_DENY(EsRefBuffer_acquireHandle(buffer));
+    ES_DENY(EsRefBuffer_releaseHandle(buffer));
+    return TRUE;
+}
+
+/**
+ * @brief Test topic copies are null-terminated
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_copyTopicString() {
+    char *copy;
+
+    copy = EsCopyTopicString("a/b/c-ignored", 5);
+    ES_ASSERT(strcmp(copy, "a/b/c") == 0);
+    EsFreeMemory(copy);
+
+    copy = EsCopyTopicString("a/b", 0);
+    ES_ASSERT(strcmp(copy, "a/b") == 0);
+    EsFreeMemory(copy);
+    return TRUE;
+}
+
+/**
+ * @brief Test properties are packed as 4-byte aligned items
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_packProperties() {
+    MQTTProperties props;
+    MQTTProperty array[3];
+    U_32 packed[12];
+
+    initProperties(&props, array);
+    ES_ASSERT(EsPackedPropertiesSize(NULL) == 0);
+    ES_ASSERT(EsPackedPropertiesSize(&props) == sizeof(packed));
+
+    memset(packed, 0xFF, sizeof(packed));
+    EsPackProperties(&props, packed);
+    ES_ASSERT(packed[0] == MQTTPROPERTY_CODE_MESSAGE_EXPIRY_INTERVAL && packed[1] == 60);
+    ES_ASSERT(packed[2] == MQTTPROPERTY_CODE_REASON_STRING && packed[3] == 6);
+    ES_ASSERT(memcmp(&packed[4], "reason\0\0", 8) == 0);
+    ES_ASSERT(packed[6] == MQTTPROPERTY_CODE_USER_PROPERTY && packed[7] == 3);
+    ES_ASSERT(memcmp(&packed[8], "key\0", 4) == 0);
+    ES_ASSERT(packed[9] == 5 && memcmp(&packed[10], "value\0\0\0", 8) == 0);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_copyProperties);
+    ES_RUN_TEST(test_copyMessage);
+    ES_RUN_TEST(test_freeMessageCopy);
+    ES_RUN_TEST(test_copyTopicString);
+    ES_RUN_TEST(test_packProperties);
+    ES_RETURN_TEST_RESULTS();
+}
@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsMessageFilter.h"
+#include "EsMqttLibrary.h"
+#include "EsMqttAsyncArguments.h"
+#include "EsMqttAsyncMessages.h"
+#include "EsRefBuffer.h"
+
+/*
+ * Messages are only sent where they are freed in C (filtered or unrouted),
+ * so no test posts to a vm.
+ */
+
+/***************/
+/*  F A K E S  */
+/***************/
+
+/**
+ * @brief Number of Paho messages and strings given back to the fake Paho
+ */
+static volatile I_32 _FreedMessages;
+static volatile I_32 _FreedStrings;
+
+/**
+ * @brief Fake MQTTClient_freeMessage()
+ */
+static void fakeFreeMessage(MQTTClient_message **msg) {
+    free((*msg)->payload);
+    free(*msg);
+    *msg = NULL;
+    p_atomic_int_inc(&_FreedMessages);
+}
+
+/**
+ * @brief Fake MQTTClient_free()
+ */
+static void fakeFree(void *ptr) {
+    free(ptr);
+    p_atomic_int_inc(&_FreedStrings);
+}
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Answer a new arrived message of the topic, with Paho's data allocated as Paho does
+ * @param topic
+ * @return arrived message
+ */
+static EsMqttAsyncMessage *newArrivedMessage(const char *topic) {
+    MQTTClient_message initializer = MQTTClient_message_initializer;
+    MQTTClient_message *message;
+    char *topicName;
+
+    message = (MQTTClient_message *) malloc(sizeof(MQTTClient_message));
+    *message = initializer;
+    message->payload = malloc(5);
+    memcpy(message->payload, "hello", 5);
+    message->payloadlen = 5;
+    topicName = (char *) malloc(strlen(topic) + 1);
+    strcpy(topicName, topic);
+    return EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_MESSAGEARRIVED, 4, NULL, topicName, 0, message);
+}
+
+/**
+ * @brief Reset the freed counters, post inline and enable pass-through with the fake Paho
+ */
+static void setUp() {
+    p_atomic_int_set(&_FreedMessages, 0);
+    p_atomic_int_set(&_FreedStrings, 0);
+    EsMqttAsyncMessage_SetDispatcher(FALSE);
+    EsMqttAsyncArguments_SetPassThrough(fakeFreeMessage, fakeFree);
+    EsMqttAsyncMessage_SetTopicRoute("routed/#", EsTrue, EsTrue);
+}
+
+/**
+ * @brief Remove the route and filter and go back to copies
+ */
+static void tearDown() {
+    EsMqttAsyncMessage_SetTopicRoute("routed/#", EsNil, EsNil);
+    EsMqttAsyncMessage_SetTopicFilter("sampled/#", ESMF_TYPE_NONE, 0);
+    EsMqttAsyncArguments_SetPassThrough(NULL, NULL);
+}
+
+/**
+ * @brief Wait until the fake Paho got the number of messages back
+ * @param count
+ * @return TRUE if freed, FALSE on timeout
+ */
+static pboolean waitForFreedMessages(I_32 count) {
+    int i;
+
+    for (i = 0; i < 1000 && p_atomic_int_get(&_FreedMessages) < count; i++) {
+        p_uthread_sleep(1);
+    }
+    return p_atomic_int_get(&_FreedMessages) == count;
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test an inline pass-through message that matches no route is given back to Paho
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_inlineUnrouted() {
+    EsMqttFlowStats before, after;
+
+    setUp();
+    EsMqttAsyncMessage_GetFlowStats(&before);
+    ES_ASSERT(EsMqttAsyncMessage_send(newArrivedMessage("other/topic")) == TRUE);
+    EsMqttAsyncMessage_GetFlowStats(&after);
+    ES_ASSERT(after.numUnrouted == before.numUnrouted + 1);
+    ES_ASSERT(after.numPosts == before.numPosts);
+    ES_ASSERT(p_atomic_int_get(&_FreedMessages) == 1 && p_atomic_int_get(&_FreedStrings) == 1);
+    tearDown();
+    return TRUE;
+}
+
+/**
+ * @brief Test an inline pass-through message dropped by its topic filter is given back to Paho
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_inlineFiltered() {
+    EsMqttFlowStats before, after;
+
+    setUp();
+    ES_ASSERT(EsMqttAsyncMessage_SetTopicFilter("sampled/#", ESMF_TYPE_SAMPLE, 2));
+    EsMqttAsyncMessage_GetFlowStats(&before);
+    /* The first is accepted (and unrouted), the second is dropped */
+    ES_ASSERT(EsMqttAsyncMessage_send(newArrivedMessage("sampled/a")) == TRUE);
+    ES_ASSERT(EsMqttAsyncMessage_send(newArrivedMessage("sampled/a")) == TRUE);
+    EsMqttAsyncMessage_GetFlowStats(&after);
+    ES_ASSERT(after.numFiltered == before.numFiltered + 1);
+    ES_ASSERT(after.numUnrouted == before.numUnrouted + 1);
+    ES_ASSERT(p_atomic_int_get(&_FreedMessages) == 2 && p_atomic_int_get(&_FreedStrings) == 2);
+    tearDown();
+    return TRUE;
+}
+
+/**
+ * @brief Test a queued pass-through message that matches no route is given back to Paho
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_dispatcherUnrouted() {
+    setUp();
+    EsMqttAsyncMessage_SetDispatcher(TRUE);
+    ES_ASSERT(EsMqttAsyncMessage_send(newArrivedMessage("other/topic")) == TRUE);
+    ES_ASSERT(waitForFreedMessages(1));
+    ES_ASSERT(p_atomic_int_get(&_FreedStrings) == 1);
+    tearDown();
+    return TRUE;
+}
+
+/**
+ * @brief Test an unrouted copied message leaves Paho's data to Paho
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_copiedUnrouted() {
+    MQTTClient_message initializer = MQTTClient_message_initializer;
+    MQTTClient_message message = initializer;
+    char topicName[] = "other/topic";
+
+    setUp();
+    EsMqttAsyncArguments_SetPassThrough(NULL, NULL);
+    message.payload = "hello";
+    message.payloadlen = 5;
+    ES_ASSERT(EsMqttAsyncMessage_send(EsMqttAsyncMessage_newInit(
+            ESMQTT_CB_TYPE_MESSAGEARRIVED, 4, NULL, topicName, 0, &message)) == TRUE);
+    ES_ASSERT(p_atomic_int_get(&_FreedMessages) == 0 && p_atomic_int_get(&_FreedStrings) == 0);
+    tearDown();
+    return TRUE;
+}
+
+/**
+ * @brief Test an arrived message whose payload can not be copied is not created
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_copyFailure() {
+    MQTTClient_message initializer = MQTTClient_message_initializer;
+    MQTTClient_message message = initializer;
+    char topicName[] = "other/topic";
+    EsMqttAsyncMessage *msg;
+    void **buffers;
+    U_32 numBuffers;
+
+    EsMqttAsyncArguments_SetPassThrough(NULL, NULL);
+    message.payload = "hello";
+    message.payloadlen = 5;
+
+    /* Use up every payload buffer handle */
+    buffers = (void **) malloc(sizeof(void *) * 70000);
+    for (numBuffers = 0; numBuffers < 70000; numBuffers++) {
+        buffers[numBuffers] = EsRefBuffer_new(1);
+        if (buffers[numBuffers] == NULL) {
+            break;
+        }
+    }
+    ES_ASSERT(numBuffers < 70000);
+    msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_MESSAGEARRIVED, 4, NULL, topicName, 0, &message);
+    while (numBuffers > 0) {
+        EsRefBuffer_release(buffers[--numBuffers]);
+    }
+    free(buffers);
+    ES_ASSERT(msg == NULL);
+
+    msg = EsMqttAsyncMessage_newInit(ESMQTT_CB_TYPE_MESSAGEARRIVED, 4, NULL, topicName, 0, &message);
+    ES_ASSERT(msg != NULL);
+    EsMqttAsyncMessage_free(msg);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    EsGlobalInfo globalInfo;
+
+    EsMqttLibraryInit(&globalInfo);
+    ES_RUN_TEST(test_inlineUnrouted);
+    ES_RUN_TEST(test_inlineFiltered);
+    ES_RUN_TEST(test_dispatcherUnrouted);
+    ES_RUN_TEST(test_copiedUnrouted);
+    ES_RUN_TEST(test_copyFailure);
+    EsMqttLibraryShutdown();
+    ES_RETURN_TEST_RESULTS();
+}
@@ -0,0 +1,473 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsMqttBulk.h"
+
+/***************/
+/*  F A K E S  */
+/***************/
+
+#define FAKE_MAX_MESSAGES 8
+
+/**
+ * @brief What the fake publish functions were last given
+ */
+static char _PublishedTopic[64];
+static char _PublishedPayload[64];
+static int _PublishedQos;
+static int _PublishedRetained;
+static int _PublishCount;
+static int _Publish5Count;
+
+/**
+ * @brief Messages the fake receive answers, in order
+ */
+static const char *_ReceiveTopics[FAKE_MAX_MESSAGES];
+static const char *_ReceivePayloads[FAKE_MAX_MESSAGES];
+static int _ReceiveCount;
+static int _ReceiveNext;
+static int _ReceiveRc;
+static int _FreedCount;
+
+/**
+ * @brief Record the published message
+ * @param topicName
+ * @param msg
+ */
+static void recordPublish(const char *topicName, const MQTTClient_message *msg) {
+    strcpy(_PublishedTopic, topicName);
+    memcpy(_PublishedPayload, msg->payload, (size_t) msg->payloadlen);
+    _PublishedPayload[msg->payloadlen] = '\0';
+    _PublishedQos = msg->qos;
+    _PublishedRetained = msg->retained;
+}
+
+/**
+ * @brief Fake MQTTClient_publishMessage(), fails the topic "bad"
+ */
+static int fakePublish(MQTTClient handle, const char *topicName, MQTTClient_message *msg,
+                       MQTTClient_deliveryToken *dt) {
+    ES_UNUSED(handle);
+
+    _PublishCount++;
+    recordPublish(topicName, msg);
+    if (strcmp(topicName, "bad") == 0) {
+        return MQTTCLIENT_FAILURE;
+    }
+    *dt = _PublishCount;
+    return MQTTCLIENT_SUCCESS;
+}
+
+/**
+ * @brief Fake MQTTClient_publishMessage() of an MQTT v5 client
+ */
+static int fakePublishWrongVersion(MQTTClient handle, const char *topicName, MQTTClient_message *msg,
+                                   MQTTClient_deliveryToken *dt) {
+    ES_UNUSED(handle);
+    ES_UNUSED(topicName);
+    ES_UNUSED(msg);
+    ES_UNUSED(dt);
+
+    _PublishCount++;
+    return MQTTCLIENT_WRONG_MQTT_VERSION;
+}
+
+/**
+ * @brief Fake MQTTClient_publishMessage5()
+ */
+static MQTTResponse fakePublish5(MQTTClient handle, const char *topicName, MQTTClient_message *msg,
+                                 MQTTClient_deliveryToken *dt) {
+    MQTTResponse response;
+
+    ES_UNUSED(handle);
+
+    memset(&response, 0, sizeof(response));
+    _Publish5Count++;
+    recordPublish(topicName, msg);
+    *dt = 100 + _Publish5Count;
+    return response;
+}
+
+/**
+ * @brief Fake MQTTClient_receive(), answers the next queued message
+ */
+static int fakeReceive(MQTTClient handle, char **topicName, int *topicLen, MQTTClient_message **message,
+                       unsigned long timeout) {
+    MQTTClient_message initializer = MQTTClient_message_initializer;
+    MQTTClient_message *msg;
+    const char *payload;
+
+    ES_UNUSED(handle);
+    ES_UNUSED(timeout);
+
+    if (_ReceiveRc != MQTTCLIENT_SUCCESS) {
+        return _ReceiveRc;
+    }
+    if (_ReceiveNext == _ReceiveCount) {
+        return MQTTCLIENT_SUCCESS;
+    }
+    payload = _ReceivePayloads[_ReceiveNext];
+    msg = (MQTTClient_message *) malloc(sizeof(MQTTClient_message));
+    *msg = initializer;
+    msg->payloadlen = (int) strlen(payload);
+    msg->payload = malloc(strlen(payload) + 1);
+    strcpy((char *) msg->payload, payload);
+    msg->qos = 1;
+    msg->msgid = _ReceiveNext + 1;
+    *topicName = (char *) malloc(strlen(_ReceiveTopics[_ReceiveNext]) + 1);
+    strcpy(*topicName, _ReceiveTopics[_ReceiveNext]);
+    *topicLen = 0;
+    *message = msg;
+    _ReceiveNext++;
+    return MQTTCLIENT_SUCCESS;
+}
+
+/**
+ * @brief Fake MQTTClient_freeMessage()
+ */
+static void fakeFreeMessage(MQTTClient_message **msg) {
+    free((*msg)->payload);
+    free(*msg);
+    *msg = NULL;
+    _FreedCount++;
+}
+
+/**
+ * @brief Fake MQTTClient_free()
+ */
+static void fakeFree(void *ptr) {
+    free(ptr);
+}
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Set up the bulk module with the fake functions and nothing to receive
+ */
+static void setUp() {
+    EsMqttBulk_ModuleInit(NULL);
+    EsMqttBulk_SetPublishFunc(fakePublish);
+    EsMqttBulk_SetReceiveFuncs(fakeReceive, fakeFreeMessage, fakeFree);
+    _PublishCount = 0;
+    _Publish5Count = 0;
+    _ReceiveCount = 0;
+    _ReceiveNext = 0;
+    _ReceiveRc = MQTTCLIENT_SUCCESS;
+    _FreedCount = 0;
+}
+
+/**
+ * @brief Queue a message for the fake receive
+ * @param topic
+ * @param payload
+ */
+static void queueMessage(const char *topic, const char *payload) {
+    _ReceiveTopics[_ReceiveCount] = topic;
+    _ReceivePayloads[_ReceiveCount] = payload;
+    _ReceiveCount++;
+}
+
+/**
+ * @brief Pack a publish record the way the Smalltalk image does
+ * @param records 4-byte aligned
+ * @param offset of the record
+ * @param topic
+ * @param payload
+ * @param qos
+ * @param retained
+ * @return offset after the record, including its padding
+ */
+static U_32 packRecord(U_8 *records, U_32 offset, const char *topic, const char *payload, I_32 qos, I_32 retained) {
+    EsMqttPublishRecord record;
+
+    record.topicLen = (U_32) strlen(topic);
+    record.payloadLen = (U_32) strlen(payload);
+    record.qos = qos;
+    record.retained = retained;
+    memcpy(records + offset, &record, sizeof(record));
+    offset += sizeof(record);
+    memcpy(records + offset, topic, record.topicLen + 1);
+    offset += record.topicLen + 1;
+    memcpy(records + offset, payload, record.payloadLen);
+    offset += record.payloadLen;
+    return (offset + 3) & ~3U;
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test records are published in order and each starts on a 4-byte boundary
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_publish() {
+    U_32 records[32];
+    U_8 *bytes = (U_8 *) records;
+    I_32 tokens[3];
+    U_32 size;
+
+    setUp();
+    size = packRecord(bytes, 0, "a/b", "hello", 1, 0);
+    ES_ASSERT(size == 28);
+    size = packRecord(bytes, size, "bad", "x", 0, 0);
+    ES_ASSERT(size == 52);
+    size = packRecord(bytes, size, "c", "", 2, 1);
+    ES_ASSERT(size == 72);
+
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 3, tokens) == 3);
+    ES_ASSERT(_PublishCount == 3);
+    ES_ASSERT(tokens[0] == 1 && tokens[1] == MQTTCLIENT_FAILURE && tokens[2] == 3);
+    ES_ASSERT(strcmp(_PublishedTopic, "c") == 0 && _PublishedPayload[0] == '\0');
+    ES_ASSERT(_PublishedQos == 2 && _PublishedRetained == 1);
+
+    /* The last record may end without its padding */
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size - 2, 3, tokens) == 3);
+    EsMqttBulk_ModuleShutdown();
+    return TRUE;
+}
+
+/**
+ * @brief Test a malformed or truncated record stops the publishing
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_publishMalformed() {
+    U_32 records[32];
+    U_8 *bytes = (U_8 *) records;
+    EsMqttPublishRecord *second;
+    I_32 tokens[3];
+    U_32 first;
+    U_32 size;
+
+    setUp();
+    first = packRecord(bytes, 0, "a/b", "hello", 1, 0);
+    size = packRecord(bytes, first, "c/d", "world", 0, 0);
+    second = (EsMqttPublishRecord *) (bytes + first);
+
+    /* Truncated: the second payload runs past the records */
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size - 4, 2, tokens) == 1);
+    ES_ASSERT(strcmp(_PublishedTopic, "a/b") == 0);
+
+    /* Fewer records than count */
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 3, tokens) == 2);
+
+    /* Topic not null-terminated */
+    bytes[first + sizeof(EsMqttPublishRecord) + second->topicLen] = 'x';
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 2, tokens) == 1);
+
+    /* Empty topic */
+    packRecord(bytes, first, "c/d", "world", 0, 0);
+    second->topicLen = 0;
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 2, tokens) == 1);
+
+    /* Payload length overflows */
+    second->topicLen = 3;
+    second->payloadLen = 0xFFFFFFF0U;
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 2, tokens) == 1);
+
+    /* Topic length wraps the sum of the lengths on 32-bit */
+    second->topicLen = 0xFFFFFFFFU;
+    second->payloadLen = 5;
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 2, tokens) == 1);
+
+    /* Only the header of the second record */
+    second->topicLen = 3;
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, first + sizeof(EsMqttPublishRecord), 2, tokens) == 1);
+    EsMqttBulk_ModuleShutdown();
+    return TRUE;
+}
+
+/**
+ * @brief Test MQTT v5 clients are published with MQTTClient_publishMessage5()
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_publishV5() {
+    U_32 records[32];
+    U_8 *bytes = (U_8 *) records;
+    I_32 tokens[2];
+    U_32 size;
+
+    setUp();
+    size = packRecord(bytes, 0, "a/b", "hello", 1, 0);
+    size = packRecord(bytes, size, "c/d", "world", 2, 1);
+
+    /* No v5 function, every record fails */
+    EsMqttBulk_SetPublishFunc(fakePublishWrongVersion);
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 2, tokens) == 2);
+    ES_ASSERT(tokens[0] == MQTTCLIENT_WRONG_MQTT_VERSION && tokens[1] == MQTTCLIENT_WRONG_MQTT_VERSION);
+
+    /* Only the first record tries the v3 function */
+    _PublishCount = 0;
+    EsMqttBulk_SetPublish5Func(fakePublish5);
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 2, tokens) == 2);
+    ES_ASSERT(_PublishCount == 1 && _Publish5Count == 2);
+    ES_ASSERT(tokens[0] == 101 && tokens[1] == 102);
+    ES_ASSERT(strcmp(_PublishedTopic, "c/d") == 0 && strcmp(_PublishedPayload, "world") == 0);
+    ES_ASSERT(_PublishedQos == 2 && _PublishedRetained == 1);
+
+    /* Only the v5 function */
+    EsMqttBulk_SetPublishFunc(NULL);
+    ES_ASSERT(EsMqttBulk_Publish(NULL, records, size, 2, tokens) == 2);
+    ES_ASSERT(_PublishCount == 1 && _Publish5Count == 4);
+    EsMqttBulk_ModuleShutdown();
+    return TRUE;
+}
+
+/**
+ * @brief Test nothing is published without a function or with misaligned buffers
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_publishRefused() {
+    U_32 records[16];
+    U_8 *bytes = (U_8 *) records;
+    I_32 tokens[2];
+    U_32 size;
+
+    setUp();
+    size = packRecord(bytes, 4, "a/b", "hello", 1, 0);
+    ES_ASSERT(EsMqttBulk_Publish(NULL, bytes + 1, size - 4, 1, tokens) == 0);
+    ES_ASSERT(EsMqttBulk_Publish(NULL, bytes + 4, size - 4, 1, (I_32 *) ((U_8 *) tokens + 2)) == 0);
+    ES_ASSERT(EsMqttBulk_Publish(NULL, NULL, size - 4, 1, tokens) == 0);
+    ES_ASSERT(_PublishCount == 0);
+    ES_ASSERT(EsMqttBulk_Publish(NULL, bytes + 4, size - 4, 1, tokens) == 1);
+
+    EsMqttBulk_SetPublishFunc(NULL);
+    ES_ASSERT(EsMqttBulk_Publish(NULL, bytes + 4, size - 4, 1, tokens) == 0);
+    ES_ASSERT(_PublishCount == 1);
+    EsMqttBulk_ModuleShutdown();
+    return TRUE;
+}
+
+/**
+ * @brief Test received messages are written as zero-padded records and given back
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_receive() {
+    U_32 buffer[32];
+    U_8 *bytes = (U_8 *) buffer;
+    EsMqttReceiveRecord record;
+    U_32 end;
+    I_32 rc;
+
+    setUp();
+    queueMessage("a/b", "hello");
+    queueMessage("topic", "");
+    memset(buffer, 0xFF, sizeof(buffer));
+
+    end = EsMqttBulk_Receive(NULL, buffer, sizeof(buffer), 4, 10, 0, &rc);
+    ES_ASSERT(rc == MQTTCLIENT_SUCCESS);
+    ES_ASSERT(end == 4 + 28 + 4 + 8 + 28 + 8);
+    ES_ASSERT(_FreedCount == 2);
+
+    memcpy(&record, bytes + 4, sizeof(record));
+    ES_ASSERT(record.topicLen == 3 && record.propertiesLen == 0 && record.payloadLen == 5);
+    ES_ASSERT(record.qos == 1 && record.msgid == 1);
+    ES_ASSERT(memcmp(bytes + 32, "a/b\0", 4) == 0);
+    ES_ASSERT(memcmp(bytes + 36, "hello\0\0\0", 8) == 0);
+
+    memcpy(&record, bytes + 44, sizeof(record));
+    ES_ASSERT(record.topicLen == 5 && record.payloadLen == 0 && record.msgid == 2);
+    ES_ASSERT(memcmp(bytes + 72, "topic\0\0\0", 8) == 0);
+    ES_ASSERT(bytes[end] == 0xFF);
+
+    /* Nothing ready */
+    ES_ASSERT(EsMqttBulk_Receive(NULL, buffer, sizeof(buffer), 0, 10, 0, &rc) == 0);
+    ES_ASSERT(rc == MQTTCLIENT_SUCCESS);
+    EsMqttBulk_ModuleShutdown();
+    return TRUE;
+}
+
+/**
+ * @brief Test a message that does not fit is held and written first by the next receive
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_receiveHeld() {
+    U_32 buffer[32];
+    U_8 *bytes = (U_8 *) buffer;
+    MQTTClient client = (MQTTClient) &buffer;
+    EsMqttReceiveRecord record;
+    I_32 rc;
+
+    setUp();
+    queueMessage("a/b", "hello");
+    queueMessage("c/d", "world!");
+    queueMessage("e/f", "third");
+
+    ES_ASSERT(EsMqttBulk_GetHeldSize(client) == 0);
+    ES_ASSERT(EsMqttBulk_Receive(client, buffer, 60, 0, 10, 0, &rc) == 40);
+    ES_ASSERT(rc == MQTTCLIENT_SUCCESS);
+    ES_ASSERT(_FreedCount == 1);
+    ES_ASSERT(EsMqttBulk_GetHeldSize(client) == 40);
+    ES_ASSERT(EsMqttBulk_GetHeldSize(NULL) == 0);
+
+    /* Held per client */
+    ES_ASSERT(EsMqttBulk_Receive(NULL, buffer, sizeof(buffer), 0, 1, 0, &rc) == 40);
+    memcpy(&record, bytes, sizeof(record));
+    ES_ASSERT(record.msgid == 3);
+
+    ES_ASSERT(EsMqttBulk_Receive(client, buffer, sizeof(buffer), 0, 10, 0, &rc) == 40);
+    memcpy(&record, bytes, sizeof(record));
+    ES_ASSERT(record.payloadLen == 6 && record.msgid == 2);
+    ES_ASSERT(memcmp(bytes + 32, "world!\0\0", 8) == 0);
+    ES_ASSERT(EsMqttBulk_GetHeldSize(client) == 0);
+    ES_ASSERT(_FreedCount == 3);
+
+    /* Held messages are given back on shutdown */
+    queueMessage("g/h", "held");
+    ES_ASSERT(EsMqttBulk_Receive(client, buffer, 16, 0, 10, 0, &rc) == 0);
+    ES_ASSERT(EsMqttBulk_GetHeldSize(client) == 36);
+    EsMqttBulk_ModuleShutdown();
+    ES_ASSERT(_FreedCount == 4);
+    return TRUE;
+}
+
+/**
+ * @brief Test a failed receive answers its return code
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_receiveFailure() {
+    U_32 buffer[32];
+    I_32 rc;
+
+    setUp();
+    queueMessage("a/b", "hello");
+    _ReceiveRc = MQTTCLIENT_FAILURE - 2;
+    ES_ASSERT(EsMqttBulk_Receive(NULL, buffer, sizeof(buffer), 8, 10, 0, &rc) == 8);
+    ES_ASSERT(rc == MQTTCLIENT_FAILURE - 2);
+    ES_ASSERT(_ReceiveNext == 0);
+
+    /* Refused arguments */
+    _ReceiveRc = MQTTCLIENT_SUCCESS;
+    ES_ASSERT(EsMqttBulk_Receive(NULL, buffer, sizeof(buffer), 2, 10, 0, &rc) == 2);
+    ES_ASSERT(rc == MQTTCLIENT_FAILURE);
+    ES_ASSERT(EsMqttBulk_Receive(NULL, buffer, 8, 12, 10, 0, &rc) == 12);
+    ES_ASSERT(rc == MQTTCLIENT_FAILURE);
+    ES_ASSERT(EsMqttBulk_SetReceiveFuncs(fakeReceive, NULL, fakeFree) == FALSE);
+    ES_ASSERT(EsMqttBulk_Receive(NULL, buffer, sizeof(buffer), 0, 10, 0, &rc) == 0);
+    ES_ASSERT(rc == MQTTCLIENT_FAILURE);
+    ES_ASSERT(_ReceiveNext == 0);
+    EsMqttBulk_ModuleShutdown();
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_publish);
+    ES_RUN_TEST(test_publishMalformed);
+    ES_RUN_TEST(test_publishV5);
+    ES_RUN_TEST(test_publishRefused);
+    ES_RUN_TEST(test_receive);
+    ES_RUN_TEST(test_receiveHeld);
+    ES_RUN_TEST(test_receiveFailure);
+    ES_RETURN_TEST_RESULTS();
+}
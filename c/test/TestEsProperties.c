@@ -1,3 +1,7 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "EsUnitTest.h"
 #include "EsProperties.h"
 
@@ -156,6 +160,96 @@ static pboolean test_sequenceable() {
 	return TRUE;
 }
 
+/**
+ * @brief Test lookup, update, order and removal as the properties grow
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_manyKeys() {
+    EsProperties *p;
+    EsPropertyPair pair;
+    char keys[100][8];
+    char value[8];
+    char *removed;
+    U_32 i;
+
+    p = EsProperties_new();
+    for (i = 0; i < 100; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%u", i);
+        snprintf(value, sizeof(value), "v%u", i);
+        EsProperties_atPut(p, keys[i], value);
+    }
+    ES_ASSERT(EsProperties_getSize(p) == 100);
+    for (i = 0; i < 100; i++) {
+        snprintf(value, sizeof(value), "v%u", i);
+        ES_ASSERT(EsProperties_valueEquals(p, keys[i], value));
+        EsProperties_atIndex(p, i, &pair);
+        ES_ASSERT(pair.key == keys[i]);
+    }
+
+    /* Lookup by an equal key that is not the same string */
+    ES_ASSERT(EsProperties_valueEquals(p, "k42", "v42"));
+
+    /* Update keeps the position */
+    EsProperties_atPut(p, "k7", "updated");
+    ES_ASSERT(EsProperties_getSize(p) == 100);
+    ES_ASSERT(EsProperties_valueEquals(p, "k7", "updated"));
+    EsProperties_atIndex(p, 7, &pair);
+    ES_ASSERT(pair.key == keys[7]);
+
+    /* Remove from the middle keeps the order */
+    removed = EsProperties_removeKey(p, "k50");
+    ES_ASSERT(removed != NULL && strcmp(removed, "v50") == 0);
+    free(removed);
+    ES_ASSERT(EsProperties_getSize(p) == 99);
+    ES_DENY(EsProperties_includesKey(p, "k50"));
+    EsProperties_atIndex(p, 50, &pair);
+    ES_ASSERT(pair.key == keys[51]);
+    ES_ASSERT(EsProperties_valueEquals(p, "k99", "v99"));
+
+    EsProperties_free(p);
+    return TRUE;
+}
+
+/**
+ * @brief Test values that outgrow the inline arena and entries
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_spill() {
+    EsProperties *p;
+    char longValue[200];
+    char *removed;
+
+    memset(longValue, 'x', sizeof(longValue) - 1);
+    longValue[sizeof(longValue) - 1] = '\0';
+
+    p = EsProperties_new();
+    EsProperties_atPut(p, "small", "1");
+    EsProperties_atPut(p, "long", longValue);
+    EsProperties_atPut(p, "small2", "2");
+    ES_ASSERT(EsProperties_valueEquals(p, "long", longValue));
+
+    /* Arena values are answered as heap copies */
+    removed = EsProperties_removeKey(p, "small");
+    ES_ASSERT(removed != NULL && strcmp(removed, "1") == 0);
+    free(removed);
+    removed = EsProperties_removeKey(p, "long");
+    ES_ASSERT(removed != NULL && strcmp(removed, longValue) == 0);
+    free(removed);
+
+    /* Spill the inline entries */
+    EsProperties_atPut(p, "a", "a");
+    EsProperties_atPut(p, "b", "b");
+    EsProperties_atPut(p, "c", "c");
+    EsProperties_atPut(p, "d", "d");
+    EsProperties_atPut(p, "b", longValue);
+    ES_ASSERT(EsProperties_getSize(p) == 5);
+    ES_ASSERT(EsProperties_valueEquals(p, "small2", "2"));
+    ES_ASSERT(EsProperties_valueEquals(p, "b", longValue));
+    ES_ASSERT(EsProperties_valueEquals(p, "d", "d"));
+    EsProperties_free(p);
+    return TRUE;
+}
+
 /**************************/
 /*   T E S T  S U I T E   */
 /**************************/
@@ -168,5 +262,7 @@ int main() {
     ES_RUN_TEST(test_newFree);
     ES_RUN_TEST(test_properties);
     ES_RUN_TEST(test_sequenceable);
+    ES_RUN_TEST(test_manyKeys);
+    ES_RUN_TEST(test_spill);
     ES_RETURN_TEST_RESULTS();
 }
\ No newline at end of file
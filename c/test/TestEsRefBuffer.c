@@ -0,0 +1,154 @@
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsRefBuffer.h"
+
+static void *Buffer;
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Thread-Function that acquires and releases the shared buffer by address and handle
+ * @param arg number of rounds
+ * @return NULL
+ */
+static void *acquireReleaseBuffer(void *arg) {
+    U_32 numRounds = (U_32) (U_PTR) arg;
+
+    U_32 handle = EsRefBuffer_getHandle(Buffer);
+
+    for (U_32 round = 0; round < numRounds; round++) {
+        EsRefBuffer_acquire(Buffer);
+        EsRefBuffer_release(Buffer);
+        EsRefBuffer_acquireHandle(handle);
+        EsRefBuffer_releaseHandle(handle);
+    }
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test new/copy and the accessors
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_newCopy() {
+    const char *bytes = "payload";
+
+    Buffer = EsRefBuffer_newCopy(bytes, 7);
+    ES_DENY(Buffer == NULL);
+    ES_ASSERT(memcmp(Buffer, bytes, 7) == 0);
+    ES_ASSERT(((U_PTR) Buffer % sizeof(U_64)) == 0);
+    ES_DENY(EsRefBuffer_getHandle(Buffer) == ES_HANDLE_NONE);
+    ES_ASSERT(EsRefBuffer_getSize(Buffer) == 7);
+    ES_ASSERT(EsRefBuffer_getRefCount(Buffer) == 1);
+    ES_ASSERT(EsRefBuffer_release(Buffer));
+
+    Buffer = EsRefBuffer_new(0);
+    ES_DENY(Buffer == NULL);
+    ES_ASSERT(EsRefBuffer_getSize(Buffer) == 0);
+    ES_ASSERT(EsRefBuffer_release(Buffer));
+
+    ES_ASSERT(EsRefBuffer_getHandle(NULL) == ES_HANDLE_NONE);
+    ES_DENY(EsRefBuffer_acquire(NULL));
+    ES_DENY(EsRefBuffer_release(NULL));
+    ES_ASSERT(EsRefBuffer_getSize(NULL) == 0);
+    ES_ASSERT(EsRefBuffer_getRefCount(NULL) == 0);
+    return TRUE;
+}
+
+/**
+ * @brief Test the buffer lives until the last reference is released
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_acquireRelease() {
+    Buffer = EsRefBuffer_new(16);
+    ES_ASSERT(EsRefBuffer_acquire(Buffer));
+    ES_ASSERT(EsRefBuffer_acquire(Buffer));
+    ES_ASSERT(EsRefBuffer_getRefCount(Buffer) == 3);
+
+    ES_ASSERT(EsRefBuffer_release(Buffer));
+    ES_ASSERT(EsRefBuffer_release(Buffer));
+    ES_ASSERT(EsRefBuffer_getRefCount(Buffer) == 1);
+    memset(Buffer, 0xFF, 16);
+    ES_ASSERT(EsRefBuffer_release(Buffer));
+    return TRUE;
+}
+
+/**
+ * @brief Test acquire/release by handle, and that a stale handle is rejected
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_handles() {
+    U_32 handle;
+    void *other;
+
+    Buffer = EsRefBuffer_new(16);
+    handle = EsRefBuffer_getHandle(Buffer);
+    ES_ASSERT(EsRefBuffer_acquireHandle(handle));
+    ES_ASSERT(EsRefBuffer_getRefCount(Buffer) == 2);
+    ES_ASSERT(EsRefBuffer_releaseHandle(handle));
+    ES_ASSERT(EsRefBuffer_getRefCount(Buffer) == 1);
+
+    /* The last release by handle frees the buffer, its handle is stale */
+    ES_ASSERT(EsRefBuffer_releaseHandle(handle));
+    ES_DENY(EsRefBuffer_acquireHandle(handle));
+    ES_DENY(EsRefBuffer_releaseHandle(handle));
+
+    /* A new buffer does not answer to the stale handle */
+    other = EsRefBuffer_new(16);
+    ES_DENY(EsRefBuffer_getHandle(other) == handle);
+    ES_DENY(EsRefBuffer_acquireHandle(handle));
+    ES_ASSERT(EsRefBuffer_getRefCount(other) == 1);
+
+    /* The last release by address also makes the handle stale */
+    handle = EsRefBuffer_getHandle(other);
+    ES_ASSERT(EsRefBuffer_release(other));
+    ES_DENY(EsRefBuffer_acquireHandle(handle));
+
+    ES_DENY(EsRefBuffer_acquireHandle(ES_HANDLE_NONE));
+    ES_DENY(EsRefBuffer_releaseHandle(ES_HANDLE_NONE));
+    return TRUE;
+}
+
+/**
+ * @brief Test acquire/release from many threads
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_threads() {
+    PUThread *threads[4];
+
+    Buffer = EsRefBuffer_new(8);
+    for (U_32 i = 0; i < 4; i++) {
+        threads[i] = p_uthread_create((PUThreadFunc) acquireReleaseBuffer, (ppointer) (U_PTR) 10000, TRUE);
+        ES_DENY(threads[i] == NULL);
+    }
+    for (U_32 i = 0; i < 4; i++) {
+        p_uthread_join(threads[i]);
+        p_uthread_unref(threads[i]);
+    }
+    ES_ASSERT(EsRefBuffer_getRefCount(Buffer) == 1);
+    ES_ASSERT(EsRefBuffer_release(Buffer));
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_newCopy);
+    ES_RUN_TEST(test_acquireRelease);
+    ES_RUN_TEST(test_handles);
+    ES_RUN_TEST(test_threads);
+    ES_RETURN_TEST_RESULTS();
+}
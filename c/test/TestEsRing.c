@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsRing.h"
+
+#define NUM_PRODUCERS       4
+#define NUM_RECORDS         20000
+
+static EsRing *Ring;
+
+/**
+ * @brief Record used by the tests
+ */
+typedef struct _TestRecord TestRecord;
+struct _TestRecord {
+    U_32 producer;
+    U_32 number;
+};
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Thread-Function that pushes numbered records, retrying while the ring is full
+ * @param arg producer id
+ * @return NULL
+ */
+static void *pushRecords(void *arg) {
+    TestRecord record;
+
+    record.producer = (U_32) (U_PTR) arg;
+    for (record.number = 0; record.number < NUM_RECORDS; record.number++) {
+        while (!EsRing_push(Ring, &record, sizeof(record))) {
+            p_uthread_yield();
+        }
+    }
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test the ring arguments are checked
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_new() {
+    ES_ASSERT(EsRing_new(0, 8) == NULL);
+    ES_ASSERT(EsRing_new(8, 0) == NULL);
+    ES_ASSERT(EsRing_new(ES_RING_MAX_CAPACITY + 1, 8) == NULL);
+
+    Ring = EsRing_new(5, 8);
+    ES_DENY(Ring == NULL);
+    ES_ASSERT(EsRing_getCapacity(Ring) == 8);
+    ES_ASSERT(EsRing_peek(Ring) == NULL);
+    EsRing_free(Ring);
+
+    Ring = EsRing_new(1, 8);
+    ES_ASSERT(EsRing_getCapacity(Ring) == 2);
+    EsRing_free(Ring);
+    EsRing_free(NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test records come out in order, and a full ring refuses records
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_pushPop() {
+    const char *record;
+    char text[16];
+
+    Ring = EsRing_new(4, 16);
+    ES_ASSERT(EsRing_push(Ring, "one", 4));
+    ES_ASSERT(EsRing_push(Ring, "two", 4));
+    ES_ASSERT(EsRing_push(Ring, "three", 6));
+    ES_ASSERT(EsRing_push(Ring, "four", 5));
+    ES_DENY(EsRing_push(Ring, "five", 5));
+    ES_DENY(EsRing_push(Ring, "too large for a record", 23));
+
+    record = (const char *) EsRing_peek(Ring);
+    ES_ASSERT(strcmp(record, "one") == 0);
+    ES_ASSERT(EsRing_peek(Ring) == record);
+    EsRing_pop(Ring);
+    ES_ASSERT(EsRing_push(Ring, "five", 5));
+
+    ES_ASSERT(strcmp((const char *) EsRing_peek(Ring), "two") == 0);
+    EsRing_pop(Ring);
+    ES_ASSERT(strcmp((const char *) EsRing_peek(Ring), "three") == 0);
+    EsRing_pop(Ring);
+    ES_ASSERT(strcmp((const char *) EsRing_peek(Ring), "four") == 0);
+    EsRing_pop(Ring);
+    ES_ASSERT(strcmp((const char *) EsRing_peek(Ring), "five") == 0);
+    EsRing_pop(Ring);
+    ES_ASSERT(EsRing_peek(Ring) == NULL);
+
+    /* Many rounds through the slots */
+    for (U_32 i = 0; i < 1000; i++) {
+        snprintf(text, sizeof(text), "%u", i);
+        ES_ASSERT(EsRing_push(Ring, text, (U_32) strlen(text) + 1));
+        ES_ASSERT(strcmp((const char *) EsRing_peek(Ring), text) == 0);
+        EsRing_pop(Ring);
+    }
+    EsRing_free(Ring);
+    return TRUE;
+}
+
+/**
+ * @brief Test runs of records are pushed and taken, and a closed ring refuses records
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_pushTakeAll() {
+    U_32 in[6] = {1, 2, 3, 4, 5, 6};
+    U_32 out[6] = {0};
+
+    Ring = EsRing_new(4, sizeof(U_32));
+    ES_DENY(EsRing_isReady(Ring));
+    ES_ASSERT(EsRing_takeAll(Ring, out, 4) == 0);
+
+    /* Only as many as there is room for */
+    ES_ASSERT(EsRing_pushAll(Ring, in, 6) == 4);
+    ES_ASSERT(EsRing_getCount(Ring) == 4);
+    ES_ASSERT(EsRing_pushAll(Ring, in + 4, 2) == 0);
+    ES_ASSERT(EsRing_isReady(Ring));
+
+    ES_ASSERT(EsRing_takeAll(Ring, out, 3) == 3);
+    ES_ASSERT(out[0] == 1 && out[1] == 2 && out[2] == 3);
+    ES_ASSERT(EsRing_pushAll(Ring, in + 4, 2) == 2);
+    ES_ASSERT(EsRing_takeAll(Ring, out, 6) == 3);
+    ES_ASSERT(out[0] == 4 && out[1] == 5 && out[2] == 6);
+    ES_ASSERT(EsRing_getCount(Ring) == 0);
+
+    /* Closed: claimed records drain, new ones are refused */
+    ES_ASSERT(EsRing_pushAll(Ring, in, 2) == 2);
+    ES_DENY(EsRing_isClosed(Ring));
+    EsRing_close(Ring);
+    EsRing_close(Ring);
+    ES_ASSERT(EsRing_isClosed(Ring));
+    ES_DENY(EsRing_push(Ring, in, sizeof(U_32)));
+    ES_ASSERT(EsRing_pushAll(Ring, in, 1) == 0);
+    ES_ASSERT(EsRing_getCount(Ring) == 2);
+    ES_ASSERT(EsRing_takeAll(Ring, out, 6) == 2);
+    ES_ASSERT(out[0] == 1 && out[1] == 2);
+    ES_ASSERT(EsRing_getCount(Ring) == 0);
+    EsRing_free(Ring);
+    return TRUE;
+}
+
+/**
+ * @brief Test many producers with a concurrent consumer
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_threads() {
+    PUThread *threads[NUM_PRODUCERS];
+    U_32 nextNumber[NUM_PRODUCERS] = {0};
+    const TestRecord *record;
+    U_32 numRecords = 0;
+
+    Ring = EsRing_new(64, sizeof(TestRecord));
+    for (U_32 i = 0; i < NUM_PRODUCERS; i++) {
+        threads[i] = p_uthread_create((PUThreadFunc) pushRecords, (ppointer) (U_PTR) i, TRUE);
+        ES_DENY(threads[i] == NULL);
+    }
+
+    /* Each producer's records come out in its own order */
+    while (numRecords < NUM_PRODUCERS * NUM_RECORDS) {
+        record = (const TestRecord *) EsRing_peek(Ring);
+        if (record == NULL) {
+            p_uthread_yield();
+            continue;
+        }
+        ES_ASSERT(record->producer < NUM_PRODUCERS);
+        ES_ASSERT(record->number == nextNumber[record->producer]);
+        nextNumber[record->producer]++;
+        EsRing_pop(Ring);
+        numRecords++;
+    }
+
+    for (U_32 i = 0; i < NUM_PRODUCERS; i++) {
+        p_uthread_join(threads[i]);
+        p_uthread_unref(threads[i]);
+    }
+    ES_ASSERT(EsRing_peek(Ring) == NULL);
+    EsRing_free(Ring);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_new);
+    ES_RUN_TEST(test_pushPop);
+    ES_RUN_TEST(test_pushTakeAll);
+    ES_RUN_TEST(test_threads);
+    ES_RETURN_TEST_RESULTS();
+}
@@ -0,0 +1,114 @@
+#include "EsUnitTest.h"
+#include "EsSignal.h"
+
+#include "plibsys.h"
+
+static EsSignal *Signal;
+static volatile pint Value = 0;
+static volatile pint NumWoken = 0;
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Wait on the signal until the value is set
+ * @param arg unused
+ * @return NULL
+ */
+static void *waitForValue(void *arg) {
+    U_32 ticket;
+
+    ES_UNUSED(arg);
+    do {
+        ticket = EsSignal_prepareWait(Signal);
+        if (p_atomic_int_get(&Value) != 0) {
+            EsSignal_cancelWait(Signal);
+            break;
+        }
+        EsSignal_wait(Signal, ticket);
+    } while (TRUE);
+    p_atomic_int_inc(&NumWoken);
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test new/free
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_newFree() {
+    EsSignal *signal = EsSignal_new();
+
+    ES_DENY(signal == NULL);
+    EsSignal_free(signal);
+    EsSignal_free(NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test that a notify after the ticket ends the wait
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_notifyBeforeWait() {
+    U_32 ticket;
+
+    Signal = EsSignal_new();
+    ticket = EsSignal_prepareWait(Signal);
+    EsSignal_notifyAll(Signal);
+    /* Must not block */
+    EsSignal_wait(Signal, ticket);
+
+    /* Notify without waiters is a no-op */
+    EsSignal_notifyAll(Signal);
+    EsSignal_notifyAll(NULL);
+    EsSignal_free(Signal);
+    return TRUE;
+}
+
+/**
+ * @brief Test that all waiting threads are woken up
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_notifyAllWaiters() {
+    PUThread *waiters[4];
+
+    Value = 0;
+    NumWoken = 0;
+    Signal = EsSignal_new();
+    for (U_32 i = 0; i < 4; i++) {
+        waiters[i] = p_uthread_create((PUThreadFunc) waitForValue, NULL, TRUE);
+        ES_DENY(waiters[i] == NULL);
+    }
+    p_uthread_sleep(10);
+    ES_ASSERT(p_atomic_int_get(&NumWoken) == 0);
+
+    p_atomic_int_set(&Value, 1);
+    EsSignal_notifyAll(Signal);
+    for (U_32 i = 0; i < 4; i++) {
+        p_uthread_join(waiters[i]);
+        p_uthread_unref(waiters[i]);
+    }
+    ES_ASSERT(p_atomic_int_get(&NumWoken) == 4);
+    EsSignal_free(Signal);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_newFree);
+    ES_RUN_TEST(test_notifyBeforeWait);
+    ES_RUN_TEST(test_notifyAllWaiters);
+    ES_RETURN_TEST_RESULTS();
+}
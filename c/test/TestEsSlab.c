@@ -0,0 +1,134 @@
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsSlab.h"
+
+static EsSlab *Slab;
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Thread-Function that allocates and releases blocks
+ * @param arg number of rounds
+ * @return NULL
+ */
+static void *allocReleaseBlocks(void *arg) {
+    U_32 numRounds = (U_32) (U_PTR) arg;
+    U_64 *blocks[8];
+
+    for (U_32 round = 0; round < numRounds; round++) {
+        for (U_32 i = 0; i < 8; i++) {
+            blocks[i] = (U_64 *) EsSlab_alloc(Slab);
+            *blocks[i] = round;
+        }
+        for (U_32 i = 0; i < 8; i++) {
+            EsSlab_release(Slab, blocks[i]);
+        }
+    }
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test new/free and the aligned block size
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_newFree() {
+    EsSlabStats stats;
+
+    Slab = EsSlab_new(13, 4);
+    ES_DENY(Slab == NULL);
+    EsSlab_getStats(Slab, &stats);
+    ES_ASSERT(stats.blockSize == 16);
+    ES_ASSERT(stats.numBlocks == 0);
+    ES_ASSERT(stats.numInUse == 0);
+    ES_ASSERT(stats.highWater == 0);
+    EsSlab_free(Slab);
+    EsSlab_free(NULL);
+
+    EsSlab_getStats(NULL, &stats);
+    ES_ASSERT(stats.blockSize == 0);
+    ES_ASSERT(EsSlab_alloc(NULL) == NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test blocks are recycled and the stats track occupancy
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_allocRelease() {
+    EsSlabStats stats;
+    void *blocks[6];
+    void *block;
+
+    Slab = EsSlab_new(24, 4);
+    for (U_32 i = 0; i < 6; i++) {
+        blocks[i] = EsSlab_alloc(Slab);
+        ES_DENY(blocks[i] == NULL);
+        memset(blocks[i], 0xFF, 24);
+    }
+    EsSlab_getStats(Slab, &stats);
+    ES_ASSERT(stats.numBlocks == 8);
+    ES_ASSERT(stats.numInUse == 6);
+    ES_ASSERT(stats.highWater == 6);
+
+    EsSlab_release(Slab, blocks[5]);
+    block = EsSlab_alloc(Slab);
+    ES_ASSERT(block == blocks[5]);
+
+    for (U_32 i = 0; i < 6; i++) {
+        EsSlab_release(Slab, blocks[i]);
+    }
+    EsSlab_getStats(Slab, &stats);
+    ES_ASSERT(stats.numBlocks == 8);
+    ES_ASSERT(stats.numInUse == 0);
+    ES_ASSERT(stats.highWater == 6);
+    EsSlab_free(Slab);
+    return TRUE;
+}
+
+/**
+ * @brief Test alloc/release from many threads
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_threads() {
+    EsSlabStats stats;
+    PUThread *threads[4];
+
+    Slab = EsSlab_new(sizeof(U_64), 16);
+    for (U_32 i = 0; i < 4; i++) {
+        threads[i] = p_uthread_create((PUThreadFunc) allocReleaseBlocks, (ppointer) (U_PTR) 1000, TRUE);
+        ES_DENY(threads[i] == NULL);
+    }
+    for (U_32 i = 0; i < 4; i++) {
+        p_uthread_join(threads[i]);
+        p_uthread_unref(threads[i]);
+    }
+    EsSlab_getStats(Slab, &stats);
+    ES_ASSERT(stats.numInUse == 0);
+    ES_ASSERT(stats.highWater <= 32);
+    ES_ASSERT(stats.numBlocks <= 32);
+    EsSlab_free(Slab);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_newFree);
+    ES_RUN_TEST(test_allocRelease);
+    ES_RUN_TEST(test_threads);
+    ES_RETURN_TEST_RESULTS();
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsTopicTable.h"
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief State used by the tests
+ */
+typedef struct _TestState TestState;
+struct _TestState {
+    U_64 count;
+    U_32 id;
+};
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test adding and finding topic names
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_atOrAdd() {
+    EsTopicTable *table;
+    TestState *state;
+
+    ES_ASSERT(EsTopicTable_new(sizeof(TestState), 0) == NULL);
+    table = EsTopicTable_new(sizeof(TestState), 16);
+    ES_DENY(table == NULL);
+    ES_ASSERT(EsTopicTable_at(table, "a/b", 0) == NULL);
+
+    state = (TestState *) EsTopicTable_atOrAdd(table, "a/b", 0);
+    ES_DENY(state == NULL);
+    ES_ASSERT(state->count == 0 && state->id == 0);
+    ES_ASSERT(((U_PTR) state % sizeof(U_64)) == 0);
+    state->id = 1;
+    ES_ASSERT(EsTopicTable_getSize(table) == 1);
+
+    /* Same topic name, with or without a length */
+    ES_ASSERT(EsTopicTable_at(table, "a/b", 0) == state);
+    ES_ASSERT(EsTopicTable_atOrAdd(table, "a/b/c", 3) == state);
+    ES_ASSERT(EsTopicTable_getSize(table) == 1);
+
+    /* Prefixes and extensions are other topic names */
+    ES_ASSERT(EsTopicTable_at(table, "a/", 0) == NULL);
+    ES_ASSERT(EsTopicTable_at(table, "a/bc", 0) == NULL);
+    state = (TestState *) EsTopicTable_atOrAdd(table, "a/bc", 0);
+    ES_ASSERT(state->id == 0);
+    ES_ASSERT(EsTopicTable_getSize(table) == 2);
+
+    EsTopicTable_free(table);
+    EsTopicTable_free(NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test the table grows, and is capped at maxTopics
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_grow() {
+    EsTopicTable *table;
+    TestState *state;
+    char topic[32];
+
+    table = EsTopicTable_new(sizeof(TestState), 1000);
+    for (U_32 i = 0; i < 1000; i++) {
+        snprintf(topic, sizeof(topic), "sensors/%u/temp", i);
+        state = (TestState *) EsTopicTable_atOrAdd(table, topic, 0);
+        ES_DENY(state == NULL);
+        state->id = i;
+    }
+    ES_ASSERT(EsTopicTable_getSize(table) == 1000);
+    ES_ASSERT(EsTopicTable_atOrAdd(table, "sensors/1000/temp", 0) == NULL);
+    ES_ASSERT(EsTopicTable_getSize(table) == 1000);
+
+    for (U_32 i = 0; i < 1000; i++) {
+        snprintf(topic, sizeof(topic), "sensors/%u/temp", i);
+        state = (TestState *) EsTopicTable_at(table, topic, 0);
+        ES_DENY(state == NULL);
+        ES_ASSERT(state->id == i);
+    }
+    EsTopicTable_free(table);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_atOrAdd);
+    ES_RUN_TEST(test_grow);
+    ES_RETURN_TEST_RESULTS();
+}
@@ -0,0 +1,148 @@
+#include <string.h>
+
+#include "EsUnitTest.h"
+#include "EsTopicTrie.h"
+
+/*******************/
+/*  U T I L I T Y  */
+/*******************/
+
+/**
+ * @brief Match function that answers the value of the matching filter
+ * @param value
+ * @param userData [output] char **
+ */
+static void copyValue(void *value, void *userData) {
+    *(char **) userData = (char *) value;
+}
+
+/**
+ * @brief Answer the value (filter) that matches the topic
+ * @param trie
+ * @param topic
+ * @return filter or NULL if no match
+ */
+static char *matchTopic(EsTopicTrie *trie, const char *topic) {
+    char *value = NULL;
+
+    EsTopicTrie_match(trie, topic, 0, copyValue, &value);
+    return value;
+}
+
+/**
+ * @brief Add the filter with itself as the value
+ * @param trie
+ * @param filter
+ * @return TRUE if added, FALSE otherwise
+ */
+static BOOLEAN putFilter(EsTopicTrie *trie, const char *filter) {
+    return EsTopicTrie_put(trie, filter, (void *) filter, NULL);
+}
+
+/*****************/
+/*   T E S T S   */
+/*****************/
+
+/**
+ * @brief Test filter validation
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_validFilter() {
+    ES_ASSERT(EsTopicTrie_isValidFilter("a/b/c"));
+    ES_ASSERT(EsTopicTrie_isValidFilter("a/+/c"));
+    ES_ASSERT(EsTopicTrie_isValidFilter("#"));
+    ES_ASSERT(EsTopicTrie_isValidFilter("+/+"));
+    ES_ASSERT(EsTopicTrie_isValidFilter("/a/"));
+    ES_DENY(EsTopicTrie_isValidFilter(NULL));
+    ES_DENY(EsTopicTrie_isValidFilter(""));
+    ES_DENY(EsTopicTrie_isValidFilter("a/#/c"));
+    ES_DENY(EsTopicTrie_isValidFilter("a/b#"));
+    ES_DENY(EsTopicTrie_isValidFilter("a/b+/c"));
+    return TRUE;
+}
+
+/**
+ * @brief Test matching with and without wildcards
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_match() {
+    EsTopicTrie *trie = EsTopicTrie_new();
+    const char *topic = "a/b/c/d";
+
+    ES_DENY(trie == NULL);
+    ES_ASSERT(matchTopic(trie, "a") == NULL);
+
+    ES_ASSERT(putFilter(trie, "a/b/c"));
+    ES_ASSERT(putFilter(trie, "a/+/c"));
+    ES_ASSERT(putFilter(trie, "a/#"));
+    ES_ASSERT(putFilter(trie, "+/x"));
+    ES_ASSERT(EsTopicTrie_getSize(trie) == 4);
+
+    /* Most specific filter wins */
+    ES_ASSERT(strcmp(matchTopic(trie, "a/b/c"), "a/b/c") == 0);
+    ES_ASSERT(strcmp(matchTopic(trie, "a/z/c"), "a/+/c") == 0);
+    ES_ASSERT(strcmp(matchTopic(trie, "a/z/q"), "a/#") == 0);
+    ES_ASSERT(strcmp(matchTopic(trie, "a"), "a/#") == 0);
+    ES_ASSERT(strcmp(matchTopic(trie, "a/x"), "a/#") == 0);
+    ES_ASSERT(strcmp(matchTopic(trie, "b/x"), "+/x") == 0);
+    ES_ASSERT(matchTopic(trie, "b/y") == NULL);
+    ES_ASSERT(matchTopic(trie, "b") == NULL);
+
+    /* Length limited topic (not null-terminated) */
+    ES_ASSERT(EsTopicTrie_match(trie, topic, 5, NULL, NULL));
+    ES_ASSERT(EsTopicTrie_match(trie, "b/xy", 3, NULL, NULL));
+
+    /* Wildcards at the first level skip $ topics */
+    ES_ASSERT(putFilter(trie, "#"));
+    ES_ASSERT(strcmp(matchTopic(trie, "q/r"), "#") == 0);
+    ES_ASSERT(matchTopic(trie, "$SYS/x") == NULL);
+    ES_ASSERT(putFilter(trie, "$SYS/#"));
+    ES_ASSERT(strcmp(matchTopic(trie, "$SYS/x"), "$SYS/#") == 0);
+
+    EsTopicTrie_free(trie, NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test replace and remove
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_remove() {
+    EsTopicTrie *trie = EsTopicTrie_new();
+    void *oldValue = NULL;
+    int a, b;
+
+    ES_ASSERT(EsTopicTrie_put(trie, "a/+/c", &a, &oldValue));
+    ES_ASSERT(oldValue == NULL);
+    ES_ASSERT(EsTopicTrie_put(trie, "a/+/c", &b, &oldValue));
+    ES_ASSERT(oldValue == &a);
+    ES_ASSERT(EsTopicTrie_getSize(trie) == 1);
+    ES_ASSERT(EsTopicTrie_put(trie, "a/+", &a, NULL));
+
+    ES_ASSERT(EsTopicTrie_remove(trie, "a/+/c") == &b);
+    ES_ASSERT(EsTopicTrie_remove(trie, "a/+/c") == NULL);
+    ES_ASSERT(EsTopicTrie_remove(trie, "a") == NULL);
+    ES_DENY(EsTopicTrie_match(trie, "a/b/c", 0, NULL, NULL));
+    ES_ASSERT(EsTopicTrie_match(trie, "a/b", 0, NULL, NULL));
+    ES_ASSERT(EsTopicTrie_remove(trie, "a/+") == &a);
+    ES_ASSERT(EsTopicTrie_getSize(trie) == 0);
+    ES_DENY(EsTopicTrie_match(trie, "a/b", 0, NULL, NULL));
+
+    EsTopicTrie_free(trie, NULL);
+    return TRUE;
+}
+
+/**************************/
+/*   T E S T  S U I T E   */
+/**************************/
+
+/**
+ * Run all Tests
+ * @return 0 on Pass, -1 on Fail
+ */
+int main() {
+    ES_RUN_TEST(test_validFilter);
+    ES_RUN_TEST(test_match);
+    ES_RUN_TEST(test_remove);
+    ES_RETURN_TEST_RESULTS();
+}
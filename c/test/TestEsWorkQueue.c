@@ -3,6 +3,10 @@
 #include "EsWorkTask.h"
 
 static U_PTR Counter = 0;
+static volatile pint AtomicCounter = 0;
+static volatile pint GateOpen = FALSE;
+static volatile pint FreeCounter = 0;
+static volatile pint AcceptedCounter = 0;
 static EsWorkQueue *Queue;
 static pboolean FreeFuncCalled = FALSE;
 
@@ -19,6 +23,58 @@ static void counterWorkTaskFunc(EsWorkTask *task) {
     Counter += incAmount;
 }
 
+/**
+ * @brief Thread-safe work function to execute for tasks
+ * @note Used by queues with multiple consumers
+ * @param task
+ */
+static void atomicCounterWorkTaskFunc(EsWorkTask *task) {
+    ES_UNUSED(task);
+    p_atomic_int_inc(&AtomicCounter);
+}
+
+/**
+ * @brief Work function that blocks the consumer until the gate is open
+ * @param task
+ */
+static void gateWorkTaskFunc(EsWorkTask *task) {
+    ES_UNUSED(task);
+    while (!p_atomic_int_get(&GateOpen)) {
+        p_uthread_sleep(1);
+    }
+}
+
+/**
+ * @brief Free Data function that counts the frees
+ * @param data
+ */
+static void countingFreeWorkTaskDataFunc(void *data) {
+    ES_UNUSED(data);
+    p_atomic_int_inc(&FreeCounter);
+}
+
+/**
+ * @brief Answer a new ring queue whose consumer is blocked on the gate
+ * @param capacity of the ring
+ * @param policy when full
+ * @return queue
+ */
+static EsWorkQueue *newBlockedRingQueue(char *capacity, char *policy) {
+    EsWorkQueue *queue;
+
+    GateOpen = FALSE;
+    queue = EsWorkQueue_new(ESQ_TYPE_RING_BUFFER);
+    EsProperties_atPut(EsWorkQueue_getProperties(queue), ESQ_PROP_CAPACITY, capacity);
+    EsProperties_atPut(EsWorkQueue_getProperties(queue), ESQ_PROP_FULL_POLICY, policy);
+    EsWorkQueue_init(queue);
+    EsWorkQueue_submit(queue, EsWorkTask_newInit(gateWorkTaskFunc, NULL));
+    /* Wait for the consumer to take the gate task */
+    while (EsWorkQueue_getSize(queue) != 0) {
+        p_uthread_sleep(1);
+    }
+    return queue;
+}
+
 /**
  * @brief Free Data function that only simulates a free
  * @param data
@@ -44,6 +100,44 @@ static void *produceCounterIncrementer(void *arg) {
     return NULL;
 }
 
+/**
+ * @brief Thread-Function
+ * @param arg
+ * @return Exit code after thread is done
+ */
+static void *produceAtomicCounterIncrementer(void *arg) {
+    int numTasks = (U_32) (U_PTR) arg;
+    for (int i = 0; i < numTasks; i++) {
+        EsWorkTask *task = NULL;
+
+        task = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+        EsWorkQueue_submit(Queue, task);
+    }
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/**
+ * @brief Thread-Function that submits tasks until the queue rejects one
+ * @param arg unused
+ * @return Exit code after thread is done
+ */
+static void *produceUntilRejected(void *arg) {
+    EsWorkTask *task;
+
+    ES_UNUSED(arg);
+    do {
+        task = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+        if (!EsWorkQueue_submit(Queue, task)) {
+            EsWorkTask_free(task);
+            break;
+        }
+        p_atomic_int_inc(&AcceptedCounter);
+    } while (TRUE);
+    p_uthread_exit(0);
+    return NULL;
+}
+
 /*****************/
 /*   T E S T S   */
 /*****************/
@@ -130,6 +224,309 @@ static pboolean test_sync_separateThreadProducer() {
     return TRUE;
 }
 
+/**
+ * @brief Test execution of tasks produced in the test
+ * thread and consumed by the THREAD_POOL workers
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_pool_currentThreadProducer() {
+    U_32 numTasks = 10000;
+
+    AtomicCounter = 0;
+    Queue = EsWorkQueue_new(ESQ_TYPE_THREAD_POOL);
+    ES_ASSERT(Queue != NULL);
+    EsProperties_atPut(EsWorkQueue_getProperties(Queue), ESQ_PROP_NUM_THREADS, "4");
+    EsWorkQueue_init(Queue);
+    for (U_32 i = 0; i < numTasks; i++) {
+        EsWorkTask *task = NULL;
+
+        task = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+        ES_ASSERT(EsWorkQueue_submit(Queue, task));
+    }
+    EsWorkQueue_shutdown(Queue);
+    ES_ASSERT(EsWorkQueue_getSize(Queue) == 0);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == (pint) numTasks);
+    EsWorkQueue_free(Queue);
+    return TRUE;
+}
+
+/**
+ * @brief Test execution of tasks that are produced
+ * in separate threads for type THREAD_POOL
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_pool_separateThreadProducers() {
+    U_32 numTasks = 10000;
+    PUThread *producers[4];
+
+    AtomicCounter = 0;
+    Queue = EsWorkQueue_new(ESQ_TYPE_THREAD_POOL);
+    EsWorkQueue_init(Queue);
+
+    for (U_32 i = 0; i < 4; i++) {
+        producers[i] = p_uthread_create((PUThreadFunc) produceAtomicCounterIncrementer,
+                                        (ppointer) (U_PTR) numTasks, TRUE);
+        ES_DENY(producers[i] == NULL);
+    }
+    for (U_32 i = 0; i < 4; i++) {
+        p_uthread_join(producers[i]);
+        p_uthread_unref(producers[i]);
+    }
+    EsWorkQueue_free(Queue);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == (pint) (numTasks * 4));
+    return TRUE;
+}
+
+/**
+ * @brief Test that tasks submitted before init are run
+ * and tasks submitted after shutdown are rejected
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_pool_lifecycle() {
+    EsWorkTask *task;
+
+    AtomicCounter = 0;
+    Queue = EsWorkQueue_new(ESQ_TYPE_THREAD_POOL);
+    task = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+    ES_ASSERT(EsWorkQueue_submit(Queue, task));
+    ES_ASSERT(EsWorkQueue_getSize(Queue) == 1);
+    EsWorkQueue_init(Queue);
+    EsWorkQueue_shutdown(Queue);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 1);
+
+    /* Rejected tasks remain owned by the caller */
+    task = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+    ES_DENY(EsWorkQueue_submit(Queue, task));
+    EsWorkTask_free(task);
+    EsWorkQueue_free(Queue);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 1);
+    return TRUE;
+}
+
+/**
+ * @brief Test execution of tasks produced in separate
+ * threads and consumed by the RING_BUFFER consumer
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_ring_separateThreadProducers() {
+    U_32 numTasks = 10000;
+    PUThread *producers[4];
+    EsWorkTask *task;
+
+    AtomicCounter = 0;
+    Queue = EsWorkQueue_new(ESQ_TYPE_RING_BUFFER);
+    EsProperties_atPut(EsWorkQueue_getProperties(Queue), ESQ_PROP_CAPACITY, "100");
+
+    /* Tasks are rejected until init */
+    task = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+    ES_DENY(EsWorkQueue_submit(Queue, task));
+    EsWorkTask_free(task);
+    EsWorkQueue_init(Queue);
+
+    for (U_32 i = 0; i < 4; i++) {
+        producers[i] = p_uthread_create((PUThreadFunc) produceAtomicCounterIncrementer,
+                                        (ppointer) (U_PTR) numTasks, TRUE);
+        ES_DENY(producers[i] == NULL);
+    }
+    for (U_32 i = 0; i < 4; i++) {
+        p_uthread_join(producers[i]);
+        p_uthread_unref(producers[i]);
+    }
+    EsWorkQueue_shutdown(Queue);
+    ES_ASSERT(EsWorkQueue_getSize(Queue) == 0);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == (pint) (numTasks * 4));
+    EsWorkQueue_free(Queue);
+    return TRUE;
+}
+
+/**
+ * @brief Test that every task a RING_BUFFER accepted while
+ * it was shutting down still runs
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_ring_shutdownWhileProducing() {
+    PUThread *producers[4];
+
+    AtomicCounter = 0;
+    AcceptedCounter = 0;
+    Queue = EsWorkQueue_new(ESQ_TYPE_RING_BUFFER);
+    EsProperties_atPut(EsWorkQueue_getProperties(Queue), ESQ_PROP_CAPACITY, "16");
+    EsWorkQueue_init(Queue);
+    for (U_32 i = 0; i < 4; i++) {
+        producers[i] = p_uthread_create((PUThreadFunc) produceUntilRejected, NULL, TRUE);
+        ES_DENY(producers[i] == NULL);
+    }
+    p_uthread_sleep(10);
+    EsWorkQueue_shutdown(Queue);
+    for (U_32 i = 0; i < 4; i++) {
+        p_uthread_join(producers[i]);
+        p_uthread_unref(producers[i]);
+    }
+    ES_ASSERT(EsWorkQueue_getSize(Queue) == 0);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == p_atomic_int_get(&AcceptedCounter));
+    EsWorkQueue_free(Queue);
+    return TRUE;
+}
+
+/**
+ * @brief Test the RING_BUFFER reject policy
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_ring_rejectPolicy() {
+    EsWorkTask *task;
+
+    AtomicCounter = 0;
+    Queue = newBlockedRingQueue("4", ESQ_FULL_POLICY_REJECT);
+    for (U_32 i = 0; i < 4; i++) {
+        ES_ASSERT(EsWorkQueue_submit(Queue, EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL)));
+    }
+    ES_ASSERT(EsWorkQueue_getSize(Queue) == 4);
+    task = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+    ES_DENY(EsWorkQueue_submit(Queue, task));
+    EsWorkTask_free(task);
+
+    p_atomic_int_set(&GateOpen, TRUE);
+    EsWorkQueue_free(Queue);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 4);
+    return TRUE;
+}
+
+/**
+ * @brief Test the RING_BUFFER drop oldest policy
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_ring_dropOldestPolicy() {
+    EsWorkTask *task;
+
+    AtomicCounter = 0;
+    FreeCounter = 0;
+    Queue = newBlockedRingQueue("4", ESQ_FULL_POLICY_DROP_OLDEST);
+    for (U_32 i = 0; i < 6; i++) {
+        task = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+        EsWorkTask_setFreeUserDataFunc(task, countingFreeWorkTaskDataFunc);
+        ES_ASSERT(EsWorkQueue_submit(Queue, task));
+    }
+    ES_ASSERT(EsWorkQueue_getSize(Queue) == 4);
+    ES_ASSERT(p_atomic_int_get(&FreeCounter) == 2);
+
+    p_atomic_int_set(&GateOpen, TRUE);
+    EsWorkQueue_free(Queue);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 4);
+    ES_ASSERT(p_atomic_int_get(&FreeCounter) == 6);
+    return TRUE;
+}
+
+/**
+ * @brief Test that a RING_BUFFER producer under the block policy
+ * sleeps until the consumer makes room
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_ring_blockPolicy() {
+    PUThread *producer;
+
+    AtomicCounter = 0;
+    Queue = newBlockedRingQueue("2", ESQ_FULL_POLICY_BLOCK);
+    producer = p_uthread_create((PUThreadFunc) produceAtomicCounterIncrementer, (ppointer) (U_PTR) 3, TRUE);
+    ES_DENY(producer == NULL);
+    p_uthread_sleep(20);
+    ES_ASSERT(EsWorkQueue_getSize(Queue) == 2);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 0);
+
+    p_atomic_int_set(&GateOpen, TRUE);
+    p_uthread_join(producer);
+    p_uthread_unref(producer);
+    EsWorkQueue_waitUntilIdle(Queue);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 3);
+    EsWorkQueue_free(Queue);
+    return TRUE;
+}
+
+/**
+ * @brief Test waiting until all submitted tasks have finished
+ * for each queue type
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_waitUntilIdle() {
+    enum EsWorkQueueType types[] = {ESQ_TYPE_SYNCHRONOUS, ESQ_TYPE_THREAD_POOL, ESQ_TYPE_RING_BUFFER};
+
+    for (U_32 t = 0; t < 3; t++) {
+        AtomicCounter = 0;
+        Queue = EsWorkQueue_new(types[t]);
+        EsWorkQueue_init(Queue);
+
+        /* Idle queue answers right away */
+        EsWorkQueue_waitUntilIdle(Queue);
+        for (U_32 i = 0; i < 1000; i++) {
+            ES_ASSERT(EsWorkQueue_submit(Queue, EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL)));
+        }
+        EsWorkQueue_waitUntilIdle(Queue);
+        ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 1000);
+        ES_ASSERT(EsWorkQueue_getSize(Queue) == 0);
+        EsWorkQueue_free(Queue);
+    }
+    EsWorkQueue_waitUntilIdle(NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test submitting many tasks in one operation
+ * for each queue type
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_submitAll() {
+    enum EsWorkQueueType types[] = {ESQ_TYPE_SYNCHRONOUS, ESQ_TYPE_THREAD_POOL, ESQ_TYPE_RING_BUFFER};
+    EsWorkTask *tasks[100];
+
+    for (U_32 t = 0; t < 3; t++) {
+        AtomicCounter = 0;
+        Queue = EsWorkQueue_new(types[t]);
+        EsProperties_atPut(EsWorkQueue_getProperties(Queue), ESQ_PROP_CAPACITY, "64");
+        EsWorkQueue_init(Queue);
+        for (U_32 round = 0; round < 10; round++) {
+            for (U_32 i = 0; i < 100; i++) {
+                tasks[i] = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+            }
+            ES_ASSERT(EsWorkQueue_submitAll(Queue, tasks, 100) == 100);
+        }
+        ES_ASSERT(EsWorkQueue_submitAll(Queue, tasks, 0) == 0);
+        EsWorkQueue_waitUntilIdle(Queue);
+        ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 1000);
+
+        /* Rejected tasks remain owned by the caller */
+        EsWorkQueue_shutdown(Queue);
+        tasks[0] = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+        ES_ASSERT(EsWorkQueue_submitAll(Queue, tasks, 1) == 0);
+        EsWorkTask_free(tasks[0]);
+        EsWorkQueue_free(Queue);
+    }
+    ES_ASSERT(EsWorkQueue_submitAll(NULL, tasks, 1) == 0);
+    return TRUE;
+}
+
+/**
+ * @brief Test that a RING_BUFFER under the reject policy
+ * accepts the tasks that fit and leaves the rest to the caller
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_ring_submitAllPartial() {
+    EsWorkTask *tasks[6];
+
+    AtomicCounter = 0;
+    Queue = newBlockedRingQueue("4", ESQ_FULL_POLICY_REJECT);
+    for (U_32 i = 0; i < 6; i++) {
+        tasks[i] = EsWorkTask_newInit(atomicCounterWorkTaskFunc, NULL);
+    }
+    ES_ASSERT(EsWorkQueue_submitAll(Queue, tasks, 6) == 4);
+    ES_ASSERT(EsWorkQueue_getSize(Queue) == 4);
+    EsWorkTask_free(tasks[4]);
+    EsWorkTask_free(tasks[5]);
+
+    p_atomic_int_set(&GateOpen, TRUE);
+    EsWorkQueue_free(Queue);
+    ES_ASSERT(p_atomic_int_get(&AtomicCounter) == 4);
+    return TRUE;
+}
+
 /**************************/
 /*   T E S T  S U I T E   */
 /**************************/
@@ -142,5 +539,16 @@ int main() {
     ES_RUN_TEST(test_newFree);
     ES_RUN_TEST(test_sync_currentThreadProducer);
     ES_RUN_TEST(test_sync_separateThreadProducer);
+    ES_RUN_TEST(test_pool_currentThreadProducer);
+    ES_RUN_TEST(test_pool_separateThreadProducers);
+    ES_RUN_TEST(test_pool_lifecycle);
+    ES_RUN_TEST(test_ring_separateThreadProducers);
+    ES_RUN_TEST(test_ring_shutdownWhileProducing);
+    ES_RUN_TEST(test_ring_rejectPolicy);
+    ES_RUN_TEST(test_ring_dropOldestPolicy);
+    ES_RUN_TEST(test_ring_blockPolicy);
+    ES_RUN_TEST(test_waitUntilIdle);
+    ES_RUN_TEST(test_submitAll);
+    ES_RUN_TEST(test_ring_submitAllPartial);
     ES_RETURN_TEST_RESULTS();
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 
 static U_PTR Counter = 0;
 static pboolean FreeFuncCalled = FALSE;
+static EsWorkTaskPool *Pool;
+static volatile pint TasksCached;
+static volatile pint PoolFreed;
 
 /*******************/
 /*  U T I L I T Y  */
@@ -27,6 +30,40 @@ static void noOpFreeWorkTaskDataFunc(void *data) {
     FreeFuncCalled = TRUE;
 }
 
+/**
+ * @brief Thread-Function that acquires tasks from the Pool
+ * @param arg EsWorkTask** array to fill (64 tasks)
+ * @return NULL
+ */
+static void *acquireTasks(void *arg) {
+    EsWorkTask **tasks = (EsWorkTask **) arg;
+
+    for (U_32 i = 0; i < 64; i++) {
+        tasks[i] = EsWorkTaskPool_acquireInit(Pool, counterWorkTaskFunc, (void *) (U_PTR) 1);
+    }
+    p_uthread_exit(0);
+    return NULL;
+}
+
+/**
+ * @brief Thread-Function that caches tasks and exits after the Pool was freed
+ * @param arg unused
+ * @return NULL
+ */
+static void *cacheTasksThenOutlivePool(void *arg) {
+    ES_UNUSED(arg);
+    for (U_32 i = 0; i < 8; i++) {
+        EsWorkTask_release(EsWorkTaskPool_acquire(Pool));
+    }
+    p_atomic_int_set(&TasksCached, TRUE);
+    while (!p_atomic_int_get(&PoolFreed)) {
+        p_uthread_yield();
+    }
+    /* Thread exit hooks may still run for the cache */
+    p_uthread_exit(0);
+    return NULL;
+}
+
 /*****************/
 /*   T E S T S   */
 /*****************/
@@ -129,6 +166,109 @@ static pboolean test_run() {
     return TRUE;
 }
 
+/**
+ * @brief Test acquire/release of pooled tasks on one thread
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_poolSameThread() {
+    EsWorkTask *task;
+    EsWorkTask *first;
+
+    Pool = EsWorkTaskPool_new();
+    ES_DENY(Pool == NULL);
+    ES_ASSERT(EsWorkTaskPool_acquire(NULL) == NULL);
+
+    /* First acquire has to allocate */
+    first = EsWorkTaskPool_acquireInit(Pool, counterWorkTaskFunc, (void *) (U_PTR) 5);
+    ES_ASSERT(EsWorkTaskPool_getNumMisses(Pool) == 1);
+    ES_ASSERT(EsWorkTaskPool_getNumHits(Pool) == 0);
+    EsWorkTask_setFreeUserDataFunc(first, noOpFreeWorkTaskDataFunc);
+
+    Counter = 0;
+    FreeFuncCalled = FALSE;
+    EsWorkTask_run(first);
+    EsWorkTask_release(first);
+    ES_ASSERT(Counter == 5);
+    ES_ASSERT(FreeFuncCalled);
+
+    /* Released task is recycled zeroed */
+    task = EsWorkTaskPool_acquire(Pool);
+    ES_ASSERT(task == first);
+    ES_ASSERT(EsWorkTask_getRunFunc(task) == NULL);
+    ES_ASSERT(EsWorkTask_getUserData(task) == NULL);
+    ES_ASSERT(EsWorkTask_getFreeUserDataFunc(task) == NULL);
+    ES_ASSERT(EsWorkTaskPool_getNumHits(Pool) == 1);
+    ES_ASSERT(EsWorkTaskPool_getNumMisses(Pool) == 1);
+
+    /* Pooled tasks can still be freed */
+    EsWorkTask_free(task);
+
+    /* Unpooled tasks are freed on release */
+    EsWorkTask_release(EsWorkTask_new());
+    EsWorkTask_release(NULL);
+
+    EsWorkTaskPool_free(Pool);
+    EsWorkTaskPool_free(NULL);
+    return TRUE;
+}
+
+/**
+ * @brief Test tasks acquired on one thread and released on another
+ * @note The released tasks must flow back to the acquiring thread
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_poolCrossThread() {
+    EsWorkTask *tasks[64];
+    PUThread *producer;
+
+    Pool = EsWorkTaskPool_new();
+    for (U_32 round = 0; round < 4; round++) {
+        producer = p_uthread_create((PUThreadFunc) acquireTasks, (ppointer) tasks, TRUE);
+        ES_DENY(producer == NULL);
+        p_uthread_join(producer);
+        p_uthread_unref(producer);
+
+        Counter = 0;
+        for (U_32 i = 0; i < 64; i++) {
+            ES_DENY(tasks[i] == NULL);
+            EsWorkTask_run(tasks[i]);
+            EsWorkTask_release(tasks[i]);
+        }
+        ES_ASSERT(Counter == 64);
+    }
+    /*
+     * The releasing thread keeps a full cache (64) and spills the rest,
+     * so only the first 2 rounds have to allocate
+     */
+    ES_ASSERT(EsWorkTaskPool_getNumMisses(Pool) == 64 * 2);
+    ES_ASSERT(EsWorkTaskPool_getNumHits(Pool) == 64 * 2);
+    EsWorkTaskPool_free(Pool);
+    return TRUE;
+}
+
+/**
+ * @brief Test a thread with a cache that exits after the pool was freed
+ * @note Its cache must stay valid until its thread exit hook
+ * @return TRUE if tests passes, FALSE otherwise
+ */
+static pboolean test_poolCacheOutlivesPool() {
+    PUThread *thread;
+
+    Pool = EsWorkTaskPool_new();
+    TasksCached = FALSE;
+    PoolFreed = FALSE;
+    thread = p_uthread_create((PUThreadFunc) cacheTasksThenOutlivePool, NULL, TRUE);
+    ES_DENY(thread == NULL);
+    while (!p_atomic_int_get(&TasksCached)) {
+        p_uthread_yield();
+    }
+    EsWorkTaskPool_free(Pool);
+    p_atomic_int_set(&PoolFreed, TRUE);
+    p_uthread_join(thread);
+    p_uthread_unref(thread);
+    return TRUE;
+}
+
 /**************************/
 /*   T E S T  S U I T E   */
 /**************************/
@@ -142,5 +282,8 @@ int main() {
     ES_RUN_TEST(test_accessors);
     ES_RUN_TEST(test_properties);
     ES_RUN_TEST(test_run);
+    ES_RUN_TEST(test_poolSameThread);
+    ES_RUN_TEST(test_poolCrossThread);
+    ES_RUN_TEST(test_poolCacheOutlivesPool);
     ES_RETURN_TEST_RESULTS();
 }
\ No newline at end of file